@@ -2,37 +2,37 @@
 
 #include <chrono>
 #include <future>
+#include <iostream>
 #include <glm/glm.hpp>
 
+#include "demo_scene.hpp"
 #include "input_controller.hpp"
 #include "../engine/vk_camera.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+#include "../engine/vk_frame_info.hpp"
+#include "../engine/vk_frame_stats.hpp"
 #include "../engine/vk_model.hpp"
+#include "../engine/vk_resolution_controller.hpp"
 #include "../renderer/vk_buffer.hpp"
+#include "../renderer/vk_clustered_lighting.hpp"
 #include "../renderer/vk_device.hpp"
+#include "../renderer/vk_gpu_profiler.hpp"
+#include "../renderer/vk_render_graph.hpp"
+#include "../renderer/vk_temporal_upscaler.hpp"
+#include "../renderer/simple_render_system/vk_deferred_lighting_system.hpp"
 #include "../renderer/simple_render_system/vk_point_light_system.hpp"
+#include "../renderer/simple_render_system/vk_shadow_system.hpp"
 #include "../renderer/simple_render_system/vk_simple_render_system.hpp"
 
 using vk_engine::application;
 
-struct global_ubo
-{
-	alignas(16) glm::mat4 projection{1.f};
-	alignas(16) glm::mat4 view{1.f};
-	alignas(16) glm::vec4 ambient_light_color{1.f, 1.f, 1.f, .2f};
-	alignas(16) glm::vec3 light_direction{
-		normalize(glm::vec3{1.f, -3.f, -1.f})
-	};
-	alignas(16) glm::vec3 point_light_position{-1.f};
-	alignas(16) glm::vec4 point_light_color{1.f, 1.f, 0.f, 1.f};
-};
-
 application::application()
 {
 	global_pool = vk_descriptor_pool::builder(device)
 	              .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
 	              .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
 	              .build();
-	load_game_objects();
+	load_demo_scene(device, game_objects);
 }
 
 application::~application() = default;
@@ -45,7 +45,7 @@ void application::run()
 	{
 		ubo_buffer = std::make_unique<vk_buffer>(
 			device,
-			sizeof global_ubo,
+			sizeof(global_ubo),
 			1,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
@@ -78,20 +78,263 @@ void application::run()
 	//camera.set_view_direction(glm::vec3{0.f}, glm::vec3{0.5f, 0.f, 1.f});
 	//camera.set_view_target(glm::vec3(-1, -2, -2), glm::vec3(0, 0, 2.5));
 
-	const vk_simple_render_system simple_render_system{
-		device, renderer.get_swap_chain_render_pass(), global_set_layout->get_descriptor_set_layout()
+	// the acquired image is handed over by the presentation engine through the acquire semaphore,
+	// which is waited on at color attachment output
+	vk_render_graph render_graph{device};
+	const auto swap_chain_image = render_graph.import_image("swap chain", {
+		                                                        renderer.get_swap_chain_image_format(),
+		                                                        VK_IMAGE_LAYOUT_UNDEFINED,
+		                                                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		                                                        0,
+		                                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		                                                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		                                                        0
+	                                                        });
+	// the scene is drawn into the top left of full size targets at the render scale and resolved up to the swap
+	// chain, so changing the scale every frame never recreates an image
+	const auto scene_color = render_graph.create_image("scene color", {renderer.get_swap_chain_image_format()});
+	const auto velocity = render_graph.create_image("velocity", {vk_temporal_upscaler::velocity_format});
+	const auto depth_image = render_graph.create_image("depth", {renderer.get_swap_chain_depth_format()});
+	// the deferred pass's g-buffer, only ever attachments of that pass
+	const auto albedo = render_graph.create_image("albedo", {vk_deferred_lighting_system::albedo_format});
+	const auto normal = render_graph.create_image("normal", {vk_deferred_lighting_system::normal_format});
+	// the temporal histories outlive the frame, the upscaler owns them and leaves both ready to be sampled
+	const auto history = render_graph.import_image("history", {
+		                                               vk_temporal_upscaler::history_format,
+		                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                                               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		                                               0,
+		                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                                               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		                                               VK_ACCESS_SHADER_READ_BIT
+	                                               });
+	// last sampled by the previous frame's resolve, its contents are overwritten
+	const auto next_history = render_graph.import_image("next history", {
+		                                                    vk_temporal_upscaler::history_format,
+		                                                    VK_IMAGE_LAYOUT_UNDEFINED,
+		                                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		                                                    0,
+		                                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		                                                    VK_ACCESS_SHADER_READ_BIT
+	                                                    });
+	// the light lists of the clusters, written by the gpu light assignment and read wherever lights are shaded
+	const auto cluster_ranges = render_graph.import_buffer("cluster ranges");
+	const auto light_indices = render_graph.import_buffer("light indices");
+	const auto assignment_pass = render_graph.add_pass("light assignment", [&](vk_render_graph::pass_builder& pass)
+	{
+		pass.write_buffer(cluster_ranges);
+		pass.write_buffer(light_indices);
+	});
+	// the cascade updates, every cascade layer is read by the passes that shade with shadows
+	vk_shadow_system shadow_system{device, pipeline_manager};
+	shadow_system.add_passes(render_graph);
+	const auto main_pass = render_graph.add_pass("main", [&](vk_render_graph::pass_builder& pass)
+	{
+		pass.write_color(scene_color, attachment_load_op::clear, {{0.1f, 0.1f, 0.1f, 1.0f}});
+		pass.write_color(velocity, attachment_load_op::clear, {{0.f, 0.f, 0.f, 0.f}});
+		pass.write_depth(depth_image);
+		pass.read_buffer(cluster_ranges);
+		pass.read_buffer(light_indices);
+		for (const auto cascade : shadow_system.get_cascade_resources())
+			pass.read_texture(cascade);
+	});
+	// the alternative to the main pass, one of them is enabled at a time
+	const auto deferred_pass = render_graph.add_pass("deferred", [&](vk_render_graph::pass_builder& pass)
+	{
+		pass.write_color(albedo, attachment_load_op::dont_care);
+		pass.write_color(normal, attachment_load_op::dont_care);
+		pass.write_color(velocity, attachment_load_op::clear, {{0.f, 0.f, 0.f, 0.f}});
+		pass.write_depth(depth_image);
+
+		// lighting, then the light billboards on top
+		pass.next_subpass();
+		pass.write_color(scene_color, attachment_load_op::clear, {{0.1f, 0.1f, 0.1f, 1.0f}});
+		pass.write_color(velocity);
+		pass.read_depth(depth_image);
+		pass.read_input(albedo);
+		pass.read_input(normal);
+		pass.read_input(depth_image);
+		pass.read_buffer(cluster_ranges);
+		pass.read_buffer(light_indices);
+		for (const auto cascade : shadow_system.get_cascade_resources())
+			pass.read_texture(cascade);
+	});
+	const auto resolve_pass = render_graph.add_pass("temporal resolve", [&](vk_render_graph::pass_builder& pass)
+	{
+		pass.read_texture(scene_color);
+		pass.read_texture(velocity);
+		pass.read_texture(history);
+		pass.write_color(next_history, attachment_load_op::dont_care);
+		pass.write_color(swap_chain_image);
+	});
+	render_graph.compile();
+	shadow_system.create_graph_pipeline();
+
+	// the light the billboard shows, shaded through the clusters like any other
+	vk_clustered_lighting clustered_lighting{device, pipeline_manager};
+	const std::vector<point_light> lights{{ubo.point_light_position, 10.f, ubo.point_light_color}};
+	// the cpu assignment uploads finished lists, there is nothing to dispatch
+	render_graph.set_pass_enabled(assignment_pass, clustered_lighting.get_assignment() == light_assignment::gpu);
+
+	// both write the velocity the resolve reprojects with
+	vk_simple_render_system simple_render_system{
+		device, pipeline_manager, render_graph.get_render_pass(main_pass),
+		global_set_layout->get_descriptor_set_layout(), clustered_lighting.get_descriptor_set_layout(),
+		shadow_system.get_descriptor_set_layout(), true
 	};
+	// the scene's static objects never change
+	simple_render_system.build_static_batch(game_objects);
 
-	const vk_point_light_system point_light_system{
-		device, renderer.get_swap_chain_render_pass(), global_set_layout->get_descriptor_set_layout()
+	vk_point_light_system point_light_system{
+		device, pipeline_manager, render_graph.get_render_pass(main_pass),
+		global_set_layout->get_descriptor_set_layout(), true
 	};
 
+	const VkRenderPass deferred_render_pass = render_graph.get_render_pass(deferred_pass);
+	simple_render_system.set_gbuffer_pass(deferred_render_pass, 0);
+	point_light_system.set_deferred_pass(deferred_render_pass, 1);
+	vk_deferred_lighting_system deferred_lighting_system{
+		device, pipeline_manager, deferred_render_pass, 1, global_set_layout->get_descriptor_set_layout(),
+		clustered_lighting.get_descriptor_set_layout(), shadow_system.get_descriptor_set_layout(), 2
+	};
+	bool deferred_shading = false;
+	render_graph.set_pass_enabled(deferred_pass, deferred_shading);
+
+	vk_temporal_upscaler temporal_upscaler{device, pipeline_manager, render_graph.get_render_pass(resolve_pass)};
+
+	vk_gpu_profiler gpu_profiler{device};
+	render_graph.set_profiler(&gpu_profiler);
+
+	// with temporal upscaling the scale stays in the range it reconstructs well from
+	vk_resolution_controller resolution_controller{};
+	const auto set_resolution_range = [&]
+	{
+		const auto& temporal = temporal_upscaler.get_config();
+		constexpr resolution_config defaults{};
+		if (temporal_upscaler.is_enabled())
+			resolution_controller.set_scale_range(temporal.min_render_scale, temporal.max_render_scale);
+		else
+			resolution_controller.set_scale_range(defaults.min_scale, defaults.max_scale);
+	};
+	set_resolution_range();
+	bool dynamic_resolution = true;
+	VkExtent2D render_extent = renderer.get_swap_chain_extent();
+	glm::mat4 previous_view_projection{1.f};
+	bool has_previous_view_projection = false;
+
+	render_graph.set_record(assignment_pass, [&](const vk_frame_info& frame_info)
+	{
+		clustered_lighting.record_assignment(frame_info.command_buffer, frame_info.frame_index);
+	});
+
+	render_graph.set_record(main_pass, [&](const vk_frame_info& frame_info)
+	{
+		{
+			const vk_gpu_scope scope{&gpu_profiler, frame_info.command_buffer, "render_game_objects"};
+			simple_render_system.render_game_objects(frame_info);
+		}
+		{
+			const vk_gpu_scope scope{&gpu_profiler, frame_info.command_buffer, "render_lights"};
+			point_light_system.render_lights(frame_info, lights);
+		}
+	});
+
+	render_graph.set_record(deferred_pass, 0, [&](const vk_frame_info& frame_info)
+	{
+		const vk_gpu_scope scope{&gpu_profiler, frame_info.command_buffer, "render_gbuffer"};
+		simple_render_system.render_gbuffer(frame_info);
+	});
+
+	render_graph.set_record(deferred_pass, 1, [&](const vk_frame_info& frame_info)
+	{
+		{
+			const vk_gpu_scope scope{&gpu_profiler, frame_info.command_buffer, "deferred_lighting"};
+			deferred_lighting_system.render(frame_info, render_extent, render_graph.get_image_view(albedo),
+			                                render_graph.get_image_view(normal),
+			                                render_graph.get_image_view(depth_image));
+		}
+		{
+			const vk_gpu_scope scope{&gpu_profiler, frame_info.command_buffer, "render_lights"};
+			point_light_system.render_deferred_lights(frame_info, lights);
+		}
+	});
+
+	render_graph.set_record(resolve_pass, [&](const vk_frame_info& frame_info)
+	{
+		temporal_upscaler.resolve(frame_info, render_graph.get_image_view(scene_color),
+		                          render_graph.get_image_view(velocity));
+	});
+
 	auto current_time = std::chrono::high_resolution_clock::now();
+	vk_cpu_profiler::get().set_thread_name("main");
+	bool dump_trace_key_down = false;
+	bool depth_prepass_key_down = false;
+	bool dynamic_resolution_key_down = false;
+	bool temporal_upscaling_key_down = false;
+	bool deferred_shading_key_down = false;
+
+	// ten seconds at 60 fps, reported every five to the log and frame_stats.csv
+	vk_frame_stats frame_stats{600, 5.0, "frame_stats.csv"};
 
 	while (!window.should_close())
 	{
+		VK_PROFILE_SCOPE("frame");
 		glfwPollEvents();
 
+		// on release, so one press writes one trace
+		const bool dump_trace_key = glfwGetKey(window.get_glfw_window(), cam_controller.keys.dump_trace) == GLFW_PRESS;
+		if (dump_trace_key_down && !dump_trace_key)
+		{
+			if (vk_cpu_profiler::get().dump_trace("trace.json"))
+				std::cout << "[CPU PROFILER]" << std::endl << "	trace written to trace.json" << std::endl;
+		}
+		dump_trace_key_down = dump_trace_key;
+
+		const bool depth_prepass_key =
+			glfwGetKey(window.get_glfw_window(), cam_controller.keys.toggle_depth_prepass) == GLFW_PRESS;
+		if (depth_prepass_key_down && !depth_prepass_key)
+		{
+			simple_render_system.set_depth_prepass(!simple_render_system.is_depth_prepass_enabled());
+			std::cout << "[Simple Render System]" << std::endl << "	depth prepass "
+				<< (simple_render_system.is_depth_prepass_enabled() ? "on" : "off") << std::endl;
+		}
+		depth_prepass_key_down = depth_prepass_key;
+
+		const bool dynamic_resolution_key =
+			glfwGetKey(window.get_glfw_window(), cam_controller.keys.toggle_dynamic_resolution) == GLFW_PRESS;
+		if (dynamic_resolution_key_down && !dynamic_resolution_key)
+		{
+			dynamic_resolution = !dynamic_resolution;
+			resolution_controller.reset();
+			std::cout << "[Dynamic Resolution]" << std::endl << "	" << (dynamic_resolution ? "on" : "off")
+				<< std::endl;
+		}
+		dynamic_resolution_key_down = dynamic_resolution_key;
+
+		const bool temporal_upscaling_key =
+			glfwGetKey(window.get_glfw_window(), cam_controller.keys.toggle_temporal_upscaling) == GLFW_PRESS;
+		if (temporal_upscaling_key_down && !temporal_upscaling_key)
+		{
+			temporal_upscaler.set_enabled(!temporal_upscaler.is_enabled());
+			set_resolution_range();
+			std::cout << "[Temporal Upscaling]" << std::endl << "	"
+				<< (temporal_upscaler.is_enabled() ? "on" : "off") << std::endl;
+		}
+		temporal_upscaling_key_down = temporal_upscaling_key;
+
+		const bool deferred_shading_key =
+			glfwGetKey(window.get_glfw_window(), cam_controller.keys.toggle_deferred_shading) == GLFW_PRESS;
+		if (deferred_shading_key_down && !deferred_shading_key)
+		{
+			deferred_shading = !deferred_shading;
+			render_graph.set_pass_enabled(main_pass, !deferred_shading);
+			render_graph.set_pass_enabled(deferred_pass, deferred_shading);
+			std::cout << "[Deferred Shading]" << std::endl << "	" << (deferred_shading ? "on" : "off")
+				<< std::endl;
+		}
+		deferred_shading_key_down = deferred_shading_key;
+
 		auto new_time = std::chrono::high_resolution_clock::now();
 		float frame_time = std::chrono::duration<float, std::chrono::seconds::period>(new_time - current_time).
 			count();
@@ -104,9 +347,30 @@ void application::run()
 		camera.set_orthographic_projection(-aspect, aspect, -1.f, 1.f, -1.f, 1.f);
 		camera.set_perspective_projection(glm::radians(60.f), aspect, 0.1f, 100.f);
 
+		const auto wait_start = std::chrono::high_resolution_clock::now();
 		if (const auto command_buffer = renderer.begin_frame())
 		{
+			// cpu time leaves out the fence wait and acquire above and the present below
+			const auto cpu_start = std::chrono::high_resolution_clock::now();
 			int frame_index = renderer.get_frame_index();
+			gpu_profiler.begin_frame(command_buffer, frame_index);
+
+			// the gpu time is a few frames old, the controller waits for frames at a new scale before reacting again
+			const VkExtent2D swap_chain_extent = renderer.get_swap_chain_extent();
+			const float previous_scale = resolution_controller.get_scale();
+			if (dynamic_resolution)
+				resolution_controller.update(gpu_profiler.get_last_frame_milliseconds());
+			// off, the largest scale of the range: native, or what temporal upscaling is tuned for
+			const float render_scale = dynamic_resolution
+				                           ? resolution_controller.get_scale()
+				                           : resolution_controller.get_config().max_scale;
+			render_extent = vk_resolution_controller::scale_extent(swap_chain_extent, render_scale);
+			if (resolution_controller.get_scale() != previous_scale)
+				std::cout << "[Dynamic Resolution]" << std::endl
+					<< "	render scale " << render_scale << " (" << render_extent.width << "x"
+					<< render_extent.height << ")" << std::endl;
+			temporal_upscaler.begin_frame(render_extent, swap_chain_extent);
+			camera.set_jitter(temporal_upscaler.get_jitter());
 			vk_frame_info frame_info{
 				frame_index,
 				frame_time,
@@ -114,21 +378,27 @@ void application::run()
 				camera,
 				global_descriptor_sets[frame_index],
 				game_objects,
+				clustered_lighting.get_descriptor_set(frame_index),
+				shadow_system.get_descriptor_set(frame_index)
 			};
-			// std::cout
-			// 	<< "[Main]" << std::endl
-			// 	<< "	frame index:" << frame_index << std::endl
-			// 	<< "	frame time: " << frame_time << std::endl
-			// 	<< "	frame rate: " << 1 / frame_time << std::endl;
-
 			//update
-			ubo.projection = camera.get_projection();
-			ubo.view = camera.get_view();
-			ubo_buffers[frame_index]->write_to_buffer(&ubo);
-			ubo_buffers[frame_index]->flush();
-
-			//render
-			renderer.begin_swap_chain_render_pass(command_buffer);
+			{
+				VK_PROFILE_SCOPE("update_ubo");
+				// the velocity is between unjittered positions, the jitter is taken out again in the shaders
+				const glm::mat4 view_projection = camera.get_projection() * camera.get_view();
+				ubo.projection = camera.get_jittered_projection();
+				ubo.view = camera.get_view();
+				ubo.previous_view_projection = has_previous_view_projection
+					                               ? previous_view_projection
+					                               : view_projection;
+				ubo.jitter = {camera.get_jitter(), 0.f, 0.f};
+				previous_view_projection = view_projection;
+				has_previous_view_projection = true;
+				ubo_buffers[frame_index]->write_to_buffer(&ubo);
+				ubo_buffers[frame_index]->flush();
+			}
+			clustered_lighting.upload(frame_index, camera, render_extent, lights);
+			shadow_system.prepare_shadows(frame_info, ubo.light_direction);
 
 			// update rotations
 			/*for (auto& game_object : game_objects)
@@ -138,56 +408,37 @@ void application::run()
 				game_object.transform.rotation.z = glm::mod(game_object.transform.rotation.z + 0.1f, 360.f);
 			}*/
 
-			simple_render_system.render_game_objects(frame_info);
-			point_light_system.render_light(frame_info);
+			//render
+			render_graph.set_extent(renderer.get_swap_chain_extent());
+			render_graph.set_render_area(main_pass, render_extent);
+			render_graph.set_render_area(deferred_pass, render_extent);
+			render_graph.bind_imported_image(
+				history, temporal_upscaler.get_history_image(), temporal_upscaler.get_history_view());
+			render_graph.bind_imported_image(
+				next_history, temporal_upscaler.get_next_history_image(), temporal_upscaler.get_next_history_view());
+			render_graph.bind_imported_image(
+				swap_chain_image,
+				renderer.get_current_swap_chain_image(),
+				renderer.get_current_swap_chain_image_view());
+			render_graph.bind_imported_buffer(
+				cluster_ranges, clustered_lighting.get_cluster_ranges_buffer(frame_index));
+			render_graph.bind_imported_buffer(
+				light_indices, clustered_lighting.get_light_indices_buffer(frame_index));
+			render_graph.execute(frame_info);
+
+			gpu_profiler.end_frame(command_buffer);
+
+			const auto cpu_time = (wait_start - new_time) + (std::chrono::high_resolution_clock::now() - cpu_start);
+			frame_stats.add_frame(
+				frame_time * 1000.0,
+				std::chrono::duration<double, std::chrono::milliseconds::period>(cpu_time).count(),
+				gpu_profiler.get_last_frame_milliseconds());
+			frame_stats.update(std::cout);
 
-			renderer.end_swap_chain_render_pass(command_buffer);
 			renderer.end_frame();
 		}
 	}
 
 	vkDeviceWaitIdle(device.get_device());
-}
-
-void application::load_game_objects()
-{
-	const std::shared_ptr flat_vase_model = vk_model::create_model_from_file(
-		device,
-		R"(assets\models\flat_vase.obj)");
-
-	const std::shared_ptr smooth_vase_model = vk_model::create_model_from_file(
-		device,
-		R"(assets\models\smooth_vase.obj)");
-
-	const std::shared_ptr floor_model = vk_model::create_model_from_file(
-		device,
-		R"(assets\models\quad.obj)");
-
-	const std::shared_ptr raiju_model = vk_model::create_model_from_file(
-		device,
-		R"(assets\models\raiju.obj)");
-
-	auto flat_vase_object = vk_game_object::create_game_object();
-	flat_vase_object.model = flat_vase_model;
-	flat_vase_object.transform.translation = {-.5f, .0f, .0f};
-	flat_vase_object.transform.scale = glm::vec3{3.f, 2.0f, 3.0f};
-	game_objects.emplace(flat_vase_object.get_id(), std::move(flat_vase_object));
-
-	auto smooth_vase_object = vk_game_object::create_game_object();
-	smooth_vase_object.model = smooth_vase_model;
-	smooth_vase_object.transform.translation = {.5f, .0f, .0f};
-	smooth_vase_object.transform.scale = glm::vec3{3.0f, 1.0f, 3.0f};
-	game_objects.emplace(smooth_vase_object.get_id(), std::move(smooth_vase_object));
-
-	auto floor_object = vk_game_object::create_game_object();
-	floor_object.model = floor_model;
-	floor_object.transform.translation = {.0f, .0f, .0f};
-	floor_object.transform.scale = glm::vec3{3.0f, 1.0f, 3.0f};
-	game_objects.emplace(floor_object.get_id(), std::move(floor_object));
-
-	auto raiju_object = vk_game_object::create_game_object();
-	raiju_object.model = raiju_model;
-	raiju_object.transform.translation = {.0f, -1.0f, .0f};
-	raiju_object.transform.scale = glm::vec3{.1f, -.1f, .1f};
-	game_objects.emplace(raiju_object.get_id(), std::move(raiju_object));
+	gpu_profiler.write_summary(std::cout);
 }
@@ -5,6 +5,7 @@
 #include "../renderer/vk_renderer.hpp"
 #include "../renderer/vk_window.hpp"
 #include "../renderer/simple_render_system/vk_descriptors.hpp"
+#include "../renderer/simple_render_system/vk_pipeline_manager.hpp"
 
 namespace vk_engine
 {
@@ -23,11 +24,10 @@ namespace vk_engine
 		void run();
 
 	private:
-		void load_game_objects();
-
 		vk_window window{width, height, "Vulkan!"};
 		vk_device device{window};
 		vk_renderer renderer{window, device};
+		vk_pipeline_manager pipeline_manager{device};
 
 		//order matters
 		std::unique_ptr<vk_descriptor_pool> global_pool{};
@@ -0,0 +1,505 @@
+#include "bench_app.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../engine/vk_camera.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+#include "../engine/vk_frame_info.hpp"
+#include "../engine/vk_frame_stats.hpp"
+#include "../engine/vk_model.hpp"
+#include "../renderer/vk_buffer.hpp"
+#include "../renderer/vk_clustered_lighting.hpp"
+#include "../renderer/vk_gpu_profiler.hpp"
+#include "../renderer/vk_offscreen_renderer.hpp"
+#include "../renderer/vk_renderer.hpp"
+#include "../renderer/vk_swapchain.hpp"
+#include "../renderer/simple_render_system/vk_point_light_system.hpp"
+#include "../renderer/simple_render_system/vk_shadow_system.hpp"
+#include "../renderer/simple_render_system/vk_simple_render_system.hpp"
+
+// set by the build, so results can be told apart
+#ifndef VK_ENGINE_VERSION
+#define VK_ENGINE_VERSION "unknown"
+#endif
+
+using vk_engine::bench_app;
+
+namespace
+{
+	// mt19937 output is fixed by the standard, the distributions aren't, so floats are made by hand to get the
+	// same scene from every standard library
+	float next_float(std::mt19937& rng, const float min, const float max)
+	{
+		const float unit = static_cast<float>(rng() >> 8) * (1.f / 16777216.f);
+		return min + unit * (max - min);
+	}
+
+	// half the edge of the cube the objects are spread over, about one unit of room per object
+	float field_extent(const uint32_t object_count)
+	{
+		return std::max(1.f, std::cbrt(static_cast<float>(object_count)) * .5f);
+	}
+
+	uint64_t peak_resident_bytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// quoted, with quotes, backslashes and control characters escaped, device names come from the driver
+	std::string json_string(const std::string_view value)
+	{
+		std::string result{"\""};
+		for (const char c : value)
+		{
+			switch (c)
+			{
+			case '"': result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escaped[7];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+					result += escaped;
+				}
+				else
+					result += c;
+			}
+		}
+		return result + '"';
+	}
+
+	void write_json_summary(std::ostream& out, const char* name, const vk_engine::frame_time_summary& summary)
+	{
+		out << "    " << json_string(name) << ": {\"samples\": " << summary.count << ", \"mean\": " << summary.mean
+			<< ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+			<< ", \"max\": " << summary.max << ", \"stutters\": " << summary.stutters << "}";
+	}
+}
+
+void vk_engine::load_bench_scene(vk_device& device, const bench_config& config, vk_game_object::map& game_objects,
+                                 std::vector<point_light>& lights)
+{
+	struct bench_model
+	{
+		std::shared_ptr<vk_model> model;
+		glm::vec3 scale;
+	};
+
+	const bench_model models[] = {
+		{vk_model::create_model_from_file(device, "assets/models/flat_vase.obj"), {3.f, 2.f, 3.f}},
+		{vk_model::create_model_from_file(device, "assets/models/smooth_vase.obj"), {3.f, 1.f, 3.f}},
+		{vk_model::create_model_from_file(device, "assets/models/cube.obj"), {.25f, .25f, .25f}},
+		{vk_model::create_model_from_file(device, "assets/models/colored_cube.obj"), {.25f, .25f, .25f}},
+	};
+	constexpr uint32_t model_count = sizeof(models) / sizeof(models[0]);
+
+	std::mt19937 rng{config.seed};
+	const float extent = field_extent(config.object_count);
+
+	game_objects.reserve(game_objects.size() + config.object_count);
+	for (uint32_t i = 0; i < config.object_count; i++)
+	{
+		const auto& [model, scale] = models[rng() % model_count];
+
+		auto object = vk_game_object::create_game_object();
+		object.model = model;
+		object.transform.translation = {
+			next_float(rng, -extent, extent),
+			next_float(rng, -extent, 0.f),
+			next_float(rng, -extent, extent)
+		};
+		object.transform.rotation = {
+			next_float(rng, 0.f, glm::two_pi<float>()),
+			next_float(rng, 0.f, glm::two_pi<float>()),
+			next_float(rng, 0.f, glm::two_pi<float>())
+		};
+		object.transform.scale = scale * next_float(rng, .5f, 1.5f);
+		game_objects.emplace(object.get_id(), std::move(object));
+	}
+
+	lights.clear();
+	lights.reserve(config.light_count);
+	for (uint32_t i = 0; i < config.light_count; i++)
+	{
+		point_light light{};
+		light.position = {
+			next_float(rng, -extent, extent),
+			next_float(rng, -extent, -.5f),
+			next_float(rng, -extent, extent)
+		};
+		light.radius = config.light_radius;
+		light.color = {next_float(rng, .2f, 1.f), next_float(rng, .2f, 1.f), next_float(rng, .2f, 1.f), 1.f};
+		lights.push_back(light);
+	}
+}
+
+bench_app::bench_app(bench_config config) : config{std::move(config)}
+{
+#ifndef VK_ENGINE_NULL_DRIVER
+	if (!this->config.offscreen && vk_window::is_display_available())
+		window = std::make_unique<vk_window>(this->config.width, this->config.height, "vk_engine bench");
+#endif
+
+	device = window ? std::make_unique<vk_device>(*window) : std::make_unique<vk_device>();
+	pipeline_manager = std::make_unique<vk_pipeline_manager>(*device);
+
+	global_pool = vk_descriptor_pool::builder(*device)
+	              .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	              .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	              .build();
+	load_bench_scene(*device, this->config, game_objects, lights);
+	memory_after_load = device->get_memory_stats();
+}
+
+bench_app::~bench_app() = default;
+
+void bench_app::run()
+{
+	vk_cpu_profiler::get().set_thread_name("main");
+	samples.clear();
+	samples.reserve(config.frame_count);
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	if (window)
+	{
+		vk_renderer renderer{*window, *device};
+		run_frames(renderer);
+	}
+	else
+	{
+		vk_offscreen_renderer renderer{*device, {config.width, config.height}};
+		run_frames(renderer);
+	}
+
+	double seconds = 0.0;
+	for (const auto& sample : samples)
+		seconds += sample.frame_ms / 1000.0;
+
+	std::cout
+		<< "[BENCH]" << std::endl
+		<< "	backend: " << get_backend_name() << std::endl
+		<< "	scene: " << config.object_count << " objects, " << config.light_count << " lights, seed "
+		<< config.seed << std::endl
+		<< "	frames: " << samples.size() << " (+" << config.warmup_frames << " warmup)" << std::endl
+		<< "	total time: " << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+			start_time).count() << " s" << std::endl;
+
+	write_results(seconds);
+}
+
+template <typename renderer_t>
+void bench_app::run_frames(renderer_t& renderer)
+{
+	std::vector<std::unique_ptr<vk_buffer>> ubo_buffers(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+
+	for (auto& ubo_buffer : ubo_buffers)
+	{
+		ubo_buffer = std::make_unique<vk_buffer>(
+			*device,
+			sizeof(global_ubo),
+			1,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+		ubo_buffer->map();
+	}
+
+	auto global_set_layout = vk_descriptor_set_layout::builder(*device)
+	                         .add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+	                                      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+	                         .build();
+
+	std::vector<VkDescriptorSet> global_descriptor_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < static_cast<int>(global_descriptor_sets.size()); ++i)
+	{
+		auto buffer_info = ubo_buffers[i]->descriptor_info();
+		vk_descriptor_writer(*global_set_layout, *global_pool)
+			.write_buffer(0, &buffer_info)
+			.build(global_descriptor_sets[i]);
+	}
+
+	// looks down at the whole field from the front
+	const float extent = field_extent(config.object_count);
+	vk_camera camera{};
+	camera.set_view_target({0.f, -extent * 1.5f, -extent * 2.5f}, {0.f, -extent * .25f, 0.f});
+	camera.set_perspective_projection(glm::radians(60.f), renderer.get_aspect_ratio(), 0.1f,
+	                                  std::max(100.f, extent * 8.f));
+
+	global_ubo ubo{};
+
+	vk_clustered_lighting clustered_lighting{
+		*device, *pipeline_manager,
+		config.gpu_light_assignment ? light_assignment::gpu : light_assignment::cpu
+	};
+
+	vk_shadow_system shadow_system{*device, *pipeline_manager};
+
+	vk_simple_render_system simple_render_system{
+		*device, *pipeline_manager, renderer.get_swap_chain_render_pass(),
+		global_set_layout->get_descriptor_set_layout(), clustered_lighting.get_descriptor_set_layout(),
+		shadow_system.get_descriptor_set_layout()
+	};
+	simple_render_system.set_depth_prepass(config.depth_prepass);
+
+	vk_point_light_system point_light_system{
+		*device, *pipeline_manager, renderer.get_swap_chain_render_pass(),
+		global_set_layout->get_descriptor_set_layout()
+	};
+
+	vk_gpu_profiler gpu_profiler{*device};
+
+	// every measured frame has to draw the full scene
+	pipeline_manager->wait_all();
+
+	// fixed timestep so every run animates the same frames, whatever the frame rate
+	constexpr float frame_time = 1.f / 60.f;
+	const uint32_t total_frames = config.warmup_frames + config.frame_count;
+	auto frame_start = std::chrono::high_resolution_clock::now();
+#ifdef VK_ENGINE_NULL_DRIVER
+	// measured frames that drew any light billboard, the rest were culled
+	uint64_t light_gizmo_frames = 0;
+	// the shadow passes redraw only the cascades that changed, one pipeline bind for all of them
+	uint64_t shadow_draws = 0;
+	uint64_t shadow_frames = 0;
+#endif
+
+	for (uint32_t frame = 0; frame < total_frames;)
+	{
+		if (window)
+		{
+			glfwPollEvents();
+			if (window->should_close())
+				break;
+		}
+
+#ifdef VK_ENGINE_NULL_DRIVER
+		if (frame == config.warmup_frames)
+			null_driver::reset_command_counts();
+#endif
+
+		VK_PROFILE_SCOPE("frame");
+		const auto command_buffer = renderer.begin_frame();
+		// the swap chain was recreated, nothing to record this time
+		if (!command_buffer)
+			continue;
+
+
+		const auto record_start = std::chrono::high_resolution_clock::now();
+		const int frame_index = renderer.get_frame_index();
+		gpu_profiler.begin_frame(command_buffer, frame_index);
+		vk_frame_info frame_info{
+			frame_index,
+			frame_time,
+			command_buffer,
+			camera,
+			global_descriptor_sets[frame_index],
+			game_objects,
+			clustered_lighting.get_descriptor_set(frame_index),
+			shadow_system.get_descriptor_set(frame_index)
+		};
+
+		//update
+		{
+			VK_PROFILE_SCOPE("update_scene");
+			for (auto& [id, game_object] : game_objects)
+				game_object.transform.rotation.y = glm::mod(game_object.transform.rotation.y + frame_time,
+				                                            glm::two_pi<float>());
+
+			ubo.projection = camera.get_projection();
+			ubo.view = camera.get_view();
+			ubo_buffers[frame_index]->write_to_buffer(&ubo);
+			ubo_buffers[frame_index]->flush();
+
+			clustered_lighting.update(command_buffer, frame_index, camera, renderer.get_swap_chain_extent(), lights);
+			{
+				const vk_gpu_scope scope{&gpu_profiler, command_buffer, "render_shadows"};
+				shadow_system.render_shadows(frame_info, ubo.light_direction);
+			}
+		}
+
+		//render
+		{
+			const vk_gpu_scope pass_scope{&gpu_profiler, command_buffer, "main"};
+			renderer.begin_swap_chain_render_pass(command_buffer);
+			simple_render_system.render_game_objects(frame_info);
+			point_light_system.render_lights(frame_info, lights);
+			renderer.end_swap_chain_render_pass(command_buffer);
+		}
+#ifdef VK_ENGINE_NULL_DRIVER
+		if (frame >= config.warmup_frames && point_light_system.get_visible_light_count() > 0)
+			light_gizmo_frames++;
+		if (frame >= config.warmup_frames && shadow_system.get_stats().render_passes > 0)
+		{
+			shadow_draws += shadow_system.get_stats().draws;
+			shadow_frames++;
+		}
+#endif
+
+		gpu_profiler.end_frame(command_buffer);
+		const auto submit_start = std::chrono::high_resolution_clock::now();
+		renderer.end_frame();
+		const auto frame_end = std::chrono::high_resolution_clock::now();
+
+		if (frame >= config.warmup_frames)
+		{
+			using milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>;
+			samples.push_back({
+				milliseconds(frame_end - frame_start).count(),
+				milliseconds(record_start - frame_start).count(),
+				milliseconds(submit_start - record_start).count(),
+				milliseconds(frame_end - submit_start).count(),
+				gpu_profiler.get_last_frame_milliseconds()
+			});
+		}
+		frame_start = frame_end;
+		frame++;
+	}
+
+	vkDeviceWaitIdle(device->get_device());
+	memory_during_run = device->get_memory_stats();
+	gpu_profiler.write_summary(std::cout);
+
+#ifdef VK_ENGINE_NULL_DRIVER
+	commands = null_driver::get_command_counts();
+
+	// every object with a model (twice with the depth prepass) and one instanced draw for all visible light
+	// billboards, one pipeline each for the two systems, the prepass, the light assignment dispatch and the shadow
+	// passes
+	const uint64_t frames = samples.size();
+	const uint64_t object_passes = config.depth_prepass ? 2 : 1;
+	const uint64_t expected_draws = frames * config.object_count * object_passes + light_gizmo_frames + shadow_draws;
+	const uint64_t expected_pipeline_binds = frames * (object_passes + (config.gpu_light_assignment ? 1 : 0)) +
+		light_gizmo_frames + shadow_frames;
+	if (commands.draws != expected_draws)
+		throw std::runtime_error("Null driver recorded " + std::to_string(commands.draws) + " draws, expected " +
+			std::to_string(expected_draws));
+	if (commands.pipeline_binds != expected_pipeline_binds)
+		throw std::runtime_error("Null driver recorded " + std::to_string(commands.pipeline_binds) +
+			" pipeline binds, expected " + std::to_string(expected_pipeline_binds));
+#endif
+}
+
+void bench_app::write_results(const double seconds) const
+{
+	std::ofstream file{config.output_path, std::ios::trunc};
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open bench output " + config.output_path);
+
+	std::vector<double> frame_ms, wait_ms, record_ms, submit_ms, gpu_ms;
+	for (const auto& sample : samples)
+	{
+		frame_ms.push_back(sample.frame_ms);
+		wait_ms.push_back(sample.wait_ms);
+		record_ms.push_back(sample.record_ms);
+		submit_ms.push_back(sample.submit_ms);
+		gpu_ms.push_back(sample.gpu_ms);
+	}
+
+	const auto& properties = device->properties;
+
+	file << std::fixed << std::setprecision(4)
+		<< "{\n"
+		<< "  \"engine_version\": " << json_string(VK_ENGINE_VERSION) << ",\n"
+		<< "  \"device\": {\"name\": " << json_string(properties.deviceName) << ", \"vendor_id\": "
+		<< properties.vendorID << ", \"driver_version\": " << properties.driverVersion << ", \"api_version\": "
+		<< properties.apiVersion << "},\n"
+		<< "  \"backend\": " << json_string(get_backend_name()) << ",\n"
+		<< "  \"config\": {\"objects\": " << config.object_count << ", \"lights\": " << config.light_count
+		<< ", \"light_radius\": " << config.light_radius << ", \"light_assignment\": "
+		<< json_string(config.gpu_light_assignment ? "gpu" : "cpu") << ", \"depth_prepass\": "
+		<< (config.depth_prepass ? "true" : "false") << ", \"seed\": " << config.seed << ", \"width\": " << config.width << ", \"height\": " << config.height
+		<< ", \"warmup_frames\": " << config.warmup_frames << ", \"frames\": " << config.frame_count << "},\n"
+		<< "  \"frames\": " << samples.size() << ",\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"fps\": " << (seconds > 0.0 ? static_cast<double>(samples.size()) / seconds : 0.0) << ",\n"
+		<< "  \"timings_ms\": {\n";
+	write_json_summary(file, "frame", summarize_times(std::move(frame_ms)));
+	file << ",\n";
+	write_json_summary(file, "cpu_wait", summarize_times(std::move(wait_ms)));
+	file << ",\n";
+	write_json_summary(file, "cpu_record", summarize_times(std::move(record_ms)));
+	file << ",\n";
+	write_json_summary(file, "cpu_submit", summarize_times(std::move(submit_ms)));
+	file << ",\n";
+	write_json_summary(file, "gpu", summarize_times(std::move(gpu_ms)));
+	file << "\n  },\n"
+		<< "  \"memory\": {\"device_bytes_scene\": " << memory_after_load.allocated_bytes
+		<< ", \"device_bytes\": " << memory_during_run.allocated_bytes
+		<< ", \"device_bytes_peak\": " << memory_during_run.peak_bytes
+		<< ", \"device_allocations\": " << memory_during_run.allocation_count
+		<< ", \"host_bytes_peak\": " << peak_resident_bytes() << "}";
+#ifdef VK_ENGINE_NULL_DRIVER
+	// per measured frame
+	const double frames = samples.empty() ? 1.0 : static_cast<double>(samples.size());
+	const auto per_frame = [&](const uint64_t count) { return static_cast<double>(count) / frames; };
+	file << ",\n"
+		<< "  \"commands\": {\"command_buffers\": " << per_frame(commands.command_buffers)
+		<< ", \"submits\": " << per_frame(commands.submits)
+		<< ", \"render_passes\": " << per_frame(commands.render_passes)
+		<< ", \"draws\": " << per_frame(commands.draws)
+		<< ", \"vertices\": " << per_frame(commands.vertices)
+		<< ", \"dispatches\": " << per_frame(commands.dispatches)
+		<< ", \"pipeline_binds\": " << per_frame(commands.pipeline_binds)
+		<< ", \"descriptor_set_binds\": " << per_frame(commands.descriptor_set_binds)
+		<< ", \"vertex_buffer_binds\": " << per_frame(commands.vertex_buffer_binds)
+		<< ", \"index_buffer_binds\": " << per_frame(commands.index_buffer_binds)
+		<< ", \"push_constants\": " << per_frame(commands.push_constants)
+		<< ", \"barriers\": " << per_frame(commands.barriers)
+		<< ", \"redundant_pipeline_binds\": " << per_frame(commands.redundant_pipeline_binds)
+		<< ", \"redundant_vertex_buffer_binds\": " << per_frame(commands.redundant_vertex_buffer_binds)
+		<< ", \"redundant_index_buffer_binds\": " << per_frame(commands.redundant_index_buffer_binds) << "}";
+#endif
+	file << "\n}\n";
+
+	if (!file)
+		throw std::runtime_error("Failed to write bench output " + config.output_path);
+
+	std::cout << "	results: " << config.output_path << std::endl;
+}
+
+const char* bench_app::get_backend_name() const
+{
+#ifdef VK_ENGINE_NULL_DRIVER
+	return "null";
+#else
+	return window ? "windowed" : "offscreen";
+#endif
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../engine/vk_game_object.hpp"
+#include "../renderer/vk_device.hpp"
+#include "../renderer/vk_window.hpp"
+#include "../engine/vk_light_clusters.hpp"
+#include "../renderer/simple_render_system/vk_descriptors.hpp"
+#include "../renderer/simple_render_system/vk_pipeline_manager.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef VK_ENGINE_NULL_DRIVER
+#include "../null_driver/vk_null_driver.hpp"
+#endif
+
+namespace vk_engine
+{
+	struct bench_config
+	{
+		uint32_t object_count = 1000;
+		uint32_t light_count = 8;
+		float light_radius = 4.f;
+		// assign lights to clusters with a compute dispatch instead of on the cpu
+		bool gpu_light_assignment = false;
+		// see vk_simple_render_system::set_depth_prepass
+		bool depth_prepass = false;
+		uint32_t seed = 1;
+
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		uint32_t warmup_frames = 60;
+		uint32_t frame_count = 1000;
+
+		// renders offscreen even when a display is there, without a display (or on the null driver) it always does
+		bool offscreen = false;
+		std::string output_path = "bench.json";
+	};
+
+	// stress scene for comparing engine versions: object_count copies of the bundled models and light_count
+	// lights, placed from a fixed seed so every run (and every build) renders the same frames
+	void load_bench_scene(vk_device& device, const bench_config& config, vk_game_object::map& game_objects,
+	                      std::vector<point_light>& lights);
+
+	// renders the bench scene for a fixed number of frames with a fixed timestep and writes cpu record, submit,
+	// gpu and memory numbers as json
+	class bench_app
+	{
+	public:
+		explicit bench_app(bench_config config);
+		~bench_app();
+
+		bench_app(const bench_app&) = delete;
+		bench_app& operator=(const bench_app&) = delete;
+
+		void run();
+
+	private:
+		struct frame_sample
+		{
+			double frame_ms;
+			double wait_ms; // event polling, fence wait and acquire
+			double record_ms; // scene update and command recording
+			double submit_ms; // end_frame: end, submit and present
+			double gpu_ms;
+		};
+
+		template <typename renderer_t>
+		void run_frames(renderer_t& renderer);
+		void write_results(double seconds) const;
+		const char* get_backend_name() const;
+
+		bench_config config;
+
+		// null when rendering offscreen
+		std::unique_ptr<vk_window> window;
+		std::unique_ptr<vk_device> device;
+		std::unique_ptr<vk_pipeline_manager> pipeline_manager;
+
+		//order matters
+		std::unique_ptr<vk_descriptor_pool> global_pool{};
+		vk_game_object::map game_objects;
+		std::vector<point_light> lights;
+
+		std::vector<frame_sample> samples;
+		device_memory_stats memory_after_load{};
+		device_memory_stats memory_during_run{}; // taken while the renderer is still alive
+
+#ifdef VK_ENGINE_NULL_DRIVER
+		// recorded over the measured frames
+		null_driver::command_counts commands{};
+#endif
+	};
+}
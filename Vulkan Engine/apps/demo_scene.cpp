@@ -0,0 +1,55 @@
+#include "demo_scene.hpp"
+
+#include "../engine/vk_model.hpp"
+
+void vk_engine::load_demo_scene(vk_device& device, vk_game_object::map& game_objects)
+{
+	// every object is static, the meshes are kept for the static batch
+	const std::shared_ptr flat_vase_model = vk_model::create_model_from_file(
+		device,
+		"assets/models/flat_vase.obj",
+		true);
+
+	const std::shared_ptr smooth_vase_model = vk_model::create_model_from_file(
+		device,
+		"assets/models/smooth_vase.obj",
+		true);
+
+	const std::shared_ptr floor_model = vk_model::create_model_from_file(
+		device,
+		"assets/models/quad.obj",
+		true);
+
+	const std::shared_ptr raiju_model = vk_model::create_model_from_file(
+		device,
+		"assets/models/raiju.obj",
+		true);
+
+	auto flat_vase_object = vk_game_object::create_game_object();
+	flat_vase_object.model = flat_vase_model;
+	flat_vase_object.transform.translation = {-.5f, .0f, .0f};
+	flat_vase_object.transform.scale = glm::vec3{3.f, 2.0f, 3.0f};
+	flat_vase_object.is_static = true;
+	game_objects.emplace(flat_vase_object.get_id(), std::move(flat_vase_object));
+
+	auto smooth_vase_object = vk_game_object::create_game_object();
+	smooth_vase_object.model = smooth_vase_model;
+	smooth_vase_object.transform.translation = {.5f, .0f, .0f};
+	smooth_vase_object.transform.scale = glm::vec3{3.0f, 1.0f, 3.0f};
+	smooth_vase_object.is_static = true;
+	game_objects.emplace(smooth_vase_object.get_id(), std::move(smooth_vase_object));
+
+	auto floor_object = vk_game_object::create_game_object();
+	floor_object.model = floor_model;
+	floor_object.transform.translation = {.0f, .0f, .0f};
+	floor_object.transform.scale = glm::vec3{3.0f, 1.0f, 3.0f};
+	floor_object.is_static = true;
+	game_objects.emplace(floor_object.get_id(), std::move(floor_object));
+
+	auto raiju_object = vk_game_object::create_game_object();
+	raiju_object.model = raiju_model;
+	raiju_object.transform.translation = {.0f, -1.0f, .0f};
+	raiju_object.transform.scale = glm::vec3{.1f, -.1f, .1f};
+	raiju_object.is_static = true;
+	game_objects.emplace(raiju_object.get_id(), std::move(raiju_object));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../engine/vk_game_object.hpp"
+#include "../renderer/vk_device.hpp"
+
+namespace vk_engine
+{
+	// vases, floor and raiju scene shared by the windowed and headless apps
+	void load_demo_scene(vk_device& device, vk_game_object::map& game_objects);
+}
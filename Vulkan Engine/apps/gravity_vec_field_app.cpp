@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include "../engine/vk_cpu_profiler.hpp"
 #include "../renderer/simple_render_system/vk_simple_render_system.hpp"
 
 using namespace vk_engine;
@@ -87,6 +88,7 @@ vec3 gravity_physics_system::compute_force(const vk_game_object& from_obj, const
 
 void gravity_physics_system::step_simulation(std::vector<vk_game_object>& physics_objs, const float dt) const
 {
+	VK_PROFILE_FUNCTION();
 	// Loops through all pairs of objects and applies attractive force between them
 	for (auto iter_a = physics_objs.begin(); iter_a != physics_objs.end(); ++iter_a)
 	{
@@ -181,7 +183,9 @@ void gravity_vec_field_app::run()
 	gravity_physics_system gravity_system{0.81f};
 	vec_field_system vec_field_system{};
 
-	vk_simple_render_system simple_render_system{device, renderer.get_swap_chain_render_pass(), nullptr}; //TODO
+	vk_simple_render_system simple_render_system{
+		device, pipeline_manager, renderer.get_swap_chain_render_pass(), nullptr, nullptr, nullptr
+	}; //TODO
 	vk_camera camera{};
 
 	while (!window.should_close())
@@ -209,7 +213,6 @@ void gravity_vec_field_app::run()
 			};
 			renderer.begin_swap_chain_render_pass(command_buffer);
 			simple_render_system.render_game_objects(frame_info);
-			simple_render_system.render_game_objects(frame_info);
 			renderer.end_swap_chain_render_pass(command_buffer);
 			renderer.end_frame();
 		}
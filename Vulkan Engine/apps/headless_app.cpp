@@ -0,0 +1,197 @@
+#include "headless_app.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <glm/glm.hpp>
+
+#include "demo_scene.hpp"
+#include "../engine/vk_camera.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+#include "../engine/vk_frame_info.hpp"
+#include "../engine/vk_frame_stats.hpp"
+#include "../renderer/vk_buffer.hpp"
+#include "../renderer/vk_clustered_lighting.hpp"
+#include "../renderer/vk_gpu_profiler.hpp"
+#include "../renderer/vk_swapchain.hpp"
+#include "../renderer/simple_render_system/vk_point_light_system.hpp"
+#include "../renderer/simple_render_system/vk_shadow_system.hpp"
+#include "../renderer/simple_render_system/vk_simple_render_system.hpp"
+
+using vk_engine::headless_app;
+
+headless_app::headless_app(headless_app_config config) : config{std::move(config)}
+{
+	global_pool = vk_descriptor_pool::builder(device)
+	              .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	              .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	              .build();
+	load_demo_scene(device, game_objects);
+}
+
+headless_app::~headless_app() = default;
+
+void headless_app::run()
+{
+	std::vector<std::unique_ptr<vk_buffer>> ubo_buffers(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+
+	for (auto& ubo_buffer : ubo_buffers)
+	{
+		ubo_buffer = std::make_unique<vk_buffer>(
+			device,
+			sizeof(global_ubo),
+			1,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+		ubo_buffer->map();
+	}
+
+	auto global_set_layout = vk_descriptor_set_layout::builder(device)
+	                         .add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+	                                      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+	                         .build();
+
+	std::vector<VkDescriptorSet> global_descriptor_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < static_cast<int>(global_descriptor_sets.size()); ++i)
+	{
+		auto buffer_info = ubo_buffers[i]->descriptor_info();
+		vk_descriptor_writer(*global_set_layout, *global_pool)
+			.write_buffer(0, &buffer_info)
+			.build(global_descriptor_sets[i]);
+	}
+
+	// same view as the windowed app starts with, so captures can be compared against it
+	global_ubo ubo{};
+	auto viewer_object = vk_game_object::create_game_object();
+	viewer_object.transform.translation = {0.f, -1.f, -2.5f};
+	viewer_object.transform.rotation.x = -.5f;
+
+	vk_camera camera{};
+	camera.set_view_yxz(viewer_object.transform.translation, viewer_object.transform.rotation);
+	camera.set_perspective_projection(glm::radians(60.f), renderer.get_aspect_ratio(), 0.1f, 100.f);
+
+	vk_clustered_lighting clustered_lighting{device, pipeline_manager};
+	const std::vector<point_light> lights{{ubo.point_light_position, 10.f, ubo.point_light_color}};
+
+	vk_shadow_system shadow_system{device, pipeline_manager};
+
+	vk_simple_render_system simple_render_system{
+		device, pipeline_manager, renderer.get_swap_chain_render_pass(),
+		global_set_layout->get_descriptor_set_layout(), clustered_lighting.get_descriptor_set_layout(),
+		shadow_system.get_descriptor_set_layout()
+	};
+	// the scene's static objects never change
+	simple_render_system.build_static_batch(game_objects);
+
+	vk_point_light_system point_light_system{
+		device, pipeline_manager, renderer.get_swap_chain_render_pass(),
+		global_set_layout->get_descriptor_set_layout()
+	};
+
+	vk_gpu_profiler gpu_profiler{device, 64, config.pipeline_statistics, config.frame_count};
+
+	// every measured frame has to draw the full scene
+	pipeline_manager.wait_all();
+
+	// fixed timestep keeps every run identical, the frame time we measure is wall clock
+	constexpr float frame_time = 1.f / 60.f;
+	const uint32_t total_frames = config.warmup_frames + config.frame_count;
+	auto start_time = std::chrono::high_resolution_clock::now();
+
+	vk_cpu_profiler::get().set_thread_name("main");
+
+	// measured frames only, reported once at the end
+	vk_frame_stats frame_stats{config.frame_count, 0.0};
+	auto frame_start = start_time;
+
+	for (uint32_t frame = 0; frame < total_frames; frame++)
+	{
+		VK_PROFILE_SCOPE("frame");
+		if (frame == config.warmup_frames)
+			start_time = std::chrono::high_resolution_clock::now();
+
+		const auto command_buffer = renderer.begin_frame();
+		const auto cpu_start = std::chrono::high_resolution_clock::now();
+		const int frame_index = renderer.get_frame_index();
+		gpu_profiler.begin_frame(command_buffer, frame_index);
+		vk_frame_info frame_info{
+			frame_index,
+			frame_time,
+			command_buffer,
+			camera,
+			global_descriptor_sets[frame_index],
+			game_objects,
+			clustered_lighting.get_descriptor_set(frame_index),
+			shadow_system.get_descriptor_set(frame_index)
+		};
+
+		//update
+		{
+			VK_PROFILE_SCOPE("update_ubo");
+			ubo.projection = camera.get_projection();
+			ubo.view = camera.get_view();
+			ubo_buffers[frame_index]->write_to_buffer(&ubo);
+			ubo_buffers[frame_index]->flush();
+		}
+		clustered_lighting.update(command_buffer, frame_index, camera, renderer.get_swap_chain_extent(), lights);
+		{
+			const vk_gpu_scope scope{&gpu_profiler, command_buffer, "render_shadows"};
+			shadow_system.render_shadows(frame_info, ubo.light_direction);
+		}
+
+		//render
+		{
+			const vk_gpu_scope pass_scope{&gpu_profiler, command_buffer, "main"};
+			renderer.begin_swap_chain_render_pass(command_buffer);
+			{
+				const vk_gpu_scope scope{&gpu_profiler, command_buffer, "render_game_objects"};
+				simple_render_system.render_game_objects(frame_info);
+			}
+			{
+				const vk_gpu_scope scope{&gpu_profiler, command_buffer, "render_lights"};
+				point_light_system.render_lights(frame_info, lights);
+			}
+			renderer.end_swap_chain_render_pass(command_buffer);
+		}
+
+		if (!config.capture_path.empty() && frame == config.warmup_frames + config.capture_frame)
+			renderer.request_readback(config.capture_path, config.capture_format);
+
+		gpu_profiler.end_frame(command_buffer);
+		const auto cpu_end = std::chrono::high_resolution_clock::now();
+		renderer.end_frame();
+
+		const auto frame_end = std::chrono::high_resolution_clock::now();
+		if (frame >= config.warmup_frames)
+		{
+			frame_stats.add_frame(
+				std::chrono::duration<double, std::chrono::milliseconds::period>(frame_end - frame_start).count(),
+				std::chrono::duration<double, std::chrono::milliseconds::period>(cpu_end - cpu_start).count(),
+				gpu_profiler.get_last_frame_milliseconds());
+		}
+		frame_start = frame_end;
+	}
+
+	// the measured frames are only done once the gpu has retired them
+	vkDeviceWaitIdle(device.get_device());
+	const auto end_time = std::chrono::high_resolution_clock::now();
+	renderer.wait_for_readbacks();
+
+	const double seconds = std::chrono::duration<double, std::chrono::seconds::period>(end_time - start_time).
+		count();
+	std::cout
+		<< "[HEADLESS]" << std::endl
+		<< "	frames: " << config.frame_count << " (+" << config.warmup_frames << " warmup)" << std::endl
+		<< "	total time: " << seconds << " s" << std::endl
+		<< "	frame time: " << seconds * 1000.0 / config.frame_count << " ms" << std::endl
+		<< "	frame rate: " << config.frame_count / seconds << " fps" << std::endl;
+
+	if (!config.capture_path.empty())
+		std::cout << "	capture: " << config.capture_path << std::endl;
+
+	frame_stats.write_report(std::cout);
+	gpu_profiler.write_summary(std::cout);
+
+	if (!config.trace_path.empty() && vk_cpu_profiler::get().dump_trace(config.trace_path))
+		std::cout << "[CPU PROFILER]" << std::endl << "	trace written to " << config.trace_path << std::endl;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../engine/vk_game_object.hpp"
+#include "../engine/vk_image_writer.hpp"
+#include "../renderer/vk_device.hpp"
+#include "../renderer/vk_offscreen_renderer.hpp"
+#include "../renderer/simple_render_system/vk_descriptors.hpp"
+#include "../renderer/simple_render_system/vk_pipeline_manager.hpp"
+
+#include <string>
+
+namespace vk_engine
+{
+	struct headless_app_config
+	{
+		uint32_t width = 800;
+		uint32_t height = 600;
+		uint32_t warmup_frames = 10;
+		uint32_t frame_count = 1000;
+
+		// empty path disables readback, capture_frame counts measured frames only
+		std::string capture_path{};
+		uint32_t capture_frame = 0;
+		image_file_format capture_format = image_file_format::png;
+
+		// per pass vertex/primitive/invocation counts next to the gpu timings
+		bool pipeline_statistics = false;
+
+		// chrome trace json of the whole run, empty disables it
+		std::string trace_path{};
+	};
+
+	// renders the demo scene offscreen without a window and reports frames per second, nothing is presented
+	class headless_app
+	{
+	public:
+		explicit headless_app(headless_app_config config);
+		~headless_app();
+
+		headless_app(const headless_app&) = delete;
+		headless_app& operator=(const headless_app&) = delete;
+
+		void run();
+
+	private:
+		headless_app_config config;
+
+		vk_device device{};
+		vk_offscreen_renderer renderer{device, {config.width, config.height}};
+		vk_pipeline_manager pipeline_manager{device};
+
+		//order matters
+		std::unique_ptr<vk_descriptor_pool> global_pool{};
+		vk_game_object::map game_objects;
+	};
+}
@@ -21,6 +21,12 @@ namespace vk_engine
 			int look_right = GLFW_KEY_RIGHT;
 			int look_up = GLFW_KEY_UP;
 			int look_down = GLFW_KEY_DOWN;
+
+			int dump_trace = GLFW_KEY_F12;
+			int toggle_depth_prepass = GLFW_KEY_F2;
+			int toggle_dynamic_resolution = GLFW_KEY_F3;
+			int toggle_temporal_upscaling = GLFW_KEY_F4;
+			int toggle_deferred_shading = GLFW_KEY_F5;
 		};
 
 		void move_in_plane_xz(GLFWwindow* window, float delta_time, vk_game_object& game_object) const;
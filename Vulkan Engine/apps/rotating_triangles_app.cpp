@@ -19,8 +19,8 @@ namespace vk_engine
 
 	void rotating_triangles_app::run()
 	{
-		const vk_simple_render_system simple_render_system{
-			device, renderer.get_swap_chain_render_pass(), nullptr
+		vk_simple_render_system simple_render_system{
+			device, pipeline_manager, renderer.get_swap_chain_render_pass(), nullptr, nullptr, nullptr
 		}; //TODO
 		vk_camera camera{};
 
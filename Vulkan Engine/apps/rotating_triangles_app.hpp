@@ -4,6 +4,7 @@
 #include "../renderer/vk_device.hpp"
 #include "../renderer/vk_renderer.hpp"
 #include "../renderer/vk_window.hpp"
+#include "../renderer/simple_render_system/vk_pipeline_manager.hpp"
 
 namespace vk_engine
 {
@@ -27,6 +28,7 @@ namespace vk_engine
 		vk_window window{width, height, "Vulkan!"};
 		vk_device device{window};
 		vk_renderer renderer{window, device};
+		vk_pipeline_manager pipeline_manager{device};
 
 		vk_game_object::map game_objects;
 	};
@@ -0,0 +1,43 @@
+#version 460
+
+layout (location = 0) in vec3 position;
+
+layout (set = 0, binding = 0) uniform GlobalUBO {
+    mat4 projection_mat;
+    mat4 view_mat;
+    vec4 ambient_light;
+    vec3 directional_light;
+    vec3 point_light_pos;
+    vec4 point_light_color;
+    mat4 previous_view_projection; // unjittered
+    vec4 jitter; // ndc offset in projection_mat
+} ubo;
+
+struct ObjectData {
+    vec4 model_rows[3];
+    vec4 normal_columns[3];
+    vec3 color;
+    uint material_id;
+    vec4 previous_model_rows[3]; // of the frame before, for motion vectors
+};
+
+// the same buffer the shaded draws read, see simple_shader.vert
+layout (std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} object_buffer;
+
+// has to come out bit for bit like simple_shader.vert, the shaded draws test depth EQUAL against it
+invariant gl_Position;
+
+void main() {
+    ObjectData object = object_buffer.objects[gl_InstanceIndex];
+
+    vec4 local_pos = vec4(position, 1.0);
+    vec4 world_pos = vec4(
+        dot(object.model_rows[0], local_pos),
+        dot(object.model_rows[1], local_pos),
+        dot(object.model_rows[2], local_pos),
+        1.0);
+
+    gl_Position = ubo.projection_mat * ubo.view_mat * world_pos;
+}
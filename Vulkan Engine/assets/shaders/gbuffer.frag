@@ -0,0 +1,18 @@
+#version 460
+
+layout (location = 0) in vec3 frag_color;
+layout (location = 1) in vec3 frag_pos_world;
+layout (location = 2) in vec3 frag_norm_world;
+layout (location = 3) in vec4 frag_clip;
+layout (location = 4) in vec4 frag_previous_clip;
+
+// see vk_deferred_lighting_system, shaded by deferred_lighting.frag
+layout (location = 0) out vec4 out_albedo;
+layout (location = 1) out vec4 out_normal; // world space, 0..1
+layout (location = 2) out vec2 out_velocity;
+
+void main() {
+    out_albedo = vec4(frag_color, 1.0);
+    out_normal = vec4(normalize(frag_norm_world) * 0.5 + 0.5, 0.0);
+    out_velocity = (frag_clip.xy / frag_clip.w - frag_previous_clip.xy / frag_previous_clip.w) * 0.5;
+}
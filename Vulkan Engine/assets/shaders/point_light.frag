@@ -1,21 +1,18 @@
 #version 460
 
 layout (location = 0) in vec2 frag_offset;
+layout (location = 1) flat in vec3 frag_color;
+layout (location = 2) flat in vec4 frag_clip;
+layout (location = 3) flat in vec4 frag_previous_clip;
 
 layout (location = 0) out vec4 out_color;
-
-layout (set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection_mat;
-    mat4 view_mat;
-    vec4 ambient_light;
-    vec3 directional_light;
-    vec3 point_light_pos;
-    vec4 point_light_color;
-} ubo;
+// see simple_shader.frag
+layout (location = 1) out vec2 out_velocity;
 
 void main() {
     float dist = sqrt(dot(frag_offset, frag_offset));
     if (dist >= 1.0) discard;
 
-    out_color = vec4(ubo.point_light_color.xyz, 1.0);
-}
\ No newline at end of file
+    out_color = vec4(frag_color, 1.0);
+    out_velocity = (frag_clip.xy / frag_clip.w - frag_previous_clip.xy / frag_previous_clip.w) * 0.5;
+}
@@ -10,6 +10,9 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 frag_offset;
+layout (location = 1) flat out vec3 frag_color;
+layout (location = 2) flat out vec4 frag_clip;
+layout (location = 3) flat out vec4 frag_previous_clip;
 
 layout (set = 0, binding = 0) uniform GlobalUBO {
     mat4 projection_mat;
@@ -18,15 +21,32 @@ layout (set = 0, binding = 0) uniform GlobalUBO {
     vec3 directional_light;
     vec3 point_light_pos;
     vec4 point_light_color;
+    mat4 previous_view_projection; // unjittered
+    vec4 jitter; // ndc offset in projection_mat
 } ubo;
 
-const float LIGHT_RADIUS = 0.1;
+struct LightGizmo {
+    vec4 position_radius;
+    vec4 color;
+};
+
+// one entry per visible light, the instance index picks it
+layout (std430, set = 1, binding = 0) readonly buffer GizmoBuffer {
+    LightGizmo gizmos[];
+} gizmo_buffer;
 
 void main() {
+    LightGizmo gizmo = gizmo_buffer.gizmos[gl_InstanceIndex];
     frag_offset = OFFSETS[gl_VertexIndex];
+    frag_color = gizmo.color.xyz;
 
-    vec4 light_cam_space = ubo.view_mat * vec4(ubo.point_light_pos, 1.0);
-    vec4 pos_cam_space = light_cam_space + LIGHT_RADIUS * vec4(frag_offset, 0.0, 0.0);
+    vec4 light_cam_space = ubo.view_mat * vec4(gizmo.position_radius.xyz, 1.0);
+    vec4 pos_cam_space = light_cam_space + gizmo.position_radius.w * vec4(frag_offset, 0.0, 0.0);
 
     gl_Position = ubo.projection_mat * pos_cam_space;
-}
\ No newline at end of file
+
+    // the whole billboard moves like its center, it faces the camera again every frame
+    vec4 center_clip = ubo.projection_mat * light_cam_space;
+    frag_clip = center_clip - vec4(ubo.jitter.xy * center_clip.w, 0.0, 0.0);
+    frag_previous_clip = ubo.previous_view_projection * vec4(gizmo.position_radius.xyz, 1.0);
+}
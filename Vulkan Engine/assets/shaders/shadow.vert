@@ -0,0 +1,30 @@
+#version 460
+
+// the interleaved model vertices, only the position is read
+layout (location = 0) in vec3 position;
+
+struct Caster {
+    vec4 model_rows[3];
+};
+
+// every draw of the frame's shadow passes, the draw's first instance is its index
+layout (std430, set = 0, binding = 0) readonly buffer CasterBuffer {
+    Caster casters[];
+} caster_buffer;
+
+layout (push_constant) uniform Push {
+    mat4 view_projection; // of the cascade being rendered
+} push;
+
+void main() {
+    Caster caster = caster_buffer.casters[gl_InstanceIndex];
+
+    vec4 local_pos = vec4(position, 1.0);
+    vec4 world_pos = vec4(
+        dot(caster.model_rows[0], local_pos),
+        dot(caster.model_rows[1], local_pos),
+        dot(caster.model_rows[2], local_pos),
+        1.0);
+
+    gl_Position = push.view_projection * world_pos;
+}
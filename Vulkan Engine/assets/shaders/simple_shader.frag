@@ -3,8 +3,12 @@
 layout (location = 0) in vec3 frag_color;
 layout (location = 1) in vec3 frag_pos_world;
 layout (location = 2) in vec3 frag_norm_world;
+layout (location = 3) in vec4 frag_clip;
+layout (location = 4) in vec4 frag_previous_clip;
 
 layout (location = 0) out vec4 out_color;
+// screen space motion since the last frame in uv, dropped by render passes without a velocity target
+layout (location = 1) out vec2 out_velocity;
 
 layout (set = 0, binding = 0) uniform GlobalUBO {
     mat4 projection_mat;
@@ -13,23 +17,105 @@ layout (set = 0, binding = 0) uniform GlobalUBO {
     vec3 directional_light;
     vec3 point_light_pos;
     vec4 point_light_color;
+    mat4 previous_view_projection; // unjittered
+    vec4 jitter; // ndc offset in projection_mat
 } ubo;
 
-layout (push_constant) uniform Push {
-    mat4 model_mat;
-    mat4 normal_mat;
-} push;
+// see vk_clustered_lighting
+layout (set = 2, binding = 0) uniform ClusterParams {
+    mat4 view;
+    mat4 inverse_projection;
+    uvec4 grid; // w is the light count
+    vec4 slicing; // scale, bias, 1 if logarithmic, max lights per cluster
+    vec4 depth_range; // near, far, framebuffer size
+} clusters;
+
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec4 color;
+};
+
+layout (std430, set = 2, binding = 1) readonly buffer LightBuffer {
+    PointLight lights[];
+} light_buffer;
+
+// (offset, count) into light_indices, x fastest, then y, then z
+layout (std430, set = 2, binding = 2) readonly buffer ClusterRanges {
+    uvec2 cluster_ranges[];
+};
+
+layout (std430, set = 2, binding = 3) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+// see vk_shadow_system
+layout (set = 3, binding = 0) uniform ShadowParams {
+    mat4 view_projections[4];
+    vec4 split_depths; // view depth each cascade ends at
+    vec4 direction_to_light; // w is intensity
+    vec4 settings; // cascade count, texel size in uv
+} shadows;
+
+layout (set = 3, binding = 1) uniform sampler2DArrayShadow shadow_map;
+
+uint cluster_index(float view_depth) {
+    uvec2 tile = uvec2(gl_FragCoord.xy / clusters.depth_range.zw * vec2(clusters.grid.xy));
+    tile = min(tile, clusters.grid.xy - 1u);
+
+    float depth = max(view_depth, clusters.depth_range.x);
+    float slice = clusters.slicing.z > 0.5 ? log(depth) : depth;
+    uint z = uint(clamp(slice * clusters.slicing.x + clusters.slicing.y, 0.0, float(clusters.grid.z - 1u)));
+
+    return (z * clusters.grid.y + tile.y) * clusters.grid.x + tile.x;
+}
+
+// 1 lit, 0 in shadow. the first cascade whose slice holds the fragment, 3x3 hardware filtered taps
+float shadow_factor(float view_depth) {
+    uint cascade_count = uint(shadows.settings.x);
+    uint cascade = 0u;
+    while (cascade < cascade_count && view_depth > shadows.split_depths[cascade])
+        cascade++;
+    if (cascade == cascade_count)
+        return 1.0;
+
+    vec4 light_pos = shadows.view_projections[cascade] * vec4(frag_pos_world, 1.0);
+    vec2 uv = light_pos.xy * 0.5 + 0.5;
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 offset = vec2(x, y) * shadows.settings.y;
+            lit += texture(shadow_map, vec4(uv + offset, float(cascade), light_pos.z));
+        }
+    }
+    return lit / 9.0;
+}
 
 void main() {
-    vec3 light_direction = ubo.point_light_pos - frag_pos_world;
+    vec3 normal = normalize(frag_norm_world);
+    float view_depth = (clusters.view * vec4(frag_pos_world, 1.0)).z;
 
-    float attenuation = 1.0 / dot(light_direction, light_direction);
+    float sun = max(dot(normal, shadows.direction_to_light.xyz), 0.0) * shadows.direction_to_light.w;
+    vec3 diffuse_light = vec3(sun * shadow_factor(view_depth));
 
-    vec3 light_color = ubo.point_light_color.xyz * ubo.point_light_color.w * attenuation;
+    uvec2 range = cluster_ranges[cluster_index(view_depth)];
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = light_buffer.lights[light_indices[range.x + i]];
 
-    vec3 ambient_light = ubo.ambient_light.xyz * ubo.ambient_light.w;
+        vec3 light_direction = light.position - frag_pos_world;
+        float distance_squared = dot(light_direction, light_direction);
+
+        // inverse square, faded out to nothing at the radius
+        float falloff = clamp(1.0 - distance_squared / (light.radius * light.radius), 0.0, 1.0);
+        float attenuation = falloff * falloff / max(distance_squared, 0.0001);
 
-    vec3 diffuse_light = light_color * max(dot(normalize(frag_norm_world), light_direction), 0.0);
+        vec3 light_color = light.color.xyz * light.color.w * attenuation;
+        diffuse_light += light_color * max(dot(normal, normalize(light_direction)), 0.0);
+    }
+
+    vec3 ambient_light = ubo.ambient_light.xyz * ubo.ambient_light.w;
 
     out_color = vec4((diffuse_light + ambient_light) * frag_color, 1.0);
-}
\ No newline at end of file
+    out_velocity = (frag_clip.xy / frag_clip.w - frag_previous_clip.xy / frag_previous_clip.w) * 0.5;
+}
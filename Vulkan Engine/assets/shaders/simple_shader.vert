@@ -8,6 +8,8 @@ layout (location = 3) in vec3 uv;
 layout (location = 0) out vec3 frag_color;
 layout (location = 1) out vec3 frag_pos_world;
 layout (location = 2) out vec3 frag_norm_world;
+layout (location = 3) out vec4 frag_clip;
+layout (location = 4) out vec4 frag_previous_clip;
 
 layout (set = 0, binding = 0) uniform GlobalUBO {
     mat4 projection_mat;
@@ -16,23 +18,53 @@ layout (set = 0, binding = 0) uniform GlobalUBO {
     vec3 directional_light;
     vec3 point_light_pos;
     vec4 point_light_color;
+    mat4 previous_view_projection; // unjittered
+    vec4 jitter; // ndc offset in projection_mat
 } ubo;
 
-layout (push_constant) uniform Push {
-    mat4 model_mat;
-    mat4 normal_mat;
-} push;
+struct ObjectData {
+    vec4 model_rows[3];
+    vec4 normal_columns[3];
+    vec3 color;
+    uint material_id;
+    vec4 previous_model_rows[3]; // of the frame before, for motion vectors
+};
+
+// one entry per draw, the draw's first instance is its index
+layout (std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} object_buffer;
 
 const float AMBIENT_LIGHT = 0.2;
 
+// the depth prepass computes the same position, see depth_prepass.vert
+invariant gl_Position;
+
 void main() {
-    vec4 world_pos = push.model_mat * vec4(position, 1.0);
+    ObjectData object = object_buffer.objects[gl_InstanceIndex];
+
+    vec4 local_pos = vec4(position, 1.0);
+    vec4 world_pos = vec4(
+        dot(object.model_rows[0], local_pos),
+        dot(object.model_rows[1], local_pos),
+        dot(object.model_rows[2], local_pos),
+        1.0);
 
     gl_Position = ubo.projection_mat * ubo.view_mat * world_pos;
 
-    frag_norm_world = normalize(mat3(push.normal_mat) * normal);
+    // both without jitter, a still pixel has no motion whatever the jitter
+    vec4 previous_world_pos = vec4(
+        dot(object.previous_model_rows[0], local_pos),
+        dot(object.previous_model_rows[1], local_pos),
+        dot(object.previous_model_rows[2], local_pos),
+        1.0);
+    frag_clip = gl_Position - vec4(ubo.jitter.xy * gl_Position.w, 0.0, 0.0);
+    frag_previous_clip = ubo.previous_view_projection * previous_world_pos;
+
+    mat3 normal_mat = mat3(object.normal_columns[0].xyz, object.normal_columns[1].xyz, object.normal_columns[2].xyz);
+    frag_norm_world = normalize(normal_mat * normal);
 
     frag_pos_world = world_pos.xyz;
 
     frag_color = color;
-}
\ No newline at end of file
+}
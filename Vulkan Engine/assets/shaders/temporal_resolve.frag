@@ -0,0 +1,54 @@
+#version 460
+
+layout (location = 0) in vec2 frag_uv;
+
+layout (location = 0) out vec4 out_history;
+layout (location = 1) out vec4 out_color;
+
+// full size targets, the scene and its velocity only cover the render area in their top left
+layout (set = 0, binding = 0) uniform sampler2D scene_color;
+layout (set = 0, binding = 1) uniform sampler2D velocity;
+layout (set = 0, binding = 2) uniform sampler2D history;
+
+// see vk_temporal_upscaler
+layout (push_constant) uniform Resolve {
+    vec4 area; // render area width and height in texels, target width and height
+    vec4 jitter_weight; // jitter in render texels, history weight (0 without a history), unused
+} resolve;
+
+void main() {
+    vec2 render_size = resolve.area.xy;
+    vec2 target_size = resolve.area.zw;
+    ivec2 last_texel = ivec2(render_size) - 1;
+
+    // where this pixel's center landed in the jittered render
+    vec2 render_pos = frag_uv * render_size + resolve.jitter_weight.xy;
+    ivec2 center = clamp(ivec2(render_pos), ivec2(0), last_texel);
+
+    // the history is only trusted as far as it stays within the colors around the new sample
+    vec3 color_min = vec3(1e9);
+    vec3 color_max = vec3(-1e9);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbour = texelFetch(scene_color, clamp(center + ivec2(x, y), ivec2(0), last_texel), 0).rgb;
+            color_min = min(color_min, neighbour);
+            color_max = max(color_max, neighbour);
+        }
+    }
+
+    // bilinear, half a texel inside the render area so nothing past it bleeds in
+    vec2 sample_pos = clamp(render_pos, vec2(0.5), render_size - 0.5);
+    vec3 current = texture(scene_color, sample_pos / target_size).rgb;
+
+    // motion since the last frame, what is here now was at history_uv then
+    vec2 history_uv = frag_uv - texelFetch(velocity, center, 0).xy;
+    float weight = resolve.jitter_weight.z;
+    if (any(lessThan(history_uv, vec2(0.0))) || any(greaterThan(history_uv, vec2(1.0))))
+        weight = 0.0;
+
+    vec3 previous = clamp(texture(history, history_uv).rgb, color_min, color_max);
+    vec3 resolved = mix(current, previous, weight);
+
+    out_history = vec4(resolved, 1.0);
+    out_color = vec4(resolved, 1.0);
+}
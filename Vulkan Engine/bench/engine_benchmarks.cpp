@@ -0,0 +1,262 @@
+#include "vk_microbench.hpp"
+
+#include <random>
+#include <glm/gtc/constants.hpp>
+
+#include "../apps/gravity_vec_field_app.hpp"
+#include "../engine/vk_camera.hpp"
+#include "../engine/vk_game_object.hpp"
+#include "../engine/vk_light_clusters.hpp"
+#include "../engine/vk_model.hpp"
+#include "../renderer/vk_draw_list.hpp"
+#include "../renderer/vk_dynamic_batcher.hpp"
+
+// cpu kernels only, nothing here creates a device, so they run on any machine the engine links on
+
+using vk_engine::microbench::do_not_optimize;
+using vk_engine::microbench::state;
+
+namespace
+{
+	// inputs cycle through a small table, so the compiler can't fold a constant input
+	constexpr size_t input_count = 1024;
+
+	float next_float(std::mt19937& rng, const float min, const float max)
+	{
+		const float unit = static_cast<float>(rng() >> 8) * (1.f / 16777216.f);
+		return min + unit * (max - min);
+	}
+
+	glm::vec3 next_vec3(std::mt19937& rng, const float min, const float max)
+	{
+		return {next_float(rng, min, max), next_float(rng, min, max), next_float(rng, min, max)};
+	}
+
+	std::vector<vk_engine::transform_component> make_transforms()
+	{
+		std::mt19937 rng{1};
+		std::vector<vk_engine::transform_component> transforms(input_count);
+		for (auto& transform : transforms)
+		{
+			transform.translation = next_vec3(rng, -10.f, 10.f);
+			transform.rotation = next_vec3(rng, 0.f, 360.f);
+			transform.scale = next_vec3(rng, .1f, 2.f);
+		}
+		return transforms;
+	}
+
+	void transform_mat4(state& state)
+	{
+		const auto transforms = make_transforms();
+		size_t i = 0;
+		for (auto _ : state)
+			do_not_optimize(transforms[i++ % input_count].mat4());
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations()));
+	}
+
+	void transform_normal_matrix(state& state)
+	{
+		const auto transforms = make_transforms();
+		size_t i = 0;
+		for (auto _ : state)
+			do_not_optimize(transforms[i++ % input_count].normal_matrix());
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations()));
+	}
+
+	void camera_set_view_yxz(state& state)
+	{
+		std::mt19937 rng{2};
+		std::vector<glm::vec3> positions(input_count), rotations(input_count);
+		for (size_t i = 0; i < input_count; i++)
+		{
+			positions[i] = next_vec3(rng, -10.f, 10.f);
+			rotations[i] = next_vec3(rng, -glm::pi<float>(), glm::pi<float>());
+		}
+
+		vk_engine::vk_camera camera{};
+		size_t i = 0;
+		for (auto _ : state)
+		{
+			camera.set_view_yxz(positions[i % input_count], rotations[i % input_count]);
+			do_not_optimize(camera.get_view());
+			i++;
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations()));
+	}
+
+	void camera_set_perspective_projection(state& state)
+	{
+		std::mt19937 rng{3};
+		std::vector<float> aspects(input_count);
+		for (auto& aspect : aspects)
+			aspect = next_float(rng, .5f, 2.5f);
+
+		vk_engine::vk_camera camera{};
+		size_t i = 0;
+		for (auto _ : state)
+		{
+			camera.set_perspective_projection(glm::radians(60.f), aspects[i++ % input_count], .1f, 100.f);
+			do_not_optimize(camera.get_projection());
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations()));
+	}
+
+	void vertex_hash(state& state)
+	{
+		std::mt19937 rng{4};
+		std::vector<vk_engine::vk_model::vertex> vertices(input_count);
+		for (auto& vertex : vertices)
+		{
+			vertex.position = next_vec3(rng, -1.f, 1.f);
+			vertex.color = next_vec3(rng, 0.f, 1.f);
+			vertex.normal = normalize(next_vec3(rng, -1.f, 1.f));
+			vertex.uv = {next_float(rng, 0.f, 1.f), next_float(rng, 0.f, 1.f)};
+		}
+
+		const std::hash<vk_engine::vk_model::vertex> hasher{};
+		size_t i = 0;
+		for (auto _ : state)
+			do_not_optimize(hasher(vertices[i++ % input_count]));
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations()));
+	}
+
+	// paths are relative to the project directory, like the apps
+	void load_model(state& state, const char* file_path)
+	{
+		size_t vertex_count = 0;
+		try
+		{
+			for (auto _ : state)
+			{
+				vk_engine::vk_model::builder builder{};
+				builder.load_model(file_path);
+				vertex_count = builder.vertices.size();
+				do_not_optimize(builder.indices.data());
+			}
+		}
+		catch (const std::exception& e)
+		{
+			state.skip_with_error(e.what());
+			return;
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations() * vertex_count));
+	}
+
+	// keys shaped like a frame's: one pass and pipeline, a handful of models, random depths
+	void draw_list_sort(state& state)
+	{
+		const auto draw_count = static_cast<size_t>(state.arg());
+		std::mt19937 rng{6};
+
+		std::vector<vk_engine::draw_packet> unsorted(draw_count);
+		for (auto& packet : unsorted)
+			packet = {vk_engine::draw_key::make(0, 1, rng() % 4, next_float(rng, .1f, 100.f)), nullptr};
+
+		std::vector<vk_engine::draw_packet> packets, scratch;
+		vk_engine::vk_sort_workers workers{};
+		for (auto _ : state)
+		{
+			state.pause_timing();
+			packets = unsorted;
+			state.resume_timing();
+
+			vk_engine::radix_sort(packets, scratch, &workers);
+			do_not_optimize(packets.data());
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations() * draw_count));
+	}
+
+	// lights scattered through the view frustum, the default 16x9x24 grid
+	void light_cluster_assign(state& state)
+	{
+		const auto light_count = static_cast<size_t>(state.arg());
+		std::mt19937 rng{7};
+
+		vk_engine::vk_camera camera{};
+		camera.set_perspective_projection(glm::radians(60.f), 16.f / 9.f, .1f, 100.f);
+
+		std::vector<vk_engine::point_light> lights(light_count);
+		for (auto& light : lights)
+		{
+			const float depth = next_float(rng, 1.f, 80.f);
+			light.position = {next_float(rng, -depth, depth), next_float(rng, -depth, depth) * .6f, depth};
+			light.radius = next_float(rng, 1.f, 5.f);
+		}
+
+		vk_engine::vk_light_clusters clusters{};
+		for (auto _ : state)
+		{
+			clusters.assign(camera.get_view(), camera.get_projection(), lights);
+			do_not_optimize(clusters.get_light_indices().data());
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations() * light_count));
+	}
+
+	// n vertices of tiny meshes to world space, what vk_dynamic_batcher does per batched object every frame
+	void dynamic_batch_transform(state& state)
+	{
+		const auto vertex_count = static_cast<size_t>(state.arg());
+		std::mt19937 rng{8};
+
+		std::vector<vk_engine::vk_model::vertex> vertices(vertex_count), transformed(vertex_count);
+		for (auto& vertex : vertices)
+		{
+			vertex.position = next_vec3(rng, -1.f, 1.f);
+			vertex.color = next_vec3(rng, 0.f, 1.f);
+			vertex.normal = normalize(next_vec3(rng, -1.f, 1.f));
+			vertex.uv = {next_float(rng, 0.f, 1.f), next_float(rng, 0.f, 1.f)};
+		}
+
+		const auto transforms = make_transforms();
+		size_t i = 0;
+		for (auto _ : state)
+		{
+			const auto& transform = transforms[i++ % input_count];
+			vk_engine::transform_vertices(vertices.data(), static_cast<uint32_t>(vertex_count), transform.mat4(),
+			                              transform.normal_matrix(), transformed.data());
+			do_not_optimize(transformed.data());
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations() * vertex_count));
+	}
+
+	// n bodies pulling on each other, n^2 / 2 force evaluations per step
+	void gravity_step_simulation(state& state)
+	{
+		const auto body_count = static_cast<size_t>(state.arg());
+		std::mt19937 rng{5};
+
+		std::vector<vk_engine::vk_game_object> bodies;
+		bodies.reserve(body_count);
+		for (size_t i = 0; i < body_count; i++)
+		{
+			auto body = vk_engine::vk_game_object::create_game_object();
+			body.transform.translation = next_vec3(rng, -1.f, 1.f);
+			body.rigid_body.velocity = next_vec3(rng, -.1f, .1f);
+			body.rigid_body.mass = next_float(rng, .5f, 1.5f);
+			bodies.push_back(std::move(body));
+		}
+
+		const vk_engine::gravity_physics_system physics_system{0.81f};
+		for (auto _ : state)
+		{
+			physics_system.update(bodies, 1.f / 60.f, 1);
+			do_not_optimize(bodies.data());
+		}
+		state.set_items_processed(static_cast<int64_t>(state.get_iterations() * body_count * body_count / 2));
+	}
+}
+
+VK_BENCHMARK(transform_mat4);
+VK_BENCHMARK(transform_normal_matrix);
+VK_BENCHMARK(camera_set_view_yxz);
+VK_BENCHMARK(camera_set_perspective_projection);
+VK_BENCHMARK(vertex_hash);
+VK_BENCHMARK_CAPTURE(load_model, colored_cube, "assets/models/colored_cube.obj");
+VK_BENCHMARK_CAPTURE(load_model, cube, "assets/models/cube.obj");
+VK_BENCHMARK_CAPTURE(load_model, flat_vase, "assets/models/flat_vase.obj");
+VK_BENCHMARK_CAPTURE(load_model, quad, "assets/models/quad.obj");
+VK_BENCHMARK_CAPTURE(load_model, smooth_vase, "assets/models/smooth_vase.obj");
+VK_BENCHMARK(draw_list_sort)->range(1024, 1 << 20);
+VK_BENCHMARK(light_cluster_assign)->range(16, 4096);
+VK_BENCHMARK(dynamic_batch_transform)->range(3, 3 << 12);
+VK_BENCHMARK(gravity_step_simulation)->range(8, 1024);
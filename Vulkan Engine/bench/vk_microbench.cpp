@@ -0,0 +1,223 @@
+#include "vk_microbench.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+namespace vk_engine::microbench
+{
+	namespace
+	{
+		std::vector<std::unique_ptr<definition>>& registry()
+		{
+			static std::vector<std::unique_ptr<definition>> definitions;
+			return definitions;
+		}
+
+		void write_json_string(std::ostream& out, const std::string& text)
+		{
+			out << '"';
+			for (const char c : text)
+			{
+				if (c == '"' || c == '\\')
+					out << '\\' << c;
+				else if (c == '\n')
+					out << "\\n";
+				else
+					out << c;
+			}
+			out << '"';
+		}
+
+		struct result
+		{
+			std::string name;
+			uint64_t iterations;
+			double ns_per_iteration;
+			double items_per_second;
+			std::string error;
+		};
+	}
+
+	void state::start_timing()
+	{
+		elapsed = {};
+		started = std::chrono::steady_clock::now();
+		timing = true;
+	}
+
+	void state::stop_timing()
+	{
+		if (timing)
+			elapsed += std::chrono::steady_clock::now() - started;
+		timing = false;
+	}
+
+	void state::pause_timing()
+	{
+		stop_timing();
+	}
+
+	void state::resume_timing()
+	{
+		started = std::chrono::steady_clock::now();
+		timing = true;
+	}
+
+	definition* definition::range(int64_t first, const int64_t last, const int64_t multiplier)
+	{
+		for (; first < last; first *= multiplier)
+			arguments.push_back(first);
+		arguments.push_back(last);
+		return this;
+	}
+
+	definition* register_benchmark(std::string name, definition::function fn)
+	{
+		registry().push_back(std::make_unique<definition>(std::move(name), std::move(fn)));
+		return registry().back().get();
+	}
+
+	class runner
+	{
+	public:
+		explicit runner(const double min_time) : min_time{min_time}
+		{
+		}
+
+		// grows the iteration count until one run takes at least min_time, that run is the result
+		result run(const definition& benchmark, const int64_t argument, std::string name) const
+		{
+			uint64_t iterations = 1;
+			while (true)
+			{
+				state run_state{argument, iterations};
+				benchmark.fn(run_state);
+				if (!run_state.error.empty())
+					return {std::move(name), 0, 0.0, 0.0, run_state.error};
+
+				const double seconds = std::chrono::duration<double>(run_state.elapsed).count();
+				if (seconds >= min_time || iterations >= max_iterations)
+				{
+					return {
+						std::move(name),
+						iterations,
+						seconds * 1e9 / static_cast<double>(iterations),
+						seconds > 0.0 ? static_cast<double>(run_state.items_processed) / seconds : 0.0,
+						{}
+					};
+				}
+
+				// aim a bit past min_time so the next run is usually the last
+				const double multiplier = std::clamp(min_time * 1.4 / std::max(seconds, 1e-9), 2.0, 100.0);
+				iterations = std::min<uint64_t>(max_iterations,
+				                                static_cast<uint64_t>(static_cast<double>(iterations) * multiplier));
+			}
+		}
+
+	private:
+		static constexpr uint64_t max_iterations = 1'000'000'000;
+
+		double min_time;
+	};
+
+	int run_benchmarks(const int argc, char** argv)
+	{
+		std::string filter;
+		std::string json_path;
+		double min_time = 0.5;
+
+		try
+		{
+			for (int i = 1; i < argc; i++)
+			{
+				const auto next = [&] { return i + 1 < argc ? argv[++i] : throw std::invalid_argument(argv[i]); };
+
+				if (std::strcmp(argv[i], "--filter") == 0)
+					filter = next();
+				else if (std::strcmp(argv[i], "--min-time") == 0)
+					min_time = std::stod(next());
+				else if (std::strcmp(argv[i], "--json") == 0)
+					json_path = next();
+				else
+					throw std::invalid_argument(argv[i]);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "invalid argument: " << e.what() << '\n';
+			return EXIT_FAILURE;
+		}
+
+		const runner bench_runner{min_time};
+		std::vector<result> results;
+		bool failed = false;
+
+		std::cout << std::left << std::setw(48) << "benchmark" << std::right << std::setw(14) << "ns/iter"
+			<< std::setw(14) << "iterations" << std::setw(16) << "items/s" << std::endl;
+
+		for (const auto& benchmark : registry())
+		{
+			std::vector<int64_t> arguments = benchmark->get_arguments();
+			const bool has_arguments = !arguments.empty();
+			if (!has_arguments)
+				arguments.push_back(0);
+
+			for (const int64_t argument : arguments)
+			{
+				std::string name = benchmark->get_name();
+				if (has_arguments)
+					name += "/" + std::to_string(argument);
+				if (!filter.empty() && name.find(filter) == std::string::npos)
+					continue;
+
+				const auto& bench_result = results.emplace_back(bench_runner.run(*benchmark, argument, name));
+				std::cout << std::left << std::setw(48) << bench_result.name << std::right;
+				if (!bench_result.error.empty())
+				{
+					std::cout << "  error: " << bench_result.error << std::endl;
+					failed = true;
+					continue;
+				}
+
+				std::cout << std::fixed << std::setprecision(1) << std::setw(14) << bench_result.ns_per_iteration
+					<< std::setw(14) << bench_result.iterations << std::setprecision(0) << std::setw(16)
+					<< bench_result.items_per_second << std::defaultfloat << std::endl;
+			}
+		}
+
+		if (!json_path.empty())
+		{
+			std::ofstream file{json_path, std::ios::trunc};
+			file << "{\"benchmarks\": [";
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const auto& [name, iterations, ns_per_iteration, items_per_second, error] = results[i];
+				file << (i == 0 ? "\n" : ",\n") << "  {\"name\": ";
+				write_json_string(file, name);
+				file << ", \"iterations\": " << iterations << ", \"ns_per_iteration\": " << ns_per_iteration
+					<< ", \"items_per_second\": " << items_per_second << ", \"error\": ";
+				write_json_string(file, error);
+				file << "}";
+			}
+			file << "\n]}\n";
+
+			if (!file)
+			{
+				std::cerr << "failed to write " << json_path << '\n';
+				return EXIT_FAILURE;
+			}
+		}
+
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	return vk_engine::microbench::run_benchmarks(argc, argv);
+}
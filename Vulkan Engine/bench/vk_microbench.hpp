@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// registers a benchmark function void(vk_engine::microbench::state&) under its own name, the returned
+// definition takes ->arg(n) for every parameter it should run with
+#define VK_BENCHMARK_CONCAT_INNER(a, b) a##b
+#define VK_BENCHMARK_CONCAT(a, b) VK_BENCHMARK_CONCAT_INNER(a, b)
+#define VK_BENCHMARK(fn) \
+	static auto* VK_BENCHMARK_CONCAT(benchmark_, __LINE__) = ::vk_engine::microbench::register_benchmark(#fn, fn)
+// same function under fn/name with extra arguments bound, e.g. one case per input file
+#define VK_BENCHMARK_CAPTURE(fn, name, ...) \
+	static auto* VK_BENCHMARK_CONCAT(benchmark_, __LINE__) = ::vk_engine::microbench::register_benchmark( \
+		#fn "/" #name, [](::vk_engine::microbench::state& state) { fn(state, __VA_ARGS__); })
+
+namespace vk_engine::microbench
+{
+	// keeps the optimizer from dropping a result nobody reads
+	template <typename T>
+	void do_not_optimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+
+	// handed to every benchmark run, the timed region is the range-for over it:
+	//     for (auto _ : state) { ...measured work... }
+	class state
+	{
+	public:
+		// non-trivial, so an unused loop variable doesn't warn
+		struct value
+		{
+			~value()
+			{
+			}
+		};
+
+		class iterator
+		{
+		public:
+			value operator*() const { return {}; }
+			iterator& operator++()
+			{
+				--remaining;
+				return *this;
+			}
+			bool operator!=(const iterator&) const
+			{
+				if (remaining != 0)
+					return true;
+				parent->stop_timing();
+				return false;
+			}
+
+		private:
+			iterator(state* parent, const uint64_t remaining) : parent{parent}, remaining{remaining}
+			{
+			}
+
+			state* parent;
+			uint64_t remaining;
+
+			friend class state;
+		};
+
+		state(const int64_t argument, const uint64_t iterations) : argument{argument}, iterations{iterations}
+		{
+		}
+
+		iterator begin()
+		{
+			start_timing();
+			return {this, iterations};
+		}
+		iterator end() { return {this, 0}; }
+
+		int64_t arg() const { return argument; }
+		uint64_t get_iterations() const { return iterations; }
+
+		// leaves setup work inside the loop out of the measurement
+		void pause_timing();
+		void resume_timing();
+
+		// counts what one run processed, reported as a rate next to the time
+		void set_items_processed(const int64_t items) { items_processed = items; }
+		void skip_with_error(std::string message) { error = std::move(message); }
+
+	private:
+		void start_timing();
+		void stop_timing();
+
+		int64_t argument;
+		uint64_t iterations;
+		std::chrono::steady_clock::time_point started{};
+		std::chrono::steady_clock::duration elapsed{};
+		bool timing = false;
+
+		int64_t items_processed = 0;
+		std::string error;
+
+		friend class runner;
+	};
+
+	class definition
+	{
+	public:
+		using function = std::function<void(state&)>;
+
+		definition(std::string name, function fn) : name{std::move(name)}, fn{std::move(fn)}
+		{
+		}
+
+		definition* arg(const int64_t argument)
+		{
+			arguments.push_back(argument);
+			return this;
+		}
+
+		// every power of multiplier from first to last, both included
+		definition* range(int64_t first, int64_t last, int64_t multiplier = 8);
+
+		const std::string& get_name() const { return name; }
+		const std::vector<int64_t>& get_arguments() const { return arguments; }
+
+	private:
+		std::string name;
+		function fn;
+		std::vector<int64_t> arguments;
+
+		friend class runner;
+	};
+
+	definition* register_benchmark(std::string name, definition::function fn);
+
+	// [--filter substring] [--min-time seconds] [--json path], returns the process exit code
+	int run_benchmarks(int argc, char** argv);
+}
@@ -0,0 +1,79 @@
+#include "apps/bench_app.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	// [--objects n] [--lights n] [--light-radius r] [--gpu-lights] [--depth-prepass] [--seed n] [--frames n]
+	// [--warmup n] [--size wxh] [--offscreen] [--out path]
+	void parse_bench_args(const int argc, char** argv, vk_engine::bench_config& config)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const auto next = [&] { return i + 1 < argc ? argv[++i] : throw std::invalid_argument(argv[i]); };
+
+			if (std::strcmp(argv[i], "--objects") == 0)
+				config.object_count = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--lights") == 0)
+				config.light_count = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--light-radius") == 0)
+				config.light_radius = std::stof(next());
+			else if (std::strcmp(argv[i], "--gpu-lights") == 0)
+				config.gpu_light_assignment = true;
+			else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+				config.depth_prepass = true;
+			else if (std::strcmp(argv[i], "--seed") == 0)
+				config.seed = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--frames") == 0)
+				config.frame_count = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--warmup") == 0)
+				config.warmup_frames = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--size") == 0)
+			{
+				const std::string size = next();
+				const auto x = size.find('x');
+				config.width = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+				config.height = static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+			}
+			else if (std::strcmp(argv[i], "--offscreen") == 0)
+				config.offscreen = true;
+			else if (std::strcmp(argv[i], "--out") == 0)
+				config.output_path = next();
+			else
+				throw std::invalid_argument(argv[i]);
+		}
+
+		if (config.frame_count == 0 || config.width == 0 || config.height == 0)
+			throw std::invalid_argument("frame count and size must not be zero");
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	vk_engine::bench_config config{};
+
+	try
+	{
+		parse_bench_args(argc, argv, config);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "invalid argument: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		vk_engine::bench_app app{config};
+		app.run();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+# generates a source file with every compiled shader as a byte array, looked up by vk_shader_cache
+# before it touches the disk. run in script mode:
+#   cmake -DSHADER_FILES=a.spv|b.spv -DSOURCE_ROOT=<dir> -DOUTPUT=<file> -P embed_shaders.cmake
+
+string(REPLACE "|" ";" SHADER_FILES "${SHADER_FILES}")
+
+set(CONTENT "// generated by cmake/embed_shaders.cmake, do not edit\n\n#include <cstddef>\n\nnamespace vk_engine\n{\n")
+string(APPEND CONTENT "\tstruct embedded_shader\n\t{\n\t\tconst char* path;\n\t\tconst unsigned char* code;\n\t\tsize_t code_size;\n\t};\n\n")
+
+set(TABLE "")
+set(INDEX 0)
+foreach (SHADER_FILE ${SHADER_FILES})
+    file(READ ${SHADER_FILE} HEX_CONTENT HEX)
+    string(LENGTH "${HEX_CONTENT}" HEX_LENGTH)
+    math(EXPR BYTE_COUNT "${HEX_LENGTH} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX_CONTENT}")
+
+    # same relative path the render systems pass to vk_pipeline
+    file(RELATIVE_PATH SHADER_PATH ${SOURCE_ROOT} ${SHADER_FILE})
+
+    string(APPEND CONTENT "\talignas(4) static const unsigned char shader_${INDEX}[] = {${BYTES}};\n")
+    string(APPEND TABLE "\t\t{\"${SHADER_PATH}\", shader_${INDEX}, ${BYTE_COUNT}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach ()
+
+if (INDEX EQUAL 0)
+    string(APPEND TABLE "\t\t{\"\", nullptr, 0},\n")
+endif ()
+
+string(APPEND CONTENT "\n\textern const embedded_shader embedded_shaders[] = {\n${TABLE}\t};\n")
+string(APPEND CONTENT "\textern const size_t embedded_shader_count = ${INDEX};\n}\n")
+
+file(WRITE ${OUTPUT} "${CONTENT}")
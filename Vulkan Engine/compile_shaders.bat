@@ -14,4 +14,11 @@ for %%f in (assets/shaders/*.frag) do (
     glslc assets/shaders/%%f -o assets/shaders/%%f.spv
 )
 
+echo "[Compiling] compute shaders..."
+
+for %%f in (assets/shaders/*.comp) do (
+    echo "  %%f"
+    glslc assets/shaders/%%f -o assets/shaders/%%f.spv
+)
+
 echo "Done."
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "vk_camera.hpp"
 
+#include <cassert>
+
 using vk_engine::vk_camera;
 
 void vk_camera::set_orthographic_projection(
@@ -87,6 +89,18 @@ const glm::mat4& vk_camera::get_projection() const
 	return projection_matrix;
 }
 
+glm::mat4 vk_camera::get_jittered_projection() const
+{
+	// adds jitter * w to clip x and y, an ndc offset for perspective and orthographic projections alike
+	glm::mat4 jittered = projection_matrix;
+	for (int column = 0; column < 4; column++)
+	{
+		jittered[column][0] += jitter.x * projection_matrix[column][3];
+		jittered[column][1] += jitter.y * projection_matrix[column][3];
+	}
+	return jittered;
+}
+
 const glm::mat4& vk_camera::get_view() const
 {
 	return view_matrix;
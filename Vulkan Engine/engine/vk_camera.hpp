@@ -11,11 +11,18 @@ namespace vk_engine
 		void set_view_direction(glm::vec3 position, glm::vec3 direction, glm::vec3 up = glm::vec3{0.f, -1.f, 0.f});
 		void set_view_target(glm::vec3 position, glm::vec3 target, glm::vec3 up = glm::vec3{0.f, -1.f, 0.f});
 		void set_view_yxz(glm::vec3 position, glm::vec3 rotation);
+		// shifts the image by ndc_offset without changing the projection culling and lighting see, for temporal
+		// reconstruction. one pixel is 2 / extent in ndc
+		void set_jitter(glm::vec2 ndc_offset) { jitter = ndc_offset; }
 		const glm::mat4& get_projection() const;
+		// the projection to rasterize with, get_projection plus the jitter
+		glm::mat4 get_jittered_projection() const;
 		const glm::mat4& get_view() const;
+		glm::vec2 get_jitter() const { return jitter; }
 
 	private:
 		glm::mat4 projection_matrix{1.f};
+		glm::vec2 jitter{0.f};
 		glm::mat4 view_matrix{1.f};
 	};
 }
@@ -0,0 +1,118 @@
+#include "vk_cpu_profiler.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+namespace vk_engine
+{
+	namespace
+	{
+		void write_json_string(std::ostream& out, const std::string& value)
+		{
+			out << '"';
+			for (const char c : value)
+			{
+				if (c == '"' || c == '\\')
+					out << '\\' << c;
+				else if (static_cast<unsigned char>(c) < 0x20)
+					out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+						<< std::dec << std::setfill(' ');
+				else
+					out << c;
+			}
+			out << '"';
+		}
+	}
+
+	vk_cpu_profiler& vk_cpu_profiler::get()
+	{
+		static vk_cpu_profiler profiler;
+		return profiler;
+	}
+
+	vk_cpu_profiler::vk_cpu_profiler() : start_time{std::chrono::steady_clock::now()}
+	{
+	}
+
+	uint64_t vk_cpu_profiler::now_ns() const
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start_time).count());
+	}
+
+	vk_cpu_profiler::thread_buffer& vk_cpu_profiler::get_thread_buffer()
+	{
+		// buffers outlive their threads so events of finished workers still make it into the dump
+		thread_local thread_buffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock{buffers_mutex};
+			auto& new_buffer = buffers.emplace_back(std::make_unique<thread_buffer>());
+			new_buffer->thread_id = static_cast<uint32_t>(buffers.size());
+			new_buffer->thread_name = "thread " + std::to_string(new_buffer->thread_id);
+			buffer = new_buffer.get();
+		}
+		return *buffer;
+	}
+
+	void vk_cpu_profiler::set_thread_name(std::string name)
+	{
+		auto& buffer = get_thread_buffer();
+		std::lock_guard<std::mutex> lock{buffers_mutex};
+		buffer.thread_name = std::move(name);
+	}
+
+	void vk_cpu_profiler::record(const char* name, const uint64_t begin_ns, const uint64_t end_ns)
+	{
+		if (!is_enabled())
+			return;
+
+		auto& buffer = get_thread_buffer();
+		const size_t index = buffer.count.load(std::memory_order_relaxed);
+		const size_t chunk = index / chunk_size;
+		if (chunk >= max_chunks)
+			return; // full, later events are dropped
+
+		// only this thread ever allocates its chunks, the dumper never looks past the published count
+		if (buffer.chunks[chunk] == nullptr)
+			buffer.chunks[chunk] = std::make_unique<event[]>(chunk_size);
+
+		buffer.chunks[chunk][index % chunk_size] = {name, begin_ns, end_ns};
+		buffer.count.store(index + 1, std::memory_order_release);
+	}
+
+	bool vk_cpu_profiler::dump_trace(const std::string& file_path) const
+	{
+		std::ofstream file{file_path, std::ios::trunc};
+		if (!file.is_open())
+			return false;
+
+		std::lock_guard<std::mutex> lock{buffers_mutex};
+
+		// complete ("X") events in microseconds, one track per thread
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		for (const auto& buffer : buffers)
+		{
+			file << (first ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->thread_id
+				<< R"(,"args":{"name":)";
+			write_json_string(file, buffer->thread_name);
+			file << "}}";
+			first = false;
+
+			const size_t count = buffer->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto& [name, begin_ns, end_ns] = buffer->chunks[i / chunk_size][i % chunk_size];
+				file << ",\n{\"name\":";
+				write_json_string(file, name);
+				file << R"(,"ph":"X","pid":1,"tid":)" << buffer->thread_id << std::fixed << std::setprecision(3)
+					<< ",\"ts\":" << static_cast<double>(begin_ns) / 1000.0
+					<< ",\"dur\":" << static_cast<double>(end_ns - begin_ns) / 1000.0 << std::defaultfloat << "}";
+			}
+		}
+		file << "\n]}\n";
+
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// scoped cpu timing, compiled out with VK_ENGINE_DISABLE_PROFILER. names must be string literals (or otherwise
+// outlive the dump), only the pointer is stored
+#ifndef VK_ENGINE_DISABLE_PROFILER
+#define VK_PROFILE_CONCAT_INNER(a, b) a##b
+#define VK_PROFILE_CONCAT(a, b) VK_PROFILE_CONCAT_INNER(a, b)
+#define VK_PROFILE_SCOPE(name) const vk_engine::vk_cpu_scope VK_PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#define VK_PROFILE_FUNCTION() VK_PROFILE_SCOPE(__func__)
+#else
+#define VK_PROFILE_SCOPE(name) ((void)0)
+#define VK_PROFILE_FUNCTION() ((void)0)
+#endif
+
+namespace vk_engine
+{
+	// process wide recorder of begin/end events. every thread appends to its own buffer without locks or
+	// contention, dump_trace() writes everything recorded so far as chrome trace json (chrome://tracing, perfetto)
+	class vk_cpu_profiler
+	{
+	public:
+		struct event
+		{
+			const char* name;
+			uint64_t begin_ns;
+			uint64_t end_ns;
+		};
+
+		static vk_cpu_profiler& get();
+
+		vk_cpu_profiler(const vk_cpu_profiler&) = delete;
+		vk_cpu_profiler& operator=(const vk_cpu_profiler&) = delete;
+
+		// recording is on by default, scopes still read the clock when it is off but store nothing
+		void set_enabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+		bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+		// shows up as the track name in the trace viewer
+		void set_thread_name(std::string name);
+
+		void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+		uint64_t now_ns() const;
+
+		// safe while other threads keep recording, returns false if the file can't be written
+		bool dump_trace(const std::string& file_path) const;
+
+	private:
+		// events live in fixed size chunks that never move, the owner publishes the count after writing an event
+		// and the dumper only reads up to the published count
+		static constexpr size_t chunk_size = 4096;
+		static constexpr size_t max_chunks = 1024;
+
+		struct thread_buffer
+		{
+			uint32_t thread_id = 0;
+			std::string thread_name;
+			std::unique_ptr<event[]> chunks[max_chunks];
+			std::atomic<size_t> count{0};
+		};
+
+		vk_cpu_profiler();
+
+		thread_buffer& get_thread_buffer();
+
+		std::atomic<bool> enabled{true};
+		const std::chrono::steady_clock::time_point start_time;
+
+		mutable std::mutex buffers_mutex; // thread registration and dumping only
+		std::vector<std::unique_ptr<thread_buffer>> buffers;
+	};
+
+	class vk_cpu_scope
+	{
+	public:
+		explicit vk_cpu_scope(const char* name) : name{name}, begin_ns{vk_cpu_profiler::get().now_ns()}
+		{
+		}
+
+		~vk_cpu_scope()
+		{
+			auto& profiler = vk_cpu_profiler::get();
+			profiler.record(name, begin_ns, profiler.now_ns());
+		}
+
+		vk_cpu_scope(const vk_cpu_scope&) = delete;
+		vk_cpu_scope& operator=(const vk_cpu_scope&) = delete;
+
+	private:
+		const char* name;
+		uint64_t begin_ns;
+	};
+}
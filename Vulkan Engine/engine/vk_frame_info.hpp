@@ -6,6 +6,21 @@
 
 namespace vk_engine
 {
+	struct global_ubo
+	{
+		alignas(16) glm::mat4 projection{1.f};
+		alignas(16) glm::mat4 view{1.f};
+		alignas(16) glm::vec4 ambient_light_color{1.f, 1.f, 1.f, .2f};
+		alignas(16) glm::vec3 light_direction{
+			normalize(glm::vec3{1.f, -3.f, -1.f})
+		};
+		alignas(16) glm::vec3 point_light_position{-1.f};
+		alignas(16) glm::vec4 point_light_color{1.f, 1.f, 0.f, 1.f};
+		// unjittered, of the frame before, for motion vectors
+		alignas(16) glm::mat4 previous_view_projection{1.f};
+		alignas(16) glm::vec4 jitter{0.f}; // ndc offset in projection, see vk_camera::set_jitter
+	};
+
 	struct vk_frame_info
 	{
 		int frame_index;
@@ -14,5 +29,7 @@ namespace vk_engine
 		vk_camera& camera;
 		VkDescriptorSet global_descriptor_set;
 		vk_game_object::map& game_objects;
+		VkDescriptorSet light_descriptor_set{}; // see vk_clustered_lighting
+		VkDescriptorSet shadow_descriptor_set{}; // see vk_shadow_system
 	};
 }
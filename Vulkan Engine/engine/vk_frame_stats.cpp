@@ -0,0 +1,141 @@
+#include "vk_frame_stats.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+
+namespace vk_engine
+{
+	namespace
+	{
+		// nearest rank on a sorted copy
+		double percentile(const std::vector<double>& sorted, const double fraction)
+		{
+			const auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+			return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+		}
+
+		void write_summary(std::ostream& out, const char* name, const frame_time_summary& summary)
+		{
+			out << "	" << name << ": ";
+			if (summary.count == 0)
+			{
+				out << "no samples" << std::endl;
+				return;
+			}
+			out << std::fixed << std::setprecision(2)
+				<< "mean " << summary.mean << " ms, p50 " << summary.p50 << ", p95 " << summary.p95
+				<< ", p99 " << summary.p99 << ", max " << summary.max << ", stutters " << summary.stutters
+				<< std::defaultfloat << std::endl;
+		}
+
+		void write_csv_summary(std::ostream& out, const frame_time_summary& summary)
+		{
+			out << ',' << summary.mean << ',' << summary.p50 << ',' << summary.p95 << ',' << summary.p99
+				<< ',' << summary.max << ',' << summary.stutters;
+		}
+	}
+
+	vk_frame_stats::vk_frame_stats(const size_t window_size, const double report_interval,
+	                               const std::string& csv_path)
+		: samples(window_size),
+		  report_interval{report_interval},
+		  start_time{std::chrono::steady_clock::now()},
+		  last_report{start_time}
+	{
+		assert(window_size > 0 && "Frame stats window must hold at least one frame");
+
+		if (!csv_path.empty())
+		{
+			csv.open(csv_path, std::ios::trunc);
+			csv << "time_s,frames";
+			for (const char* source : {"frame", "cpu", "gpu"})
+				for (const char* column : {"mean", "p50", "p95", "p99", "max", "stutters"})
+					csv << ',' << source << '_' << column;
+			csv << std::endl;
+		}
+	}
+
+	void vk_frame_stats::add_frame(const double frame_ms, const double cpu_ms, const double gpu_ms)
+	{
+		samples[next_sample] = {frame_ms, cpu_ms, gpu_ms};
+		next_sample = (next_sample + 1) % samples.size();
+		sample_count = std::min(sample_count + 1, samples.size());
+		total_frames++;
+	}
+
+	void vk_frame_stats::update(std::ostream& log)
+	{
+		if (report_interval <= 0.0)
+			return;
+
+		const auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - last_report).count() < report_interval)
+			return;
+		last_report = now;
+
+		write_report(log);
+		if (csv.is_open())
+			write_csv_line();
+	}
+
+	frame_time_summary vk_frame_stats::summarize(const channel source) const
+	{
+		std::vector<double> times;
+		times.reserve(sample_count);
+		for (size_t i = 0; i < sample_count; i++)
+		{
+			const auto& [frame_ms, cpu_ms, gpu_ms] = samples[i];
+			const double time = source == channel::frame ? frame_ms : source == channel::cpu ? cpu_ms : gpu_ms;
+			times.push_back(time);
+		}
+
+		return summarize_times(std::move(times));
+	}
+
+	frame_time_summary summarize_times(std::vector<double> times)
+	{
+		times.erase(std::remove_if(times.begin(), times.end(), [](const double time) { return time < 0.0; }),
+		            times.end());
+
+		frame_time_summary summary{};
+		if (times.empty())
+			return summary;
+
+		std::sort(times.begin(), times.end());
+		summary.count = static_cast<uint32_t>(times.size());
+		for (const double time : times)
+			summary.mean += time;
+		summary.mean /= static_cast<double>(times.size());
+		summary.p50 = percentile(times, 0.50);
+		summary.p95 = percentile(times, 0.95);
+		summary.p99 = percentile(times, 0.99);
+		summary.max = times.back();
+
+		const double stutter_threshold = summary.p50 * vk_frame_stats::stutter_factor;
+		summary.stutters = static_cast<uint32_t>(
+			times.end() - std::upper_bound(times.begin(), times.end(), stutter_threshold));
+		return summary;
+	}
+
+	void vk_frame_stats::write_report(std::ostream& out) const
+	{
+		out << "[FRAME STATS]" << std::endl
+			<< "	last " << sample_count << " of " << total_frames << " frames" << std::endl;
+		write_summary(out, "frame", summarize(channel::frame));
+		write_summary(out, "cpu", summarize(channel::cpu));
+		write_summary(out, "gpu", summarize(channel::gpu));
+	}
+
+	void vk_frame_stats::write_csv_line()
+	{
+		csv << std::fixed << std::setprecision(3)
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()
+			<< ',' << total_frames;
+		write_csv_summary(csv, summarize(channel::frame));
+		write_csv_summary(csv, summarize(channel::cpu));
+		write_csv_summary(csv, summarize(channel::gpu));
+		csv << std::endl;
+	}
+}
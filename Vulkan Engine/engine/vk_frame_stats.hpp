@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+	struct frame_time_summary
+	{
+		uint32_t count = 0;
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+		uint32_t stutters = 0; // samples over stutter_factor times the median
+	};
+
+	// percentiles of any list of millisecond times, negative ones are left out
+	frame_time_summary summarize_times(std::vector<double> times);
+
+	// rolling window of frame, cpu and gpu times in milliseconds. averages hide hitches, so the reports are
+	// percentiles plus a count of frames that took much longer than the typical one
+	class vk_frame_stats
+	{
+	public:
+		enum class channel
+		{
+			frame, // wall clock between frames
+			cpu, // time the cpu spent on the frame, without waiting for the gpu
+			gpu, // gpu time of the frame, arrives a few frames late
+		};
+
+		static constexpr double stutter_factor = 2.0;
+
+		// a report goes to the log (and a csv line to csv_path, if set) every report_interval seconds,
+		// 0 disables periodic reports
+		explicit vk_frame_stats(size_t window_size = 600, double report_interval = 5.0, const std::string& csv_path = {});
+
+		vk_frame_stats(const vk_frame_stats&) = delete;
+		vk_frame_stats& operator=(const vk_frame_stats&) = delete;
+
+		// negative times are unknown and left out, e.g. gpu times before the first readback
+		void add_frame(double frame_ms, double cpu_ms, double gpu_ms);
+
+		// writes a report when the interval has passed, call once per frame
+		void update(std::ostream& log);
+
+		frame_time_summary summarize(channel source) const;
+		void write_report(std::ostream& out) const;
+
+	private:
+		struct sample
+		{
+			double frame_ms;
+			double cpu_ms;
+			double gpu_ms;
+		};
+
+		void write_csv_line();
+
+		std::vector<sample> samples; // ring
+		size_t next_sample = 0;
+		size_t sample_count = 0;
+		uint64_t total_frames = 0;
+
+		double report_interval;
+		std::chrono::steady_clock::time_point start_time;
+		std::chrono::steady_clock::time_point last_report;
+		std::ofstream csv;
+	};
+}
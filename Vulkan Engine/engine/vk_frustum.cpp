@@ -0,0 +1,25 @@
+#include "vk_frustum.hpp"
+
+using vk_engine::vk_frustum;
+
+vk_frustum vk_frustum::from_matrix(const glm::mat4& view_projection)
+{
+	// rows of the matrix, a clip space point is inside when -w <= x, y <= w and 0 <= z <= w
+	const auto row = [&](const int i)
+	{
+		return glm::vec4{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+	};
+	const glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+	vk_frustum frustum{};
+	frustum.planes[left_plane] = w + x;
+	frustum.planes[right_plane] = w - x;
+	frustum.planes[bottom_plane] = w + y;
+	frustum.planes[top_plane] = w - y;
+	frustum.planes[near_plane] = z;
+	frustum.planes[far_plane] = w - z;
+
+	for (auto& plane : frustum.planes)
+		plane /= glm::length(glm::vec3{plane});
+	return frustum;
+}
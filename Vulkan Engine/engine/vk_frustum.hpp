@@ -0,0 +1,30 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	// the six planes of a view projection, normals point inwards. depth is 0..1, see vk_camera
+	struct vk_frustum
+	{
+		enum side { left_plane, right_plane, bottom_plane, top_plane, near_plane, far_plane, plane_count };
+
+		glm::vec4 planes[plane_count]{}; // xyz normal, w distance, normalized
+
+		static vk_frustum from_matrix(const glm::mat4& view_projection);
+
+		// conservative: spheres near a frustum corner may pass without touching it
+		bool intersects_sphere(const glm::vec3& center, float radius) const
+		{
+			for (const auto& plane : planes)
+			{
+				if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius)
+					return false;
+			}
+			return true;
+		}
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <memory_resource>
 #include <unordered_map>
 #include <glm/ext.hpp>
 
@@ -42,6 +43,8 @@ namespace vk_engine
 		glm::vec3 color{}; //TODO ?
 		transform_component transform{};
 		rigid_body_component rigid_body{};
+		// promised never to move, its shadows are cached with the rest of the static geometry
+		bool is_static{false};
 
 	private:
 		explicit vk_game_object(id_t object_id);
@@ -0,0 +1,166 @@
+#include "vk_image_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	const std::array<uint32_t, 256>& crc_table()
+	{
+		static const auto table = []
+		{
+			std::array<uint32_t, 256> t{};
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				t[n] = c;
+			}
+			return t;
+		}();
+		return table;
+	}
+
+	uint32_t update_crc(uint32_t crc, const uint8_t* data, const size_t size)
+	{
+		const auto& table = crc_table();
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return crc;
+	}
+
+	void put_u32_be(std::vector<uint8_t>& out, const uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void write_chunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk;
+		chunk.reserve(data.size() + 12);
+		put_u32_be(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+
+		// crc covers the type and the data, not the length
+		const uint32_t crc = update_crc(0xffffffffu, chunk.data() + 4, chunk.size() - 4) ^ 0xffffffffu;
+		put_u32_be(chunk, crc);
+
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+	}
+
+	// zlib stream made of uncompressed deflate blocks, readback files are for verification, not for size
+	std::vector<uint8_t> zlib_store(const std::vector<uint8_t>& data)
+	{
+		constexpr size_t max_block = 65535;
+
+		std::vector<uint8_t> out;
+		out.reserve(data.size() + data.size() / max_block * 5 + 16);
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		size_t offset = 0;
+		do
+		{
+			const size_t block = std::min(max_block, data.size() - offset);
+			const bool last = offset + block == data.size();
+			out.push_back(last ? 1 : 0);
+			out.push_back(static_cast<uint8_t>(block));
+			out.push_back(static_cast<uint8_t>(block >> 8));
+			out.push_back(static_cast<uint8_t>(~block));
+			out.push_back(static_cast<uint8_t>(~block >> 8));
+			out.insert(out.end(), data.begin() + offset, data.begin() + offset + block);
+			offset += block;
+		}
+		while (offset < data.size());
+
+		uint32_t a = 1, b = 0;
+		for (const uint8_t byte : data)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		put_u32_be(out, b << 16 | a);
+
+		return out;
+	}
+}
+
+namespace vk_engine
+{
+	void write_image(
+		const std::string& path,
+		const image_file_format format,
+		const uint32_t width,
+		const uint32_t height,
+		const std::vector<uint8_t>& rgba)
+	{
+		switch (format)
+		{
+		case image_file_format::png:
+			write_png(path, width, height, rgba);
+			break;
+		case image_file_format::raw:
+			write_raw(path, rgba);
+			break;
+		}
+	}
+
+	void write_png(const std::string& path, const uint32_t width, const uint32_t height,
+	               const std::vector<uint8_t>& rgba)
+	{
+		assert(rgba.size() == static_cast<size_t>(width) * height * 4 && "Pixel data does not match image size");
+
+		std::ofstream file{path, std::ios::binary};
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open image file: " + path);
+
+		constexpr uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		std::vector<uint8_t> header;
+		put_u32_be(header, width);
+		put_u32_be(header, height);
+		header.push_back(8); // bit depth
+		header.push_back(6); // rgba
+		header.push_back(0); // deflate
+		header.push_back(0); // adaptive filtering
+		header.push_back(0); // no interlace
+		write_chunk(file, "IHDR", header);
+
+		// every scanline starts with its filter type, 0 = none
+		const size_t row_size = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> scanlines;
+		scanlines.reserve((row_size + 1) * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			scanlines.push_back(0);
+			const auto row = rgba.begin() + static_cast<std::ptrdiff_t>(row_size * y);
+			scanlines.insert(scanlines.end(), row, row + static_cast<std::ptrdiff_t>(row_size));
+		}
+		write_chunk(file, "IDAT", zlib_store(scanlines));
+		write_chunk(file, "IEND", {});
+
+		if (!file)
+			throw std::runtime_error("Failed to write image file: " + path);
+	}
+
+	void write_raw(const std::string& path, const std::vector<uint8_t>& rgba)
+	{
+		std::ofstream file{path, std::ios::binary};
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open image file: " + path);
+
+		file.write(reinterpret_cast<const char*>(rgba.data()), static_cast<std::streamsize>(rgba.size()));
+
+		if (!file)
+			throw std::runtime_error("Failed to write image file: " + path);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+	enum class image_file_format
+	{
+		png,
+		raw, // tightly packed rgba8 rows, top to bottom, no header
+	};
+
+	// writes tightly packed rgba8 pixels to path, throws on io failure
+	void write_image(
+		const std::string& path,
+		image_file_format format,
+		uint32_t width,
+		uint32_t height,
+		const std::vector<uint8_t>& rgba);
+
+	void write_png(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba);
+	void write_raw(const std::string& path, const std::vector<uint8_t>& rgba);
+}
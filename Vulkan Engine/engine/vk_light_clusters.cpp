@@ -0,0 +1,243 @@
+#include "vk_light_clusters.hpp"
+#include "vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_LIGHT_CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+using vk_engine::light_cluster_slicing;
+using vk_engine::vk_light_clusters;
+
+namespace
+{
+	uint32_t to_tile(const float ndc, const uint32_t tile_count)
+	{
+		const float tile = std::floor((ndc + 1.f) * .5f * static_cast<float>(tile_count));
+		return static_cast<uint32_t>(std::clamp(tile, 0.f, static_cast<float>(tile_count - 1)));
+	}
+}
+
+light_cluster_slicing light_cluster_slicing::from_projection(const glm::mat4& projection, const uint32_t slice_count)
+{
+	light_cluster_slicing slicing{};
+	const auto slices = static_cast<float>(slice_count);
+
+	// see vk_camera: perspective puts view z in w, both map near to 0 and far to 1
+	slicing.logarithmic = projection[2][3] != 0.f;
+	slicing.near = -projection[3][2] / projection[2][2];
+	if (slicing.logarithmic)
+	{
+		slicing.far = projection[3][2] / (1.f - projection[2][2]);
+		slicing.near = std::max(slicing.near, 1e-4f);
+		slicing.scale = slices / std::log(slicing.far / slicing.near);
+		slicing.bias = -std::log(slicing.near) * slicing.scale;
+	}
+	else
+	{
+		slicing.far = slicing.near + 1.f / projection[2][2];
+		slicing.scale = slices / (slicing.far - slicing.near);
+		slicing.bias = -slicing.near * slicing.scale;
+	}
+	return slicing;
+}
+
+float light_cluster_slicing::get_slice_depth(const uint32_t slice, const uint32_t slice_count) const
+{
+	const float t = static_cast<float>(slice) / static_cast<float>(slice_count);
+	if (logarithmic)
+		return near * std::pow(far / near, t);
+	return near + (far - near) * t;
+}
+
+vk_light_clusters::vk_light_clusters(const light_cluster_grid grid) : grid{grid}
+{
+	cluster_ranges.resize(grid.count());
+}
+
+void vk_light_clusters::build_cluster_bounds(const glm::mat4& projection)
+{
+	bounds_projection = projection;
+	slicing = light_cluster_slicing::from_projection(projection, grid.z);
+
+	row_stride = (grid.x + 3) & ~3u;
+	const size_t padded_count = static_cast<size_t>(row_stride) * grid.y * grid.z;
+
+	// padding never hits: the distance to an inverted infinite box is infinite
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+	min_x.assign(padded_count, infinity);
+	min_y.assign(padded_count, infinity);
+	min_z.assign(padded_count, infinity);
+	max_x.assign(padded_count, -infinity);
+	max_y.assign(padded_count, -infinity);
+	max_z.assign(padded_count, -infinity);
+
+	// each tile corner is a line through the near and far planes, the cluster corners are where it crosses the
+	// slice depths. works for orthographic projections too, where the lines are parallel
+	const glm::mat4 inverse_projection = glm::inverse(projection);
+	const auto unproject = [&](const float x, const float y, const float z)
+	{
+		const glm::vec4 point = inverse_projection * glm::vec4{x, y, z, 1.f};
+		return glm::vec3{point} / point.w;
+	};
+
+	for (uint32_t z = 0; z < grid.z; z++)
+	{
+		const float depths[] = {slicing.get_slice_depth(z, grid.z), slicing.get_slice_depth(z + 1, grid.z)};
+		for (uint32_t y = 0; y < grid.y; y++)
+		{
+			for (uint32_t x = 0; x < grid.x; x++)
+			{
+				glm::vec3 bounds_min{infinity}, bounds_max{-infinity};
+				for (uint32_t corner = 0; corner < 4; corner++)
+				{
+					const float ndc_x = -1.f + 2.f * static_cast<float>(x + (corner & 1)) / static_cast<float>(grid.x);
+					const float ndc_y = -1.f + 2.f * static_cast<float>(y + (corner >> 1)) / static_cast<float>(
+						grid.y);
+					const glm::vec3 near_point = unproject(ndc_x, ndc_y, 0.f);
+					const glm::vec3 far_point = unproject(ndc_x, ndc_y, 1.f);
+					for (const float depth : depths)
+					{
+						const float t = (depth - near_point.z) / (far_point.z - near_point.z);
+						const glm::vec3 point = near_point + t * (far_point - near_point);
+						bounds_min = glm::min(bounds_min, point);
+						bounds_max = glm::max(bounds_max, point);
+					}
+				}
+
+				const size_t i = (static_cast<size_t>(z) * grid.y + y) * row_stride + x;
+				min_x[i] = bounds_min.x;
+				min_y[i] = bounds_min.y;
+				min_z[i] = bounds_min.z;
+				max_x[i] = bounds_max.x;
+				max_y[i] = bounds_max.y;
+				max_z[i] = bounds_max.z;
+			}
+		}
+	}
+}
+
+void vk_light_clusters::assign(const glm::mat4& view, const glm::mat4& projection,
+                               const std::vector<point_light>& lights)
+{
+	VK_PROFILE_FUNCTION();
+	if (projection != bounds_projection)
+		build_cluster_bounds(projection);
+
+	hits.clear();
+	for (uint32_t light = 0; light < static_cast<uint32_t>(lights.size()); light++)
+	{
+		const glm::vec3 center{view * glm::vec4{lights[light].position, 1.f}};
+		const float radius = lights[light].radius;
+
+		const float depth_min = std::max(center.z - radius, slicing.near);
+		const float depth_max = std::min(center.z + radius, slicing.far);
+		if (depth_min > depth_max || radius <= 0.f)
+			continue;
+
+		// screen extent of the light's view space box, clipped to the depths it can be seen at
+		glm::vec2 ndc_min{std::numeric_limits<float>::infinity()}, ndc_max{-std::numeric_limits<float>::infinity()};
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const glm::vec4 clip = projection * glm::vec4{
+				center.x + (corner & 1 ? radius : -radius),
+				center.y + (corner & 2 ? radius : -radius),
+				corner & 4 ? depth_max : depth_min,
+				1.f
+			};
+			const glm::vec2 ndc = glm::vec2{clip} / clip.w;
+			ndc_min = glm::min(ndc_min, ndc);
+			ndc_max = glm::max(ndc_max, ndc);
+		}
+		if (ndc_max.x < -1.f || ndc_min.x > 1.f || ndc_max.y < -1.f || ndc_min.y > 1.f)
+			continue;
+
+		const uint32_t x_first = to_tile(ndc_min.x, grid.x), x_last = to_tile(ndc_max.x, grid.x);
+		const uint32_t y_first = to_tile(ndc_min.y, grid.y), y_last = to_tile(ndc_max.y, grid.y);
+		const auto slice_of = [&](const float depth)
+		{
+			const float slice = slicing.logarithmic
+				                    ? std::log(depth) * slicing.scale + slicing.bias
+				                    : depth * slicing.scale + slicing.bias;
+			return static_cast<uint32_t>(std::clamp(std::floor(slice), 0.f, static_cast<float>(grid.z - 1)));
+		};
+		const uint32_t z_first = slice_of(depth_min), z_last = slice_of(depth_max);
+
+#ifdef VK_LIGHT_CLUSTERS_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 center_x = _mm_set1_ps(center.x);
+		const __m128 center_y = _mm_set1_ps(center.y);
+		const __m128 center_z = _mm_set1_ps(center.z);
+		const __m128 radius_squared = _mm_set1_ps(radius * radius);
+		// squared distance from the center to four boxes along one axis, zero inside
+		const auto axis_distance = [&](const float* mins, const float* maxs, const __m128 center_axis)
+		{
+			const __m128 below = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(mins), center_axis), zero);
+			const __m128 above = _mm_max_ps(_mm_sub_ps(center_axis, _mm_loadu_ps(maxs)), zero);
+			const __m128 distance = _mm_add_ps(below, above);
+			return _mm_mul_ps(distance, distance);
+		};
+#endif
+
+		for (uint32_t z = z_first; z <= z_last; z++)
+		{
+			for (uint32_t y = y_first; y <= y_last; y++)
+			{
+				const size_t row = (static_cast<size_t>(z) * grid.y + y) * row_stride;
+				const uint32_t cluster_row = (z * grid.y + y) * grid.x;
+
+				for (uint32_t x = x_first & ~3u; x <= x_last; x += 4)
+				{
+					const size_t i = row + x;
+#ifdef VK_LIGHT_CLUSTERS_SSE
+					const __m128 distance = _mm_add_ps(
+						_mm_add_ps(axis_distance(&min_x[i], &max_x[i], center_x),
+						           axis_distance(&min_y[i], &max_y[i], center_y)),
+						axis_distance(&min_z[i], &max_z[i], center_z));
+					const auto mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distance, radius_squared)));
+#else
+					uint32_t mask = 0;
+					for (uint32_t lane = 0; lane < 4; lane++)
+					{
+						const glm::vec3 box_min{min_x[i + lane], min_y[i + lane], min_z[i + lane]};
+						const glm::vec3 box_max{max_x[i + lane], max_y[i + lane], max_z[i + lane]};
+						const glm::vec3 distance = glm::max(box_min - center, 0.f) + glm::max(center - box_max, 0.f);
+						if (glm::dot(distance, distance) <= radius * radius)
+							mask |= 1u << lane;
+					}
+#endif
+					for (uint32_t lane = 0; lane < 4; lane++)
+					{
+						if (mask & 1u << lane && x + lane >= x_first && x + lane <= x_last)
+							hits.push_back({cluster_row + x + lane, light});
+					}
+				}
+			}
+		}
+	}
+
+	// counting sort by cluster, lights stay in index order within a cluster
+	for (auto& range : cluster_ranges)
+		range = {0, 0};
+	for (const auto& hit : hits)
+		cluster_ranges[hit.x].y++;
+
+	uint32_t offset = 0;
+	for (auto& range : cluster_ranges)
+	{
+		range.x = offset;
+		offset += range.y;
+		range.y = 0;
+	}
+
+	light_indices.resize(hits.size());
+	for (const auto& [cluster, light] : hits)
+	{
+		auto& range = cluster_ranges[cluster];
+		light_indices[range.x + range.y++] = light;
+	}
+}
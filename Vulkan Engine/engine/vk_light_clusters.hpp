@@ -0,0 +1,80 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	// std430 layout of PointLight in the shaders
+	struct point_light
+	{
+		glm::vec3 position{}; // world space
+		float radius{1.f}; // no light reaches past it
+		glm::vec4 color{1.f}; // w is intensity
+	};
+
+	// froxels: screen tiles times depth slices, slices are exponential in view depth for perspective projections
+	// and linear for orthographic ones
+	struct light_cluster_grid
+	{
+		uint32_t x = 16;
+		uint32_t y = 9;
+		uint32_t z = 24;
+
+		uint32_t count() const { return x * y * z; }
+	};
+
+	// how view depth maps to a slice: logarithmic ? log(depth) * scale + bias : depth * scale + bias
+	struct light_cluster_slicing
+	{
+		float near = .1f;
+		float far = 100.f;
+		float scale = 0.f;
+		float bias = 0.f;
+		bool logarithmic = true;
+
+		// near and far come from the projection matrix, perspective or orthographic
+		static light_cluster_slicing from_projection(const glm::mat4& projection, uint32_t slice_count);
+
+		float get_slice_depth(uint32_t slice, uint32_t slice_count) const;
+	};
+
+	// assigns lights to the clusters they touch on the cpu: every light is tested against the view space bounds of
+	// the clusters its screen and depth extent covers, four clusters of a row at a time with sse where available.
+	// the result is one (offset, count) range per cluster into a list of light indices, the layout the fragment
+	// shader reads (see assets/shaders/simple_shader.frag)
+	class vk_light_clusters
+	{
+	public:
+		explicit vk_light_clusters(light_cluster_grid grid = {});
+
+		void assign(const glm::mat4& view, const glm::mat4& projection, const std::vector<point_light>& lights);
+
+		const light_cluster_grid& get_grid() const { return grid; }
+		const light_cluster_slicing& get_slicing() const { return slicing; }
+		// x fastest, then y, then z
+		const std::vector<glm::uvec2>& get_cluster_ranges() const { return cluster_ranges; }
+		const std::vector<uint32_t>& get_light_indices() const { return light_indices; }
+
+	private:
+		// only when the projection changes
+		void build_cluster_bounds(const glm::mat4& projection);
+
+		light_cluster_grid grid;
+		light_cluster_slicing slicing{};
+		glm::mat4 bounds_projection{0.f};
+
+		// view space bounds, structure of arrays, rows padded to a multiple of four clusters
+		uint32_t row_stride = 0;
+		std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+
+		// (cluster, light) pairs in light order, bucketed by cluster afterwards
+		std::vector<glm::uvec2> hits;
+		std::vector<glm::uvec2> cluster_ranges;
+		std::vector<uint32_t> light_indices;
+	};
+}
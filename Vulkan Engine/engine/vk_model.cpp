@@ -1,8 +1,10 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "vk_model.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
 #include "../engine/vk_utils.hpp"
 
+#include <atomic>
 #include <cassert>
 #include <iostream>
 #include <unordered_map>
@@ -11,25 +13,18 @@
 
 using vk_engine::vk_model;
 
-namespace std
+size_t std::hash<vk_model::vertex>::operator()(const vk_model::vertex& vertex) const noexcept
 {
-	template <>
-	struct hash<vk_model::vertex>
-	{
-		size_t operator()(const vk_model::vertex& vertex) const noexcept
-		{
-			size_t seed{0};
-			vk_engine::hash_combine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
-		}
-	};
+	size_t seed{0};
+	vk_engine::hash_combine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+	return seed;
 }
 
 std::vector<VkVertexInputBindingDescription> vk_model::vertex::get_binding_descriptions()
 {
 	std::vector<VkVertexInputBindingDescription> binding_descriptions(1);
 	binding_descriptions[0].binding = 0;
-	binding_descriptions[0].stride = sizeof vertex;
+	binding_descriptions[0].stride = sizeof(vertex);
 	binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 	return binding_descriptions;
 }
@@ -46,6 +41,11 @@ std::vector<VkVertexInputAttributeDescription> vk_model::vertex::get_attribute_d
 	return attribute_descriptions;
 }
 
+std::vector<VkVertexInputAttributeDescription> vk_model::vertex::get_position_attribute_descriptions()
+{
+	return {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vertex, position)}};
+}
+
 bool vk_model::vertex::operator==(const vertex& other) const
 {
 	return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
@@ -113,17 +113,58 @@ void vk_model::builder::load_model(const std::string& file_path)
 		}
 }
 
-vk_model::vk_model(vk_device& device, const builder& builder): device(device)
+vk_model::vk_model(vk_device& device, const builder& builder) : geometry_pool{device.get_geometry_pool()}
 {
+	static std::atomic<uint32_t> next_id{0};
+	id = next_id.fetch_add(1, std::memory_order_relaxed);
+
+	// around the box center, not the tightest sphere but good enough for culling
+	if (!builder.vertices.empty())
+	{
+		glm::vec3 min_position{builder.vertices.front().position}, max_position{min_position};
+		for (const auto& vertex : builder.vertices)
+		{
+			min_position = glm::min(min_position, vertex.position);
+			max_position = glm::max(max_position, vertex.position);
+		}
+		const glm::vec3 center = (min_position + max_position) * .5f;
+		float radius = 0.f;
+		for (const auto& vertex : builder.vertices)
+			radius = glm::max(radius, glm::length(vertex.position - center));
+		bounding_sphere = glm::vec4{center, radius};
+	}
+
 	create_vertex_buffers(builder.vertices);
 	create_index_buffers(builder.indices);
+	if (builder.keep_mesh)
+	{
+		mesh_vertices = builder.vertices;
+		mesh_indices = builder.indices;
+	}
+
+	const size_t expanded_count = builder.indices.empty() ? builder.vertices.size() : builder.indices.size();
+	if (expanded_count <= max_batched_vertex_count)
+	{
+		if (builder.indices.empty())
+			batch_vertices = builder.vertices;
+		else
+			for (const uint32_t index : builder.indices)
+				batch_vertices.push_back(builder.vertices[index]);
+	}
 }
 
-vk_model::~vk_model() = default;
+vk_model::~vk_model()
+{
+	geometry_pool.free_vertices(vertex_range);
+	geometry_pool.free_indices(index_range);
+}
 
-std::unique_ptr<vk_model> vk_model::create_model_from_file(vk_device& device, const std::string& file_path)
+std::unique_ptr<vk_model> vk_model::create_model_from_file(vk_device& device, const std::string& file_path,
+                                                           const bool keep_mesh)
 {
+	VK_PROFILE_FUNCTION();
 	builder builder{};
+	builder.keep_mesh = keep_mesh;
 	builder.load_model(file_path);
 
 	std::cout
@@ -138,79 +179,55 @@ std::unique_ptr<vk_model> vk_model::create_model_from_file(vk_device& device, co
 
 void vk_model::bind(const VkCommandBuffer command_buffer) const
 {
-	const VkBuffer buffers[] = {vertex_buffer->get_buffer()};
-	constexpr VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
-	if (has_index_buffer)
-		vkCmdBindIndexBuffer(command_buffer, index_buffer->get_buffer(), 0, VK_INDEX_TYPE_UINT32);
+	geometry_pool.bind(command_buffer);
 }
 
-void vk_model::draw(const VkCommandBuffer command_buffer) const
+void vk_model::draw(const VkCommandBuffer command_buffer, const uint32_t first_instance) const
 {
 	if (has_index_buffer)
-		vkCmdDrawIndexed(command_buffer, index_count, 1, 0, 0, 0);
+	{
+		vkCmdDrawIndexed(command_buffer, index_range.count, 1, index_range.first,
+		                 static_cast<int32_t>(vertex_range.first), first_instance);
+	}
 	else
-		vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
+		vkCmdDraw(command_buffer, vertex_range.count, 1, vertex_range.first, first_instance);
+}
+
+void vk_model::read_geometry(std::vector<vertex>& vertices, std::vector<uint32_t>& indices) const
+{
+	VK_PROFILE_FUNCTION();
+	if (!mesh_vertices.empty())
+	{
+		vertices = mesh_vertices;
+		indices = mesh_indices;
+		return;
+	}
+
+	vertices.resize(vertex_range.count);
+	geometry_pool.read_vertices(vertex_range, vertices.data());
+	indices.resize(index_range.count);
+	geometry_pool.read_indices(index_range, indices.data());
+}
+
+void vk_model::release_mesh()
+{
+	std::vector<vertex>{}.swap(mesh_vertices);
+	std::vector<uint32_t>{}.swap(mesh_indices);
 }
 
 void vk_model::create_vertex_buffers(const std::vector<vertex>& vertices)
 {
-	vertex_count = static_cast<uint32_t>(vertices.size());
+	const auto vertex_count = static_cast<uint32_t>(vertices.size());
 	assert(vertex_count >= 3 && "Vertex count must be at least 3");
 
-	const VkDeviceSize buffer_size = sizeof vertices[0] * vertex_count;
-	constexpr uint32_t vertex_size = sizeof vertices[0];
-
-	vk_buffer staging_buffer{
-		device,
-		vertex_size,
-		vertex_count,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-	staging_buffer.map();
-	staging_buffer.write_to_buffer(vertices.data());
-
-	vertex_buffer = std::make_unique<vk_buffer>(
-		device,
-		vertex_size,
-		vertex_count,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-	);
-
-	device.copy_buffer(staging_buffer.get_buffer(), vertex_buffer->get_buffer(), buffer_size);
+	vertex_range = geometry_pool.add_vertices(vertices.data(), vertex_count);
 }
 
 void vk_model::create_index_buffers(const std::vector<uint32_t>& indices)
 {
-	index_count = static_cast<uint32_t>(indices.size());
-	has_index_buffer = index_count > 0;
-
+	has_index_buffer = !indices.empty();
 	if (!has_index_buffer)
 		return;
 
-	const VkDeviceSize buffer_size = sizeof indices[0] * index_count;
-	constexpr uint32_t index_size = sizeof indices[0];
-
-	vk_buffer staging_buffer{
-		device,
-		index_size,
-		index_count,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	staging_buffer.map();
-	staging_buffer.write_to_buffer(indices.data());
-
-	index_buffer = std::make_unique<vk_buffer>(
-		device,
-		index_size,
-		index_count,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-	);
-
-	device.copy_buffer(staging_buffer.get_buffer(), index_buffer->get_buffer(), buffer_size);
+	index_range = geometry_pool.add_indices(indices.data(), static_cast<uint32_t>(indices.size()));
 }
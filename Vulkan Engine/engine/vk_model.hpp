@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include "../renderer/vk_buffer.hpp"
 #include "../renderer/vk_device.hpp"
+#include "../renderer/vk_geometry_pool.hpp"
 
 namespace vk_engine
 {
@@ -22,6 +23,8 @@ namespace vk_engine
 
 			static std::vector<VkVertexInputBindingDescription> get_binding_descriptions();
 			static std::vector<VkVertexInputAttributeDescription> get_attribute_descriptions();
+			// location 0 only, for depth only pipelines
+			static std::vector<VkVertexInputAttributeDescription> get_position_attribute_descriptions();
 
 			bool operator==(const vertex& other) const;
 		};
@@ -30,33 +33,77 @@ namespace vk_engine
 		{
 			std::vector<vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			// the model holds on to a cpu copy until release_mesh(), so a vk_static_batch built at load does not
+			// have to read it back
+			bool keep_mesh = false;
 
 			void load_model(const std::string& file_path);
 		};
 
+		// meshes with at most this many vertices, once their indices are expanded, keep them on the cpu too, so
+		// vk_dynamic_batcher can merge them into one draw
+		static constexpr uint32_t max_batched_vertex_count = 32;
+
 		vk_model(vk_device& device, const builder& builder);
 		~vk_model();
 
 		vk_model(const vk_model&) = delete;
 		vk_model& operator=(const vk_model&) = delete;
 
-		static std::unique_ptr<vk_model> create_model_from_file(vk_device& device, const std::string& file_path);
+		static std::unique_ptr<vk_model> create_model_from_file(vk_device& device, const std::string& file_path,
+		                                                        bool keep_mesh = false);
 
+		// binds the geometry pool every model of the device lives in, so it only has to happen again when the last
+		// model bound was from another pool (see get_geometry_pool), a batch rebound the buffers or models were
+		// added since
 		void bind(VkCommandBuffer command_buffer) const;
-		void draw(VkCommandBuffer command_buffer) const;
+		// first_instance shows up in gl_InstanceIndex, shaders use it to find their per object data
+		void draw(VkCommandBuffer command_buffer, uint32_t first_instance = 0) const;
+
+		// the builder's mesh, from the cpu copy if it was kept (see builder::keep_mesh), otherwise read back from the
+		// gpu, waiting for the queue. for load time work like vk_static_batch. indices is left empty for meshes
+		// without them
+		void read_geometry(std::vector<vertex>& vertices, std::vector<uint32_t>& indices) const;
+		// drops the cpu copy, the batch vertices stay
+		void release_mesh();
+
+		// unique per model for the life of the process, draws are sorted by it
+		uint32_t get_id() const { return id; }
+		// model space, xyz center, w radius
+		const glm::vec4& get_bounding_sphere() const { return bounding_sphere; }
+		bool is_batchable() const { return !batch_vertices.empty(); }
+		// model space triangle list, empty unless is_batchable()
+		const std::vector<vertex>& get_batch_vertices() const { return batch_vertices; }
+		const vk_geometry_pool* get_geometry_pool() const { return &geometry_pool; }
+		// in the pool's buffers, index_range is empty for meshes without indices
+		geometry_range get_vertex_range() const { return vertex_range; }
+		geometry_range get_index_range() const { return index_range; }
 
 	private:
 		void create_vertex_buffers(const std::vector<vertex>& vertices);
 		void create_index_buffers(const std::vector<uint32_t>& indices);
 
-		vk_device& device;
+		uint32_t id;
+		glm::vec4 bounding_sphere{0.f};
 
-		std::unique_ptr<vk_buffer> vertex_buffer{};
-		uint32_t vertex_count{};
-
-		std::unique_ptr<vk_buffer> index_buffer{};
-		uint32_t index_count{};
+		vk_geometry_pool& geometry_pool; // the device's
+		geometry_range vertex_range{};
+		geometry_range index_range{};
 		
 		bool has_index_buffer{false};
+
+		std::vector<vertex> mesh_vertices{}; // with builder::keep_mesh, until release_mesh()
+		std::vector<uint32_t> mesh_indices{};
+		std::vector<vertex> batch_vertices{};
+	};
+}
+
+namespace std
+{
+	// used to deduplicate vertices while loading models
+	template <>
+	struct hash<vk_engine::vk_model::vertex>
+	{
+		size_t operator()(const vk_engine::vk_model::vertex& vertex) const noexcept;
 	};
 }
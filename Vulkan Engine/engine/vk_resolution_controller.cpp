@@ -0,0 +1,94 @@
+#include "vk_resolution_controller.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace vk_engine
+{
+	vk_resolution_controller::vk_resolution_controller(const resolution_config config)
+		: config{config}, scale{config.max_scale}
+	{
+		assert(config.min_scale > 0.f && config.min_scale <= config.max_scale && config.max_scale <= 1.f &&
+			"Render scale range must be within (0, 1]");
+		assert(config.target_milliseconds > 0.0 && "Frame budget must be positive");
+	}
+
+	float vk_resolution_controller::update(const double gpu_milliseconds)
+	{
+		if (gpu_milliseconds < 0.0)
+			return scale;
+
+		if (frames_since_change < config.settle_frames)
+		{
+			frames_since_change++;
+			return scale;
+		}
+
+		average_milliseconds = has_average
+			                       ? average_milliseconds + (gpu_milliseconds - average_milliseconds) * config.smoothing
+			                       : gpu_milliseconds;
+		has_average = true;
+
+		float wanted = scale;
+		if (average_milliseconds > config.target_milliseconds)
+			wanted = scale * static_cast<float>(std::sqrt(config.target_milliseconds / average_milliseconds));
+		else if (average_milliseconds < config.target_milliseconds * config.headroom)
+		{
+			// aim for the headroom, not the budget, so the next frames don't land right back above it
+			const auto estimate = scale * static_cast<float>(
+				std::sqrt(config.target_milliseconds * config.headroom / average_milliseconds));
+			wanted = std::min(estimate, scale + config.max_step_up);
+		}
+
+		const float next = quantize(wanted);
+		if (next != scale)
+		{
+			scale = next;
+			has_average = false;
+			frames_since_change = 0;
+			change_count++;
+		}
+		return scale;
+	}
+
+	void vk_resolution_controller::reset()
+	{
+		scale = config.max_scale;
+		has_average = false;
+		frames_since_change = 0;
+	}
+
+	void vk_resolution_controller::set_scale_range(const float min_scale, const float max_scale)
+	{
+		assert(min_scale > 0.f && min_scale <= max_scale && max_scale <= 1.f &&
+			"Render scale range must be within (0, 1]");
+
+		config.min_scale = min_scale;
+		config.max_scale = max_scale;
+		const float clamped = std::clamp(scale, min_scale, max_scale);
+		if (clamped != scale)
+		{
+			scale = clamped;
+			has_average = false;
+			frames_since_change = 0;
+			change_count++;
+		}
+	}
+
+	VkExtent2D vk_resolution_controller::scale_extent(const VkExtent2D extent, const float render_scale)
+	{
+		const auto scaled = [render_scale](const uint32_t size)
+		{
+			return std::clamp(static_cast<uint32_t>(std::lround(size * render_scale)), 1u, std::max(size, 1u));
+		};
+		return {scaled(extent.width), scaled(extent.height)};
+	}
+
+	float vk_resolution_controller::quantize(const float value) const
+	{
+		// down when shrinking, so the estimate is not rounded back over the budget
+		const float steps = value < scale ? std::floor(value / config.step) : std::round(value / config.step);
+		return std::clamp(steps * config.step, config.min_scale, config.max_scale);
+	}
+}
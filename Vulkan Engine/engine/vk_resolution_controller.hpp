@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+namespace vk_engine
+{
+	struct resolution_config
+	{
+		double target_milliseconds = 15.0; // gpu budget of a frame, a bit under the refresh interval
+		float min_scale = .5f; // per axis
+		float max_scale = 1.f;
+		float step = 1.f / 32.f; // scales are multiples of this, smaller changes are not worth a resize
+		float max_step_up = 2.f / 32.f; // growing is careful, shrinking jumps straight to the estimate
+		double headroom = .85; // only grow while under this fraction of the budget
+		double smoothing = .2; // weight of the newest gpu time in the running average
+		// gpu times arrive frames in flight late, the ones right after a change still show the old scale
+		uint32_t settle_frames = 4;
+	};
+
+	// render scale of the scene from the gpu time of past frames. gpu time is taken to grow with the pixel count,
+	// so the scale per axis moves with the square root of budget over time. the band between headroom and budget
+	// is left alone so the scale doesn't flip back and forth around the budget
+	class vk_resolution_controller
+	{
+	public:
+		explicit vk_resolution_controller(resolution_config config = {});
+
+		// feed once per frame, negative times are unknown and ignored. returns the scale to render the next frame at
+		float update(double gpu_milliseconds);
+		// back to max_scale, e.g. after the scene or the swap chain changed
+		void reset();
+		// e.g. the range a temporal upscaler reconstructs well from, the scale is clamped into it right away
+		void set_scale_range(float min_scale, float max_scale);
+
+		float get_scale() const { return scale; }
+		VkExtent2D scale_extent(const VkExtent2D extent) const { return scale_extent(extent, scale); }
+		// at least one pixel, never past the extent
+		static VkExtent2D scale_extent(VkExtent2D extent, float render_scale);
+		uint32_t get_change_count() const { return change_count; }
+		const resolution_config& get_config() const { return config; }
+
+	private:
+		float quantize(float value) const;
+
+		resolution_config config;
+		float scale;
+		double average_milliseconds = 0.0;
+		bool has_average = false;
+		uint32_t frames_since_change = 0;
+		uint32_t change_count = 0;
+	};
+}
@@ -1,9 +1,88 @@
 #include "apps/application.hpp"
+#include "apps/headless_app.hpp"
 
+#include <cstring>
 #include <iostream>
+#include <string>
 
-int main()
+namespace
 {
+	// --headless [--frames n] [--warmup n] [--size wxh] [--capture path] [--capture-frame n] [--raw]
+	// [--pipeline-stats] [--trace path]
+	bool parse_headless_args(const int argc, char** argv, vk_engine::headless_app_config& config)
+	{
+		bool headless = false;
+		for (int i = 1; i < argc; i++)
+		{
+			const auto next = [&] { return i + 1 < argc ? argv[++i] : throw std::invalid_argument(argv[i]); };
+
+			if (std::strcmp(argv[i], "--headless") == 0)
+				headless = true;
+			else if (std::strcmp(argv[i], "--frames") == 0)
+				config.frame_count = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--warmup") == 0)
+				config.warmup_frames = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--size") == 0)
+			{
+				const std::string size = next();
+				const auto x = size.find('x');
+				config.width = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+				config.height = static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+			}
+			else if (std::strcmp(argv[i], "--capture") == 0)
+				config.capture_path = next();
+			else if (std::strcmp(argv[i], "--capture-frame") == 0)
+				config.capture_frame = static_cast<uint32_t>(std::stoul(next()));
+			else if (std::strcmp(argv[i], "--raw") == 0)
+				config.capture_format = vk_engine::image_file_format::raw;
+			else if (std::strcmp(argv[i], "--pipeline-stats") == 0)
+				config.pipeline_statistics = true;
+			else if (std::strcmp(argv[i], "--trace") == 0)
+				config.trace_path = next();
+			else
+				throw std::invalid_argument(argv[i]);
+		}
+
+		if (config.frame_count == 0 || config.width == 0 || config.height == 0)
+			throw std::invalid_argument("frame count and size must not be zero");
+		if (config.capture_frame >= config.frame_count)
+			throw std::invalid_argument("capture frame is past the last frame");
+
+		return headless;
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	vk_engine::headless_app_config headless_config{};
+	bool headless;
+
+	try
+	{
+		headless = parse_headless_args(argc, argv, headless_config);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "invalid argument: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	if (headless)
+	{
+		try
+		{
+			vk_engine::headless_app app{headless_config};
+			app.run();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << '\n';
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
 	vk_engine::application app{};
 	//vk_engine::gravity_vec_field_app app{};
 	//vk_engine::rotating_triangles_app app{};
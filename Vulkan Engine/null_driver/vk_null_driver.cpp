@@ -0,0 +1,909 @@
+#include "vk_null_driver.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+namespace vk_engine::null_driver
+{
+	namespace
+	{
+		// objects on the same "device" as the engine's, nothing outlives the process
+		struct device_state
+		{
+			std::mutex mutex; // pipelines and shader modules are created on worker threads
+			std::unordered_map<uint64_t, VkDeviceSize> buffer_sizes;
+			std::unordered_map<uint64_t, VkDeviceSize> image_sizes;
+			std::unordered_map<uint64_t, VkDeviceSize> memory_sizes;
+			std::unordered_map<uint64_t, std::unique_ptr<char[]>> memory_contents; // created on first map
+		};
+
+		struct bound_state
+		{
+			VkCommandBuffer command_buffer{};
+			uint64_t pipeline{};
+			uint64_t vertex_buffer{};
+			VkDeviceSize vertex_buffer_offset{};
+			uint64_t index_buffer{};
+			VkDeviceSize index_buffer_offset{};
+		};
+
+		std::atomic<uint64_t> next_handle{1};
+
+		device_state& get_device_state()
+		{
+			static device_state state;
+			return state;
+		}
+
+		// recording is single threaded, like in the engine
+		command_counts counts{};
+		bound_state bound{};
+		bool log_enabled = false;
+		std::vector<command> log;
+
+		// non-dispatchable handles are pointers on 64-bit and integers on 32-bit targets
+		template <typename T>
+		T make_handle()
+		{
+			const uint64_t id = next_handle.fetch_add(1, std::memory_order_relaxed) * 16;
+			if constexpr (std::is_pointer_v<T>)
+				return reinterpret_cast<T>(static_cast<uintptr_t>(id));
+			else
+				return static_cast<T>(id);
+		}
+
+		template <typename T>
+		uint64_t handle_id(const T handle)
+		{
+			if constexpr (std::is_pointer_v<T>)
+				return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+			else
+				return static_cast<uint64_t>(handle);
+		}
+
+		template <typename T>
+		VkResult create(T* handle)
+		{
+			*handle = make_handle<T>();
+			return VK_SUCCESS;
+		}
+
+		void record(const command_type type, const VkCommandBuffer command_buffer, const uint64_t object,
+		            const uint32_t count, const uint32_t instance_count = 1)
+		{
+			if (log_enabled)
+				log.push_back({type, command_buffer, object, count, instance_count});
+		}
+
+		// vk_device only looks for the validation layer and the debug utils extension
+		constexpr const char* layer_name = "VK_LAYER_KHRONOS_validation";
+		constexpr const char* instance_extension_name = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+
+		template <typename T>
+		VkResult enumerate(const T& value, uint32_t* count, T* values)
+		{
+			if (values == nullptr)
+			{
+				*count = 1;
+				return VK_SUCCESS;
+			}
+			if (*count == 0)
+				return VK_INCOMPLETE;
+			values[0] = value;
+			*count = 1;
+			return VK_SUCCESS;
+		}
+
+		VKAPI_ATTR VkResult VKAPI_CALL create_debug_utils_messenger(
+			VkInstance, const VkDebugUtilsMessengerCreateInfoEXT*, const VkAllocationCallbacks*,
+			VkDebugUtilsMessengerEXT* messenger)
+		{
+			return create(messenger);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL destroy_debug_utils_messenger(
+			VkInstance, VkDebugUtilsMessengerEXT, const VkAllocationCallbacks*)
+		{
+		}
+	}
+
+	command_counts get_command_counts()
+	{
+		return counts;
+	}
+
+	void reset_command_counts()
+	{
+		counts = {};
+	}
+
+	void set_command_log_enabled(const bool enabled)
+	{
+		log_enabled = enabled;
+	}
+
+	const std::vector<command>& get_command_log()
+	{
+		return log;
+	}
+
+	void clear_command_log()
+	{
+		log.clear();
+	}
+}
+
+using namespace vk_engine::null_driver;
+
+extern "C" {
+// instance and physical device
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo*, const VkAllocationCallbacks*,
+                                                VkInstance* instance)
+{
+	return create(instance);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(uint32_t* count, VkLayerProperties* layers)
+{
+	VkLayerProperties layer{};
+	std::strcpy(layer.layerName, layer_name);
+	layer.specVersion = VK_API_VERSION_1_0;
+	return enumerate(layer, count, layers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char*, uint32_t* count,
+                                                                      VkExtensionProperties* extensions)
+{
+	VkExtensionProperties extension{};
+	std::strcpy(extension.extensionName, instance_extension_name);
+	extension.specVersion = 1;
+	return enumerate(extension, count, extensions);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance, const char* name)
+{
+	if (std::strcmp(name, "vkCreateDebugUtilsMessengerEXT") == 0)
+		return reinterpret_cast<PFN_vkVoidFunction>(&create_debug_utils_messenger);
+	if (std::strcmp(name, "vkDestroyDebugUtilsMessengerEXT") == 0)
+		return reinterpret_cast<PFN_vkVoidFunction>(&destroy_debug_utils_messenger);
+	return nullptr;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance, uint32_t* count, VkPhysicalDevice* devices)
+{
+	static const auto physical_device = make_handle<VkPhysicalDevice>();
+	return enumerate(physical_device, count, devices);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties)
+{
+	*properties = {};
+	properties->apiVersion = VK_API_VERSION_1_0;
+	properties->driverVersion = 1;
+	properties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+	std::strcpy(properties->deviceName, "vk_engine null device");
+	// never matches a real driver, so a null run can't hand its pipeline cache to one
+	std::memcpy(properties->pipelineCacheUUID, "vk_engine null\0\0", VK_UUID_SIZE);
+
+	auto& limits = properties->limits;
+	limits.maxImageDimension2D = 16384;
+	limits.maxUniformBufferRange = 65536;
+	limits.maxStorageBufferRange = 1u << 30;
+	limits.maxPushConstantsSize = 256;
+	limits.maxMemoryAllocationCount = 1u << 20;
+	limits.bufferImageGranularity = 1;
+	limits.maxBoundDescriptorSets = 8;
+	limits.maxComputeSharedMemorySize = 32768;
+	limits.maxComputeWorkGroupCount[0] = limits.maxComputeWorkGroupCount[1] = limits.maxComputeWorkGroupCount[2]
+		= 65535;
+	limits.maxComputeWorkGroupInvocations = 1024;
+	limits.maxComputeWorkGroupSize[0] = limits.maxComputeWorkGroupSize[1] = 1024;
+	limits.maxComputeWorkGroupSize[2] = 64;
+	limits.maxDrawIndirectCount = ~0u;
+	limits.minMemoryMapAlignment = 64;
+	limits.minTexelBufferOffsetAlignment = 16;
+	limits.minUniformBufferOffsetAlignment = 256;
+	limits.minStorageBufferOffsetAlignment = 64;
+	limits.maxFramebufferWidth = 16384;
+	limits.maxFramebufferHeight = 16384;
+	limits.framebufferColorSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+	limits.timestampComputeAndGraphics = VK_FALSE;
+	limits.timestampPeriod = 1.f;
+	limits.nonCoherentAtomSize = 64;
+	limits.maxSamplerAnisotropy = 16.f;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures* features)
+{
+	*features = {};
+	features->samplerAnisotropy = VK_TRUE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t* count,
+                                                                    VkQueueFamilyProperties* families)
+{
+	// no timestamps, the gpu profiler turns itself off
+	VkQueueFamilyProperties family{};
+	family.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+	family.queueCount = 1;
+	family.timestampValidBits = 0;
+	family.minImageTransferGranularity = {1, 1, 1};
+	enumerate(family, count, families);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice,
+                                                               VkPhysicalDeviceMemoryProperties* properties)
+{
+	// one type that is everything, any request finds it
+	*properties = {};
+	properties->memoryTypeCount = 1;
+	properties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+		VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	properties->memoryTypes[0].heapIndex = 0;
+	properties->memoryHeapCount = 1;
+	properties->memoryHeaps[0].size = VkDeviceSize{16} << 30;
+	properties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat,
+                                                               VkFormatProperties* properties)
+{
+	properties->linearTilingFeatures = ~0u;
+	properties->optimalTilingFeatures = ~0u;
+	properties->bufferFeatures = ~0u;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice, const char*, uint32_t* count,
+                                                                    VkExtensionProperties*)
+{
+	*count = 0;
+	return VK_SUCCESS;
+}
+
+// surfaces and swap chains, there is nothing to present to
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySurfaceKHR(VkInstance, VkSurfaceKHR, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice, uint32_t, VkSurfaceKHR,
+                                                                    VkBool32* supported)
+{
+	*supported = VK_FALSE;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice, VkSurfaceKHR,
+                                                                         VkSurfaceCapabilitiesKHR*)
+{
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t* count,
+                                                                    VkSurfaceFormatKHR*)
+{
+	*count = 0;
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice, VkSurfaceKHR,
+                                                                         uint32_t* count, VkPresentModeKHR*)
+{
+	*count = 0;
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice, const VkSwapchainCreateInfoKHR*,
+                                                    const VkAllocationCallbacks*, VkSwapchainKHR*)
+{
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice, VkSwapchainKHR, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice, VkSwapchainKHR, uint32_t* count, VkImage*)
+{
+	*count = 0;
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice, VkSwapchainKHR, uint64_t, VkSemaphore, VkFence,
+                                                     uint32_t*)
+{
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue, const VkPresentInfoKHR*)
+{
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+// device and queues, every submit has finished by the time it returns
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo*,
+                                              const VkAllocationCallbacks*, VkDevice* device)
+{
+	return create(device);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue* queue)
+{
+	static const auto device_queue = make_handle<VkQueue>();
+	*queue = device_queue;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, const uint32_t submit_count, const VkSubmitInfo*, VkFence)
+{
+	counts.submits += submit_count;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo*, const VkAllocationCallbacks*,
+                                             VkFence* fence)
+{
+	return create(fence);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, uint32_t, const VkFence*)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*,
+                                                 const VkAllocationCallbacks*, VkSemaphore* semaphore)
+{
+	return create(semaphore);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks*)
+{
+}
+
+// command pools and buffers
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*,
+                                                   const VkAllocationCallbacks*, VkCommandPool* pool)
+{
+	return create(pool);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* allocate_info,
+                                                        VkCommandBuffer* command_buffers)
+{
+	for (uint32_t i = 0; i < allocate_info->commandBufferCount; i++)
+		command_buffers[i] = make_handle<VkCommandBuffer>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(const VkCommandBuffer command_buffer,
+                                                    const VkCommandBufferBeginInfo*)
+{
+	counts.command_buffers++;
+	bound = {};
+	bound.command_buffer = command_buffer;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer)
+{
+	return VK_SUCCESS;
+}
+
+// memory, backed by host memory once it is mapped
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* allocate_info,
+                                                const VkAllocationCallbacks*, VkDeviceMemory* memory)
+{
+	*memory = make_handle<VkDeviceMemory>();
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.memory_sizes[handle_id(*memory)] = allocate_info->allocationSize;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, const VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.memory_sizes.erase(handle_id(memory));
+	state.memory_contents.erase(handle_id(memory));
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, const VkDeviceMemory memory, const VkDeviceSize offset,
+                                           VkDeviceSize, VkMemoryMapFlags, void** data)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	const auto size = state.memory_sizes.find(handle_id(memory));
+	if (size == state.memory_sizes.end())
+		return VK_ERROR_MEMORY_MAP_FAILED;
+
+	auto& contents = state.memory_contents[handle_id(memory)];
+	if (!contents)
+		contents.reset(new char[static_cast<size_t>(size->second)]);
+	*data = contents.get() + offset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+	return VK_SUCCESS;
+}
+
+// buffers and images
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo* create_info,
+                                              const VkAllocationCallbacks*, VkBuffer* buffer)
+{
+	*buffer = make_handle<VkBuffer>();
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.buffer_sizes[handle_id(*buffer)] = create_info->size;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, const VkBuffer buffer, const VkAllocationCallbacks*)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.buffer_sizes.erase(handle_id(buffer));
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, const VkBuffer buffer,
+                                                         VkMemoryRequirements* requirements)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	requirements->size = (state.buffer_sizes[handle_id(buffer)] + 255) & ~VkDeviceSize{255};
+	requirements->alignment = 256;
+	requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo* create_info,
+                                             const VkAllocationCallbacks*, VkImage* image)
+{
+	*image = make_handle<VkImage>();
+
+	// every format counted as 8 bytes a texel, enough to make sizes and aliasing plausible
+	const auto& [width, height, depth] = create_info->extent;
+	const VkDeviceSize size = VkDeviceSize{width} * height * depth * create_info->arrayLayers * 8;
+
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.image_sizes[handle_id(*image)] = size;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, const VkImage image, const VkAllocationCallbacks*)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	state.image_sizes.erase(handle_id(image));
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, const VkImage image,
+                                                        VkMemoryRequirements* requirements)
+{
+	auto& state = get_device_state();
+	std::lock_guard<std::mutex> lock{state.mutex};
+	requirements->size = (state.image_sizes[handle_id(image)] + 4095) & ~VkDeviceSize{4095};
+	requirements->alignment = 4096;
+	requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*,
+                                                 const VkAllocationCallbacks*, VkImageView* view)
+{
+	return create(view);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice, const VkSamplerCreateInfo*, const VkAllocationCallbacks*,
+                                               VkSampler* sampler)
+{
+	return create(sampler);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice, VkSampler, const VkAllocationCallbacks*)
+{
+}
+
+// pipelines and render passes
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo*,
+                                                    const VkAllocationCallbacks*, VkShaderModule* shader_module)
+{
+	return create(shader_module);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice, VkShaderModule, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineCache(VkDevice, const VkPipelineCacheCreateInfo*,
+                                                     const VkAllocationCallbacks*, VkPipelineCache* cache)
+{
+	return create(cache);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineCache(VkDevice, VkPipelineCache, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPipelineCacheData(VkDevice, VkPipelineCache, size_t* data_size, void*)
+{
+	// empty, so nothing is ever saved
+	*data_size = 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo*,
+                                                      const VkAllocationCallbacks*, VkPipelineLayout* layout)
+{
+	return create(layout);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice, VkPipelineLayout, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, const uint32_t count,
+                                                         const VkGraphicsPipelineCreateInfo*,
+                                                         const VkAllocationCallbacks*, VkPipeline* pipelines)
+{
+	for (uint32_t i = 0; i < count; i++)
+		pipelines[i] = make_handle<VkPipeline>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice, VkPipelineCache, const uint32_t count,
+                                                        const VkComputePipelineCreateInfo*,
+                                                        const VkAllocationCallbacks*, VkPipeline* pipelines)
+{
+	for (uint32_t i = 0; i < count; i++)
+		pipelines[i] = make_handle<VkPipeline>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo*,
+                                                  const VkAllocationCallbacks*, VkRenderPass* render_pass)
+{
+	return create(render_pass);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo*,
+                                                   const VkAllocationCallbacks*, VkFramebuffer* framebuffer)
+{
+	return create(framebuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer, const VkAllocationCallbacks*)
+{
+}
+
+// descriptors
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*,
+                                                           const VkAllocationCallbacks*,
+                                                           VkDescriptorSetLayout* layout)
+{
+	return create(layout);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout,
+                                                        const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo*,
+                                                      const VkAllocationCallbacks*, VkDescriptorPool* pool)
+{
+	return create(pool);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(VkDevice, VkDescriptorPool, VkDescriptorPoolResetFlags)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* allocate_info,
+                                                        VkDescriptorSet* sets)
+{
+	for (uint32_t i = 0; i < allocate_info->descriptorSetCount; i++)
+		sets[i] = make_handle<VkDescriptorSet>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets(VkDevice, VkDescriptorPool, uint32_t, const VkDescriptorSet*)
+{
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t,
+                                                  const VkCopyDescriptorSet*)
+{
+}
+
+// queries, every result reads as zero
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo*,
+                                                 const VkAllocationCallbacks*, VkQueryPool* pool)
+{
+	return create(pool);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice, VkQueryPool, const VkAllocationCallbacks*)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice, VkQueryPool, uint32_t, uint32_t,
+                                                     const size_t data_size, void* data, VkDeviceSize,
+                                                     VkQueryResultFlags)
+{
+	std::memset(data, 0, data_size);
+	return VK_SUCCESS;
+}
+
+// commands, counted and logged
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(const VkCommandBuffer command_buffer,
+                                                const VkRenderPassBeginInfo* begin_info, VkSubpassContents)
+{
+	counts.render_passes++;
+	record(command_type::begin_render_pass, command_buffer, handle_id(begin_info->renderPass),
+	       begin_info->clearValueCount);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdNextSubpass(const VkCommandBuffer command_buffer, VkSubpassContents)
+{
+	record(command_type::next_subpass, command_buffer, 0, 0);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(const VkCommandBuffer command_buffer)
+{
+	record(command_type::end_render_pass, command_buffer, 0, 0);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(const VkCommandBuffer command_buffer, VkPipelineBindPoint,
+                                             const VkPipeline pipeline)
+{
+	counts.pipeline_binds++;
+	if (bound.pipeline == handle_id(pipeline))
+		counts.redundant_pipeline_binds++;
+	bound.pipeline = handle_id(pipeline);
+	record(command_type::bind_pipeline, command_buffer, handle_id(pipeline), 1);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(const VkCommandBuffer command_buffer, VkPipelineBindPoint,
+                                                   const VkPipelineLayout layout, uint32_t,
+                                                   const uint32_t set_count, const VkDescriptorSet*, uint32_t,
+                                                   const uint32_t*)
+{
+	counts.descriptor_set_binds++;
+	record(command_type::bind_descriptor_sets, command_buffer, handle_id(layout), set_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(const VkCommandBuffer command_buffer, uint32_t,
+                                                  const uint32_t binding_count, const VkBuffer* buffers,
+                                                  const VkDeviceSize* offsets)
+{
+	counts.vertex_buffer_binds++;
+	if (binding_count > 0)
+	{
+		if (bound.vertex_buffer == handle_id(buffers[0]) && bound.vertex_buffer_offset == offsets[0])
+			counts.redundant_vertex_buffer_binds++;
+		bound.vertex_buffer = handle_id(buffers[0]);
+		bound.vertex_buffer_offset = offsets[0];
+	}
+	record(command_type::bind_vertex_buffers, command_buffer, binding_count > 0 ? handle_id(buffers[0]) : 0,
+	       binding_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(const VkCommandBuffer command_buffer, const VkBuffer buffer,
+                                                const VkDeviceSize offset, VkIndexType)
+{
+	counts.index_buffer_binds++;
+	if (bound.index_buffer == handle_id(buffer) && bound.index_buffer_offset == offset)
+		counts.redundant_index_buffer_binds++;
+	bound.index_buffer = handle_id(buffer);
+	bound.index_buffer_offset = offset;
+	record(command_type::bind_index_buffer, command_buffer, handle_id(buffer), 1);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(const VkCommandBuffer command_buffer, const VkPipelineLayout layout,
+                                              VkShaderStageFlags, uint32_t, const uint32_t size, const void*)
+{
+	counts.push_constants++;
+	record(command_type::push_constants, command_buffer, handle_id(layout), size);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(const VkCommandBuffer command_buffer, const uint32_t vertex_count,
+                                     const uint32_t instance_count, uint32_t, uint32_t)
+{
+	counts.draws++;
+	counts.vertices += uint64_t{vertex_count} * instance_count;
+	counts.instances += instance_count;
+	record(command_type::draw, command_buffer, bound.pipeline, vertex_count, instance_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(const VkCommandBuffer command_buffer, const uint32_t index_count,
+                                            const uint32_t instance_count, uint32_t, int32_t, uint32_t)
+{
+	counts.draws++;
+	counts.vertices += uint64_t{index_count} * instance_count;
+	counts.instances += instance_count;
+	record(command_type::draw_indexed, command_buffer, bound.pipeline, index_count, instance_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(const VkCommandBuffer command_buffer, const uint32_t group_count_x,
+                                         const uint32_t group_count_y, const uint32_t group_count_z)
+{
+	counts.dispatches++;
+	record(command_type::dispatch, command_buffer, bound.pipeline, group_count_x * group_count_y * group_count_z);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(const VkCommandBuffer command_buffer, VkPipelineStageFlags,
+                                                VkPipelineStageFlags, VkDependencyFlags,
+                                                const uint32_t memory_barrier_count, const VkMemoryBarrier*,
+                                                const uint32_t buffer_barrier_count, const VkBufferMemoryBarrier*,
+                                                const uint32_t image_barrier_count, const VkImageMemoryBarrier*)
+{
+	counts.barriers++;
+	record(command_type::pipeline_barrier, command_buffer, 0,
+	       memory_barrier_count + buffer_barrier_count + image_barrier_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(const VkCommandBuffer command_buffer, const VkBuffer src_buffer,
+                                           VkBuffer, const uint32_t region_count, const VkBufferCopy*)
+{
+	record(command_type::copy, command_buffer, handle_id(src_buffer), region_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(const VkCommandBuffer command_buffer, const VkBuffer src_buffer,
+                                                  VkImage, VkImageLayout, const uint32_t region_count,
+                                                  const VkBufferImageCopy*)
+{
+	record(command_type::copy, command_buffer, handle_id(src_buffer), region_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImage(const VkCommandBuffer command_buffer, const VkImage src_image,
+                                          VkImageLayout, VkImage, VkImageLayout, const uint32_t region_count,
+                                          const VkImageCopy*)
+{
+	record(command_type::copy, command_buffer, handle_id(src_image), region_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBlitImage(const VkCommandBuffer command_buffer, const VkImage src_image,
+                                          VkImageLayout, VkImage, VkImageLayout, const uint32_t region_count,
+                                          const VkImageBlit*, VkFilter)
+{
+	record(command_type::copy, command_buffer, handle_id(src_image), region_count);
+}
+
+// a transfer like the copies, logged as one
+VKAPI_ATTR void VKAPI_CALL vkCmdClearDepthStencilImage(const VkCommandBuffer command_buffer, const VkImage image,
+                                                       VkImageLayout, const VkClearDepthStencilValue*,
+                                                       const uint32_t range_count, const VkImageSubresourceRange*)
+{
+	record(command_type::copy, command_buffer, handle_id(image), range_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(const VkCommandBuffer command_buffer, const VkImage src_image,
+                                                  VkImageLayout, VkBuffer, const uint32_t region_count,
+                                                  const VkBufferImageCopy*)
+{
+	record(command_type::copy, command_buffer, handle_id(src_image), region_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(const VkCommandBuffer command_buffer, uint32_t,
+                                            const uint32_t viewport_count, const VkViewport*)
+{
+	record(command_type::set_dynamic_state, command_buffer, 0, viewport_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(const VkCommandBuffer command_buffer, uint32_t,
+                                           const uint32_t scissor_count, const VkRect2D*)
+{
+	record(command_type::set_dynamic_state, command_buffer, 0, scissor_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(const VkCommandBuffer command_buffer, const VkQueryPool pool,
+                                               uint32_t, const uint32_t query_count)
+{
+	record(command_type::query, command_buffer, handle_id(pool), query_count);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(const VkCommandBuffer command_buffer, VkPipelineStageFlagBits,
+                                               const VkQueryPool pool, uint32_t)
+{
+	record(command_type::query, command_buffer, handle_id(pool), 1);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery(const VkCommandBuffer command_buffer, const VkQueryPool pool, uint32_t,
+                                           VkQueryControlFlags)
+{
+	record(command_type::query, command_buffer, handle_id(pool), 1);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndQuery(const VkCommandBuffer command_buffer, const VkQueryPool pool, uint32_t)
+{
+	record(command_type::query, command_buffer, handle_id(pool), 1);
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// vulkan entry points without a gpu behind them. linked instead of the vulkan loader, the engine runs unchanged on
+// a headless device: objects get fake handles, mapped memory is plain host memory, submits complete at once and
+// every vkCmd* call is counted (and optionally logged) instead of executed.
+//
+// only what the engine calls is implemented, there is no surface or swap chain, so use vk_device() and the
+// offscreen renderer. commands are expected to be recorded from one thread at a time, as the engine does.
+namespace vk_engine::null_driver
+{
+	enum class command_type : uint8_t
+	{
+		begin_render_pass,
+		next_subpass,
+		end_render_pass,
+		bind_pipeline,
+		bind_descriptor_sets,
+		bind_vertex_buffers,
+		bind_index_buffer,
+		push_constants,
+		draw,
+		draw_indexed,
+		dispatch,
+		pipeline_barrier,
+		copy,
+		query,
+		set_dynamic_state,
+	};
+
+	struct command
+	{
+		command_type type;
+		VkCommandBuffer command_buffer;
+		uint64_t object; // pipeline, layout, first buffer or render pass, whatever the command binds
+		uint32_t count; // vertices/indices for draws, workgroups for dispatches, sets or buffers for binds, bytes
+		                // for push constants
+		uint32_t instance_count;
+	};
+
+	struct command_counts
+	{
+		uint64_t command_buffers = 0; // begun
+		uint64_t submits = 0;
+		uint64_t render_passes = 0;
+		uint64_t draws = 0; // indexed and not
+		uint64_t vertices = 0; // vertex or index count times instances
+		uint64_t instances = 0;
+		uint64_t dispatches = 0;
+		uint64_t pipeline_binds = 0;
+		uint64_t descriptor_set_binds = 0; // calls, not sets
+		uint64_t vertex_buffer_binds = 0;
+		uint64_t index_buffer_binds = 0;
+		uint64_t push_constants = 0;
+		uint64_t barriers = 0;
+
+		// the same object bound again while still bound in the same command buffer
+		uint64_t redundant_pipeline_binds = 0;
+		uint64_t redundant_vertex_buffer_binds = 0;
+		uint64_t redundant_index_buffer_binds = 0;
+	};
+
+	command_counts get_command_counts();
+	void reset_command_counts();
+
+	// keeping every command costs memory per draw, so only the counts are kept unless this is on
+	void set_command_log_enabled(bool enabled);
+	const std::vector<command>& get_command_log();
+	void clear_command_log();
+}
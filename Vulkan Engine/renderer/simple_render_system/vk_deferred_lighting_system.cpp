@@ -0,0 +1,137 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include "vk_deferred_lighting_system.hpp"
+#include "../vk_swapchain.hpp"
+#include "../../engine/vk_cpu_profiler.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	vk_deferred_lighting_system::vk_deferred_lighting_system(vk_device& device, vk_pipeline_manager& pipeline_manager,
+	                                                         const VkRenderPass render_pass, const uint32_t subpass,
+	                                                         const VkDescriptorSetLayout global_set_layout,
+	                                                         const VkDescriptorSetLayout light_set_layout,
+	                                                         const VkDescriptorSetLayout shadow_set_layout,
+	                                                         const uint32_t color_attachment_count)
+		: device{device}, pipeline_manager{pipeline_manager}
+	{
+		assert(subpass > 0 && "The g-buffer is written by an earlier subpass");
+		assert(color_attachment_count > 0 && "The lighting writes color attachment 0");
+
+		create_descriptors();
+		create_pipeline(render_pass, subpass, global_set_layout, light_set_layout, shadow_set_layout,
+		                color_attachment_count);
+	}
+
+	// the layout and pipeline belong to the pipeline manager, the pipeline may still be compiling against the
+	// render pass
+	vk_deferred_lighting_system::~vk_deferred_lighting_system()
+	{
+		pipeline_manager.wait(pipeline);
+	}
+
+	void vk_deferred_lighting_system::create_descriptors()
+	{
+		gbuffer_set_layout = vk_descriptor_set_layout::builder(device)
+		                     .add_binding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .add_binding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .add_binding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .build();
+		descriptor_pool = vk_descriptor_pool::builder(device)
+		                  .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		                  .add_pool_size(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, vk_swapchain::MAX_FRAMES_IN_FLIGHT * 3)
+		                  .build();
+		gbuffer_sets.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	}
+
+	void vk_deferred_lighting_system::create_pipeline(const VkRenderPass render_pass, const uint32_t subpass,
+	                                                  const VkDescriptorSetLayout global_set_layout,
+	                                                  const VkDescriptorSetLayout light_set_layout,
+	                                                  const VkDescriptorSetLayout shadow_set_layout,
+	                                                  const uint32_t color_attachment_count)
+	{
+		// the same set numbers as vk_simple_render_system, set 1 is the g-buffer instead of the objects
+		pipeline_layout = pipeline_manager.get_pipeline_layout(
+			{global_set_layout, gbuffer_set_layout->get_descriptor_set_layout(), light_set_layout, shadow_set_layout},
+			{{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(deferred_lighting_push)}});
+
+		pipeline = pipeline_manager.request(
+			"assets/shaders/fullscreen.vert.spv",
+			"assets/shaders/deferred_lighting.frag.spv",
+			[render_pass, subpass, layout = pipeline_layout, color_attachment_count](
+			pipeline_config_info& pipeline_config)
+			{
+				// one triangle made up in the vertex shader, the depth is an input here and read only
+				pipeline_config.binding_descriptions.clear();
+				pipeline_config.attribute_descriptions.clear();
+				pipeline_config.depth_stencil_info.depthTestEnable = VK_FALSE;
+				pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+				vk_pipeline::set_color_attachment_count(pipeline_config, color_attachment_count);
+				for (uint32_t i = 1; i < color_attachment_count; i++)
+					pipeline_config.color_blend_attachments[i].colorWriteMask = 0;
+				pipeline_config.render_pass = render_pass;
+				pipeline_config.sub_pass = subpass;
+				pipeline_config.pipeline_layout = layout;
+			});
+	}
+
+	void vk_deferred_lighting_system::render(const vk_frame_info& frame_info, const VkExtent2D render_area,
+	                                         const VkImageView albedo, const VkImageView normal,
+	                                         const VkImageView depth)
+	{
+		VK_PROFILE_FUNCTION();
+		const auto ready_pipeline = pipeline_manager.get(pipeline);
+		if (ready_pipeline == nullptr)
+			return;
+
+		// the graph recreates its images when the extent changes, so this frame's set is rewritten every time.
+		// its fence was waited on, nothing reads it anymore
+		VkDescriptorImageInfo image_infos[3]{};
+		image_infos[0] = {VK_NULL_HANDLE, albedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		image_infos[1] = {VK_NULL_HANDLE, normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		image_infos[2] = {VK_NULL_HANDLE, depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+		auto& gbuffer_set = gbuffer_sets[frame_info.frame_index];
+		vk_descriptor_writer writer{*gbuffer_set_layout, *descriptor_pool};
+		writer.write_image(0, &image_infos[0])
+		      .write_image(1, &image_infos[1])
+		      .write_image(2, &image_infos[2]);
+		if (gbuffer_set == VK_NULL_HANDLE)
+		{
+			if (!writer.build(gbuffer_set))
+				throw std::runtime_error("failed to allocate g-buffer descriptor set!");
+		}
+		else
+			writer.overwrite(gbuffer_set);
+
+		// the global ubo holds the jittered projection the g-buffer was drawn with
+		const auto& camera = frame_info.camera;
+		deferred_lighting_push push{};
+		push.inverse_view_projection = glm::inverse(camera.get_jittered_projection() * camera.get_view());
+		push.viewport = {static_cast<float>(render_area.width), static_cast<float>(render_area.height), 0.f, 0.f};
+
+		ready_pipeline->bind(frame_info.command_buffer);
+
+		const VkDescriptorSet descriptor_sets[] = {
+			frame_info.global_descriptor_set,
+			gbuffer_set,
+			frame_info.light_descriptor_set,
+			frame_info.shadow_descriptor_set
+		};
+		vkCmdBindDescriptorSets(
+			frame_info.command_buffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipeline_layout,
+			0,
+			4,
+			descriptor_sets,
+			0,
+			nullptr);
+		vkCmdPushConstants(frame_info.command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+		                   sizeof(deferred_lighting_push), &push);
+		vkCmdDraw(frame_info.command_buffer, 3, 1, 0, 0);
+	}
+}
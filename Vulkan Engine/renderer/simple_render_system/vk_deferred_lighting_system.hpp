@@ -0,0 +1,69 @@
+#pragma once
+
+#include "vk_descriptors.hpp"
+#include "vk_pipeline_manager.hpp"
+#include "../../engine/vk_frame_info.hpp"
+#include "../../renderer/vk_device.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	// push constants of deferred_lighting.frag
+	struct deferred_lighting_push
+	{
+		glm::mat4 inverse_view_projection{1.f}; // of the projection the g-buffer was rendered with, jitter included
+		glm::vec4 viewport{0.f}; // render area width and height, unused
+	};
+
+	// deferred shading within one render pass: vk_simple_render_system::render_gbuffer writes albedo, normal,
+	// velocity and depth in one subpass, the next one reads them back as input attachments and shades every
+	// pixel once with the clustered lights and the shadows, however much geometry overlaps it. the g-buffer never
+	// has to leave the render pass, on tile based gpus it stays in tile memory (see vk_render_graph)
+	//
+	// usage: subpass 0 writes albedo, normal and velocity as color attachments 0 to 2 and the depth, subpass 1
+	// writes the scene color (and the velocity again if color_attachment_count is 2), reads the depth as depth
+	// attachment and albedo, normal and depth as input attachments. render() records the fullscreen lighting
+	class vk_deferred_lighting_system
+	{
+	public:
+		static constexpr VkFormat albedo_format = VK_FORMAT_R8G8B8A8_UNORM;
+		static constexpr VkFormat normal_format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+
+		// the pipeline compiles in the background, nothing is lit until it is ready. light_set_layout is set 2, see
+		// vk_clustered_lighting, shadow_set_layout is set 3, see vk_shadow_system. the lighting only writes the
+		// first of the subpass's color_attachment_count attachments
+		vk_deferred_lighting_system(vk_device& device, vk_pipeline_manager& pipeline_manager,
+		                            VkRenderPass render_pass, uint32_t subpass,
+		                            VkDescriptorSetLayout global_set_layout, VkDescriptorSetLayout light_set_layout,
+		                            VkDescriptorSetLayout shadow_set_layout, uint32_t color_attachment_count = 1);
+		~vk_deferred_lighting_system();
+
+		vk_deferred_lighting_system(const vk_deferred_lighting_system&) = delete;
+		vk_deferred_lighting_system& operator=(const vk_deferred_lighting_system&) = delete;
+
+		// records the lighting into the current subpass. the views are this frame's g-buffer attachments, the
+		// render area is the one the g-buffer was rendered at
+		void render(const vk_frame_info& frame_info, VkExtent2D render_area, VkImageView albedo, VkImageView normal,
+		            VkImageView depth);
+
+	private:
+		void create_descriptors();
+		void create_pipeline(VkRenderPass render_pass, uint32_t subpass, VkDescriptorSetLayout global_set_layout,
+		                     VkDescriptorSetLayout light_set_layout, VkDescriptorSetLayout shadow_set_layout,
+		                     uint32_t color_attachment_count);
+
+		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
+
+		// set 1, the g-buffer as input attachments
+		std::unique_ptr<vk_descriptor_set_layout> gbuffer_set_layout;
+		std::unique_ptr<vk_descriptor_pool> descriptor_pool;
+		std::vector<VkDescriptorSet> gbuffer_sets; // one per frame in flight, rewritten every render
+
+		pipeline_handle pipeline;
+		VkPipelineLayout pipeline_layout{};
+	};
+}
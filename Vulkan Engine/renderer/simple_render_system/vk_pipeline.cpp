@@ -1,8 +1,9 @@
 #include "vk_pipeline.hpp"
 
 #include <cassert>
-#include <fstream>
+#include <chrono>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 #include "../../engine/vk_model.hpp"
@@ -19,8 +20,6 @@ namespace vk_engine
 
 	vk_pipeline::~vk_pipeline()
 	{
-		vkDestroyShaderModule(device.get_device(), vert_shader_module, nullptr);
-		vkDestroyShaderModule(device.get_device(), frag_shader_module, nullptr);
 		vkDestroyPipeline(device.get_device(), graphics_pipeline, nullptr);
 	}
 
@@ -103,24 +102,11 @@ namespace vk_engine
 		config_info.attribute_descriptions = vk_model::vertex::get_attribute_descriptions();
 	}
 
-	std::vector<char> vk_pipeline::read_file(const std::string& file_path)
+	void vk_pipeline::set_color_attachment_count(pipeline_config_info& config_info, const uint32_t count)
 	{
-		std::ifstream file{file_path, std::ios::ate | std::ios::binary};
-
-		if (!file.is_open())
-		{
-			throw std::runtime_error("Failed to open file: " + file_path);
-		}
-
-		const size_t file_size = file.tellg();
-
-		std::vector<char> buffer(file_size);
-
-		file.seekg(0);
-		file.read(buffer.data(), file_size);
-
-		file.close();
-		return buffer;
+		config_info.color_blend_attachments.assign(count, config_info.color_blend_attachment);
+		config_info.color_blend_info.attachmentCount = count;
+		config_info.color_blend_info.pAttachments = config_info.color_blend_attachments.data();
 	}
 
 	void vk_pipeline::create_graphics_pipeline(
@@ -136,34 +122,30 @@ namespace vk_engine
 			config_info.render_pass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no render pass provided in config info");
 
-		const auto vert_code = read_file(vert_shader_path);
-		const auto frag_code = read_file(frag_shader_path);
-
-		std::cout
-			<< "[Simple Render System]" << std::endl
-			<< "	Creating pipeline with:" << std::endl
-			<< "	Vertex shader size: " << vert_code.size() << std::endl
-			<< "	Fragment shader size: " << frag_code.size() << std::endl;
-
-		create_shader_module(vert_code, &vert_shader_module);
-		create_shader_module(frag_code, &frag_shader_module);
+		// no fragment shader for depth only pipelines
+		vert_shader_module = device.get_shader_cache().acquire(vert_shader_path);
+		if (!frag_shader_path.empty())
+			frag_shader_module = device.get_shader_cache().acquire(frag_shader_path);
 
 		VkPipelineShaderStageCreateInfo shader_stages[2];
 		shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shader_stages[0].module = vert_shader_module;
+		shader_stages[0].module = vert_shader_module->get_shader_module();
 		shader_stages[0].pName = "main";
 		shader_stages[0].flags = 0;
 		shader_stages[0].pNext = nullptr;
 		shader_stages[0].pSpecializationInfo = nullptr;
 
-		shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shader_stages[1].module = frag_shader_module;
-		shader_stages[1].pName = "main";
-		shader_stages[1].flags = 0;
-		shader_stages[1].pNext = nullptr;
-		shader_stages[1].pSpecializationInfo = nullptr;
+		if (frag_shader_module)
+		{
+			shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			shader_stages[1].module = frag_shader_module->get_shader_module();
+			shader_stages[1].pName = "main";
+			shader_stages[1].flags = 0;
+			shader_stages[1].pNext = nullptr;
+			shader_stages[1].pSpecializationInfo = nullptr;
+		}
 
 		const auto& attributes_descriptions = config_info.attribute_descriptions;
 		const auto& binding_descriptions = config_info.binding_descriptions;
@@ -177,7 +159,7 @@ namespace vk_engine
 
 		VkGraphicsPipelineCreateInfo pipeline_info{};
 		pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipeline_info.stageCount = 2;
+		pipeline_info.stageCount = frag_shader_module ? 2 : 1;
 		pipeline_info.pStages = shader_stages;
 		pipeline_info.pVertexInputState = &vertex_input_info;
 		pipeline_info.pInputAssemblyState = &config_info.input_assembly_info;
@@ -195,20 +177,26 @@ namespace vk_engine
 		pipeline_info.basePipelineIndex = -1;
 		pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(device.get_device(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		if (vkCreateGraphicsPipelines(device.get_device(), device.get_pipeline_cache(), 1, &pipeline_info, nullptr,
 		                              &graphics_pipeline)
 			!= VK_SUCCESS)
 			throw std::runtime_error("Failed to create graphics pipeline!");
-	}
 
-	void vk_pipeline::create_shader_module(const std::vector<char>& code, VkShaderModule* shader_module) const
-	{
-		VkShaderModuleCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		create_info.codeSize = code.size();
-		create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		const double creation_ms = std::chrono::duration<double, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - start_time).count();
+		device.add_pipeline_creation_time(creation_ms);
 
-		if (vkCreateShaderModule(device.get_device(), &create_info, nullptr, shader_module) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create shader module!");
+		// one statement, pipelines may be created on several threads at once
+		std::ostringstream log;
+		log
+			<< "[Simple Render System]" << std::endl
+			<< "	Creating pipeline with:" << std::endl
+			<< "	Vertex shader size: " << vert_shader_module->get_code_size() << std::endl
+			<< "	Fragment shader size: " << (frag_shader_module ? frag_shader_module->get_code_size() : 0) << std::endl
+			<< "	Pipeline creation time: " << creation_ms << " ms ("
+			<< (device.is_pipeline_cache_warm() ? "warm" : "cold") << " cache)" << std::endl;
+		std::cout << log.str();
 	}
 }
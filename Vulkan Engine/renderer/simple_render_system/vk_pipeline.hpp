@@ -1,8 +1,10 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "../vk_device.hpp"
+#include "../vk_shader_cache.hpp"
 
 namespace vk_engine
 {
@@ -18,6 +20,7 @@ namespace vk_engine
 		VkPipelineRasterizationStateCreateInfo rasterization_info;
 		VkPipelineMultisampleStateCreateInfo multisample_info;
 		VkPipelineColorBlendAttachmentState color_blend_attachment;
+		std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments; // see set_color_attachment_count
 		VkPipelineColorBlendStateCreateInfo color_blend_info;
 		VkPipelineDepthStencilStateCreateInfo depth_stencil_info;
 		std::vector<VkDynamicState> dynamic_state_enables;
@@ -44,22 +47,21 @@ namespace vk_engine
 		void bind(VkCommandBuffer command_buffer);
 
 		static void default_pipeline_config_info(pipeline_config_info& config_info);
+		// one copy of color_blend_attachment per color attachment of the subpass, adjust them afterwards
+		static void set_color_attachment_count(pipeline_config_info& config_info, uint32_t count);
 
 	private:
-		static std::vector<char> read_file(const std::string& file_path);
-
 		void create_graphics_pipeline(
 			const std::string& vert_shader_path,
 			const std::string& frag_shader_path,
 			const pipeline_config_info& config_info);
 
-		void create_shader_module(const std::vector<char>& code, VkShaderModule* shader_module) const;
-
 		vk_device& device;
 
 		VkPipeline graphics_pipeline{};
 
-		VkShaderModule vert_shader_module{};
-		VkShaderModule frag_shader_module{};
+		// shared with every other pipeline using the same spir-v
+		std::shared_ptr<vk_shader_module> vert_shader_module;
+		std::shared_ptr<vk_shader_module> frag_shader_module;
 	};
 }
@@ -0,0 +1,313 @@
+#include "vk_pipeline_manager.hpp"
+
+#include "../../engine/vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace vk_engine
+{
+	namespace
+	{
+		// serializes state field by field, struct padding would make equal states compare different
+		class state_key
+		{
+		public:
+			template <typename T>
+			state_key& add(const T& value)
+			{
+				static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+				              "add fields, not structs");
+				key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+				return *this;
+			}
+
+			state_key& add(const std::string& value)
+			{
+				add(value.size());
+				key.append(value);
+				return *this;
+			}
+
+			std::string take() { return std::move(key); }
+
+		private:
+			std::string key;
+		};
+
+		void add_stencil_state(state_key& key, const VkStencilOpState& state)
+		{
+			key.add(state.failOp).add(state.passOp).add(state.depthFailOp).add(state.compareOp)
+			   .add(state.compareMask).add(state.writeMask).add(state.reference);
+		}
+
+		// everything vk_pipeline feeds into vkCreateGraphicsPipelines. render passes are compared by handle,
+		// compatible but distinct render passes still get their own pipeline
+		std::string make_pipeline_key(
+			const std::string& vert_shader_path,
+			const std::string& frag_shader_path,
+			const pipeline_config_info& config_info)
+		{
+			state_key key{};
+			key.add(vert_shader_path).add(frag_shader_path);
+
+			key.add(config_info.binding_descriptions.size());
+			for (const auto& binding : config_info.binding_descriptions)
+				key.add(binding.binding).add(binding.stride).add(binding.inputRate);
+			key.add(config_info.attribute_descriptions.size());
+			for (const auto& attribute : config_info.attribute_descriptions)
+				key.add(attribute.location).add(attribute.binding).add(attribute.format).add(attribute.offset);
+
+			const auto& input_assembly = config_info.input_assembly_info;
+			key.add(input_assembly.topology).add(input_assembly.primitiveRestartEnable);
+
+			const auto& viewport = config_info.viewport_info;
+			key.add(viewport.viewportCount).add(viewport.scissorCount);
+
+			const auto& raster = config_info.rasterization_info;
+			key.add(raster.depthClampEnable).add(raster.rasterizerDiscardEnable).add(raster.polygonMode)
+			   .add(raster.cullMode).add(raster.frontFace).add(raster.depthBiasEnable)
+			   .add(raster.depthBiasConstantFactor).add(raster.depthBiasClamp).add(raster.depthBiasSlopeFactor)
+			   .add(raster.lineWidth);
+
+			const auto& multisample = config_info.multisample_info;
+			key.add(multisample.rasterizationSamples).add(multisample.sampleShadingEnable)
+			   .add(multisample.minSampleShading).add(multisample.alphaToCoverageEnable)
+			   .add(multisample.alphaToOneEnable);
+			key.add(multisample.pSampleMask != nullptr ? *multisample.pSampleMask : ~0u);
+
+			const auto& blend = config_info.color_blend_info;
+			key.add(blend.logicOpEnable).add(blend.logicOp).add(blend.attachmentCount);
+			for (uint32_t i = 0; i < blend.attachmentCount; i++)
+			{
+				const auto& attachment = blend.pAttachments[i];
+				key.add(attachment.blendEnable).add(attachment.srcColorBlendFactor)
+				   .add(attachment.dstColorBlendFactor).add(attachment.colorBlendOp)
+				   .add(attachment.srcAlphaBlendFactor).add(attachment.dstAlphaBlendFactor)
+				   .add(attachment.alphaBlendOp).add(attachment.colorWriteMask);
+			}
+			for (const float constant : blend.blendConstants)
+				key.add(constant);
+
+			const auto& depth_stencil = config_info.depth_stencil_info;
+			key.add(depth_stencil.depthTestEnable).add(depth_stencil.depthWriteEnable)
+			   .add(depth_stencil.depthCompareOp).add(depth_stencil.depthBoundsTestEnable)
+			   .add(depth_stencil.minDepthBounds).add(depth_stencil.maxDepthBounds)
+			   .add(depth_stencil.stencilTestEnable);
+			add_stencil_state(key, depth_stencil.front);
+			add_stencil_state(key, depth_stencil.back);
+
+			key.add(config_info.dynamic_state_enables.size());
+			for (const auto state : config_info.dynamic_state_enables)
+				key.add(state);
+
+			key.add(config_info.pipeline_layout).add(config_info.render_pass).add(config_info.sub_pass);
+			return key.take();
+		}
+	}
+
+	vk_pipeline_manager::vk_pipeline_manager(vk_device& device, uint32_t worker_count) : device{device}
+	{
+		if (worker_count == 0)
+			worker_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+		workers.reserve(worker_count);
+		for (uint32_t i = 0; i < worker_count; i++)
+			workers.emplace_back([this] { work(); });
+	}
+
+	vk_pipeline_manager::~vk_pipeline_manager()
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stopping = true;
+			pending.clear();
+		}
+		work_available.notify_all();
+
+		// a worker in the middle of a compilation finishes it, the driver call can't be interrupted
+		for (auto& worker : workers)
+			worker.join();
+
+		for (const auto& [key, layout] : layouts_by_state)
+			vkDestroyPipelineLayout(device.get_device(), layout, nullptr);
+
+		std::cout
+			<< "[PIPELINE MANAGER]" << std::endl
+			<< "	pipelines: " << stats.pipelines_created << " for " << stats.pipeline_requests << " requests"
+			<< std::endl
+			<< "	layouts: " << stats.layouts_created << " for " << stats.layout_requests << " requests" << std::endl;
+	}
+
+	pipeline_handle vk_pipeline_manager::request(
+		std::string vert_shader_path,
+		std::string frag_shader_path,
+		const configure_fn& configure,
+		const pipeline_handle fallback)
+	{
+		assert((!fallback.is_valid() || fallback.index < entries.size()) && "Unknown fallback pipeline");
+
+		// aggregate initialized, the struct has no default constructor
+		std::unique_ptr<pipeline_config_info> config_info{new pipeline_config_info{}};
+		vk_pipeline::default_pipeline_config_info(*config_info);
+		configure(*config_info);
+
+		auto key = make_pipeline_key(vert_shader_path, frag_shader_path, *config_info);
+
+		pipeline_handle handle;
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stats.pipeline_requests++;
+
+			if (const auto it = pipelines_by_state.find(key); it != pipelines_by_state.end())
+				return it->second;
+
+			handle.index = static_cast<uint32_t>(entries.size());
+			auto& job = entries.emplace_back();
+			job.vert_shader_path = std::move(vert_shader_path);
+			job.frag_shader_path = std::move(frag_shader_path);
+			job.config_info = std::move(config_info);
+			job.fallback = fallback;
+			pending.push_back(&job);
+
+			pipelines_by_state.emplace(std::move(key), handle);
+			stats.pipelines_created++;
+		}
+		work_available.notify_one();
+
+		return handle;
+	}
+
+	VkPipelineLayout vk_pipeline_manager::get_pipeline_layout(
+		const std::vector<VkDescriptorSetLayout>& set_layouts,
+		const std::vector<VkPushConstantRange>& push_constant_ranges)
+	{
+		state_key key{};
+		key.add(set_layouts.size());
+		for (const auto set_layout : set_layouts)
+			key.add(set_layout);
+		key.add(push_constant_ranges.size());
+		for (const auto& range : push_constant_ranges)
+			key.add(range.stageFlags).add(range.offset).add(range.size);
+
+		std::lock_guard<std::mutex> lock{mutex};
+		stats.layout_requests++;
+
+		auto& layout = layouts_by_state[key.take()];
+		if (layout != VK_NULL_HANDLE)
+			return layout;
+
+		VkPipelineLayoutCreateInfo pipeline_layout_info{};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+		pipeline_layout_info.pSetLayouts = set_layouts.data();
+		pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+		pipeline_layout_info.pPushConstantRanges = push_constant_ranges.data();
+		if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &layout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create pipeline layout!");
+
+		stats.layouts_created++;
+		return layout;
+	}
+
+	vk_pipeline* vk_pipeline_manager::get(const pipeline_handle handle) const
+	{
+		assert(handle.index < entries.size() && "Unknown pipeline");
+
+		const auto& job = entries[handle.index];
+		if (auto* pipeline = get_ready(job))
+			return pipeline;
+		return job.fallback.is_valid() ? get_ready(entries[job.fallback.index]) : nullptr;
+	}
+
+	bool vk_pipeline_manager::is_ready(const pipeline_handle handle) const
+	{
+		assert(handle.index < entries.size() && "Unknown pipeline");
+		return get_ready(entries[handle.index]) != nullptr;
+	}
+
+	void vk_pipeline_manager::wait(const pipeline_handle handle) const
+	{
+		assert(handle.index < entries.size() && "Unknown pipeline");
+
+		const auto& job = entries[handle.index];
+		std::unique_lock<std::mutex> lock{mutex};
+		work_done.wait(lock, [&] { return job.done.load(std::memory_order_acquire); });
+	}
+
+	void vk_pipeline_manager::wait_all() const
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		work_done.wait(lock, [&]
+		{
+			return std::all_of(entries.begin(), entries.end(), [](const entry& job)
+			{
+				return job.done.load(std::memory_order_acquire);
+			});
+		});
+	}
+
+	pipeline_manager_stats vk_pipeline_manager::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		return stats;
+	}
+
+	vk_pipeline* vk_pipeline_manager::get_ready(const entry& job) const
+	{
+		if (!job.done.load(std::memory_order_acquire))
+			return nullptr;
+		if (job.error)
+			std::rethrow_exception(job.error);
+		return job.pipeline.get();
+	}
+
+	void vk_pipeline_manager::work()
+	{
+		vk_cpu_profiler::get().set_thread_name("pipeline worker");
+
+		while (true)
+		{
+			entry* job;
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				work_available.wait(lock, [this] { return stopping || !pending.empty(); });
+				if (stopping)
+					return;
+
+				job = pending.front();
+				pending.pop_front();
+			}
+
+			compile(*job);
+
+			{
+				// published under the lock so a waiter can't miss the notification
+				std::lock_guard<std::mutex> lock{mutex};
+				job->done.store(true, std::memory_order_release);
+			}
+			work_done.notify_all();
+		}
+	}
+
+	void vk_pipeline_manager::compile(entry& job) const
+	{
+		VK_PROFILE_FUNCTION();
+		try
+		{
+			job.pipeline = std::make_unique<vk_pipeline>(
+				device,
+				job.vert_shader_path,
+				job.frag_shader_path,
+				*job.config_info);
+		}
+		catch (...)
+		{
+			job.error = std::current_exception();
+		}
+		job.config_info.reset();
+	}
+}
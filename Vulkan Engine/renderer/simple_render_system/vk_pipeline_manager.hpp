@@ -0,0 +1,107 @@
+#pragma once
+
+#include "vk_pipeline.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_engine
+{
+	struct pipeline_handle
+	{
+		uint32_t index = ~0u;
+		bool is_valid() const { return index != ~0u; }
+	};
+
+	struct pipeline_manager_stats
+	{
+		uint32_t pipeline_requests = 0;
+		uint32_t pipelines_created = 0;
+		uint32_t layout_requests = 0;
+		uint32_t layouts_created = 0;
+	};
+
+	// compiles pipelines on worker threads through the device pipeline cache, request() returns at once and
+	// render systems skip their draws (or use a fallback pipeline) until get() hands out the finished pipeline.
+	// requests are keyed by the full pipeline state, render systems asking for the same state share one pipeline,
+	// layouts are shared the same way
+	class vk_pipeline_manager
+	{
+	public:
+		// adjusts the config after default_pipeline_config_info
+		using configure_fn = std::function<void(pipeline_config_info& config_info)>;
+
+		// worker_count 0 picks one less than the hardware threads
+		explicit vk_pipeline_manager(vk_device& device, uint32_t worker_count = 0);
+		~vk_pipeline_manager();
+
+		vk_pipeline_manager(const vk_pipeline_manager&) = delete;
+		vk_pipeline_manager& operator=(const vk_pipeline_manager&) = delete;
+
+		// the render pass has to outlive the compilation, an identical earlier request is returned as is.
+		// an empty frag_shader_path makes a depth only pipeline
+		pipeline_handle request(
+			std::string vert_shader_path,
+			std::string frag_shader_path,
+			const configure_fn& configure,
+			pipeline_handle fallback = {});
+
+		// owned by the manager, identical set layouts and push constant ranges give the same layout
+		VkPipelineLayout get_pipeline_layout(
+			const std::vector<VkDescriptorSetLayout>& set_layouts,
+			const std::vector<VkPushConstantRange>& push_constant_ranges);
+
+		// the requested pipeline if it is ready, else the fallback if that is ready, else nullptr.
+		// rethrows a compilation error on the calling thread
+		vk_pipeline* get(pipeline_handle handle) const;
+		bool is_ready(pipeline_handle handle) const;
+
+		// blocks until the pipeline is compiled (or failed), e.g. before destroying its layout
+		void wait(pipeline_handle handle) const;
+		void wait_all() const;
+
+		pipeline_manager_stats get_stats() const;
+
+	private:
+		struct entry
+		{
+			std::string vert_shader_path;
+			std::string frag_shader_path;
+			std::unique_ptr<pipeline_config_info> config_info; // heap allocated, it points into itself
+			pipeline_handle fallback;
+
+			std::unique_ptr<vk_pipeline> pipeline;
+			std::exception_ptr error;
+			std::atomic<bool> done{false};
+		};
+
+		void work();
+		void compile(entry& job) const;
+		vk_pipeline* get_ready(const entry& job) const;
+
+		vk_device& device;
+
+		// entries never move, workers keep pointers into the deque while the owner appends
+		std::deque<entry> entries;
+		std::deque<entry*> pending;
+		std::vector<std::thread> workers;
+
+		std::unordered_map<std::string, pipeline_handle> pipelines_by_state;
+		std::unordered_map<std::string, VkPipelineLayout> layouts_by_state;
+		pipeline_manager_stats stats{};
+
+		mutable std::mutex mutex;
+		std::condition_variable work_available;
+		mutable std::condition_variable work_done;
+		bool stopping = false;
+	};
+}
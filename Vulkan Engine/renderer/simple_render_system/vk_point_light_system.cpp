@@ -3,80 +3,185 @@
 
 #include "vk_point_light_system.hpp"
 #include "../vk_device.hpp"
+#include "../vk_swapchain.hpp"
+#include "../../engine/vk_cpu_profiler.hpp"
+#include "../../engine/vk_frustum.hpp"
 
+#include <cassert>
 #include <future>
 #include <stdexcept>
 #include <glm/glm.hpp>
 
 using vk_engine::vk_point_light_system;
 
-struct simple_push_const_data
+namespace
 {
-	glm::mat4 model_matrix{1.f};
-	glm::mat4 normal_matrix{1.f};
-};
+	// std430 layout of LightGizmo in point_light.vert
+	struct light_gizmo
+	{
+		glm::vec4 position_radius; // world space
+		glm::vec4 color;
+	};
 
-vk_point_light_system::vk_point_light_system(vk_device& device, const VkRenderPass render_pass,
-                                             const VkDescriptorSetLayout global_set_layout) : device{device}
+	constexpr uint32_t initial_gizmo_capacity = 64;
+}
+
+vk_point_light_system::vk_point_light_system(vk_device& device, vk_pipeline_manager& pipeline_manager,
+                                             const VkRenderPass render_pass,
+                                             const VkDescriptorSetLayout global_set_layout,
+                                             const bool motion_vectors)
+	: device{device}, pipeline_manager{pipeline_manager}, color_attachment_count{motion_vectors ? 2u : 1u}
 {
+	create_gizmo_buffers();
 	create_pipeline_layout(global_set_layout);
 	create_pipeline(render_pass);
 }
 
-vk_point_light_system::~vk_point_light_system()
+// the layout and pipeline belong to the pipeline manager, other systems may share them
+vk_point_light_system::~vk_point_light_system() = default;
+
+void vk_point_light_system::create_gizmo_buffers()
 {
-	vkDestroyPipelineLayout(device.get_device(), pipeline_layout, nullptr);
+	gizmo_set_layout = vk_descriptor_set_layout::builder(device)
+	                   .add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+	                   .build();
+	gizmo_pool = vk_descriptor_pool::builder(device)
+	             .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	             .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	             .build();
+
+	gizmo_buffers.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	gizmo_sets.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < vk_swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+		grow_gizmo_buffer(i, initial_gizmo_capacity);
+}
+
+void vk_point_light_system::grow_gizmo_buffer(const int frame_index, const uint32_t light_count)
+{
+	auto& gizmo_buffer = gizmo_buffers[frame_index];
+	uint32_t capacity = gizmo_buffer ? gizmo_buffer->get_instance_count() : light_count;
+	while (capacity < light_count)
+		capacity *= 2;
+
+	gizmo_buffer = std::make_unique<vk_buffer>(
+		device,
+		sizeof(light_gizmo),
+		capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	);
+	gizmo_buffer->map();
+
+	auto buffer_info = gizmo_buffer->descriptor_info();
+	vk_descriptor_writer writer{*gizmo_set_layout, *gizmo_pool};
+	writer.write_buffer(0, &buffer_info);
+	if (gizmo_sets[frame_index] == VK_NULL_HANDLE)
+	{
+		if (!writer.build(gizmo_sets[frame_index]))
+			throw std::runtime_error("failed to allocate light gizmo descriptor set!");
+	}
+	else
+		writer.overwrite(gizmo_sets[frame_index]);
 }
 
 void vk_point_light_system::create_pipeline_layout(const VkDescriptorSetLayout global_set_layout)
 {
-	// VkPushConstantRange push_constant_range;
-	// push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	// push_constant_range.offset = 0;
-	// push_constant_range.size = sizeof simple_push_const_data;
-
-	const std::vector<VkDescriptorSetLayout> descriptor_set_layouts{global_set_layout};
-
-	VkPipelineLayoutCreateInfo pipeline_layout_info{};
-	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
-	pipeline_layout_info.pSetLayouts = descriptor_set_layouts.data();
-	pipeline_layout_info.pushConstantRangeCount = 0;
-	pipeline_layout_info.pPushConstantRanges = nullptr;
-	if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create pipeline layout!");
+	pipeline_layout = pipeline_manager.get_pipeline_layout(
+		{global_set_layout, gizmo_set_layout->get_descriptor_set_layout()}, {});
 }
 
 void vk_point_light_system::create_pipeline(const VkRenderPass render_pass)
 {
 	assert(pipeline_layout != nullptr && "Cannot create pipeline before pipeline layout");
 
-	pipeline_config_info pipeline_config{};
-	vk_pipeline::default_pipeline_config_info(pipeline_config);
-	pipeline_config.binding_descriptions.clear();
-	pipeline_config.attribute_descriptions.clear();
-	pipeline_config.render_pass = render_pass;
-	pipeline_config.pipeline_layout = pipeline_layout;
-	pipeline = std::make_unique<vk_pipeline>(
-		device,
+	pipeline = pipeline_manager.request(
 		"assets/shaders/point_light.vert.spv",
 		"assets/shaders/point_light.frag.spv",
-		pipeline_config);
+		[render_pass, layout = pipeline_layout, count = color_attachment_count](pipeline_config_info& pipeline_config)
+		{
+			pipeline_config.binding_descriptions.clear();
+			pipeline_config.attribute_descriptions.clear();
+			vk_pipeline::set_color_attachment_count(pipeline_config, count);
+			pipeline_config.render_pass = render_pass;
+			pipeline_config.pipeline_layout = layout;
+		});
 }
 
-void vk_point_light_system::render_light(const vk_frame_info& frame_info) const
+void vk_point_light_system::set_deferred_pass(const VkRenderPass render_pass, const uint32_t subpass)
 {
-	pipeline->bind(frame_info.command_buffer);
+	deferred_pipeline = pipeline_manager.request(
+		"assets/shaders/point_light.vert.spv",
+		"assets/shaders/point_light.frag.spv",
+		[render_pass, subpass, layout = pipeline_layout, count = color_attachment_count](
+		pipeline_config_info& pipeline_config)
+		{
+			pipeline_config.binding_descriptions.clear();
+			pipeline_config.attribute_descriptions.clear();
+			pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+			vk_pipeline::set_color_attachment_count(pipeline_config, count);
+			pipeline_config.render_pass = render_pass;
+			pipeline_config.sub_pass = subpass;
+			pipeline_config.pipeline_layout = layout;
+		});
+}
+
+void vk_point_light_system::render_lights(const vk_frame_info& frame_info, const std::vector<point_light>& lights)
+{
+	VK_PROFILE_FUNCTION();
+	render(frame_info, lights, pipeline);
+}
+
+void vk_point_light_system::render_deferred_lights(const vk_frame_info& frame_info,
+                                                   const std::vector<point_light>& lights)
+{
+	VK_PROFILE_FUNCTION();
+	assert(deferred_pipeline.is_valid() && "set_deferred_pass must be called before render_deferred_lights");
+	render(frame_info, lights, deferred_pipeline);
+}
+
+void vk_point_light_system::render(const vk_frame_info& frame_info, const std::vector<point_light>& lights,
+                                   const pipeline_handle handle)
+{
+	visible_light_count = 0;
+	const auto ready_pipeline = pipeline_manager.get(handle);
+	if (ready_pipeline == nullptr || lights.empty())
+		return;
+
+	auto& gizmo_buffer = gizmo_buffers[frame_info.frame_index];
+	if (lights.size() > gizmo_buffer->get_instance_count())
+		grow_gizmo_buffer(frame_info.frame_index, static_cast<uint32_t>(lights.size()));
+
+	{
+		VK_PROFILE_SCOPE("cull_lights");
+		const auto frustum = vk_frustum::from_matrix(
+			frame_info.camera.get_projection() * frame_info.camera.get_view());
+		auto* gizmos = static_cast<light_gizmo*>(gizmo_buffer->get_mapped_memory());
+		for (const auto& light : lights)
+		{
+			if (!frustum.intersects_sphere(light.position, gizmo_radius))
+				continue;
+			gizmos[visible_light_count++] = {glm::vec4{light.position, gizmo_radius}, light.color};
+		}
+	}
+	if (visible_light_count == 0)
+		return;
+	gizmo_buffer->flush();
+
+	ready_pipeline->bind(frame_info.command_buffer);
 
+	const VkDescriptorSet descriptor_sets[] = {
+		frame_info.global_descriptor_set,
+		gizmo_sets[frame_info.frame_index]
+	};
 	vkCmdBindDescriptorSets(
 		frame_info.command_buffer,
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
 		pipeline_layout,
 		0,
-		1,
-		&frame_info.global_descriptor_set,
+		2,
+		descriptor_sets,
 		0,
 		nullptr);
 
-	vkCmdDraw(frame_info.command_buffer, 6, 1, 0, 0);
+	vkCmdDraw(frame_info.command_buffer, 6, visible_light_count, 0, 0);
 }
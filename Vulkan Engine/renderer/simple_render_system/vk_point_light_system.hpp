@@ -1,32 +1,70 @@
 #pragma once
 
-#include "vk_pipeline.hpp"
+#include "vk_descriptors.hpp"
+#include "vk_pipeline_manager.hpp"
 #include "../../engine/vk_frame_info.hpp"
+#include "../../engine/vk_light_clusters.hpp"
+#include "../../renderer/vk_buffer.hpp"
 #include "../../renderer/vk_device.hpp"
 
 #include <memory>
+#include <vector>
 
 namespace vk_engine
 {
+	// a billboard per point light, for debugging. lights outside the view are dropped on the cpu, the rest are
+	// one instanced draw
 	class vk_point_light_system
 	{
 	public:
-		vk_point_light_system(vk_device& device, VkRenderPass render_pass, VkDescriptorSetLayout global_set_layout);
+		// world space radius of every billboard
+		static constexpr float gizmo_radius = .1f;
+
+		// the pipeline compiles in the background, nothing is drawn until it is ready. motion_vectors as in
+		// vk_simple_render_system
+		vk_point_light_system(vk_device& device, vk_pipeline_manager& pipeline_manager, VkRenderPass render_pass,
+		                      VkDescriptorSetLayout global_set_layout, bool motion_vectors = false);
 		~vk_point_light_system();
 
 		vk_point_light_system(const vk_point_light_system&) = delete;
 		vk_point_light_system& operator=(const vk_point_light_system&) = delete;
 
-		void render_light(const vk_frame_info& frame_info) const;
+		// the visible lights go to the gizmo buffer of frame_info.frame_index, so call it once per frame
+		void render_lights(const vk_frame_info& frame_info, const std::vector<point_light>& lights);
+
+		// the deferred path: requests a pipeline for subpass, after the lighting, where the depth is read only and
+		// only tested against
+		void set_deferred_pass(VkRenderPass render_pass, uint32_t subpass);
+		// like render_lights, in set_deferred_pass's subpass
+		void render_deferred_lights(const vk_frame_info& frame_info, const std::vector<point_light>& lights);
+
+		// billboards drawn by the last render_lights
+		uint32_t get_visible_light_count() const { return visible_light_count; }
 
 	private:
+		void create_gizmo_buffers();
 		void create_pipeline_layout(VkDescriptorSetLayout global_set_layout);
 		void create_pipeline(VkRenderPass render_pass);
+		// the old buffer of that frame is done on the gpu, its fence was waited on before recording
+		void grow_gizmo_buffer(int frame_index, uint32_t light_count);
+		void render(const vk_frame_info& frame_info, const std::vector<point_light>& lights,
+		            pipeline_handle handle);
 
 		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
 
-		std::unique_ptr<vk_pipeline> pipeline;
+		pipeline_handle pipeline;
+		pipeline_handle deferred_pipeline; // invalid until set_deferred_pass
+		uint32_t color_attachment_count;
 
 		VkPipelineLayout pipeline_layout{};
+
+		// set 1, one billboard per visible light, persistently mapped and indexed by gl_InstanceIndex
+		std::unique_ptr<vk_descriptor_set_layout> gizmo_set_layout;
+		std::unique_ptr<vk_descriptor_pool> gizmo_pool;
+		std::vector<std::unique_ptr<vk_buffer>> gizmo_buffers;
+		std::vector<VkDescriptorSet> gizmo_sets;
+
+		uint32_t visible_light_count = 0;
 	};
 }
@@ -0,0 +1,931 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include "vk_shadow_system.hpp"
+#include "../vk_swapchain.hpp"
+#include "../../engine/vk_cpu_profiler.hpp"
+#include "../../engine/vk_frustum.hpp"
+#include "../../engine/vk_light_clusters.hpp"
+#include "../../engine/vk_model.hpp"
+#include "../../engine/vk_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <glm/glm.hpp>
+
+using vk_engine::vk_shadow_system;
+
+namespace
+{
+	// std430 layout of Caster in shadow.vert
+	struct caster_data
+	{
+		glm::vec4 model_rows[3]; // affine model matrix, transposed so each row is one vec4
+	};
+
+	constexpr uint32_t initial_caster_capacity = 1024;
+
+	bool is_empty(const VkRect2D& rect)
+	{
+		return rect.extent.width == 0 || rect.extent.height == 0;
+	}
+
+	VkRect2D unite(const VkRect2D& a, const VkRect2D& b)
+	{
+		if (is_empty(a))
+			return b;
+		if (is_empty(b))
+			return a;
+
+		const int32_t x0 = std::min(a.offset.x, b.offset.x);
+		const int32_t y0 = std::min(a.offset.y, b.offset.y);
+		const int32_t x1 = std::max(a.offset.x + static_cast<int32_t>(a.extent.width),
+		                            b.offset.x + static_cast<int32_t>(b.extent.width));
+		const int32_t y1 = std::max(a.offset.y + static_cast<int32_t>(a.extent.height),
+		                            b.offset.y + static_cast<int32_t>(b.extent.height));
+		return {{x0, y0}, {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+	}
+
+	bool overlaps(const VkRect2D& a, const VkRect2D& b)
+	{
+		return !is_empty(a) && !is_empty(b) &&
+			a.offset.x < b.offset.x + static_cast<int32_t>(b.extent.width) &&
+			b.offset.x < a.offset.x + static_cast<int32_t>(a.extent.width) &&
+			a.offset.y < b.offset.y + static_cast<int32_t>(b.extent.height) &&
+			b.offset.y < a.offset.y + static_cast<int32_t>(a.extent.height);
+	}
+}
+
+vk_shadow_system::vk_shadow_system(vk_device& device, vk_pipeline_manager& pipeline_manager,
+                                   const shadow_config config)
+	: device{device}, pipeline_manager{pipeline_manager}, config{config}
+{
+	assert(config.cascade_count > 0 && config.cascade_count <= max_cascades && "Unsupported cascade count");
+
+	create_shadow_map();
+	create_render_passes();
+	create_framebuffers();
+	create_sampler();
+	create_frame_resources();
+	create_pipeline();
+}
+
+// the pipeline and its layout belong to the pipeline manager, the pipeline may still be compiling against the
+// load render pass
+vk_shadow_system::~vk_shadow_system()
+{
+	pipeline_manager.wait(pipeline);
+	if (graph_pipeline.is_valid())
+		pipeline_manager.wait(graph_pipeline);
+
+	for (const auto framebuffer : layer_framebuffers)
+		vkDestroyFramebuffer(device.get_device(), framebuffer, nullptr);
+	for (const auto view : layer_views)
+		vkDestroyImageView(device.get_device(), view, nullptr);
+	vkDestroyImageView(device.get_device(), sampled_view, nullptr);
+	vkDestroySampler(device.get_device(), shadow_sampler, nullptr);
+	vkDestroyRenderPass(device.get_device(), clear_render_pass, nullptr);
+	vkDestroyRenderPass(device.get_device(), load_render_pass, nullptr);
+	vkDestroyImage(device.get_device(), shadow_image, nullptr);
+	device.free_memory(shadow_image_memory);
+}
+
+void vk_shadow_system::create_shadow_map()
+{
+	depth_format = device.find_supported_format(
+		{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM},
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+	const uint32_t layer_count = config.cascade_count * 2;
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.extent.width = config.resolution;
+	image_info.extent.height = config.resolution;
+	image_info.extent.depth = 1;
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = layer_count;
+	image_info.format = depth_format;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	device.create_image_with_info(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadow_image,
+	                              shadow_image_memory);
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = shadow_image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	view_info.format = depth_format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	view_info.subresourceRange.baseMipLevel = 0;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = config.cascade_count;
+
+	if (vkCreateImageView(device.get_device(), &view_info, nullptr, &sampled_view) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow map image view!");
+
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.subresourceRange.layerCount = 1;
+	layer_views.resize(layer_count);
+	for (uint32_t layer = 0; layer < layer_count; layer++)
+	{
+		view_info.subresourceRange.baseArrayLayer = layer;
+		if (vkCreateImageView(device.get_device(), &view_info, nullptr, &layer_views[layer]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create shadow map layer view!");
+	}
+
+	// every cascade starts out lit and invalid, the first frame renders them all. from then on the live layers
+	// rest ready to be sampled and the static ones ready to be copied, each update leaves them that way
+	const VkCommandBuffer command_buffer = device.begin_single_time_commands();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = shadow_image;
+	barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, layer_count};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+	                     nullptr, 0, nullptr, 1, &barrier);
+
+	constexpr VkClearDepthStencilValue clear_value{1.f, 0};
+	vkCmdClearDepthStencilImage(command_buffer, shadow_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_value, 1,
+	                            &barrier.subresourceRange);
+
+	std::array<VkImageMemoryBarrier, 2> layer_barriers{barrier, barrier};
+	layer_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	layer_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	layer_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	layer_barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	layer_barriers[0].subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, config.cascade_count};
+	layer_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	layer_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	layer_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	layer_barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	layer_barriers[1].subresourceRange = {
+		VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, config.cascade_count, config.cascade_count
+	};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+	                     nullptr, static_cast<uint32_t>(layer_barriers.size()), layer_barriers.data());
+
+	device.end_single_time_commands(command_buffer);
+}
+
+void vk_shadow_system::create_render_passes()
+{
+	VkAttachmentDescription depth_attachment{};
+	depth_attachment.format = depth_format;
+	depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference depth_attachment_ref;
+	depth_attachment_ref.attachment = 0;
+	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 0;
+	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	// the last copy out of the static layer is done before it is cleared, its depth is ready for the next copy
+	std::array<VkSubpassDependency, 2> dependencies{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].dstStageMask =
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = 1;
+	render_pass_info.pAttachments = &depth_attachment;
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+	render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	render_pass_info.pDependencies = dependencies.data();
+
+	if (vkCreateRenderPass(device.get_device(), &render_pass_info, nullptr, &clear_render_pass) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow clear render pass!");
+
+	// draws over what was just copied in, the lit shaders read the result
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	if (vkCreateRenderPass(device.get_device(), &render_pass_info, nullptr, &load_render_pass) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow load render pass!");
+}
+
+void vk_shadow_system::create_framebuffers()
+{
+	layer_framebuffers.resize(layer_views.size());
+	for (size_t layer = 0; layer < layer_views.size(); layer++)
+	{
+		VkFramebufferCreateInfo framebuffer_info = {};
+		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_info.renderPass = load_render_pass;
+		framebuffer_info.attachmentCount = 1;
+		framebuffer_info.pAttachments = &layer_views[layer];
+		framebuffer_info.width = config.resolution;
+		framebuffer_info.height = config.resolution;
+		framebuffer_info.layers = 1;
+
+		if (vkCreateFramebuffer(device.get_device(), &framebuffer_info, nullptr, &layer_framebuffers[layer]) !=
+			VK_SUCCESS)
+			throw std::runtime_error("Failed to create shadow map framebuffer!");
+	}
+}
+
+void vk_shadow_system::create_sampler()
+{
+	// hardware depth comparison with bilinear filtering, outside the map is lit
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_LINEAR;
+	sampler_info.minFilter = VK_FILTER_LINEAR;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	sampler_info.compareEnable = VK_TRUE;
+	sampler_info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	sampler_info.minLod = 0.f;
+	sampler_info.maxLod = 0.f;
+
+	if (vkCreateSampler(device.get_device(), &sampler_info, nullptr, &shadow_sampler) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow map sampler!");
+}
+
+void vk_shadow_system::create_frame_resources()
+{
+	shadow_set_layout = vk_descriptor_set_layout::builder(device)
+	                    .add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+	                    .add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+	                    .build();
+	caster_set_layout = vk_descriptor_set_layout::builder(device)
+	                    .add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+	                    .build();
+	descriptor_pool = vk_descriptor_pool::builder(device)
+	                  .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT * 2)
+	                  .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	                  .add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	                  .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+	                  .build();
+
+	VkDescriptorImageInfo image_info{};
+	image_info.sampler = shadow_sampler;
+	image_info.imageView = sampled_view;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	frames.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < vk_swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		auto& frame = frames[i];
+		frame.params = std::make_unique<vk_buffer>(
+			device,
+			sizeof(shadow_params),
+			1,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+		frame.params->map();
+
+		auto params_info = frame.params->descriptor_info();
+		if (!vk_descriptor_writer{*shadow_set_layout, *descriptor_pool}
+		     .write_buffer(0, &params_info)
+		     .write_image(1, &image_info)
+		     .build(frame.shadow_set))
+			throw std::runtime_error("failed to allocate shadow descriptor set!");
+
+		grow_caster_buffer(i, initial_caster_capacity);
+	}
+}
+
+void vk_shadow_system::grow_caster_buffer(const int frame_index, const uint32_t caster_count)
+{
+	auto& frame = frames[frame_index];
+	uint32_t capacity = frame.casters ? frame.casters->get_instance_count() : caster_count;
+	while (capacity < caster_count)
+		capacity *= 2;
+
+	frame.casters = std::make_unique<vk_buffer>(
+		device,
+		sizeof(caster_data),
+		capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+	);
+	frame.casters->map();
+
+	auto buffer_info = frame.casters->descriptor_info();
+	vk_descriptor_writer writer{*caster_set_layout, *descriptor_pool};
+	writer.write_buffer(0, &buffer_info);
+	if (frame.caster_set == VK_NULL_HANDLE)
+	{
+		if (!writer.build(frame.caster_set))
+			throw std::runtime_error("failed to allocate shadow caster descriptor set!");
+	}
+	else
+		writer.overwrite(frame.caster_set);
+}
+
+void vk_shadow_system::create_pipeline()
+{
+	pipeline_layout = pipeline_manager.get_pipeline_layout(
+		{caster_set_layout->get_descriptor_set_layout()},
+		{{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4)}});
+
+	pipeline = request_pipeline(load_render_pass);
+}
+
+vk_engine::pipeline_handle vk_shadow_system::request_pipeline(const VkRenderPass render_pass) const
+{
+	return pipeline_manager.request(
+		"assets/shaders/shadow.vert.spv",
+		"",
+		[render_pass, layout = pipeline_layout](pipeline_config_info& pipeline_config)
+		{
+			// positions only, read straight out of the interleaved model vertices
+			pipeline_config.attribute_descriptions = vk_model::vertex::get_position_attribute_descriptions();
+			pipeline_config.color_blend_info.attachmentCount = 0;
+			pipeline_config.color_blend_info.pAttachments = nullptr;
+			// against acne, the slope term for surfaces at a grazing angle to the light
+			pipeline_config.rasterization_info.depthBiasEnable = VK_TRUE;
+			pipeline_config.rasterization_info.depthBiasConstantFactor = 1.25f;
+			pipeline_config.rasterization_info.depthBiasSlopeFactor = 1.75f;
+			pipeline_config.render_pass = render_pass;
+			pipeline_config.pipeline_layout = layout;
+		});
+}
+
+void vk_shadow_system::invalidate_static_cache()
+{
+	for (auto& cascade : cascades)
+		cascade.valid = false;
+}
+
+void vk_shadow_system::add_passes(vk_render_graph& render_graph)
+{
+	assert(graph == nullptr && "The shadow passes are already part of a render graph");
+	graph = &render_graph;
+
+	const VkExtent2D extent{config.resolution, config.resolution};
+	for (uint32_t i = 0; i < config.cascade_count; i++)
+	{
+		auto& cascade = graph_cascades[i];
+		const std::string number = std::to_string(i);
+
+		// between frames the live layers rest ready to be sampled and the static ones ready to be copied
+		cascade.live = graph->import_image("shadow cascade " + number, {
+			                                   depth_format,
+			                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			                                   0,
+			                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			                                   VK_ACCESS_SHADER_READ_BIT,
+			                                   extent,
+			                                   i
+		                                   });
+		cascade.cache = graph->import_image("shadow cache " + number, {
+			                                    depth_format,
+			                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                                    0,
+			                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                                    VK_ACCESS_TRANSFER_READ_BIT,
+			                                    extent,
+			                                    config.cascade_count + i
+		                                    });
+
+		cascade.static_pass = graph->add_pass("shadow static " + number, [&](vk_render_graph::pass_builder& pass)
+		{
+			pass.write_depth(cascade.cache);
+		});
+		cascade.copy_pass = graph->add_pass("shadow copy " + number, [&](vk_render_graph::pass_builder& pass)
+		{
+			pass.read_transfer(cascade.cache);
+			pass.write_transfer(cascade.live);
+		});
+		cascade.live_pass = graph->add_pass("shadow live " + number, [&](vk_render_graph::pass_builder& pass)
+		{
+			pass.write_depth(cascade.live, attachment_load_op::load);
+		});
+
+		graph->set_record(cascade.static_pass, [this, i](const vk_frame_info& frame_info)
+		{
+			record_graph_pass(frame_info, i, true);
+		});
+		graph->set_record(cascade.copy_pass, [this, i](const vk_frame_info& frame_info)
+		{
+			record_layer_copy(frame_info.command_buffer, i, updates[graph_cascades[i].update].area);
+		});
+		graph->set_record(cascade.live_pass, [this, i](const vk_frame_info& frame_info)
+		{
+			record_graph_pass(frame_info, i, false);
+		});
+
+		cascade_resources.push_back(cascade.live);
+	}
+}
+
+void vk_shadow_system::create_graph_pipeline()
+{
+	assert(graph != nullptr && "add_passes must be called before create_graph_pipeline");
+	// every pass has one depth attachment of the same format, they are all compatible
+	graph_pipeline = request_pipeline(graph->get_render_pass(graph_cascades[0].live_pass));
+}
+
+void vk_shadow_system::prepare_shadows(const vk_frame_info& frame_info, const glm::vec3 direction_to_light,
+                                       const float intensity)
+{
+	VK_PROFILE_FUNCTION();
+	assert(graph_pipeline.is_valid() && "create_graph_pipeline must be called before prepare_shadows");
+	prepare_updates(frame_info, direction_to_light, intensity, pipeline_manager.is_ready(graph_pipeline));
+
+	for (uint32_t i = 0; i < config.cascade_count; i++)
+	{
+		auto& cascade = graph_cascades[i];
+		cascade.update = ~0u;
+		graph->bind_imported_image(cascade.live, shadow_image, layer_views[i]);
+		graph->bind_imported_image(cascade.cache, shadow_image, layer_views[config.cascade_count + i]);
+		graph->set_pass_enabled(cascade.static_pass, false);
+		graph->set_pass_enabled(cascade.copy_pass, false);
+		graph->set_pass_enabled(cascade.live_pass, false);
+	}
+
+	for (uint32_t u = 0; u < updates.size(); u++)
+	{
+		const auto& update = updates[u];
+		auto& cascade = graph_cascades[update.cascade];
+		cascade.update = u;
+		graph->set_pass_enabled(cascade.static_pass, update.full);
+		graph->set_pass_enabled(cascade.copy_pass, true);
+		graph->set_pass_enabled(cascade.live_pass, true);
+		graph->set_render_area(cascade.static_pass, update.area);
+		graph->set_render_area(cascade.live_pass, update.area);
+
+		if (update.full)
+			stats.full_updates++;
+		else
+			stats.partial_updates++;
+		cascades[update.cascade].valid = true;
+	}
+}
+
+void vk_shadow_system::render_shadows(const vk_frame_info& frame_info, const glm::vec3 direction_to_light,
+                                      const float intensity)
+{
+	VK_PROFILE_FUNCTION();
+	const auto ready_pipeline = pipeline_manager.get(pipeline);
+	prepare_updates(frame_info, direction_to_light, intensity, ready_pipeline != nullptr);
+	if (!updates.empty())
+		record_updates(frame_info.command_buffer, frame_info.frame_index, *ready_pipeline);
+}
+
+void vk_shadow_system::prepare_updates(const vk_frame_info& frame_info, const glm::vec3 direction_to_light,
+                                       const float intensity, const bool pipeline_ready)
+{
+	stats = {};
+	updates.clear();
+	const glm::vec3 direction = glm::normalize(direction_to_light);
+
+	update_cascades(frame_info.camera, direction);
+	params.direction_to_light = glm::vec4{direction, intensity};
+	params.settings = {
+		static_cast<float>(config.cascade_count), 1.f / static_cast<float>(config.resolution), 0.f, 0.f
+	};
+	auto& frame = frames[frame_info.frame_index];
+	frame.params->write_to_buffer(&params);
+	frame.params->flush();
+
+	// until then the shaders sample the cleared map, everything is lit
+	if (!pipeline_ready)
+		return;
+
+	gather_casters(frame_info);
+	plan_updates();
+	if (updates.empty())
+		return;
+
+	{
+		VK_PROFILE_SCOPE("write_caster_data");
+		const auto caster_count = static_cast<uint32_t>(pass_casters.size());
+		if (caster_count > frame.casters->get_instance_count())
+			grow_caster_buffer(frame_info.frame_index, caster_count);
+
+		auto* casters = static_cast<caster_data*>(frame.casters->get_mapped_memory());
+		for (const auto* pass_caster : pass_casters)
+		{
+			const glm::mat4& model_matrix = pass_caster->model_matrix;
+			auto& [model_rows] = *casters++;
+			for (int row = 0; row < 3; row++)
+				model_rows[row] = {model_matrix[0][row], model_matrix[1][row], model_matrix[2][row],
+				                   model_matrix[3][row]};
+		}
+		if (caster_count > 0)
+			frame.casters->flush();
+	}
+}
+
+void vk_shadow_system::update_cascades(const vk_camera& camera, const glm::vec3 direction_to_light)
+{
+	const auto slicing = light_cluster_slicing::from_projection(camera.get_projection(), 1);
+	const float near_depth = slicing.near;
+	const float far_depth = std::min(slicing.far, config.max_distance);
+
+	// looks along the light, the same for every cascade
+	const glm::vec3 up = std::abs(direction_to_light.y) > .99f ? glm::vec3{0.f, 0.f, 1.f} : glm::vec3{0.f, -1.f, 0.f};
+	vk_camera light_camera{};
+	light_camera.set_view_direction(glm::vec3{0.f}, -direction_to_light, up);
+	const glm::mat4& light_rotation = light_camera.get_view();
+
+	// the lines through the frustum corners, in view space
+	const glm::mat4 inverse_projection = glm::inverse(camera.get_projection());
+	const glm::mat4 inverse_view = glm::inverse(camera.get_view());
+	const auto unproject = [&](const float x, const float y, const float z)
+	{
+		const glm::vec4 point = inverse_projection * glm::vec4{x, y, z, 1.f};
+		return glm::vec3{point} / point.w;
+	};
+	glm::vec3 near_points[4], far_points[4];
+	for (uint32_t corner = 0; corner < 4; corner++)
+	{
+		const float x = corner & 1 ? 1.f : -1.f;
+		const float y = corner & 2 ? 1.f : -1.f;
+		near_points[corner] = unproject(x, y, 0.f);
+		far_points[corner] = unproject(x, y, 1.f);
+	}
+
+	float slice_begin = near_depth;
+	for (uint32_t i = 0; i < config.cascade_count; i++)
+	{
+		// practical split scheme, logarithmic splits pulled towards even ones
+		const float t = static_cast<float>(i + 1) / static_cast<float>(config.cascade_count);
+		const float uniform_split = near_depth + (far_depth - near_depth) * t;
+		const float slice_end = slicing.logarithmic
+			                        ? glm::mix(uniform_split, near_depth * std::pow(far_depth / near_depth, t),
+			                                   config.split_lambda)
+			                        : uniform_split;
+
+		// the slice's bounding sphere. its radius only depends on the projection, so it stays the same size while
+		// the camera turns
+		glm::vec3 corners[8];
+		glm::vec3 center{0.f};
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const glm::vec3& near_point = near_points[corner & 3];
+			const glm::vec3& far_point = far_points[corner & 3];
+			const float depth = corner & 4 ? slice_end : slice_begin;
+			const float along = (depth - near_point.z) / (far_point.z - near_point.z);
+			corners[corner] = glm::vec3{inverse_view * glm::vec4{near_point + along * (far_point - near_point), 1.f}};
+			center += corners[corner] / 8.f;
+		}
+		float radius = 0.f;
+		for (const auto& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		// rounding noise in the corners must not move the cascade
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		// the center moves in whole steps, each a whole number of texels so the texels don't swim, and the
+		// padding keeps the slice inside wherever the step puts it
+		const float padded_radius = radius * (1.f + config.snap_fraction);
+		const float texel = 2.f * padded_radius / static_cast<float>(config.resolution);
+		const float step = std::max(texel, std::floor(radius * config.snap_fraction / texel) * texel);
+		const glm::vec3 light_center = glm::floor(glm::vec3{light_rotation * glm::vec4{center, 1.f}} / step) * step;
+
+		glm::mat4 light_view = light_rotation;
+		light_view[3] = glm::vec4{-light_center, 1.f};
+		vk_camera cascade_camera{};
+		cascade_camera.set_orthographic_projection(-padded_radius, padded_radius, -padded_radius, padded_radius,
+		                                           -(padded_radius + config.caster_distance), padded_radius);
+		const glm::mat4 view_projection = cascade_camera.get_projection() * light_view;
+
+		if (view_projection != cascades[i].view_projection)
+		{
+			cascades[i].view_projection = view_projection;
+			cascades[i].valid = false;
+		}
+		params.view_projections[i] = view_projection;
+		params.split_depths[i] = slice_end;
+		slice_begin = slice_end;
+	}
+}
+
+void vk_shadow_system::gather_casters(const vk_frame_info& frame_info)
+{
+	VK_PROFILE_FUNCTION();
+	static_casters.clear();
+	dynamic_casters.clear();
+	dirty_spheres.clear();
+	frame_count++;
+	size_t static_caster_set = 0;
+
+	for (auto& [id, game_object] : frame_info.game_objects)
+	{
+		if (game_object.model == nullptr)
+			continue;
+
+		caster object_caster{game_object.transform.mat4(), game_object.model.get(), glm::vec4{0.f}};
+		const glm::mat4& model_matrix = object_caster.model_matrix;
+		const glm::vec4& bounds = object_caster.model->get_bounding_sphere();
+		// the longest axis, whatever the rotation or mirroring
+		const float scale = std::max({
+			glm::length(glm::vec3{model_matrix[0]}), glm::length(glm::vec3{model_matrix[1]}),
+			glm::length(glm::vec3{model_matrix[2]})
+		});
+		object_caster.sphere = glm::vec4{
+			glm::vec3{model_matrix * glm::vec4{glm::vec3{bounds}, 1.f}}, bounds.w * scale
+		};
+
+		if (game_object.is_static)
+		{
+			static_casters.push_back(object_caster);
+			// summed, the map's iteration order does not matter
+			size_t object_hash = 0;
+			hash_combine(object_hash, id, object_caster.model);
+			static_caster_set += object_hash;
+			continue;
+		}
+		dynamic_casters.push_back(object_caster);
+
+		// where it was and where it is now both have to be redrawn
+		auto [it, inserted] = tracked_objects.try_emplace(id);
+		auto& tracked = it->second;
+		if (inserted || tracked.model != object_caster.model || tracked.model_matrix != model_matrix)
+		{
+			if (!inserted)
+				dirty_spheres.push_back(tracked.sphere);
+			dirty_spheres.push_back(object_caster.sphere);
+			tracked.model_matrix = model_matrix;
+			tracked.model = object_caster.model;
+			tracked.sphere = object_caster.sphere;
+		}
+		tracked.seen_frame = frame_count;
+	}
+
+	// removed or made static since the last frame
+	for (auto it = tracked_objects.begin(); it != tracked_objects.end();)
+	{
+		if (it->second.seen_frame == frame_count)
+		{
+			++it;
+			continue;
+		}
+		dirty_spheres.push_back(it->second.sphere);
+		it = tracked_objects.erase(it);
+	}
+
+	// the static casters are promised not to move, only added, removed or remodelled ones are noticed
+	if (static_caster_set != static_caster_hash)
+	{
+		static_caster_hash = static_caster_set;
+		invalidate_static_cache();
+	}
+}
+
+VkRect2D vk_shadow_system::get_texel_rect(const glm::mat4& view_projection, const glm::vec4& sphere) const
+{
+	const glm::vec4 center = view_projection * glm::vec4{glm::vec3{sphere}, 1.f};
+	// orthographic, x and y are scaled alike
+	const float radius = sphere.w * glm::length(glm::vec3{view_projection[0][0], view_projection[1][0],
+	                                                      view_projection[2][0]});
+
+	// one texel of margin for the rasterizer's rounding
+	const auto resolution = static_cast<float>(config.resolution);
+	const auto to_texel = [resolution](const float ndc) { return (ndc * .5f + .5f) * resolution; };
+	const float x0 = std::max(std::floor(to_texel(center.x - radius)) - 1.f, 0.f);
+	const float y0 = std::max(std::floor(to_texel(center.y - radius)) - 1.f, 0.f);
+	const float x1 = std::min(std::ceil(to_texel(center.x + radius)) + 1.f, resolution);
+	const float y1 = std::min(std::ceil(to_texel(center.y + radius)) + 1.f, resolution);
+	if (x0 >= x1 || y0 >= y1)
+		return {};
+
+	return {
+		{static_cast<int32_t>(x0), static_cast<int32_t>(y0)},
+		{static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}
+	};
+}
+
+void vk_shadow_system::plan_updates()
+{
+	VK_PROFILE_FUNCTION();
+	updates.clear();
+	pass_casters.clear();
+
+	for (uint32_t i = 0; i < config.cascade_count; i++)
+	{
+		const auto& [view_projection, valid] = cascades[i];
+		cascade_update update{i, !valid, {{0, 0}, {config.resolution, config.resolution}}, 0, 0, 0, 0};
+		if (valid)
+		{
+			update.area = {};
+			for (const auto& sphere : dirty_spheres)
+				update.area = unite(update.area, get_texel_rect(view_projection, sphere));
+			if (is_empty(update.area))
+				continue;
+		}
+
+		// only what can throw a shadow into the cascade, up to caster_distance towards the light
+		const auto frustum = vk_frustum::from_matrix(view_projection);
+		update.first_static = static_cast<uint32_t>(pass_casters.size());
+		if (update.full)
+		{
+			for (const auto& static_caster : static_casters)
+			{
+				if (frustum.intersects_sphere(glm::vec3{static_caster.sphere}, static_caster.sphere.w))
+					pass_casters.push_back(&static_caster);
+			}
+		}
+		update.static_count = static_cast<uint32_t>(pass_casters.size()) - update.first_static;
+
+		update.first_dynamic = static_cast<uint32_t>(pass_casters.size());
+		for (const auto& dynamic_caster : dynamic_casters)
+		{
+			if (!frustum.intersects_sphere(glm::vec3{dynamic_caster.sphere}, dynamic_caster.sphere.w))
+				continue;
+			if (update.full || overlaps(update.area, get_texel_rect(view_projection, dynamic_caster.sphere)))
+				pass_casters.push_back(&dynamic_caster);
+		}
+		update.dynamic_count = static_cast<uint32_t>(pass_casters.size()) - update.first_dynamic;
+
+		updates.push_back(update);
+	}
+}
+
+void vk_shadow_system::bind_pipeline(const VkCommandBuffer command_buffer, const int frame_index,
+                                     vk_pipeline& ready_pipeline)
+{
+	ready_pipeline.bind(command_buffer);
+	vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipeline_layout,
+		0,
+		1,
+		&frames[frame_index].caster_set,
+		0,
+		nullptr);
+	bound_pool = nullptr;
+}
+
+void vk_shadow_system::record_updates(const VkCommandBuffer command_buffer, const int frame_index,
+                                      vk_pipeline& ready_pipeline)
+{
+	VK_PROFILE_FUNCTION();
+	// stays bound through every shadow pass, they are all compatible
+	bind_pipeline(command_buffer, frame_index, ready_pipeline);
+	for (const auto& update : updates)
+	{
+		const glm::mat4& view_projection = cascades[update.cascade].view_projection;
+		if (update.full)
+		{
+			record_pass(command_buffer, clear_render_pass, config.cascade_count + update.cascade, update.area,
+			            view_projection, update.first_static, update.static_count);
+			stats.full_updates++;
+		}
+		else
+			stats.partial_updates++;
+
+		record_copy(command_buffer, update.cascade, update.area);
+		record_pass(command_buffer, load_render_pass, update.cascade, update.area, view_projection,
+		            update.first_dynamic, update.dynamic_count);
+		cascades[update.cascade].valid = true;
+	}
+}
+
+void vk_shadow_system::record_pass(const VkCommandBuffer command_buffer, const VkRenderPass render_pass,
+                                   const uint32_t layer, const VkRect2D& area, const glm::mat4& view_projection,
+                                   const uint32_t first_caster, const uint32_t caster_count)
+{
+	VkClearValue clear_value{};
+	clear_value.depthStencil = {1.f, 0};
+
+	VkRenderPassBeginInfo render_pass_info{};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = render_pass;
+	render_pass_info.framebuffer = layer_framebuffers[layer];
+	render_pass_info.renderArea = area;
+	render_pass_info.clearValueCount = 1;
+	render_pass_info.pClearValues = &clear_value;
+
+	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	stats.render_passes++;
+	record_draws(command_buffer, area, view_projection, first_caster, caster_count);
+	vkCmdEndRenderPass(command_buffer);
+}
+
+void vk_shadow_system::record_draws(const VkCommandBuffer command_buffer, const VkRect2D& area,
+                                    const glm::mat4& view_projection, const uint32_t first_caster,
+                                    const uint32_t caster_count)
+{
+	if (caster_count > 0)
+	{
+		const VkViewport viewport{
+			0.f, 0.f, static_cast<float>(config.resolution), static_cast<float>(config.resolution), 0.f, 1.f
+		};
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		vkCmdSetScissor(command_buffer, 0, 1, &area);
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4),
+		                   &view_projection);
+
+		// the caster's index in the frame's caster buffer is its first instance
+		for (uint32_t i = first_caster; i < first_caster + caster_count; i++)
+		{
+			const vk_model* model = pass_casters[i]->model;
+			if (model->get_geometry_pool() != bound_pool)
+			{
+				bound_pool = model->get_geometry_pool();
+				model->bind(command_buffer);
+			}
+			model->draw(command_buffer, i);
+			stats.draws++;
+		}
+	}
+}
+
+void vk_shadow_system::record_graph_pass(const vk_frame_info& frame_info, const uint32_t cascade,
+                                         const bool static_layer)
+{
+	const auto& update = updates[graph_cascades[cascade].update];
+	// other passes may have bound something else in between, the graph began the render pass
+	bind_pipeline(frame_info.command_buffer, frame_info.frame_index, *pipeline_manager.get(graph_pipeline));
+	stats.render_passes++;
+	if (static_layer)
+		record_draws(frame_info.command_buffer, update.area, cascades[cascade].view_projection,
+		             update.first_static, update.static_count);
+	else
+		record_draws(frame_info.command_buffer, update.area, cascades[cascade].view_projection,
+		             update.first_dynamic, update.dynamic_count);
+}
+
+void vk_shadow_system::record_copy(const VkCommandBuffer command_buffer, const uint32_t cascade,
+                                   const VkRect2D& area) const
+{
+	// the last frame's shaders are done sampling before the live layer is overwritten
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = shadow_image;
+	barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, cascade, 1};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	                     0, nullptr, 0, nullptr, 1, &barrier);
+
+	record_layer_copy(command_buffer, cascade, area);
+}
+
+void vk_shadow_system::record_layer_copy(const VkCommandBuffer command_buffer, const uint32_t cascade,
+                                         const VkRect2D& area) const
+{
+	VkImageCopy region{};
+	region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, config.cascade_count + cascade, 1};
+	region.srcOffset = {area.offset.x, area.offset.y, 0};
+	region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, cascade, 1};
+	region.dstOffset = region.srcOffset;
+	region.extent = {area.extent.width, area.extent.height, 1};
+
+	vkCmdCopyImage(command_buffer, shadow_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadow_image,
+	               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "vk_descriptors.hpp"
+#include "vk_pipeline_manager.hpp"
+#include "../../engine/vk_frame_info.hpp"
+#include "../../renderer/vk_buffer.hpp"
+#include "../../renderer/vk_device.hpp"
+#include "../../renderer/vk_render_graph.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_engine
+{
+	class vk_geometry_pool;
+	class vk_model;
+
+	struct shadow_config
+	{
+		uint32_t resolution = 2048; // texels along each side of a cascade
+		uint32_t cascade_count = 4; // at most vk_shadow_system::max_cascades
+		float max_distance = 50.f; // view depth past which nothing is shadowed
+		float split_lambda = .75f; // 0 splits the depth range evenly, 1 logarithmically
+		float caster_distance = 50.f; // how far towards the light casters outside a cascade still throw shadows
+		// extra bounds around every cascade, it lets the cascade move in whole steps of that much and still cover
+		// its slice, the step is how far the camera has to move before the cached cascade is rebuilt
+		float snap_fraction = .125f;
+	};
+
+	// std140 layout of ShadowParams in simple_shader.frag
+	struct shadow_params
+	{
+		glm::mat4 view_projections[4]{};
+		glm::vec4 split_depths{0.f}; // view depth each cascade ends at
+		glm::vec4 direction_to_light{0.f}; // world space, w is intensity
+		glm::vec4 settings{0.f}; // cascade count, texel size in uv
+	};
+
+	// of the last render_shadows
+	struct shadow_stats
+	{
+		uint32_t full_updates = 0; // cascades rebuilt from the static casters up
+		uint32_t partial_updates = 0; // cascades where only the area of moved casters was redrawn
+		uint32_t render_passes = 0;
+		uint32_t draws = 0;
+	};
+
+	// cascaded shadow maps for the directional light. every cascade has two layers in one depth array: a cache of
+	// the static casters (vk_game_object::is_static), only rendered again when the cascade moves, and the live
+	// layer the lit shaders sample, the cache plus the dynamic casters. a frame where only dynamic casters moved
+	// copies the cache back over the texels they left or entered and redraws the dynamic casters there. owns the
+	// descriptor set the lit shaders read (set 3 of vk_simple_render_system)
+	class vk_shadow_system
+	{
+	public:
+		static constexpr uint32_t max_cascades = 4;
+
+		// the pipeline compiles in the background, nothing is rendered until it is ready
+		vk_shadow_system(vk_device& device, vk_pipeline_manager& pipeline_manager, shadow_config config = {});
+		~vk_shadow_system();
+
+		vk_shadow_system(const vk_shadow_system&) = delete;
+		vk_shadow_system& operator=(const vk_shadow_system&) = delete;
+
+		// records the shadow passes and writes the parameters of frame_info.frame_index. call once per frame,
+		// outside a render pass and before anything that samples the shadow map
+		void render_shadows(const vk_frame_info& frame_info, glm::vec3 direction_to_light, float intensity = .5f);
+
+		// the shadow passes as passes of a render graph instead of render_shadows, before graph.compile(). every
+		// cascade gets a clear of its static layer, the copy into its live layer and the draw over that, each layer
+		// is a resource of its own. passes sampling the shadow map read_texture every get_cascade_resources()
+		void add_passes(vk_render_graph& graph);
+		// after graph.compile(), the pipeline of the graph's passes
+		void create_graph_pipeline();
+		// render_shadows for the graph: plans the cascade updates, writes the frame's data, enables the passes
+		// recording them and binds the layers. call once per frame before graph.execute()
+		void prepare_shadows(const vk_frame_info& frame_info, glm::vec3 direction_to_light, float intensity = .5f);
+		const std::vector<render_graph_resource>& get_cascade_resources() const { return cascade_resources; }
+
+		// the next frame renders every cascade from scratch, e.g. after a static object was moved anyway
+		void invalidate_static_cache();
+
+		VkDescriptorSetLayout get_descriptor_set_layout() const
+		{
+			return shadow_set_layout->get_descriptor_set_layout();
+		}
+		VkDescriptorSet get_descriptor_set(const int frame_index) const { return frames[frame_index].shadow_set; }
+		const shadow_stats& get_stats() const { return stats; }
+
+	private:
+		struct caster
+		{
+			glm::mat4 model_matrix;
+			const vk_model* model;
+			glm::vec4 sphere; // world space bounds, xyz center, w radius
+		};
+
+		// a dynamic object as the shadow map last saw it
+		struct tracked_object
+		{
+			glm::mat4 model_matrix;
+			const vk_model* model;
+			glm::vec4 sphere;
+			uint64_t seen_frame;
+		};
+
+		struct cascade
+		{
+			glm::mat4 view_projection{0.f};
+			bool valid = false;
+		};
+
+		// what one cascade records this frame, planned before any caster data is written
+		struct cascade_update
+		{
+			uint32_t cascade;
+			bool full; // static layer from scratch and all of the live layer, else only area of the live layer
+			VkRect2D area;
+			uint32_t first_static, static_count; // into pass_casters
+			uint32_t first_dynamic, dynamic_count;
+		};
+
+		// the passes and layers of one cascade in the render graph
+		struct graph_cascade
+		{
+			render_graph_resource live;
+			render_graph_resource cache;
+			render_graph_pass static_pass;
+			render_graph_pass copy_pass;
+			render_graph_pass live_pass;
+			uint32_t update = ~0u; // into updates, none if the cascade is not updated this frame
+		};
+
+		struct frame_resources
+		{
+			std::unique_ptr<vk_buffer> params;
+			std::unique_ptr<vk_buffer> casters;
+			VkDescriptorSet shadow_set{};
+			VkDescriptorSet caster_set{};
+		};
+
+		void create_shadow_map();
+		void create_render_passes();
+		void create_framebuffers();
+		void create_sampler();
+		void create_frame_resources();
+		void create_pipeline();
+		pipeline_handle request_pipeline(VkRenderPass render_pass) const;
+		// the old buffer of that frame is done on the gpu, its fence was waited on before recording
+		void grow_caster_buffer(int frame_index, uint32_t caster_count);
+
+		// everything but the recording, no updates are planned while the pipeline is not ready
+		void prepare_updates(const vk_frame_info& frame_info, glm::vec3 direction_to_light, float intensity,
+		                     bool pipeline_ready);
+		void gather_casters(const vk_frame_info& frame_info);
+		void update_cascades(const vk_camera& camera, glm::vec3 direction_to_light);
+		void plan_updates();
+		// texels the sphere covers in a cascade, empty if none
+		VkRect2D get_texel_rect(const glm::mat4& view_projection, const glm::vec4& sphere) const;
+		void bind_pipeline(VkCommandBuffer command_buffer, int frame_index, vk_pipeline& pipeline);
+		void record_updates(VkCommandBuffer command_buffer, int frame_index, vk_pipeline& pipeline);
+		void record_pass(VkCommandBuffer command_buffer, VkRenderPass render_pass, uint32_t layer,
+		                 const VkRect2D& area, const glm::mat4& view_projection, uint32_t first_caster,
+		                 uint32_t caster_count);
+		void record_draws(VkCommandBuffer command_buffer, const VkRect2D& area, const glm::mat4& view_projection,
+		                  uint32_t first_caster, uint32_t caster_count);
+		// the static layer's area over the live one, after a barrier for the last frame's sampling
+		void record_copy(VkCommandBuffer command_buffer, uint32_t cascade, const VkRect2D& area) const;
+		void record_layer_copy(VkCommandBuffer command_buffer, uint32_t cascade, const VkRect2D& area) const;
+		// the record of a cascade's static or live pass in the render graph
+		void record_graph_pass(const vk_frame_info& frame_info, uint32_t cascade, bool static_layer);
+
+		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
+		shadow_config config;
+
+		// layers [0, cascade_count) are sampled, [cascade_count, 2 * cascade_count) cache the static casters
+		VkFormat depth_format{};
+		VkImage shadow_image{};
+		VkDeviceMemory shadow_image_memory{};
+		VkImageView sampled_view{};
+		std::vector<VkImageView> layer_views;
+		std::vector<VkFramebuffer> layer_framebuffers;
+		VkSampler shadow_sampler{};
+
+		// compatible, the framebuffers and the pipeline work with both. the clear pass leaves a static layer
+		// ready to be copied, the load pass draws over a copy and leaves the live layer ready to be sampled
+		VkRenderPass clear_render_pass{};
+		VkRenderPass load_render_pass{};
+
+		std::unique_ptr<vk_descriptor_set_layout> shadow_set_layout;
+		std::unique_ptr<vk_descriptor_set_layout> caster_set_layout;
+		std::unique_ptr<vk_descriptor_pool> descriptor_pool;
+		std::vector<frame_resources> frames;
+
+		pipeline_handle pipeline;
+		VkPipelineLayout pipeline_layout{};
+
+		// with add_passes, the graph orders the layers and does their barriers
+		vk_render_graph* graph = nullptr;
+		graph_cascade graph_cascades[max_cascades]{};
+		std::vector<render_graph_resource> cascade_resources;
+		pipeline_handle graph_pipeline;
+
+		cascade cascades[max_cascades]{};
+		shadow_params params{};
+		shadow_stats stats{};
+
+		// rebuilt every frame, kept to reuse their storage
+		std::vector<caster> static_casters;
+		std::vector<caster> dynamic_casters;
+		std::vector<glm::vec4> dirty_spheres; // where dynamic casters were and are now, if they moved
+		std::vector<const caster*> pass_casters; // every draw of the frame, one caster buffer entry each
+		std::vector<cascade_update> updates;
+		const vk_geometry_pool* bound_pool = nullptr; // while recording
+
+		std::unordered_map<vk_game_object::id_t, tracked_object> tracked_objects;
+		size_t static_caster_hash = 0; // of the (id, model) pairs of the static casters
+		uint64_t frame_count = 0;
+	};
+}
@@ -4,98 +4,428 @@
 #include "vk_simple_render_system.hpp"
 #include <glm/glm.hpp>
 #include "../vk_device.hpp"
+#include "../vk_swapchain.hpp"
+#include "../../engine/vk_cpu_profiler.hpp"
 #include "../../engine/vk_model.hpp"
+#include "../../engine/vk_utils.hpp"
 
+#include <cassert>
 #include <future>
 #include <stdexcept>
 
 namespace vk_engine
 {
-	struct simple_push_const_data
+	constexpr uint32_t opaque_pass = 0;
+	// frames a changed static set has to stay the same before the static batch is rebuilt
+	constexpr uint64_t static_rebuild_delay = 30;
+
+	// std430 layout of ObjectData in simple_shader.vert
+	struct object_data
 	{
-		glm::mat4 model_matrix{1.f};
-		glm::mat4 normal_matrix{1.f};
+		glm::vec4 model_rows[3]; // affine model matrix, transposed so each row is one vec4
+		glm::vec4 normal_columns[3]; // xyz only
+		glm::vec3 color;
+		uint32_t material_id; // no materials yet, always 0
+		glm::vec4 previous_model_rows[3]; // last frame's model matrix, like model_rows
 	};
 
-	vk_simple_render_system::vk_simple_render_system(vk_device& device, const VkRenderPass render_pass,
-	                                                 const VkDescriptorSetLayout global_set_layout) : device{device}
+	constexpr uint32_t initial_object_capacity = 1024;
+
+	vk_simple_render_system::vk_simple_render_system(vk_device& device, vk_pipeline_manager& pipeline_manager,
+	                                                 const VkRenderPass render_pass,
+	                                                 const VkDescriptorSetLayout global_set_layout,
+	                                                 const VkDescriptorSetLayout light_set_layout,
+	                                                 const VkDescriptorSetLayout shadow_set_layout,
+	                                                 const bool motion_vectors)
+		: device{device}, pipeline_manager{pipeline_manager}, motion_vectors{motion_vectors}, batcher{device},
+		  static_batch{device}
 	{
-		create_pipeline_layout(global_set_layout);
+		create_object_buffers();
+		create_pipeline_layout(global_set_layout, light_set_layout, shadow_set_layout);
 		create_pipeline(render_pass);
 	}
 
-	vk_simple_render_system::~vk_simple_render_system()
+	// the layout and pipeline belong to the pipeline manager, other systems may share them
+	vk_simple_render_system::~vk_simple_render_system() = default;
+
+	void vk_simple_render_system::create_object_buffers()
+	{
+		object_set_layout = vk_descriptor_set_layout::builder(device)
+		                    .add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		                    .build();
+		object_pool = vk_descriptor_pool::builder(device)
+		              .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		              .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		              .build();
+
+		object_buffers.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+		object_sets.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < vk_swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+			grow_object_buffer(i, initial_object_capacity);
+	}
+
+	void vk_simple_render_system::grow_object_buffer(const int frame_index, const uint32_t object_count)
 	{
-		vkDestroyPipelineLayout(device.get_device(), pipeline_layout, nullptr);
+		auto& object_buffer = object_buffers[frame_index];
+		uint32_t capacity = object_buffer ? object_buffer->get_instance_count() : object_count;
+		while (capacity < object_count)
+			capacity *= 2;
+
+		object_buffer = std::make_unique<vk_buffer>(
+			device,
+			sizeof(object_data),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+		object_buffer->map();
+
+		auto buffer_info = object_buffer->descriptor_info();
+		vk_descriptor_writer writer{*object_set_layout, *object_pool};
+		writer.write_buffer(0, &buffer_info);
+		if (object_sets[frame_index] == VK_NULL_HANDLE)
+		{
+			if (!writer.build(object_sets[frame_index]))
+				throw std::runtime_error("failed to allocate object descriptor set!");
+		}
+		else
+			writer.overwrite(object_sets[frame_index]);
 	}
 
-	void vk_simple_render_system::create_pipeline_layout(const VkDescriptorSetLayout global_set_layout)
+	void vk_simple_render_system::create_pipeline_layout(const VkDescriptorSetLayout global_set_layout,
+	                                                     const VkDescriptorSetLayout light_set_layout,
+	                                                     const VkDescriptorSetLayout shadow_set_layout)
 	{
-		VkPushConstantRange push_constant_range;
-		push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		push_constant_range.offset = 0;
-		push_constant_range.size = sizeof simple_push_const_data;
-
-		const std::vector<VkDescriptorSetLayout> descriptor_set_layouts{global_set_layout};
-
-		VkPipelineLayoutCreateInfo pipeline_layout_info{};
-		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
-		pipeline_layout_info.pSetLayouts = descriptor_set_layouts.data();
-		pipeline_layout_info.pushConstantRangeCount = 1;
-		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
-		if (vkCreatePipelineLayout(device.get_device(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create pipeline layout!");
+		pipeline_layout = pipeline_manager.get_pipeline_layout(
+			{global_set_layout, object_set_layout->get_descriptor_set_layout(), light_set_layout, shadow_set_layout},
+			{});
 	}
 
 	void vk_simple_render_system::create_pipeline(const VkRenderPass render_pass)
 	{
 		assert(pipeline_layout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		pipeline_config_info pipeline_config{};
-		vk_pipeline::default_pipeline_config_info(pipeline_config);
-		pipeline_config.render_pass = render_pass;
-		pipeline_config.pipeline_layout = pipeline_layout;
-		pipeline = std::make_unique<vk_pipeline>(
-			device,
+		// the shaders always write velocity to attachment 1, render passes without one drop it
+		const uint32_t color_attachment_count = motion_vectors ? 2 : 1;
+
+		pipeline = pipeline_manager.request(
+			"assets/shaders/simple_shader.vert.spv",
+			"assets/shaders/simple_shader.frag.spv",
+			[render_pass, layout = pipeline_layout, color_attachment_count](pipeline_config_info& pipeline_config)
+			{
+				vk_pipeline::set_color_attachment_count(pipeline_config, color_attachment_count);
+				pipeline_config.render_pass = render_pass;
+				pipeline_config.pipeline_layout = layout;
+			});
+
+		// the same layout, so the sets bound once serve both passes. depth_prepass.vert computes gl_Position
+		// exactly like simple_shader.vert, both invariant, or the EQUAL test would drop pixels
+		prepass_pipeline = pipeline_manager.request(
+			"assets/shaders/depth_prepass.vert.spv",
+			"",
+			[render_pass, layout = pipeline_layout, color_attachment_count](pipeline_config_info& pipeline_config)
+			{
+				pipeline_config.attribute_descriptions = vk_model::vertex::get_position_attribute_descriptions();
+				pipeline_config.color_blend_attachment.colorWriteMask = 0;
+				vk_pipeline::set_color_attachment_count(pipeline_config, color_attachment_count);
+				pipeline_config.render_pass = render_pass;
+				pipeline_config.pipeline_layout = layout;
+			});
+
+		equal_pipeline = pipeline_manager.request(
 			"assets/shaders/simple_shader.vert.spv",
 			"assets/shaders/simple_shader.frag.spv",
-			pipeline_config);
+			[render_pass, layout = pipeline_layout, color_attachment_count](pipeline_config_info& pipeline_config)
+			{
+				pipeline_config.depth_stencil_info.depthCompareOp = VK_COMPARE_OP_EQUAL;
+				pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+				vk_pipeline::set_color_attachment_count(pipeline_config, color_attachment_count);
+				pipeline_config.render_pass = render_pass;
+				pipeline_config.pipeline_layout = layout;
+			});
+	}
+
+	void vk_simple_render_system::set_gbuffer_pass(const VkRenderPass render_pass, const uint32_t subpass)
+	{
+		gbuffer_pipeline = pipeline_manager.request(
+			"assets/shaders/simple_shader.vert.spv",
+			"assets/shaders/gbuffer.frag.spv",
+			[render_pass, subpass, layout = pipeline_layout](pipeline_config_info& pipeline_config)
+			{
+				vk_pipeline::set_color_attachment_count(pipeline_config, 3);
+				pipeline_config.render_pass = render_pass;
+				pipeline_config.sub_pass = subpass;
+				pipeline_config.pipeline_layout = layout;
+			});
+	}
+
+	void vk_simple_render_system::build_static_batch(const vk_game_object::map& game_objects)
+	{
+		VK_PROFILE_FUNCTION();
+		// the last frame recorded may still draw the old one
+		static_batch.retire(retired_resources, frame_count);
+		static_batch.build(game_objects);
+
+		// merged, the cpu copies are not needed anymore, a rebuild reads the meshes back
+		static_batch_hash = 0;
+		for (const auto& [id, game_object] : game_objects)
+		{
+			if (game_object.is_static && game_object.model != nullptr)
+			{
+				static_batch_hash += hash_static_object(game_object);
+				game_object.model->release_mesh();
+			}
+		}
+		static_batch_valid = true;
+		// invalidate_static_batch() waits as long again before the next one
+		pending_static_hash = static_batch_hash;
+		pending_static_frame = frame_count;
+	}
+
+	size_t vk_simple_render_system::hash_static_object(const vk_game_object& game_object)
+	{
+		size_t hash = 0;
+		hash_combine(hash, game_object.get_id(), game_object.model.get());
+		return hash;
+	}
+
+	bool vk_simple_render_system::moved_since_last_frame(const vk_game_object& game_object)
+	{
+		if (!motion_vectors)
+			return false;
+
+		// still ones stay tracked while batched, so the frame one starts moving is noticed
+		const glm::mat4 model_matrix = game_object.transform.mat4();
+		const auto [it, inserted] = tracked_objects.try_emplace(game_object.get_id(), tracked_object{model_matrix, 0});
+		if (!inserted && it->second.seen_frame + 1 == frame_count && it->second.model_matrix != model_matrix)
+			return true;
+		it->second = {model_matrix, frame_count};
+		return false;
+	}
+
+	void vk_simple_render_system::render_game_objects(const vk_frame_info& frame_info)
+	{
+		VK_PROFILE_FUNCTION();
+		render(frame_info, pipeline, true);
+	}
+
+	void vk_simple_render_system::render_gbuffer(const vk_frame_info& frame_info)
+	{
+		VK_PROFILE_FUNCTION();
+		assert(gbuffer_pipeline.is_valid() && "set_gbuffer_pass must be called before render_gbuffer");
+		render(frame_info, gbuffer_pipeline, false);
 	}
 
-	void vk_simple_render_system::render_game_objects(const vk_frame_info& frame_info) const
+	void vk_simple_render_system::render(const vk_frame_info& frame_info, const pipeline_handle shading_handle,
+	                                     const bool allow_depth_prepass)
 	{
-		pipeline->bind(frame_info.command_buffer);
+		const auto ready_pipeline = pipeline_manager.get(shading_handle);
+		if (ready_pipeline == nullptr)
+			return;
+
+		const glm::mat4& view = frame_info.camera.get_view();
+		draw_list.clear();
+		draw_list.reserve(frame_info.game_objects.size());
+		batched_objects.clear();
+		static_objects.clear();
+		uint32_t batched_vertex_count = 0;
+		size_t static_object_hash = 0;
+		frame_count++;
+
+		// called after begin_frame waited on this slot's fence, so frame n - MAX_FRAMES_IN_FLIGHT is done
+		if (frame_count > vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+			retired_resources.collect(frame_count - vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+
+		const auto add_object = [&](const vk_game_object& game_object)
+		{
+			if (dynamic_batching && game_object.model->is_batchable() && !moved_since_last_frame(game_object))
+			{
+				batched_objects.push_back(&game_object);
+				batched_vertex_count += static_cast<uint32_t>(game_object.model->get_batch_vertices().size());
+				return;
+			}
+
+			// view space z of the origin, the camera looks down +z
+			const glm::vec3& position = game_object.transform.translation;
+			const float depth = view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z +
+				view[3][2];
+			draw_list.push(draw_key::make(opaque_pass, shading_handle.index, game_object.model->get_id(), depth),
+			               game_object);
+		};
+
+		for (auto& [id, game_object] : frame_info.game_objects)
+		{
+			if (game_object.model == nullptr)
+				continue;
+
+			if (static_batching && game_object.is_static)
+			{
+				static_objects.push_back(&game_object);
+				static_object_hash += hash_static_object(game_object);
+				continue;
+			}
+			add_object(game_object);
+		}
+
+		// a static set the batch was not built from, e.g. one added and one removed, is drawn without it until the
+		// set has stayed the same for a while, a burst of changes like a level streaming in is rebuilt once
+		if (static_batching && (!static_batch_valid || static_object_hash != static_batch_hash))
+		{
+			if (static_object_hash != pending_static_hash)
+			{
+				pending_static_hash = static_object_hash;
+				pending_static_frame = frame_count;
+			}
+			if (frame_count - pending_static_frame >= static_rebuild_delay)
+				build_static_batch(frame_info.game_objects);
+		}
+		const bool use_static_batch = static_batching && static_batch_valid && static_object_hash == static_batch_hash;
+		if (!use_static_batch)
+		{
+			for (const auto* game_object : static_objects)
+				add_object(*game_object);
+		}
+		draw_list.sort();
+
+		if (use_static_batch)
+			static_batch.cull(frame_info.camera.get_projection() * frame_info.camera.get_view());
 
+		// written in draw order, draw i reads object i. the batches share one more entry, their vertices are in world
+		// space already
+		const auto draw_count = static_cast<uint32_t>(draw_list.size());
+		const bool has_batches = !batched_objects.empty() || (use_static_batch && !static_batch.empty());
+		const uint32_t object_count = draw_count + (has_batches ? 1 : 0);
+		auto& object_buffer = object_buffers[frame_info.frame_index];
+		if (object_count > object_buffer->get_instance_count())
+			grow_object_buffer(frame_info.frame_index, object_count);
+
+		{
+			VK_PROFILE_SCOPE("write_object_data");
+			auto* objects = static_cast<object_data*>(object_buffer->get_mapped_memory());
+			for (const auto& [key, game_object] : draw_list)
+			{
+				const glm::mat4 model_matrix = game_object->transform.mat4();
+				const glm::mat3 normal_matrix = game_object->transform.normal_matrix();
+
+				glm::mat4 previous_model_matrix = model_matrix;
+				if (motion_vectors)
+				{
+					const auto [it, inserted] = tracked_objects.try_emplace(game_object->get_id(),
+					                                                        tracked_object{model_matrix, 0});
+					if (!inserted && it->second.seen_frame + 1 == frame_count)
+						previous_model_matrix = it->second.model_matrix;
+					it->second = {model_matrix, frame_count};
+				}
+
+				auto& [model_rows, normal_columns, color, material_id, previous_model_rows] = *objects++;
+				for (int row = 0; row < 3; row++)
+				{
+					model_rows[row] = {model_matrix[0][row], model_matrix[1][row], model_matrix[2][row],
+					                   model_matrix[3][row]};
+					previous_model_rows[row] = {previous_model_matrix[0][row], previous_model_matrix[1][row],
+					                            previous_model_matrix[2][row], previous_model_matrix[3][row]};
+				}
+				for (int column = 0; column < 3; column++)
+					normal_columns[column] = glm::vec4{normal_matrix[column], 0.f};
+				color = game_object->color;
+				material_id = 0;
+			}
+			if (has_batches)
+			{
+				auto& [model_rows, normal_columns, color, material_id, previous_model_rows] = *objects;
+				for (int row = 0; row < 3; row++)
+				{
+					model_rows[row] = glm::vec4{0.f};
+					model_rows[row][row] = 1.f;
+					previous_model_rows[row] = model_rows[row];
+					normal_columns[row] = model_rows[row];
+				}
+				color = glm::vec3{1.f};
+				material_id = 0;
+			}
+			object_buffer->flush();
+
+			// objects gone from the scene
+			if (tracked_objects.size() > draw_list.size() + batched_objects.size())
+			{
+				for (auto it = tracked_objects.begin(); it != tracked_objects.end();)
+				{
+					if (it->second.seen_frame != frame_count)
+						it = tracked_objects.erase(it);
+					else
+						++it;
+				}
+			}
+		}
+
+		{
+			VK_PROFILE_SCOPE("dynamic_batch");
+			batcher.begin(frame_info.frame_index, batched_vertex_count);
+			for (const auto* game_object : batched_objects)
+				batcher.add(*game_object->model, game_object->transform.mat4(), game_object->transform.normal_matrix());
+			batcher.end();
+		}
+
+		// both or neither, EQUAL only works on top of the prepass depth
+		vk_pipeline* depth_only_pipeline = nullptr;
+		vk_pipeline* shading_pipeline = ready_pipeline;
+		if (depth_prepass && allow_depth_prepass)
+		{
+			const auto ready_prepass_pipeline = pipeline_manager.get(prepass_pipeline);
+			const auto ready_equal_pipeline = pipeline_manager.get(equal_pipeline);
+			if (ready_prepass_pipeline != nullptr && ready_equal_pipeline != nullptr)
+			{
+				depth_only_pipeline = ready_prepass_pipeline;
+				shading_pipeline = ready_equal_pipeline;
+			}
+		}
+
+		(depth_only_pipeline != nullptr ? depth_only_pipeline : shading_pipeline)->bind(frame_info.command_buffer);
+
+		const VkDescriptorSet descriptor_sets[] = {
+			frame_info.global_descriptor_set,
+			object_sets[frame_info.frame_index],
+			frame_info.light_descriptor_set,
+			frame_info.shadow_descriptor_set
+		};
 		vkCmdBindDescriptorSets(
 			frame_info.command_buffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipeline_layout,
 			0,
-			1,
-			&frame_info.global_descriptor_set,
+			4,
+			descriptor_sets,
 			0,
 			nullptr);
 
-		for (auto& [id, game_object] : frame_info.game_objects)
+		const auto draw_objects = [&]
 		{
-			if (game_object.model == nullptr)
-				continue;
-			
-			simple_push_const_data push{};
-			push.model_matrix = game_object.transform.mat4();
-			push.normal_matrix = game_object.transform.normal_matrix();
-
-			vkCmdPushConstants(
-				frame_info.command_buffer,
-				pipeline_layout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof simple_push_const_data,
-				&push);
-
-			game_object.model->bind(frame_info.command_buffer);
-			game_object.model->draw(frame_info.command_buffer);
+			// first, the static geometry is mostly big occluders
+			if (use_static_batch)
+				static_batch.draw(frame_info.command_buffer, draw_count);
+
+			// every model of the device shares the pool's buffers, in practice one bind per pass
+			const vk_geometry_pool* bound_pool = nullptr;
+			uint32_t object_index = 0;
+			for (const auto& [key, game_object] : draw_list)
+			{
+				const vk_model& model = *game_object->model;
+				if (model.get_geometry_pool() != bound_pool)
+				{
+					bound_pool = model.get_geometry_pool();
+					model.bind(frame_info.command_buffer);
+				}
+				model.draw(frame_info.command_buffer, object_index++);
+			}
+			batcher.draw(frame_info.command_buffer, draw_count);
+		};
+
+		if (depth_only_pipeline != nullptr)
+		{
+			VK_PROFILE_SCOPE("depth_prepass");
+			draw_objects();
+			shading_pipeline->bind(frame_info.command_buffer);
 		}
+		draw_objects();
 	}
 }
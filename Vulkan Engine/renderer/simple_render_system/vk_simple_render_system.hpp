@@ -1,32 +1,125 @@
 #pragma once
 
-#include "vk_pipeline.hpp"
+#include "vk_descriptors.hpp"
+#include "vk_pipeline_manager.hpp"
 #include "../../engine/vk_frame_info.hpp"
+#include "../../renderer/vk_buffer.hpp"
 #include "../../renderer/vk_device.hpp"
+#include "../../renderer/vk_draw_list.hpp"
+#include "../../renderer/vk_dynamic_batcher.hpp"
+#include "../../renderer/vk_static_batch.hpp"
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace vk_engine
 {
 	class vk_simple_render_system
 	{
 	public:
-		vk_simple_render_system(vk_device& device, VkRenderPass render_pass, VkDescriptorSetLayout global_set_layout);
+		// the pipeline compiles in the background, nothing is drawn until it is ready. light_set_layout is set 2,
+		// see vk_clustered_lighting, shadow_set_layout is set 3, see vk_shadow_system. with motion_vectors the
+		// render pass has a velocity target as color attachment 1, see vk_temporal_upscaler, and every object's
+		// model matrix is kept for the next frame
+		vk_simple_render_system(vk_device& device, vk_pipeline_manager& pipeline_manager, VkRenderPass render_pass,
+		                        VkDescriptorSetLayout global_set_layout, VkDescriptorSetLayout light_set_layout,
+		                        VkDescriptorSetLayout shadow_set_layout, bool motion_vectors = false);
 		~vk_simple_render_system();
 
 		vk_simple_render_system(const vk_simple_render_system&) = delete;
 		vk_simple_render_system& operator=(const vk_simple_render_system&) = delete;
 
-		void render_game_objects(const vk_frame_info& frame_info) const;
+		// draws sorted by pipeline, model and depth, the geometry pool is bound once for all of them.
+		// object data goes to the storage buffer of frame_info.frame_index, so call it once per frame
+		void render_game_objects(const vk_frame_info& frame_info);
+
+		// the deferred path: requests a pipeline that writes albedo, normal and velocity to color attachments 0 to 2
+		// of subpass instead of shading, see vk_deferred_lighting_system
+		void set_gbuffer_pass(VkRenderPass render_pass, uint32_t subpass);
+		// like render_game_objects, into the g-buffer. never with the depth prepass, deferred lighting already runs
+		// once per pixel. nothing is drawn until set_gbuffer_pass's pipeline is compiled
+		void render_gbuffer(const vk_frame_info& frame_info);
+
+		// draws every object twice: depth only first, then shaded with depth test EQUAL and no depth writes, so
+		// each pixel runs the fragment shader once however many meshes overlap it. worth it when fragment shading
+		// is the bottleneck, it doubles the draws and the vertex work. takes effect from the next
+		// render_game_objects, until both of its pipelines are compiled the objects are drawn without it
+		void set_depth_prepass(const bool enabled) { depth_prepass = enabled; }
+		bool is_depth_prepass_enabled() const { return depth_prepass; }
+
+		// objects with a batchable model (see vk_model::max_batched_vertex_count) are moved to world space on the
+		// cpu and drawn together in one draw instead of one each. the batch has no previous model matrix, so with
+		// motion_vectors an object that moved since the last frame is drawn on its own that frame. on by default
+		void set_dynamic_batching(const bool enabled) { dynamic_batching = enabled; }
+		bool is_dynamic_batching_enabled() const { return dynamic_batching; }
+
+		// static objects (vk_game_object::is_static) are merged into a vk_static_batch and drawn a cell at a time,
+		// culled against the camera. build_static_batch() waits for the queue, call it at scene load. static
+		// objects added, removed or given another model, or moved and followed by invalidate_static_batch(), are
+		// drawn one by one until the set has settled for a few frames and the batch is rebuilt. on by default
+		void set_static_batching(const bool enabled) { static_batching = enabled; }
+		bool is_static_batching_enabled() const { return static_batching; }
+		// the old batch is destroyed once the frames in flight are done with it. releases the cpu meshes of the
+		// static objects' models (see vk_model::release_mesh)
+		void build_static_batch(const vk_game_object::map& game_objects);
+		void invalidate_static_batch() { static_batch_valid = false; }
+		const static_batch_stats& get_static_batch_stats() const { return static_batch.get_stats(); }
 
 	private:
-		void create_pipeline_layout(VkDescriptorSetLayout global_set_layout);
+		// an object as the last frame drew it
+		struct tracked_object
+		{
+			glm::mat4 model_matrix;
+			uint64_t seen_frame;
+		};
+
+		void create_object_buffers();
+		void create_pipeline_layout(VkDescriptorSetLayout global_set_layout, VkDescriptorSetLayout light_set_layout,
+		                            VkDescriptorSetLayout shadow_set_layout);
 		void create_pipeline(VkRenderPass render_pass);
+		// the old buffer of that frame is done on the gpu, its fence was waited on before recording
+		void grow_object_buffer(int frame_index, uint32_t object_count);
+		// of one static object's id and model, summed over a scene, the map's iteration order does not matter
+		static size_t hash_static_object(const vk_game_object& game_object);
+		// with motion_vectors only, tracks the object if it did not
+		bool moved_since_last_frame(const vk_game_object& game_object);
+		void render(const vk_frame_info& frame_info, pipeline_handle shading_pipeline, bool allow_depth_prepass);
 
 		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
 
-		std::unique_ptr<vk_pipeline> pipeline;
+		pipeline_handle pipeline;
+		pipeline_handle prepass_pipeline; // position only, no fragment shader
+		pipeline_handle equal_pipeline; // shades what the prepass left visible
+		pipeline_handle gbuffer_pipeline; // invalid until set_gbuffer_pass
+		bool depth_prepass = false;
+		bool dynamic_batching = true;
+		bool static_batching = true;
+		bool static_batch_valid = false;
+		size_t static_batch_hash = 0; // of the static objects in the last build
+		size_t pending_static_hash = 0; // of a static set the batch was not built from, since pending_static_frame
+		uint64_t pending_static_frame = 0;
+		bool motion_vectors;
 
 		VkPipelineLayout pipeline_layout{};
+
+		// set 1, per object data for every draw of a frame, persistently mapped and indexed by gl_InstanceIndex
+		std::unique_ptr<vk_descriptor_set_layout> object_set_layout;
+		std::unique_ptr<vk_descriptor_pool> object_pool;
+		std::vector<std::unique_ptr<vk_buffer>> object_buffers;
+		std::vector<VkDescriptorSet> object_sets;
+
+		// rebuilt every frame, kept to reuse their storage
+		vk_draw_list draw_list;
+		std::vector<const vk_game_object*> batched_objects;
+		std::vector<const vk_game_object*> static_objects;
+		vk_dynamic_batcher batcher;
+		vk_static_batch static_batch;
+		vk_deletion_queue retired_resources; // old static batches, keyed on frame_count
+
+		// motion vectors only, drawn or batched. objects that were not seen last frame start without motion
+		std::unordered_map<vk_game_object::id_t, tracked_object> tracked_objects;
+		uint64_t frame_count = 0;
 	};
 }
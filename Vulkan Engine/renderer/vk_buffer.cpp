@@ -52,7 +52,7 @@ vk_buffer::~vk_buffer()
 {
 	unmap();
 	vkDestroyBuffer(device.get_device(), buffer, nullptr);
-	vkFreeMemory(device.get_device(), memory, nullptr);
+	device.free_memory(memory);
 }
 
 /**
@@ -0,0 +1,274 @@
+#include "vk_clustered_lighting.hpp"
+#include "vk_shader_cache.hpp"
+#include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	namespace
+	{
+		// matches local_size_x in light_clusters.comp
+		constexpr uint32_t clusters_per_workgroup = 64;
+
+		constexpr uint32_t initial_light_capacity = 64;
+		constexpr uint32_t initial_light_index_capacity = 4096;
+
+		uint32_t grow_capacity(uint32_t capacity, const uint32_t required)
+		{
+			while (capacity < required)
+				capacity *= 2;
+			return capacity;
+		}
+	}
+
+	vk_clustered_lighting::vk_clustered_lighting(vk_device& device, vk_pipeline_manager& pipeline_manager,
+	                                             const light_assignment assignment, const light_cluster_grid grid)
+		: device{device}, pipeline_manager{pipeline_manager}, assignment{assignment}, clusters{grid}
+	{
+		create_frame_resources();
+		if (assignment == light_assignment::gpu)
+			create_compute_pipeline();
+	}
+
+	// the pipeline layout belongs to the pipeline manager
+	vk_clustered_lighting::~vk_clustered_lighting()
+	{
+		if (compute_pipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(device.get_device(), compute_pipeline, nullptr);
+	}
+
+	void vk_clustered_lighting::create_frame_resources()
+	{
+		constexpr VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		descriptor_set_layout = vk_descriptor_set_layout::builder(device)
+		                        .add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stages)
+		                        .add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages)
+		                        .add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages)
+		                        .add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages)
+		                        .build();
+		descriptor_pool = vk_descriptor_pool::builder(device)
+		                  .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		                  .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		                  .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vk_swapchain::MAX_FRAMES_IN_FLIGHT * 3)
+		                  .build();
+
+		// the gpu writes the cluster lists itself, they never leave device memory
+		const uint32_t cluster_count = clusters.get_grid().count();
+		const VkMemoryPropertyFlags cluster_memory = assignment == light_assignment::gpu
+			                                             ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			                                             : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+		frames.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames)
+		{
+			frame.params = std::make_unique<vk_buffer>(
+				device,
+				sizeof(light_cluster_params),
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+			frame.params->map();
+
+			frame.cluster_ranges = std::make_unique<vk_buffer>(
+				device,
+				sizeof(glm::uvec2),
+				cluster_count,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				cluster_memory
+			);
+			if (assignment == light_assignment::cpu)
+				frame.cluster_ranges->map();
+
+			const uint32_t light_index_count = assignment == light_assignment::gpu
+				                                   ? cluster_count * max_lights_per_cluster
+				                                   : initial_light_index_capacity;
+			reserve(frame, initial_light_capacity, light_index_count);
+		}
+	}
+
+	void vk_clustered_lighting::create_compute_pipeline()
+	{
+		compute_shader = device.get_shader_cache().acquire("assets/shaders/light_clusters.comp.spv");
+		compute_pipeline_layout = pipeline_manager.get_pipeline_layout(
+			{descriptor_set_layout->get_descriptor_set_layout()}, {});
+
+		VkComputePipelineCreateInfo pipeline_info{};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_info.stage.module = compute_shader->get_shader_module();
+		pipeline_info.stage.pName = "main";
+		pipeline_info.layout = compute_pipeline_layout;
+		pipeline_info.basePipelineIndex = -1;
+
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		if (vkCreateComputePipelines(device.get_device(), device.get_pipeline_cache(), 1, &pipeline_info, nullptr,
+		                             &compute_pipeline) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create light cluster pipeline!");
+
+		const double creation_ms = std::chrono::duration<double, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - start_time).count();
+		device.add_pipeline_creation_time(creation_ms);
+
+		std::cout
+			<< "[Clustered Lighting]" << std::endl
+			<< "	Creating light cluster pipeline with:" << std::endl
+			<< "	Compute shader size: " << compute_shader->get_code_size() << std::endl
+			<< "	Pipeline creation time: " << creation_ms << " ms" << std::endl;
+	}
+
+	void vk_clustered_lighting::reserve(frame_resources& frame, const uint32_t light_count,
+	                                    const uint32_t light_index_count)
+	{
+		bool changed = false;
+		if (!frame.lights || frame.lights->get_instance_count() < light_count)
+		{
+			const uint32_t capacity = frame.lights
+				                          ? grow_capacity(frame.lights->get_instance_count(), light_count)
+				                          : light_count;
+			frame.lights = std::make_unique<vk_buffer>(
+				device,
+				sizeof(point_light),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+			frame.lights->map();
+			changed = true;
+		}
+
+		if (!frame.light_indices || frame.light_indices->get_instance_count() < light_index_count)
+		{
+			const uint32_t capacity = frame.light_indices
+				                          ? grow_capacity(frame.light_indices->get_instance_count(), light_index_count)
+				                          : light_index_count;
+			const bool host_visible = assignment == light_assignment::cpu;
+			frame.light_indices = std::make_unique<vk_buffer>(
+				device,
+				sizeof(uint32_t),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				host_visible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+			if (host_visible)
+				frame.light_indices->map();
+			changed = true;
+		}
+
+		if (changed)
+			write_descriptor_set(frame);
+	}
+
+	void vk_clustered_lighting::write_descriptor_set(frame_resources& frame) const
+	{
+		auto params_info = frame.params->descriptor_info();
+		auto lights_info = frame.lights->descriptor_info();
+		auto cluster_ranges_info = frame.cluster_ranges->descriptor_info();
+		auto light_indices_info = frame.light_indices->descriptor_info();
+
+		vk_descriptor_writer writer{*descriptor_set_layout, *descriptor_pool};
+		writer.write_buffer(0, &params_info)
+		      .write_buffer(1, &lights_info)
+		      .write_buffer(2, &cluster_ranges_info)
+		      .write_buffer(3, &light_indices_info);
+
+		if (frame.descriptor_set == VK_NULL_HANDLE)
+		{
+			if (!writer.build(frame.descriptor_set))
+				throw std::runtime_error("failed to allocate light cluster descriptor set!");
+		}
+		else
+			writer.overwrite(frame.descriptor_set);
+	}
+
+	void vk_clustered_lighting::update(const VkCommandBuffer command_buffer, const int frame_index,
+	                                   const vk_camera& camera, const VkExtent2D extent,
+	                                   const std::vector<point_light>& lights)
+	{
+		upload(frame_index, camera, extent, lights);
+		if (assignment == light_assignment::cpu)
+			return;
+
+		record_assignment(command_buffer, frame_index);
+
+		// the lists have to be written before any fragment reads them
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void vk_clustered_lighting::upload(const int frame_index, const vk_camera& camera, const VkExtent2D extent,
+	                                   const std::vector<point_light>& lights)
+	{
+		VK_PROFILE_FUNCTION();
+		auto& frame = frames[frame_index];
+		const auto& grid = clusters.get_grid();
+		const auto light_count = static_cast<uint32_t>(lights.size());
+
+		light_cluster_slicing slicing;
+		if (assignment == light_assignment::cpu)
+		{
+			clusters.assign(camera.get_view(), camera.get_projection(), lights);
+			slicing = clusters.get_slicing();
+
+			const auto& light_indices = clusters.get_light_indices();
+			reserve(frame, light_count, static_cast<uint32_t>(light_indices.size()));
+
+			frame.cluster_ranges->write_to_buffer(clusters.get_cluster_ranges().data());
+			frame.cluster_ranges->flush();
+			if (!light_indices.empty())
+			{
+				frame.light_indices->write_to_buffer(light_indices.data(),
+				                                     light_indices.size() * sizeof(uint32_t));
+				frame.light_indices->flush();
+			}
+		}
+		else
+		{
+			slicing = light_cluster_slicing::from_projection(camera.get_projection(), grid.z);
+			reserve(frame, light_count, 0);
+		}
+
+		if (light_count > 0)
+		{
+			frame.lights->write_to_buffer(lights.data(), light_count * sizeof(point_light));
+			frame.lights->flush();
+		}
+
+		light_cluster_params params{};
+		params.view = camera.get_view();
+		params.inverse_projection = glm::inverse(camera.get_projection());
+		params.grid = {grid.x, grid.y, grid.z, light_count};
+		params.slicing = {
+			slicing.scale, slicing.bias, slicing.logarithmic ? 1.f : 0.f,
+			static_cast<float>(max_lights_per_cluster)
+		};
+		params.depth_range = {
+			slicing.near, slicing.far, static_cast<float>(extent.width), static_cast<float>(extent.height)
+		};
+		frame.params->write_to_buffer(&params);
+		frame.params->flush();
+	}
+
+	void vk_clustered_lighting::record_assignment(const VkCommandBuffer command_buffer, const int frame_index) const
+	{
+		if (assignment == light_assignment::cpu)
+			return;
+
+		const auto& grid = clusters.get_grid();
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1,
+		                        &frames[frame_index].descriptor_set, 0, nullptr);
+		vkCmdDispatch(command_buffer, (grid.count() + clusters_per_workgroup - 1) / clusters_per_workgroup, 1, 1);
+	}
+}
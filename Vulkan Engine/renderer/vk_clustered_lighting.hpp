@@ -0,0 +1,105 @@
+#pragma once
+
+#include "vk_buffer.hpp"
+#include "vk_device.hpp"
+#include "simple_render_system/vk_descriptors.hpp"
+#include "simple_render_system/vk_pipeline_manager.hpp"
+#include "../engine/vk_camera.hpp"
+#include "../engine/vk_light_clusters.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vk_engine
+{
+	class vk_shader_module;
+
+	enum class light_assignment
+	{
+		cpu, // vk_light_clusters, compact light lists uploaded every frame
+		gpu, // compute dispatch, at most max_lights_per_cluster lights per cluster
+	};
+
+	// std140 layout of ClusterParams in simple_shader.frag and light_clusters.comp
+	struct light_cluster_params
+	{
+		glm::mat4 view{1.f};
+		glm::mat4 inverse_projection{1.f};
+		glm::uvec4 grid{0}; // clusters along x, y and z, w is the light count
+		glm::vec4 slicing{0.f}; // scale, bias, 1 if logarithmic, max lights per cluster
+		glm::vec4 depth_range{0.f}; // near, far, framebuffer width and height in pixels
+	};
+
+	// point lights for clustered forward shading. owns the descriptor set the lit shaders read (set 2 of
+	// vk_simple_render_system): the parameters, the light list, one light range per cluster and the light indices
+	// the ranges point into, one copy per frame in flight
+	class vk_clustered_lighting
+	{
+	public:
+		static constexpr uint32_t max_lights_per_cluster = 256;
+
+		vk_clustered_lighting(vk_device& device, vk_pipeline_manager& pipeline_manager,
+		                      light_assignment assignment = light_assignment::cpu, light_cluster_grid grid = {});
+		~vk_clustered_lighting();
+
+		vk_clustered_lighting(const vk_clustered_lighting&) = delete;
+		vk_clustered_lighting& operator=(const vk_clustered_lighting&) = delete;
+
+		// uploads the lights and assigns them to clusters, right away on the cpu or by recording a dispatch into
+		// command_buffer. call outside a render pass, before anything that shades with them
+		void update(VkCommandBuffer command_buffer, int frame_index, const vk_camera& camera, VkExtent2D extent,
+		            const std::vector<point_light>& lights);
+
+		// update split for a render graph: upload does everything but the dispatch, record_assignment records it
+		// (nothing on the cpu path) without a barrier. the pass recording it writes the cluster ranges and light
+		// indices buffers, the passes shading with them read them
+		void upload(int frame_index, const vk_camera& camera, VkExtent2D extent,
+		            const std::vector<point_light>& lights);
+		void record_assignment(VkCommandBuffer command_buffer, int frame_index) const;
+		VkBuffer get_cluster_ranges_buffer(const int frame_index) const
+		{
+			return frames[frame_index].cluster_ranges->get_buffer();
+		}
+		VkBuffer get_light_indices_buffer(const int frame_index) const
+		{
+			return frames[frame_index].light_indices->get_buffer();
+		}
+
+		VkDescriptorSetLayout get_descriptor_set_layout() const
+		{
+			return descriptor_set_layout->get_descriptor_set_layout();
+		}
+		VkDescriptorSet get_descriptor_set(const int frame_index) const { return frames[frame_index].descriptor_set; }
+		light_assignment get_assignment() const { return assignment; }
+
+	private:
+		struct frame_resources
+		{
+			std::unique_ptr<vk_buffer> params;
+			std::unique_ptr<vk_buffer> lights;
+			std::unique_ptr<vk_buffer> cluster_ranges;
+			std::unique_ptr<vk_buffer> light_indices;
+			VkDescriptorSet descriptor_set{};
+		};
+
+		void create_frame_resources();
+		void create_compute_pipeline();
+		// the old buffers of that frame are done on the gpu, its fence was waited on before recording
+		void reserve(frame_resources& frame, uint32_t light_count, uint32_t light_index_count);
+		void write_descriptor_set(frame_resources& frame) const;
+
+		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
+		light_assignment assignment;
+		vk_light_clusters clusters;
+
+		std::unique_ptr<vk_descriptor_set_layout> descriptor_set_layout;
+		std::unique_ptr<vk_descriptor_pool> descriptor_pool;
+		std::vector<frame_resources> frames;
+
+		// gpu assignment only
+		std::shared_ptr<vk_shader_module> compute_shader;
+		VkPipelineLayout compute_pipeline_layout{};
+		VkPipeline compute_pipeline{};
+	};
+}
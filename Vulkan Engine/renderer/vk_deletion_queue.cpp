@@ -0,0 +1,41 @@
+#include "vk_deletion_queue.hpp"
+
+#include <cassert>
+
+namespace vk_engine
+{
+	vk_deletion_queue::~vk_deletion_queue()
+	{
+		flush();
+	}
+
+	void vk_deletion_queue::push(const uint64_t last_use_frame, std::function<void()> deleter)
+	{
+		assert(
+			(entries.empty() || entries.back().last_use_frame <= last_use_frame) &&
+			"Resources must be retired in frame order");
+
+		entries.push_back({last_use_frame, std::move(deleter)});
+	}
+
+	void vk_deletion_queue::collect(const uint64_t completed_frame)
+	{
+		// entries are pushed in frame order, so we can stop at the first one still in use
+		while (!entries.empty() && entries.front().last_use_frame <= completed_frame)
+		{
+			const auto deleter = std::move(entries.front().deleter);
+			entries.pop_front();
+			deleter();
+		}
+	}
+
+	void vk_deletion_queue::flush()
+	{
+		while (!entries.empty())
+		{
+			const auto deleter = std::move(entries.front().deleter);
+			entries.pop_front();
+			deleter();
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace vk_engine
+{
+	class vk_deletion_queue
+	{
+	public:
+		vk_deletion_queue() = default;
+		~vk_deletion_queue();
+
+		vk_deletion_queue(const vk_deletion_queue&) = delete;
+		vk_deletion_queue& operator=(const vk_deletion_queue&) = delete;
+
+		// deleter may only run once the gpu has finished every frame up to and including last_use_frame
+		void push(uint64_t last_use_frame, std::function<void()> deleter);
+
+		// runs every deleter whose last use frame is <= completed_frame, in retirement order
+		void collect(uint64_t completed_frame);
+
+		// runs every pending deleter, caller must make sure the device is idle
+		void flush();
+
+		bool empty() const { return entries.empty(); }
+
+	private:
+		struct entry
+		{
+			uint64_t last_use_frame;
+			std::function<void()> deleter;
+		};
+
+		std::deque<entry> entries;
+	};
+}
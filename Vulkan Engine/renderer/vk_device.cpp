@@ -1,13 +1,49 @@
 #include "vk_device.hpp"
+#include "vk_geometry_pool.hpp"
+#include "vk_shader_cache.hpp"
+#include "../engine/vk_model.hpp"
 
 // std headers
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
 
 namespace vk_engine
 {
+	namespace
+	{
+		// prefixed to the driver's blob on disk, the driver header alone says nothing about the driver version
+		// and some drivers crash on data written by an older version of themselves
+		struct pipeline_cache_file_header
+		{
+			uint32_t magic;
+			uint32_t vendor_id;
+			uint32_t device_id;
+			uint32_t driver_version;
+			uint8_t cache_uuid[VK_UUID_SIZE];
+			uint64_t data_size;
+			uint64_t data_hash;
+		};
+
+		constexpr uint32_t pipeline_cache_magic = 0x43505456; // "VTPC"
+
+		uint64_t hash_bytes(const char* data, const size_t size)
+		{
+			// fnv-1a, only guards against truncated or corrupted files
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= static_cast<uint8_t>(data[i]);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	}
+
 	// local callback functions
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 		VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
@@ -43,7 +79,7 @@ namespace vk_engine
 	}
 
 	// class member functions
-	vk_device::vk_device(vk_window& window) : window{window}
+	vk_device::vk_device(vk_window& window) : window{&window}
 	{
 		create_instance();
 		setup_debug_messenger();
@@ -51,10 +87,39 @@ namespace vk_engine
 		pick_physical_device();
 		create_logical_device();
 		create_command_pool();
+		create_pipeline_cache();
+		shader_cache = std::make_unique<vk_shader_cache>(*this);
+		geometry_pool = std::make_unique<vk_geometry_pool>(*this, static_cast<uint32_t>(sizeof(vk_model::vertex)));
+	}
+
+	vk_device::vk_device()
+	{
+		create_instance();
+		setup_debug_messenger();
+		pick_physical_device();
+		create_logical_device();
+		create_command_pool();
+		create_pipeline_cache();
+		shader_cache = std::make_unique<vk_shader_cache>(*this);
+		geometry_pool = std::make_unique<vk_geometry_pool>(*this, static_cast<uint32_t>(sizeof(vk_model::vertex)));
 	}
 
 	vk_device::~vk_device()
 	{
+		// frames still in flight may draw from the pool's buffers
+		vkDeviceWaitIdle(device);
+		geometry_pool.reset();
+		shader_cache.reset();
+		const size_t saved_size = save_pipeline_cache();
+
+		// the creation times are reported even when nothing could be saved
+		std::cout
+			<< "[PIPELINE CACHE]" << std::endl
+			<< "	" << (cache_stats.warm ? "warm" : "cold") << " start, " << cache_stats.pipeline_count
+			<< " pipelines created in " << cache_stats.pipeline_creation_ms << " ms" << std::endl
+			<< "	saved " << saved_size << " bytes to " << pipeline_cache_path << std::endl;
+
+		vkDestroyPipelineCache(device, pipeline_cache, nullptr);
 		vkDestroyCommandPool(device, command_pool, nullptr);
 		vkDestroyDevice(device, nullptr);
 
@@ -63,7 +128,8 @@ namespace vk_engine
 			destroy_debug_utils_messenger_ext(instance, debug_messenger, nullptr);
 		}
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		if (surface != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(instance, surface, nullptr);
 		vkDestroyInstance(instance, nullptr);
 	}
 
@@ -141,6 +207,12 @@ namespace vk_engine
 
 		vkGetPhysicalDeviceProperties(physical_device, &properties);
 		std::cout << "physical device: " << properties.deviceName << std::endl;
+
+		uint32_t queue_family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+		timestamp_valid_bits = queue_families[find_queue_families(physical_device).graphics_family].timestampValidBits;
 	}
 
 	void vk_device::create_logical_device()
@@ -162,8 +234,14 @@ namespace vk_engine
 			queue_create_infos.push_back(queue_create_info);
 		}
 
+		VkPhysicalDeviceFeatures supported_features;
+		vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+
 		VkPhysicalDeviceFeatures device_features = {};
 		device_features.samplerAnisotropy = VK_TRUE;
+		// optional, only the gpu profiler uses it
+		device_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+		enabled_features = device_features;
 
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -172,6 +250,7 @@ namespace vk_engine
 		create_info.pQueueCreateInfos = queue_create_infos.data();
 
 		create_info.pEnabledFeatures = &device_features;
+		const auto device_extensions = get_required_device_extensions();
 		create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
 		create_info.ppEnabledExtensionNames = device_extensions.data();
 
@@ -213,7 +292,146 @@ namespace vk_engine
 		}
 	}
 
-	void vk_device::create_surface() { window.create_window_surface(instance, &surface); }
+	void vk_device::create_pipeline_cache()
+	{
+		const auto initial_data = load_pipeline_cache_data();
+		cache_stats.warm = !initial_data.empty();
+		cache_stats.loaded_size = initial_data.size();
+
+		VkPipelineCacheCreateInfo cache_info{};
+		cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cache_info.initialDataSize = initial_data.size();
+		cache_info.pInitialData = initial_data.data();
+
+		if (vkCreatePipelineCache(device, &cache_info, nullptr, &pipeline_cache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		std::cout
+			<< "[PIPELINE CACHE]" << std::endl
+			<< "	" << (cache_stats.warm ? "warm, loaded " : "cold, loaded ") << cache_stats.loaded_size
+			<< " bytes from " << pipeline_cache_path << std::endl;
+	}
+
+	std::vector<char> vk_device::load_pipeline_cache_data() const
+	{
+		std::ifstream file{pipeline_cache_path, std::ios::ate | std::ios::binary};
+		if (!file.is_open())
+			return {};
+
+		const auto file_size = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+
+		pipeline_cache_file_header header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			return {};
+
+		// anything written for another device or driver is useless and possibly harmful, start cold instead
+		if (header.magic != pipeline_cache_magic ||
+			header.vendor_id != properties.vendorID ||
+			header.device_id != properties.deviceID ||
+			header.driver_version != properties.driverVersion ||
+			std::memcmp(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+			header.data_size != file_size - sizeof(header))
+			return {};
+
+		std::vector<char> data(static_cast<size_t>(header.data_size));
+		if (!file.read(data.data(), static_cast<std::streamsize>(data.size())) ||
+			hash_bytes(data.data(), data.size()) != header.data_hash)
+			return {};
+
+		return data;
+	}
+
+	size_t vk_device::save_pipeline_cache() const
+	{
+		size_t data_size = 0;
+		if (vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0)
+			return 0;
+
+		std::vector<char> data(data_size);
+		if (vkGetPipelineCacheData(device, pipeline_cache, &data_size, data.data()) != VK_SUCCESS)
+			return 0;
+		data.resize(data_size);
+
+		pipeline_cache_file_header header{};
+		header.magic = pipeline_cache_magic;
+		header.vendor_id = properties.vendorID;
+		header.device_id = properties.deviceID;
+		header.driver_version = properties.driverVersion;
+		std::memcpy(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.data_size = data.size();
+		header.data_hash = hash_bytes(data.data(), data.size());
+
+		// written next to the old file and renamed over it, a crash mid write must not leave a torn cache
+		const auto temp_path = pipeline_cache_path + ".tmp";
+		{
+			std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+			if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+				!file.write(data.data(), static_cast<std::streamsize>(data.size())))
+			{
+				std::cerr << "failed to write pipeline cache to " << temp_path << std::endl;
+				return 0;
+			}
+		}
+#ifdef _WIN32
+		// rename does not replace an existing file here, posix does it atomically
+		std::remove(pipeline_cache_path.c_str());
+#endif
+		if (std::rename(temp_path.c_str(), pipeline_cache_path.c_str()) != 0)
+		{
+			std::cerr << "failed to write pipeline cache to " << pipeline_cache_path << std::endl;
+			return 0;
+		}
+
+		return data.size();
+	}
+
+	void vk_device::add_pipeline_creation_time(const double milliseconds)
+	{
+		std::lock_guard<std::mutex> lock{cache_stats_mutex};
+		cache_stats.pipeline_count++;
+		cache_stats.pipeline_creation_ms += milliseconds;
+	}
+
+	VkResult vk_device::allocate_memory(const VkMemoryAllocateInfo& alloc_info, VkDeviceMemory& memory) const
+	{
+		const VkResult result = vkAllocateMemory(device, &alloc_info, nullptr, &memory);
+		if (result != VK_SUCCESS)
+			return result;
+
+		std::lock_guard<std::mutex> lock{memory_mutex};
+		allocation_sizes[memory] = alloc_info.allocationSize;
+		memory_stats.allocated_bytes += alloc_info.allocationSize;
+		memory_stats.peak_bytes = std::max(memory_stats.peak_bytes, memory_stats.allocated_bytes);
+		memory_stats.allocation_count++;
+		return result;
+	}
+
+	void vk_device::free_memory(const VkDeviceMemory memory) const
+	{
+		if (memory == VK_NULL_HANDLE)
+			return;
+
+		vkFreeMemory(device, memory, nullptr);
+
+		std::lock_guard<std::mutex> lock{memory_mutex};
+		if (const auto allocation = allocation_sizes.find(memory); allocation != allocation_sizes.end())
+		{
+			memory_stats.allocated_bytes -= allocation->second;
+			memory_stats.allocation_count--;
+			allocation_sizes.erase(allocation);
+		}
+	}
+
+	device_memory_stats vk_device::get_memory_stats() const
+	{
+		std::lock_guard<std::mutex> lock{memory_mutex};
+		return memory_stats;
+	}
+
+	void vk_device::create_surface() { window->create_window_surface(instance, &surface); }
 
 	bool vk_device::is_device_suitable(const VkPhysicalDevice device) const
 	{
@@ -221,8 +439,9 @@ namespace vk_engine
 
 		const bool extensions_supported = check_device_extension_support(device);
 
-		bool swap_chain_adequate = false;
-		if (extensions_supported)
+		// without a surface there is nothing to present to, so any device that can draw will do
+		bool swap_chain_adequate = is_headless();
+		if (extensions_supported && !is_headless())
 		{
 			auto [capabilities, formats, present_modes] = query_swap_chain_support(device);
 			swap_chain_adequate = !formats.empty() && !present_modes.empty();
@@ -292,10 +511,15 @@ namespace vk_engine
 
 	std::vector<const char*> vk_device::get_required_extensions() const
 	{
-		uint32_t glfw_extension_count = 0;
-		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		std::vector<const char*> extensions;
 
-		std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+		// glfw is never initialized in headless mode, so it can't be asked for surface extensions
+		if (!is_headless())
+		{
+			uint32_t glfw_extension_count = 0;
+			const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+			extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+		}
 
 		if (enable_validation_layers)
 		{
@@ -305,6 +529,14 @@ namespace vk_engine
 		return extensions;
 	}
 
+	std::vector<const char*> vk_device::get_required_device_extensions() const
+	{
+		if (is_headless())
+			return {};
+
+		return swap_chain_extensions;
+	}
+
 	void vk_device::has_gflw_required_instance_extensions() const
 	{
 		uint32_t extension_count = 0;
@@ -344,6 +576,7 @@ namespace vk_engine
 			&extension_count,
 			available_extensions.data());
 
+		const auto device_extensions = get_required_device_extensions();
 		std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
 
 		for (const auto& [extensionName, specVersion] : available_extensions)
@@ -373,7 +606,10 @@ namespace vk_engine
 				indices.graphics_family_has_value = true;
 			}
 			VkBool32 present_support = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+			if (is_headless())
+				present_support = queueFlags & VK_QUEUE_GRAPHICS_BIT ? VK_TRUE : VK_FALSE;
+			else
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
 			if (queueCount > 0 && present_support)
 			{
 				indices.present_family = i;
@@ -424,15 +660,7 @@ namespace vk_engine
 	{
 		for (const VkFormat format : candidates)
 		{
-			VkFormatProperties props;
-			vkGetPhysicalDeviceFormatProperties(physical_device, format, &props);
-
-			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
-			{
-				return format;
-			}
-			if (
-				tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+			if (supports_format_features(format, tiling, features))
 			{
 				return format;
 			}
@@ -440,6 +668,18 @@ namespace vk_engine
 		throw std::runtime_error("failed to find supported format!");
 	}
 
+	bool vk_device::supports_format_features(const VkFormat format, const VkImageTiling tiling,
+	                                         const VkFormatFeatureFlags features) const
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &props);
+
+		const VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR
+			                                       ? props.linearTilingFeatures
+			                                       : props.optimalTilingFeatures;
+		return (supported & features) == features;
+	}
+
 	uint32_t vk_device::find_memory_type(const uint32_t type_filter, const VkMemoryPropertyFlags prop_flags) const
 	{
 		VkPhysicalDeviceMemoryProperties mem_properties;
@@ -456,6 +696,19 @@ namespace vk_engine
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
+	bool vk_device::has_memory_type(const uint32_t type_filter, const VkMemoryPropertyFlags prop_flags) const
+	{
+		VkPhysicalDeviceMemoryProperties mem_properties;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+		for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++)
+		{
+			if ((type_filter & (1 << i)) &&
+				(mem_properties.memoryTypes[i].propertyFlags & prop_flags) == prop_flags)
+				return true;
+		}
+		return false;
+	}
+
 	void vk_device::create_buffer(
 		const VkDeviceSize size,
 		const VkBufferUsageFlags usage,
@@ -482,7 +735,7 @@ namespace vk_engine
 		alloc_info.allocationSize = mem_requirements.size;
 		alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, prop_flags);
 
-		if (vkAllocateMemory(device, &alloc_info, nullptr, &buffer_memory) != VK_SUCCESS)
+		if (allocate_memory(alloc_info, buffer_memory) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to allocate vertex buffer memory!");
 		}
@@ -524,13 +777,14 @@ namespace vk_engine
 		vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
 	}
 
-	void vk_device::copy_buffer(const VkBuffer src_buffer, const VkBuffer dst_buffer, const VkDeviceSize size) const
+	void vk_device::copy_buffer(const VkBuffer src_buffer, const VkBuffer dst_buffer, const VkDeviceSize size,
+	                            const VkDeviceSize src_offset, const VkDeviceSize dst_offset) const
 	{
 		const VkCommandBuffer command_buffer = begin_single_time_commands();
 
 		VkBufferCopy copy_region;
-		copy_region.srcOffset = 0; // Optional
-		copy_region.dstOffset = 0; // Optional
+		copy_region.srcOffset = src_offset;
+		copy_region.dstOffset = dst_offset;
 		copy_region.size = size;
 		vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
 
@@ -585,7 +839,7 @@ namespace vk_engine
 		alloc_info.allocationSize = mem_requirements.size;
 		alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, prop_flags);
 
-		if (vkAllocateMemory(device, &alloc_info, nullptr, &image_memory) != VK_SUCCESS)
+		if (allocate_memory(alloc_info, image_memory) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to allocate image memory!");
 		}
@@ -3,6 +3,10 @@
 #include "vk_window.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace vk_engine
@@ -23,16 +27,36 @@ namespace vk_engine
 		bool is_complete() const { return graphics_family_has_value && present_family_has_value; }
 	};
 
+	class vk_geometry_pool;
+	class vk_shader_cache;
+
+	struct pipeline_cache_stats
+	{
+		bool warm = false; // a valid cache for this device and driver was loaded from disk
+		size_t loaded_size = 0;
+		uint32_t pipeline_count = 0;
+		double pipeline_creation_ms = 0.0;
+	};
+
+	struct device_memory_stats
+	{
+		VkDeviceSize allocated_bytes = 0; // live right now
+		VkDeviceSize peak_bytes = 0;
+		uint32_t allocation_count = 0; // live right now
+	};
+
 	class vk_device
 	{
 	public:
 #ifdef NDEBUG
-  const bool enableValidationLayers = false;
+		const bool enable_validation_layers = false;
 #else
 		const bool enable_validation_layers = true;
 #endif
 
 		explicit vk_device(vk_window& window);
+		// headless device without a surface, for offscreen rendering (e.g. lavapipe on a machine without display)
+		vk_device();
 		~vk_device();
 
 		// Not copyable or movable
@@ -46,12 +70,27 @@ namespace vk_engine
 		VkSurfaceKHR get_surface() const { return surface; }
 		VkQueue get_graphics_queue() const { return graphics_queue; }
 		VkQueue get_present_queue() const { return present_queue; }
+		bool is_headless() const { return window == nullptr; }
+		VkPipelineCache get_pipeline_cache() const { return pipeline_cache; }
+		bool is_pipeline_cache_warm() const { return cache_stats.warm; }
+		vk_shader_cache& get_shader_cache() const { return *shader_cache; }
+		// every vk_model of the device lives in it, destroyed with the device once it is idle
+		vk_geometry_pool& get_geometry_pool() const { return *geometry_pool; }
+		void add_pipeline_creation_time(double milliseconds);
+
+		// every device memory allocation goes through these, so the live total can be reported
+		VkResult allocate_memory(const VkMemoryAllocateInfo& alloc_info, VkDeviceMemory& memory) const;
+		void free_memory(VkDeviceMemory memory) const;
+		device_memory_stats get_memory_stats() const;
 
 		swap_chain_support_details get_swap_chain_support() const { return query_swap_chain_support(physical_device); }
 		uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags prop_flags) const;
+		// e.g. lazily allocated memory, which only some (mostly tile based) gpus have
+		bool has_memory_type(uint32_t type_filter, VkMemoryPropertyFlags prop_flags) const;
 		queue_family_indices find_physical_queue_families() const { return find_queue_families(physical_device); }
 		VkFormat find_supported_format(
 			const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
+		bool supports_format_features(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) const;
 
 		// Buffer Helper Functions
 		void create_buffer(
@@ -62,7 +101,8 @@ namespace vk_engine
 			VkDeviceMemory& buffer_memory) const;
 		VkCommandBuffer begin_single_time_commands() const;
 		void end_single_time_commands(VkCommandBuffer command_buffer) const;
-		void copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) const;
+		void copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size, VkDeviceSize src_offset = 0,
+		                 VkDeviceSize dst_offset = 0) const;
 		void copy_buffer_to_image(
 			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layer_count) const;
 
@@ -73,6 +113,9 @@ namespace vk_engine
 			VkDeviceMemory& image_memory) const;
 
 		VkPhysicalDeviceProperties properties{};
+		VkPhysicalDeviceFeatures enabled_features{};
+		// 0 when the graphics queue can't write timestamps
+		uint32_t timestamp_valid_bits = 0;
 
 	private:
 		void create_instance();
@@ -81,10 +124,15 @@ namespace vk_engine
 		void pick_physical_device();
 		void create_logical_device();
 		void create_command_pool();
+		void create_pipeline_cache();
+		// bytes written, 0 when nothing was
+		size_t save_pipeline_cache() const;
+		std::vector<char> load_pipeline_cache_data() const;
 
 		// helper functions
 		bool is_device_suitable(VkPhysicalDevice device) const;
 		std::vector<const char*> get_required_extensions() const;
+		std::vector<const char*> get_required_device_extensions() const;
 		bool check_validation_layer_support() const;
 		queue_family_indices find_queue_families(VkPhysicalDevice device) const;
 		static void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info);
@@ -95,15 +143,24 @@ namespace vk_engine
 		VkInstance instance{};
 		VkDebugUtilsMessengerEXT debug_messenger{};
 		VkPhysicalDevice physical_device = VK_NULL_HANDLE;
-		vk_window& window;
+		vk_window* window = nullptr;
 		VkCommandPool command_pool{};
 
 		VkDevice device{};
 		VkSurfaceKHR surface{};
 		VkQueue graphics_queue{};
 		VkQueue present_queue{};
+		VkPipelineCache pipeline_cache{};
+		pipeline_cache_stats cache_stats{};
+		std::mutex cache_stats_mutex; // pipelines are created on worker threads
+		std::unique_ptr<vk_shader_cache> shader_cache;
+		std::unique_ptr<vk_geometry_pool> geometry_pool;
+		mutable std::mutex memory_mutex;
+		mutable std::unordered_map<VkDeviceMemory, VkDeviceSize> allocation_sizes;
+		mutable device_memory_stats memory_stats{};
 
 		const std::vector<const char*> validation_layers = {"VK_LAYER_KHRONOS_validation"};
-		const std::vector<const char*> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		const std::vector<const char*> swap_chain_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		const std::string pipeline_cache_path = "pipeline_cache.bin";
 	};
 } // namespace vk
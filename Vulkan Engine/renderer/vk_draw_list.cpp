@@ -0,0 +1,222 @@
+#include "vk_draw_list.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace vk_engine
+{
+	namespace
+	{
+		constexpr uint32_t digit_bits = 8;
+		constexpr uint32_t bucket_count = 1u << digit_bits;
+		constexpr uint32_t digit_count = 64 / digit_bits;
+
+		using histogram = std::array<size_t, bucket_count>;
+
+		constexpr uint64_t field_mask(const uint32_t bits)
+		{
+			return (uint64_t{1} << bits) - 1;
+		}
+
+		uint32_t get_digit(const uint64_t key, const uint32_t digit)
+		{
+			return static_cast<uint32_t>(key >> digit * digit_bits) & (bucket_count - 1);
+		}
+
+		// every thread waits in arrive_and_wait() until all of them got there, then all go on. reusable
+		class thread_barrier
+		{
+		public:
+			explicit thread_barrier(const uint32_t thread_count) : thread_count{thread_count}
+			{
+			}
+
+			void arrive_and_wait()
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				const uint64_t arrived_generation = generation;
+				if (++waiting == thread_count)
+				{
+					waiting = 0;
+					generation++;
+					condition.notify_all();
+					return;
+				}
+				condition.wait(lock, [&] { return generation != arrived_generation; });
+			}
+
+		private:
+			std::mutex mutex;
+			std::condition_variable condition;
+			uint32_t thread_count;
+			uint32_t waiting = 0;
+			uint64_t generation = 0;
+		};
+	}
+
+	uint64_t draw_key::make(const uint32_t pass, const uint32_t pipeline, const uint32_t model, const float depth)
+	{
+		// positive floats order like their bits, the top ones are the exponent and the leading mantissa bits
+		uint64_t depth_field = 0;
+		if (depth > 0.f)
+		{
+			uint32_t depth_bits_value;
+			std::memcpy(&depth_bits_value, &depth, sizeof(depth_bits_value));
+			depth_field = depth_bits_value >> (32 - depth_bits);
+		}
+
+		return (pass & field_mask(pass_bits)) << (pipeline_bits + model_bits + depth_bits) |
+			(pipeline & field_mask(pipeline_bits)) << (model_bits + depth_bits) |
+			(model & field_mask(model_bits)) << depth_bits |
+			depth_field;
+	}
+
+	vk_sort_workers::vk_sort_workers(uint32_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+		workers.reserve(thread_count - 1);
+		for (uint32_t thread = 1; thread < thread_count; thread++)
+			workers.emplace_back(&vk_sort_workers::work, this, thread);
+	}
+
+	vk_sort_workers::~vk_sort_workers()
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stopping = true;
+		}
+		start_condition.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	void vk_sort_workers::run(const std::function<void(uint32_t)>& new_task)
+	{
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			task = &new_task;
+			running = static_cast<uint32_t>(workers.size());
+			generation++;
+		}
+		start_condition.notify_all();
+
+		new_task(0);
+
+		std::unique_lock<std::mutex> lock{mutex};
+		done_condition.wait(lock, [&] { return running == 0; });
+		task = nullptr;
+	}
+
+	void vk_sort_workers::work(const uint32_t thread)
+	{
+		uint64_t seen_generation = 0;
+		while (true)
+		{
+			const std::function<void(uint32_t)>* current_task;
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				start_condition.wait(lock, [&] { return stopping || generation != seen_generation; });
+				if (stopping)
+					return;
+				seen_generation = generation;
+				current_task = task;
+			}
+
+			(*current_task)(thread);
+
+			std::lock_guard<std::mutex> lock{mutex};
+			if (--running == 0)
+				done_condition.notify_one();
+		}
+	}
+
+	void radix_sort(std::vector<draw_packet>& packets, std::vector<draw_packet>& scratch, vk_sort_workers* workers)
+	{
+		const size_t count = packets.size();
+		if (count < 2)
+			return;
+
+		const uint32_t thread_count = workers != nullptr && count >= parallel_sort_threshold
+			                              ? workers->get_thread_count()
+			                              : 1;
+
+		scratch.resize(count);
+
+		// each thread counts and scatters its own slice, the offsets of thread t in a bucket start after the
+		// elements threads 0..t-1 put there, which keeps the sort stable
+		std::vector<histogram> histograms(thread_count);
+		std::vector<histogram> offsets(thread_count);
+		thread_barrier barrier{thread_count};
+		bool skip_digit = false;
+		uint32_t scattered_digits = 0;
+
+		const auto sort_slice = [&](const uint32_t thread)
+		{
+			const size_t begin = count * thread / thread_count;
+			const size_t end = count * (thread + 1) / thread_count;
+			draw_packet* source = packets.data();
+			draw_packet* destination = scratch.data();
+
+			for (uint32_t digit = 0; digit < digit_count; digit++)
+			{
+				auto& counts = histograms[thread];
+				counts.fill(0);
+				for (size_t i = begin; i < end; i++)
+					counts[get_digit(source[i].key, digit)]++;
+
+				barrier.arrive_and_wait();
+				if (thread == 0)
+				{
+					size_t offset = 0;
+					skip_digit = false;
+					for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+					{
+						const size_t bucket_start = offset;
+						for (uint32_t t = 0; t < thread_count; t++)
+						{
+							offsets[t][bucket] = offset;
+							offset += histograms[t][bucket];
+						}
+						// every key has the same digit here, scattering would copy them in the same order
+						if (offset - bucket_start == count)
+							skip_digit = true;
+					}
+					if (!skip_digit)
+						scattered_digits++;
+				}
+				barrier.arrive_and_wait();
+
+				if (skip_digit)
+					continue;
+
+				auto& next = offsets[thread];
+				for (size_t i = begin; i < end; i++)
+					destination[next[get_digit(source[i].key, digit)]++] = source[i];
+				std::swap(source, destination);
+
+				// the next digit reads slices other threads are writing now
+				barrier.arrive_and_wait();
+			}
+		};
+
+		if (thread_count > 1)
+			workers->run(sort_slice);
+		else
+			sort_slice(0);
+
+		if (scattered_digits % 2 != 0)
+			packets.swap(scratch);
+	}
+
+	void vk_draw_list::sort()
+	{
+		VK_PROFILE_SCOPE("sort_draws");
+		if (!workers && packets.size() >= parallel_sort_threshold)
+			workers = std::make_unique<vk_sort_workers>();
+		radix_sort(packets, scratch, workers.get());
+	}
+}
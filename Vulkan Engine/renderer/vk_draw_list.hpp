@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vk_engine
+{
+	class vk_game_object;
+
+	// draws run in key order. from the top bit down: pass, pipeline, model, then view depth, so state only changes
+	// where a field does and the draws of one model go front to back for early depth rejection
+	struct draw_key
+	{
+		static constexpr uint32_t pass_bits = 4;
+		static constexpr uint32_t pipeline_bits = 12;
+		static constexpr uint32_t model_bits = 24;
+		static constexpr uint32_t depth_bits = 24;
+
+		// ids wrap to their field width, depth is view space, anything behind the camera sorts first
+		static uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t model, float depth);
+	};
+
+	struct draw_packet
+	{
+		uint64_t key;
+		const vk_game_object* object;
+	};
+
+	// below this many packets one thread is done before more threads would have started
+	constexpr size_t parallel_sort_threshold = 1 << 16;
+
+	// threads parked between sorts, so a frame's sort hands out slices instead of starting threads
+	class vk_sort_workers
+	{
+	public:
+		// thread_count counts the calling thread, 0 picks the hardware threads
+		explicit vk_sort_workers(uint32_t thread_count = 0);
+		~vk_sort_workers();
+
+		vk_sort_workers(const vk_sort_workers&) = delete;
+		vk_sort_workers& operator=(const vk_sort_workers&) = delete;
+
+		// task(0) on the calling thread, task(1) to task(thread count - 1) on the workers, all at once. returns
+		// when every one is done
+		void run(const std::function<void(uint32_t)>& task);
+
+		uint32_t get_thread_count() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	private:
+		void work(uint32_t thread);
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable start_condition;
+		std::condition_variable done_condition;
+		const std::function<void(uint32_t)>* task = nullptr;
+		uint64_t generation = 0; // of the last run()
+		uint32_t running = 0; // workers not done with it
+		bool stopping = false;
+	};
+
+	// lsd radix sort over 8 bit digits, stable. digits that are the same in every key are skipped, lists of at
+	// least parallel_sort_threshold packets are split over the workers' threads, without workers the calling thread
+	// sorts alone
+	void radix_sort(std::vector<draw_packet>& packets, std::vector<draw_packet>& scratch,
+	                vk_sort_workers* workers = nullptr);
+
+	// the draws a render system records in one frame, kept between frames so its storage is reused
+	class vk_draw_list
+	{
+	public:
+		void clear() { packets.clear(); }
+		void reserve(const size_t count) { packets.reserve(count); }
+		void push(const uint64_t key, const vk_game_object& object) { packets.push_back({key, &object}); }
+
+		// the workers are started by the first sort big enough to need them and kept for the next ones
+		void sort();
+
+		size_t size() const { return packets.size(); }
+		auto begin() const { return packets.cbegin(); }
+		auto end() const { return packets.cend(); }
+
+	private:
+		std::vector<draw_packet> packets;
+		std::vector<draw_packet> scratch;
+		std::unique_ptr<vk_sort_workers> workers;
+	};
+}
@@ -0,0 +1,128 @@
+#include "vk_dynamic_batcher.hpp"
+#include "vk_swapchain.hpp"
+
+#include <cassert>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_DYNAMIC_BATCHER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace vk_engine
+{
+	constexpr uint32_t initial_batch_capacity = 1024;
+
+	void transform_vertices(const vk_model::vertex* vertices, const uint32_t vertex_count,
+	                        const glm::mat4& model_matrix, const glm::mat3& normal_matrix, vk_model::vertex* out)
+	{
+		static_assert(sizeof(vk_model::vertex) == 44 && offsetof(vk_model::vertex, color) == 12 &&
+		              offsetof(vk_model::vertex, normal) == 24 && offsetof(vk_model::vertex, uv) == 36,
+		              "transform_vertices expects tightly packed position, color, normal, uv");
+#ifdef VK_DYNAMIC_BATCHER_SSE
+		const __m128 model_x = _mm_loadu_ps(&model_matrix[0][0]);
+		const __m128 model_y = _mm_loadu_ps(&model_matrix[1][0]);
+		const __m128 model_z = _mm_loadu_ps(&model_matrix[2][0]);
+		const __m128 model_w = _mm_loadu_ps(&model_matrix[3][0]);
+		const __m128 normal_x = _mm_setr_ps(normal_matrix[0].x, normal_matrix[0].y, normal_matrix[0].z, 0.f);
+		const __m128 normal_y = _mm_setr_ps(normal_matrix[1].x, normal_matrix[1].y, normal_matrix[1].z, 0.f);
+		const __m128 normal_z = _mm_setr_ps(normal_matrix[2].x, normal_matrix[2].y, normal_matrix[2].z, 0.f);
+
+		for (uint32_t i = 0; i < vertex_count; i++)
+		{
+			const auto* source = reinterpret_cast<const float*>(&vertices[i]);
+			auto* target = reinterpret_cast<float*>(&out[i]);
+
+			const __m128 position = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(model_x, _mm_set1_ps(source[0])), _mm_mul_ps(model_y, _mm_set1_ps(source[1]))),
+				_mm_add_ps(_mm_mul_ps(model_z, _mm_set1_ps(source[2])), model_w));
+			const __m128 normal = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(normal_x, _mm_set1_ps(source[6])), _mm_mul_ps(normal_y, _mm_set1_ps(source[7]))),
+				_mm_mul_ps(normal_z, _mm_set1_ps(source[8])));
+
+			// four floats at a time, every store's fourth lane is overwritten by the next one, so the vertex is
+			// written front to back in four stores
+			_mm_storeu_ps(target, position);
+			_mm_storeu_ps(target + 3, _mm_loadu_ps(source + 3));
+			_mm_storeu_ps(target + 6, normal);
+			const __m128 uv = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(source + 9));
+			_mm_storel_pi(reinterpret_cast<__m64*>(target + 9), uv);
+		}
+#else
+		for (uint32_t i = 0; i < vertex_count; i++)
+		{
+			const auto& source = vertices[i];
+			out[i] = {
+				glm::vec3{model_matrix * glm::vec4{source.position, 1.f}},
+				source.color,
+				normal_matrix * source.normal,
+				source.uv
+			};
+		}
+#endif
+	}
+
+	vk_dynamic_batcher::vk_dynamic_batcher(vk_device& device) : device{device}
+	{
+		vertex_buffers.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	}
+
+	vk_dynamic_batcher::~vk_dynamic_batcher() = default;
+
+	void vk_dynamic_batcher::grow_vertex_buffer(const int frame_index, const uint32_t vertex_count)
+	{
+		auto& vertex_buffer = vertex_buffers[frame_index];
+		uint32_t capacity = vertex_buffer ? vertex_buffer->get_instance_count() : initial_batch_capacity;
+		while (capacity < vertex_count)
+			capacity *= 2;
+
+		vertex_buffer = std::make_unique<vk_buffer>(
+			device,
+			sizeof(vk_model::vertex),
+			capacity,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+		vertex_buffer->map();
+	}
+
+	void vk_dynamic_batcher::begin(const int new_frame_index, const uint32_t new_vertex_count)
+	{
+		frame_index = new_frame_index;
+		vertex_count = 0;
+		reserved_count = new_vertex_count;
+
+		const auto& vertex_buffer = vertex_buffers[frame_index];
+		if (reserved_count > 0 && (!vertex_buffer || reserved_count > vertex_buffer->get_instance_count()))
+			grow_vertex_buffer(frame_index, reserved_count);
+	}
+
+	void vk_dynamic_batcher::add(const vk_model& model, const glm::mat4& model_matrix,
+	                             const glm::mat3& normal_matrix)
+	{
+		const auto& vertices = model.get_batch_vertices();
+		const auto count = static_cast<uint32_t>(vertices.size());
+		assert(vertex_count + count <= reserved_count && "Dynamic batch is bigger than begin() was told");
+
+		auto* mapped = static_cast<vk_model::vertex*>(vertex_buffers[frame_index]->get_mapped_memory());
+		transform_vertices(vertices.data(), count, model_matrix, normal_matrix, mapped + vertex_count);
+		vertex_count += count;
+	}
+
+	void vk_dynamic_batcher::end()
+	{
+		if (vertex_count > 0)
+			vertex_buffers[frame_index]->flush();
+	}
+
+	void vk_dynamic_batcher::draw(const VkCommandBuffer command_buffer, const uint32_t first_instance) const
+	{
+		if (vertex_count == 0)
+			return;
+
+		const VkBuffer buffers[] = {vertex_buffers[frame_index]->get_buffer()};
+		constexpr VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+		vkCmdDraw(command_buffer, vertex_count, 1, 0, first_instance);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vk_buffer.hpp"
+#include "vk_device.hpp"
+#include "../engine/vk_model.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	// vertex_count vertices to world space: positions by the affine model matrix, normals by the normal matrix
+	// (not renormalized, the shaders do that), color and uv copied. sse where available, out may be mapped memory
+	void transform_vertices(const vk_model::vertex* vertices, uint32_t vertex_count, const glm::mat4& model_matrix,
+	                        const glm::mat3& normal_matrix, vk_model::vertex* out);
+
+	// merges tiny meshes (vk_model::is_batchable) into one draw: their triangles are moved to world space on the cpu
+	// and written to a vertex buffer of the frame, drawn with one per object entry that holds the identity.
+	// worth it when the draws, not the vertices, are the cost: ui markers, debris, particles made of meshes
+	//
+	// usage per frame: begin() with the vertex count of everything that follows, add() each object, end(), then
+	// draw() as often as needed until the next begin() of the same frame index
+	class vk_dynamic_batcher
+	{
+	public:
+		explicit vk_dynamic_batcher(vk_device& device);
+		~vk_dynamic_batcher();
+
+		vk_dynamic_batcher(const vk_dynamic_batcher&) = delete;
+		vk_dynamic_batcher& operator=(const vk_dynamic_batcher&) = delete;
+
+		// frame_index's buffer must be done on the gpu, its fence was waited on before recording
+		void begin(int frame_index, uint32_t vertex_count);
+		void add(const vk_model& model, const glm::mat4& model_matrix, const glm::mat3& normal_matrix);
+		void end();
+
+		// one non indexed draw, nothing when the batch is empty. rebinds vertex buffer 0
+		void draw(VkCommandBuffer command_buffer, uint32_t first_instance) const;
+
+		uint32_t get_vertex_count() const { return vertex_count; }
+
+	private:
+		void grow_vertex_buffer(int frame_index, uint32_t vertex_count);
+
+		vk_device& device;
+
+		// one per frame in flight, persistently mapped, created on the first batch
+		std::vector<std::unique_ptr<vk_buffer>> vertex_buffers;
+
+		int frame_index = 0;
+		uint32_t vertex_count = 0;
+		uint32_t reserved_count = 0; // what begin() was told
+	};
+}
@@ -0,0 +1,220 @@
+#include "vk_geometry_pool.hpp"
+#include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vk_engine
+{
+	vk_geometry_pool::vk_geometry_pool(vk_device& device, const uint32_t vertex_size,
+	                                   const geometry_pool_config config)
+		: device{device},
+		  vertex_pool{vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT},
+		  index_pool{sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT}
+	{
+		assert(config.vertex_capacity > 0 && config.index_capacity > 0 && "Geometry pool capacities must not be 0");
+
+		create_buffer(vertex_pool, config.vertex_capacity);
+		create_buffer(index_pool, config.index_capacity);
+	}
+
+	vk_geometry_pool::~vk_geometry_pool() = default;
+
+	void vk_geometry_pool::create_buffer(range_pool& pool, const uint32_t capacity)
+	{
+		auto buffer = std::make_unique<vk_buffer>(
+			device,
+			pool.element_size,
+			capacity,
+			pool.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		uint32_t old_capacity = 0;
+		if (pool.buffer)
+		{
+			old_capacity = pool.buffer->get_instance_count();
+			device.copy_buffer(pool.buffer->get_buffer(), buffer->get_buffer(), pool.buffer->get_buffer_size());
+			grow_count++;
+
+			// recorded frames, submitted or not, may have bound it
+			std::shared_ptr retired = std::move(pool.buffer);
+			retired_resources.push(frame_count, [retired]() mutable
+			{
+				retired.reset();
+			});
+		}
+		pool.buffer = std::move(buffer);
+		release(pool, {old_capacity, capacity - old_capacity});
+	}
+
+	geometry_range vk_geometry_pool::allocate(range_pool& pool, const uint32_t count)
+	{
+		assert(count > 0 && "Cannot allocate an empty geometry range");
+
+		auto it = std::find_if(pool.free_ranges.begin(), pool.free_ranges.end(),
+		                       [count](const geometry_range& range) { return range.count >= count; });
+		if (it == pool.free_ranges.end())
+		{
+			// the free range at the end, if any, grows into the new space
+			const uint32_t capacity = pool.buffer->get_instance_count();
+			const uint32_t tail = !pool.free_ranges.empty() &&
+			                      pool.free_ranges.back().first + pool.free_ranges.back().count == capacity
+				                      ? pool.free_ranges.back().count
+				                      : 0;
+			uint32_t new_capacity = capacity * 2;
+			while (new_capacity - capacity + tail < count)
+				new_capacity *= 2;
+			create_buffer(pool, new_capacity);
+			it = std::prev(pool.free_ranges.end());
+		}
+
+		const geometry_range range{it->first, count};
+		it->first += count;
+		it->count -= count;
+		if (it->count == 0)
+			pool.free_ranges.erase(it);
+		pool.used += count;
+		return range;
+	}
+
+	void vk_geometry_pool::release(range_pool& pool, const geometry_range range)
+	{
+		if (range.count == 0)
+			return;
+
+		auto& ranges = pool.free_ranges;
+		auto next = std::lower_bound(ranges.begin(), ranges.end(), range.first,
+		                             [](const geometry_range& free, const uint32_t first)
+		                             {
+			                             return free.first < first;
+		                             });
+		assert((next == ranges.end() || range.first + range.count <= next->first) && "Geometry range freed twice");
+
+		// merged with the free ranges right before and after it
+		const bool joins_previous = next != ranges.begin() &&
+			std::prev(next)->first + std::prev(next)->count == range.first;
+		const bool joins_next = next != ranges.end() && range.first + range.count == next->first;
+		if (joins_previous && joins_next)
+		{
+			std::prev(next)->count += range.count + next->count;
+			ranges.erase(next);
+		}
+		else if (joins_previous)
+			std::prev(next)->count += range.count;
+		else if (joins_next)
+		{
+			next->first = range.first;
+			next->count += range.count;
+		}
+		else
+			ranges.insert(next, range);
+	}
+
+	void vk_geometry_pool::upload(const range_pool& pool, const geometry_range range, const void* data) const
+	{
+		const VkDeviceSize size = VkDeviceSize{pool.element_size} * range.count;
+		vk_buffer staging_buffer{
+			device,
+			pool.element_size,
+			range.count,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		};
+		staging_buffer.map();
+		staging_buffer.write_to_buffer(data);
+
+		device.copy_buffer(staging_buffer.get_buffer(), pool.buffer->get_buffer(), size, 0,
+		                   VkDeviceSize{pool.element_size} * range.first);
+	}
+
+	void vk_geometry_pool::read_back(const range_pool& pool, const geometry_range range, void* data) const
+	{
+		const VkDeviceSize size = VkDeviceSize{pool.element_size} * range.count;
+		vk_buffer staging_buffer{
+			device,
+			pool.element_size,
+			range.count,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		};
+		device.copy_buffer(pool.buffer->get_buffer(), staging_buffer.get_buffer(), size,
+		                   VkDeviceSize{pool.element_size} * range.first, 0);
+		staging_buffer.map();
+		std::memcpy(data, staging_buffer.get_mapped_memory(), static_cast<size_t>(size));
+	}
+
+	geometry_range vk_geometry_pool::add_vertices(const void* vertices, const uint32_t count)
+	{
+		VK_PROFILE_FUNCTION();
+		const geometry_range range = allocate(vertex_pool, count);
+		upload(vertex_pool, range, vertices);
+		return range;
+	}
+
+	geometry_range vk_geometry_pool::add_indices(const uint32_t* indices, const uint32_t count)
+	{
+		VK_PROFILE_FUNCTION();
+		const geometry_range range = allocate(index_pool, count);
+		upload(index_pool, range, indices);
+		return range;
+	}
+
+	void vk_geometry_pool::free_vertices(const geometry_range range)
+	{
+		// an upload to the range must not overwrite what frames in flight still draw
+		retired_resources.push(frame_count, [this, range]
+		{
+			release(vertex_pool, range);
+			vertex_pool.used -= range.count;
+		});
+	}
+
+	void vk_geometry_pool::free_indices(const geometry_range range)
+	{
+		retired_resources.push(frame_count, [this, range]
+		{
+			release(index_pool, range);
+			index_pool.used -= range.count;
+		});
+	}
+
+	void vk_geometry_pool::read_vertices(const geometry_range range, void* vertices) const
+	{
+		if (range.count > 0)
+			read_back(vertex_pool, range, vertices);
+	}
+
+	void vk_geometry_pool::read_indices(const geometry_range range, uint32_t* indices) const
+	{
+		if (range.count > 0)
+			read_back(index_pool, range, indices);
+	}
+
+	void vk_geometry_pool::begin_frame()
+	{
+		// frame n reuses the fence of frame n - MAX_FRAMES_IN_FLIGHT, which has just been waited on
+		frame_count++;
+		if (frame_count > vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+			retired_resources.collect(frame_count - vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	}
+
+	void vk_geometry_pool::bind(const VkCommandBuffer command_buffer) const
+	{
+		const VkBuffer buffers[] = {vertex_pool.buffer->get_buffer()};
+		constexpr VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(command_buffer, index_pool.buffer->get_buffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	geometry_pool_stats vk_geometry_pool::get_stats() const
+	{
+		return {
+			vertex_pool.buffer->get_instance_count(), vertex_pool.used,
+			index_pool.buffer->get_instance_count(), index_pool.used,
+			grow_count
+		};
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "vk_buffer.hpp"
+#include "vk_deletion_queue.hpp"
+#include "vk_device.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vk_engine
+{
+	struct geometry_pool_config
+	{
+		uint32_t vertex_capacity = 1 << 16; // to start with, both double when full
+		uint32_t index_capacity = 1 << 18;
+	};
+
+	// elements of one of the pool's buffers
+	struct geometry_range
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// of the pool's buffers, in elements
+	struct geometry_pool_stats
+	{
+		uint32_t vertex_capacity = 0;
+		uint32_t vertices_used = 0;
+		uint32_t index_capacity = 0;
+		uint32_t indices_used = 0;
+		uint32_t grow_count = 0;
+	};
+
+	// one device local vertex buffer and one index buffer that the meshes of every vk_model live in, so a frame
+	// binds them once and a draw only differs in its offsets (firstIndex and vertexOffset, what an indirect draw
+	// carries too). ranges are handed out first fit and merged with their neighbours when freed. indices stay
+	// relative to their mesh's first vertex
+	//
+	// adding or reading waits for the queue. a full buffer is replaced by one twice the size, with everything
+	// copied over, so the handles change: bind() again after adding. the old buffer and freed ranges are only let
+	// go of once the frames that may still read them are done, see begin_frame()
+	class vk_geometry_pool
+	{
+	public:
+		vk_geometry_pool(vk_device& device, uint32_t vertex_size, geometry_pool_config config = {});
+		~vk_geometry_pool();
+
+		vk_geometry_pool(const vk_geometry_pool&) = delete;
+		vk_geometry_pool& operator=(const vk_geometry_pool&) = delete;
+
+		geometry_range add_vertices(const void* vertices, uint32_t count);
+		geometry_range add_indices(const uint32_t* indices, uint32_t count);
+		// the range is handed out again once the frames in flight are done with it
+		void free_vertices(geometry_range range);
+		void free_indices(geometry_range range);
+
+		void read_vertices(geometry_range range, void* vertices) const;
+		void read_indices(geometry_range range, uint32_t* indices) const;
+
+		// from the renderers, once the fence of the frame's slot was waited on and the frame will be submitted
+		void begin_frame();
+
+		// vertex buffer 0 and a uint32 index buffer, both from offset 0
+		void bind(VkCommandBuffer command_buffer) const;
+
+		uint32_t get_vertex_size() const { return vertex_pool.element_size; }
+		geometry_pool_stats get_stats() const;
+
+	private:
+		struct range_pool
+		{
+			uint32_t element_size;
+			VkBufferUsageFlags usage;
+			std::unique_ptr<vk_buffer> buffer;
+			std::vector<geometry_range> free_ranges; // sorted by first, never adjacent
+			uint32_t used = 0;
+		};
+
+		void create_buffer(range_pool& pool, uint32_t capacity);
+		geometry_range allocate(range_pool& pool, uint32_t count);
+		void release(range_pool& pool, geometry_range range);
+		void upload(const range_pool& pool, geometry_range range, const void* data) const;
+		void read_back(const range_pool& pool, geometry_range range, void* data) const;
+
+		vk_device& device;
+		range_pool vertex_pool;
+		range_pool index_pool;
+		uint32_t grow_count = 0;
+
+		// outgrown buffers and freed ranges, keyed on frame_count. destroyed first, its flush still releases ranges
+		vk_deletion_queue retired_resources;
+		uint64_t frame_count = 0; // begun so far
+	};
+}
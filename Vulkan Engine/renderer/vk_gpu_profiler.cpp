@@ -0,0 +1,272 @@
+#include "vk_gpu_profiler.hpp"
+
+#include "vk_swapchain.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	namespace
+	{
+		constexpr VkQueryPipelineStatisticFlags statistic_flags =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		constexpr uint32_t statistic_count = 6;
+
+		VkQueryPool create_query_pool(const vk_device& device, const VkQueryType type, const uint32_t count,
+		                              const VkQueryPipelineStatisticFlags statistics = 0)
+		{
+			VkQueryPoolCreateInfo pool_info{};
+			pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			pool_info.queryType = type;
+			pool_info.queryCount = count;
+			pool_info.pipelineStatistics = statistics;
+
+			VkQueryPool pool;
+			if (vkCreateQueryPool(device.get_device(), &pool_info, nullptr, &pool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create query pool!");
+			return pool;
+		}
+	}
+
+	vk_gpu_profiler::vk_gpu_profiler(vk_device& device, const uint32_t max_scopes, const bool pipeline_statistics,
+	                                 const size_t history_size)
+		: device{device},
+		  max_scopes{max_scopes},
+		  enabled{device.timestamp_valid_bits != 0},
+		  statistics_enabled{pipeline_statistics && device.enabled_features.pipelineStatisticsQuery},
+		  history_size{history_size},
+		  timestamp_mask{device.timestamp_valid_bits >= 64 ? ~0ull : (1ull << device.timestamp_valid_bits) - 1}
+	{
+		if (!enabled)
+			return;
+
+		slots.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& slot : slots)
+		{
+			slot.timestamp_pool = create_query_pool(device, VK_QUERY_TYPE_TIMESTAMP, max_scopes * 2);
+			if (statistics_enabled)
+				slot.statistics_pool = create_query_pool(
+					device, VK_QUERY_TYPE_PIPELINE_STATISTICS, max_scopes, statistic_flags);
+		}
+	}
+
+	vk_gpu_profiler::~vk_gpu_profiler()
+	{
+		for (const auto& slot : slots)
+		{
+			vkDestroyQueryPool(device.get_device(), slot.timestamp_pool, nullptr);
+			if (slot.statistics_pool != VK_NULL_HANDLE)
+				vkDestroyQueryPool(device.get_device(), slot.statistics_pool, nullptr);
+		}
+	}
+
+	void vk_gpu_profiler::begin_frame(const VkCommandBuffer command_buffer, const int frame_index)
+	{
+		if (!enabled)
+			return;
+
+		// the renderer waited on this slot's fence, its last frame is complete
+		auto& slot = slots[frame_index];
+		if (slot.pending)
+			read_back(slot);
+
+		slot.scopes.clear();
+		slot.statistics_count = 0;
+		slot.frame_number = frame_count++;
+		slot.pending = false;
+		current = &slot;
+		open_scopes.clear();
+		statistics_active = false;
+
+		vkCmdResetQueryPool(command_buffer, slot.timestamp_pool, 0, max_scopes * 2);
+		if (statistics_enabled)
+			vkCmdResetQueryPool(command_buffer, slot.statistics_pool, 0, max_scopes);
+
+		frame_scope = begin_scope(command_buffer, "frame");
+	}
+
+	void vk_gpu_profiler::end_frame(const VkCommandBuffer command_buffer)
+	{
+		if (current == nullptr)
+			return;
+
+		end_scope(command_buffer, frame_scope);
+		assert(open_scopes.empty() && "GPU scope left open at the end of the frame");
+
+		current->pending = true;
+		current = nullptr;
+	}
+
+	uint32_t vk_gpu_profiler::begin_scope(const VkCommandBuffer command_buffer, const std::string& name)
+	{
+		if (current == nullptr || current->scopes.size() >= max_scopes)
+			return no_query;
+
+		const auto scope = static_cast<uint32_t>(current->scopes.size());
+		auto& record = current->scopes.emplace_back();
+		record.name = name;
+		record.depth = static_cast<uint32_t>(open_scopes.size());
+		record.statistics_query = no_query;
+
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current->timestamp_pool, scope * 2);
+
+		// statistics queries of one type can't nest, the frame scope is skipped so its children get them
+		if (statistics_enabled && !statistics_active && record.depth == 1)
+		{
+			record.statistics_query = current->statistics_count++;
+			vkCmdBeginQuery(command_buffer, current->statistics_pool, record.statistics_query, 0);
+			statistics_active = true;
+		}
+
+		open_scopes.push_back(scope);
+		return scope;
+	}
+
+	void vk_gpu_profiler::end_scope(const VkCommandBuffer command_buffer, const uint32_t scope)
+	{
+		if (current == nullptr || scope == no_query)
+			return;
+
+		assert(!open_scopes.empty() && open_scopes.back() == scope && "GPU scopes must be closed in reverse order");
+		open_scopes.pop_back();
+
+		const auto& record = current->scopes[scope];
+		if (record.statistics_query != no_query)
+		{
+			vkCmdEndQuery(command_buffer, current->statistics_pool, record.statistics_query);
+			statistics_active = false;
+		}
+
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current->timestamp_pool,
+		                    scope * 2 + 1);
+	}
+
+	void vk_gpu_profiler::read_back(frame_slot& slot)
+	{
+		slot.pending = false;
+		if (slot.scopes.empty())
+			return;
+
+		// value plus availability per query, no wait flag, the fence already covers the frame
+		const auto query_count = static_cast<uint32_t>(slot.scopes.size() * 2);
+		std::vector<uint64_t> timestamps(query_count * 2);
+		const VkResult result = vkGetQueryPoolResults(
+			device.get_device(), slot.timestamp_pool, 0, query_count,
+			timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+			return;
+
+		std::vector<uint64_t> statistics;
+		if (slot.statistics_count > 0)
+		{
+			statistics.resize(slot.statistics_count * (statistic_count + 1));
+			if (vkGetQueryPoolResults(
+				device.get_device(), slot.statistics_pool, 0, slot.statistics_count,
+				statistics.size() * sizeof(uint64_t), statistics.data(), (statistic_count + 1) * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != VK_SUCCESS)
+				statistics.clear();
+		}
+
+		gpu_frame_timings frame{};
+		frame.frame_number = slot.frame_number;
+		frame.scopes.reserve(slot.scopes.size());
+
+		const double ns_per_tick = device.properties.limits.timestampPeriod;
+		for (size_t i = 0; i < slot.scopes.size(); i++)
+		{
+			const uint64_t* begin = &timestamps[i * 4];
+			const uint64_t* end = &timestamps[i * 4 + 2];
+			if (begin[1] == 0 || end[1] == 0)
+				continue;
+
+			auto& timing = frame.scopes.emplace_back();
+			timing.name = slot.scopes[i].name;
+			timing.depth = slot.scopes[i].depth;
+			timing.milliseconds = static_cast<double>((end[0] - begin[0]) & timestamp_mask) * ns_per_tick / 1e6;
+
+			const uint32_t query = slot.scopes[i].statistics_query;
+			if (query != no_query && !statistics.empty() && statistics[query * (statistic_count + 1) + statistic_count])
+			{
+				const uint64_t* values = &statistics[query * (statistic_count + 1)];
+				timing.has_statistics = true;
+				timing.statistics = {values[0], values[1], values[2], values[3], values[4], values[5]};
+			}
+		}
+
+		last_frame = frame;
+		history.push_back(std::move(frame));
+		while (history.size() > history_size)
+			history.pop_front();
+	}
+
+	void vk_gpu_profiler::write_summary(std::ostream& out) const
+	{
+		struct scope_summary
+		{
+			uint32_t depth = 0;
+			uint32_t count = 0;
+			double total = 0.0;
+			double min = 0.0;
+			double max = 0.0;
+		};
+
+		// keyed by first appearance so the output keeps the frame's structure
+		std::vector<std::string> order;
+		std::map<std::string, scope_summary> summaries;
+		for (const auto& frame : history)
+		{
+			for (const auto& scope : frame.scopes)
+			{
+				auto [it, inserted] = summaries.try_emplace(scope.name);
+				auto& summary = it->second;
+				if (inserted)
+				{
+					order.push_back(scope.name);
+					summary.depth = scope.depth;
+					summary.min = scope.milliseconds;
+				}
+				summary.count++;
+				summary.total += scope.milliseconds;
+				summary.min = std::min(summary.min, scope.milliseconds);
+				summary.max = std::max(summary.max, scope.milliseconds);
+			}
+		}
+
+		out << "[GPU PROFILER]" << std::endl;
+		if (!enabled)
+		{
+			out << "	timestamps not supported" << std::endl;
+			return;
+		}
+		out << "	frames: " << history.size() << std::endl;
+		for (const auto& name : order)
+		{
+			const auto& summary = summaries.at(name);
+			out << "	" << std::string(summary.depth * 2, ' ') << name << ": " << std::fixed << std::setprecision(3)
+				<< summary.total / summary.count << " ms (min " << summary.min << ", max " << summary.max << ")"
+				<< std::defaultfloat << std::endl;
+		}
+
+		const auto& last = last_frame.scopes;
+		for (const auto& scope : last)
+		{
+			if (!scope.has_statistics)
+				continue;
+			const auto& stats = scope.statistics;
+			out << "	" << scope.name << " (last frame): " << stats.input_assembly_vertices << " vertices, "
+				<< stats.input_assembly_primitives << " primitives, " << stats.vertex_shader_invocations
+				<< " vs invocations, " << stats.clipping_invocations << " -> " << stats.clipping_primitives
+				<< " clipped primitives, " << stats.fragment_shader_invocations << " fs invocations" << std::endl;
+		}
+	}
+}
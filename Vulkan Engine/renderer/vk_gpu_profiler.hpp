@@ -0,0 +1,139 @@
+#pragma once
+
+#include "vk_device.hpp"
+
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+	// counters of the stages the engine uses, in VkQueryPipelineStatisticFlagBits order
+	struct gpu_pipeline_statistics
+	{
+		uint64_t input_assembly_vertices = 0;
+		uint64_t input_assembly_primitives = 0;
+		uint64_t vertex_shader_invocations = 0;
+		uint64_t clipping_invocations = 0;
+		uint64_t clipping_primitives = 0;
+		uint64_t fragment_shader_invocations = 0;
+	};
+
+	struct gpu_scope_timing
+	{
+		std::string name;
+		uint32_t depth = 0; // 0 is the whole frame
+		double milliseconds = 0.0;
+		bool has_statistics = false;
+		gpu_pipeline_statistics statistics{};
+	};
+
+	struct gpu_frame_timings
+	{
+		uint64_t frame_number = 0;
+		std::vector<gpu_scope_timing> scopes; // in the order they were opened
+	};
+
+	// timestamp queries around named scopes. results are read back when a frame slot comes around again, after
+	// its fence was waited on, so nothing ever stalls on the gpu and timings lag MAX_FRAMES_IN_FLIGHT frames.
+	//
+	// usage: begin_frame() right after the renderer's begin_frame, vk_gpu_scope objects around the work,
+	// end_frame() before the renderer's end_frame
+	class vk_gpu_profiler
+	{
+	public:
+		// pipeline statistics are skipped when the device lacks the feature
+		explicit vk_gpu_profiler(vk_device& device, uint32_t max_scopes = 64, bool pipeline_statistics = false,
+		                         size_t history_size = 240);
+		~vk_gpu_profiler();
+
+		vk_gpu_profiler(const vk_gpu_profiler&) = delete;
+		vk_gpu_profiler& operator=(const vk_gpu_profiler&) = delete;
+
+		// must be outside a render pass, the query pools are reset here
+		void begin_frame(VkCommandBuffer command_buffer, int frame_index);
+		void end_frame(VkCommandBuffer command_buffer);
+
+		// scopes nest, pipeline statistics can't and are only collected for the outermost scope inside the frame
+		uint32_t begin_scope(VkCommandBuffer command_buffer, const std::string& name);
+		void end_scope(VkCommandBuffer command_buffer, uint32_t scope);
+
+		bool is_enabled() const { return enabled; }
+		// most recent frame whose results came back, empty until the first one did
+		const gpu_frame_timings& get_last_frame() const { return last_frame; }
+		// gpu time of the whole last frame read back, negative until there is one
+		double get_last_frame_milliseconds() const
+		{
+			return last_frame.scopes.empty() ? -1.0 : last_frame.scopes.front().milliseconds;
+		}
+		const std::deque<gpu_frame_timings>& get_history() const { return history; }
+		// average, min and max of every scope over the history
+		void write_summary(std::ostream& out) const;
+
+	private:
+		static constexpr uint32_t no_query = ~0u;
+
+		struct scope_record
+		{
+			std::string name;
+			uint32_t depth;
+			uint32_t statistics_query;
+		};
+
+		struct frame_slot
+		{
+			VkQueryPool timestamp_pool{};
+			VkQueryPool statistics_pool{};
+			std::vector<scope_record> scopes;
+			uint32_t statistics_count = 0;
+			uint64_t frame_number = 0;
+			bool pending = false; // recorded and not read back yet
+		};
+
+		void read_back(frame_slot& slot);
+
+		vk_device& device;
+		uint32_t max_scopes;
+		bool enabled;
+		bool statistics_enabled;
+		size_t history_size;
+		uint64_t timestamp_mask;
+
+		std::vector<frame_slot> slots;
+		frame_slot* current = nullptr;
+		std::vector<uint32_t> open_scopes;
+		uint32_t frame_scope = no_query;
+		bool statistics_active = false;
+		uint64_t frame_count = 0;
+
+		gpu_frame_timings last_frame{};
+		std::deque<gpu_frame_timings> history;
+	};
+
+	class vk_gpu_scope
+	{
+	public:
+		// profiler may be null, the scope does nothing then
+		vk_gpu_scope(vk_gpu_profiler* profiler, VkCommandBuffer command_buffer, const std::string& name)
+			: profiler{profiler}, command_buffer{command_buffer}
+		{
+			if (profiler != nullptr)
+				scope = profiler->begin_scope(command_buffer, name);
+		}
+
+		~vk_gpu_scope()
+		{
+			if (profiler != nullptr)
+				profiler->end_scope(command_buffer, scope);
+		}
+
+		vk_gpu_scope(const vk_gpu_scope&) = delete;
+		vk_gpu_scope& operator=(const vk_gpu_scope&) = delete;
+
+	private:
+		vk_gpu_profiler* profiler;
+		VkCommandBuffer command_buffer;
+		uint32_t scope{};
+	};
+}
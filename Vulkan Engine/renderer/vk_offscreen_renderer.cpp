@@ -0,0 +1,471 @@
+#include "vk_offscreen_renderer.hpp"
+
+#include "vk_geometry_pool.hpp"
+#include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	vk_offscreen_renderer::vk_offscreen_renderer(vk_device& device, const VkExtent2D extent)
+		: device{device}, extent{extent}
+	{
+		assert(extent.width > 0 && extent.height > 0 && "Offscreen target must not be empty");
+
+		depth_format = device.find_supported_format(
+			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+		create_render_pass();
+		create_frame_targets();
+
+		std::cout
+			<< "[OFFSCREEN RENDERER]" << std::endl
+			<< "	target size: (h: " << extent.height << ", w: " << extent.width << ')' << std::endl;
+	}
+
+	vk_offscreen_renderer::~vk_offscreen_renderer()
+	{
+		for (const auto& target : frame_targets)
+			vkWaitForFences(device.get_device(), 1, &target.in_flight_fence, VK_TRUE,
+			                std::numeric_limits<uint64_t>::max());
+
+		// writes only touch host memory, but they must not outlive the process shutdown
+		for (auto& write : pending_writes)
+			write.wait();
+
+		for (auto& target : frame_targets)
+		{
+			vkDestroyFramebuffer(device.get_device(), target.framebuffer, nullptr);
+
+			vkDestroyImageView(device.get_device(), target.color_image_view, nullptr);
+			vkDestroyImage(device.get_device(), target.color_image, nullptr);
+			device.free_memory(target.color_image_memory);
+
+			vkDestroyImageView(device.get_device(), target.depth_image_view, nullptr);
+			vkDestroyImage(device.get_device(), target.depth_image, nullptr);
+			device.free_memory(target.depth_image_memory);
+
+			if (target.readback_buffer != VK_NULL_HANDLE)
+			{
+				vkDestroyBuffer(device.get_device(), target.readback_buffer, nullptr);
+				device.free_memory(target.readback_buffer_memory);
+			}
+
+			vkFreeCommandBuffers(device.get_device(), device.get_command_pool(), 1, &target.command_buffer);
+			vkDestroyFence(device.get_device(), target.in_flight_fence, nullptr);
+		}
+
+		vkDestroyRenderPass(device.get_device(), render_pass, nullptr);
+	}
+
+	VkCommandBuffer vk_offscreen_renderer::begin_frame()
+	{
+		VK_PROFILE_FUNCTION();
+		assert(!is_frame_started && "Cannot call begin_frame while already in progress.");
+		auto& target = frame_targets[current_frame_index];
+
+		// nothing to acquire, the only thing to wait on is the gpu finishing the last use of this slot
+		{
+			VK_PROFILE_SCOPE("wait_for_frame_fence");
+			vkWaitForFences(device.get_device(), 1, &target.in_flight_fence, VK_TRUE,
+			                std::numeric_limits<uint64_t>::max());
+		}
+		vkResetFences(device.get_device(), 1, &target.in_flight_fence);
+
+		if (target.readback_in_flight)
+			complete_readback(target);
+		collect_finished_writes();
+		device.get_geometry_pool().begin_frame();
+
+		is_frame_started = true;
+		VkCommandBufferBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(target.command_buffer, &begin_info) != VK_SUCCESS)
+			throw std::runtime_error("Failed to begin recording command buffer!");
+
+		return target.command_buffer;
+	}
+
+	void vk_offscreen_renderer::end_frame()
+	{
+		VK_PROFILE_FUNCTION();
+		assert(is_frame_started && "Cannot call end_frame while frame is not in progress.");
+		auto& target = frame_targets[current_frame_index];
+
+		if (target.readback_requested)
+		{
+			record_readback(target, target.command_buffer);
+			target.readback_requested = false;
+			target.readback_in_flight = true;
+		}
+
+		if (vkEndCommandBuffer(target.command_buffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record command buffer!");
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &target.command_buffer;
+
+		if (vkQueueSubmit(device.get_graphics_queue(), 1, &submit_info, target.in_flight_fence) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit draw command buffer!");
+
+		is_frame_started = false;
+		current_frame_index = (current_frame_index + 1) % vk_swapchain::MAX_FRAMES_IN_FLIGHT;
+	}
+
+	void vk_offscreen_renderer::begin_swap_chain_render_pass(const VkCommandBuffer command_buffer) const
+	{
+		assert(is_frame_started && "Cannot call begin_swap_chain_render_pass if frame is not in progress.");
+		assert(
+			command_buffer == get_current_command_buffer() &&
+			"Cannot begin render pass on command buffer from a different frame.");
+
+		VkRenderPassBeginInfo render_pass_begin_info{};
+		render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_begin_info.renderPass = render_pass;
+		render_pass_begin_info.framebuffer = frame_targets[current_frame_index].framebuffer;
+
+		render_pass_begin_info.renderArea.offset = {0, 0};
+		render_pass_begin_info.renderArea.extent = extent;
+
+		std::array<VkClearValue, 2> clear_values{};
+		clear_values[0].color = {{0.1f, 0.1f, 0.1f, 1.0f}};
+		clear_values[1].depthStencil = {1.0f, 0};
+		render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+		render_pass_begin_info.pClearValues = clear_values.data();
+
+		vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport;
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		const VkRect2D scissor{{0, 0}, extent};
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+	}
+
+	void vk_offscreen_renderer::end_swap_chain_render_pass(const VkCommandBuffer command_buffer) const
+	{
+		assert(is_frame_started && "Cannot call end_swap_chain_render_pass if frame is not in progress.");
+		assert(
+			command_buffer == get_current_command_buffer() &&
+			"Cannot end render pass on command buffer from a different frame.");
+
+		vkCmdEndRenderPass(command_buffer);
+	}
+
+	bool vk_offscreen_renderer::is_frame_in_progress() const
+	{
+		return is_frame_started;
+	}
+
+	int vk_offscreen_renderer::get_frame_index() const
+	{
+		assert(is_frame_started && "Cannot get frame index when frame is not in progress.");
+		return current_frame_index;
+	}
+
+	VkCommandBuffer vk_offscreen_renderer::get_current_command_buffer() const
+	{
+		assert(is_frame_started && "Cannot get command buffer when frame is not in progress.");
+		return frame_targets[current_frame_index].command_buffer;
+	}
+
+	float vk_offscreen_renderer::get_aspect_ratio() const
+	{
+		return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+	}
+
+	void vk_offscreen_renderer::request_readback(std::string path, const image_file_format format)
+	{
+		assert(is_frame_started && "Cannot request a readback when frame is not in progress.");
+		auto& target = frame_targets[current_frame_index];
+
+		target.readback_requested = true;
+		target.readback_path = std::move(path);
+		target.readback_format = format;
+	}
+
+	void vk_offscreen_renderer::wait_for_readbacks()
+	{
+		assert(!is_frame_started && "Cannot wait for readbacks while frame is in progress.");
+
+		for (auto& target : frame_targets)
+		{
+			if (!target.readback_in_flight)
+				continue;
+
+			vkWaitForFences(device.get_device(), 1, &target.in_flight_fence, VK_TRUE,
+			                std::numeric_limits<uint64_t>::max());
+			complete_readback(target);
+		}
+
+		for (auto& write : pending_writes)
+			write.get();
+		pending_writes.clear();
+	}
+
+	void vk_offscreen_renderer::create_render_pass()
+	{
+		VkAttachmentDescription depth_attachment{};
+		depth_attachment.format = depth_format;
+		depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depth_attachment_ref;
+		depth_attachment_ref.attachment = 1;
+		depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// the color target ends up ready to be copied out, there is no present
+		VkAttachmentDescription color_attachment = {};
+		color_attachment.format = color_format;
+		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentReference color_attachment_ref;
+		color_attachment_ref.attachment = 0;
+		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_attachment_ref;
+		subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// makes the color writes visible to a readback copy recorded after the pass
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		const std::array<VkAttachmentDescription, 2> attachments = {color_attachment, depth_attachment};
+		VkRenderPassCreateInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		render_pass_info.pAttachments = attachments.data();
+		render_pass_info.subpassCount = 1;
+		render_pass_info.pSubpasses = &subpass;
+		render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		render_pass_info.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(device.get_device(), &render_pass_info, nullptr, &render_pass) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create offscreen render pass!");
+	}
+
+	void vk_offscreen_renderer::create_frame_targets()
+	{
+		frame_targets.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+
+		for (auto& target : frame_targets)
+		{
+			VkImageCreateInfo image_info{};
+			image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_info.imageType = VK_IMAGE_TYPE_2D;
+			image_info.extent.width = extent.width;
+			image_info.extent.height = extent.height;
+			image_info.extent.depth = 1;
+			image_info.mipLevels = 1;
+			image_info.arrayLayers = 1;
+			image_info.format = color_format;
+			image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+			image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			device.create_image_with_info(
+				image_info,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				target.color_image,
+				target.color_image_memory);
+
+			image_info.format = depth_format;
+			image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+			device.create_image_with_info(
+				image_info,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				target.depth_image,
+				target.depth_image_memory);
+
+			VkImageViewCreateInfo view_info{};
+			view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_info.image = target.color_image;
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = color_format;
+			view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			view_info.subresourceRange.baseMipLevel = 0;
+			view_info.subresourceRange.levelCount = 1;
+			view_info.subresourceRange.baseArrayLayer = 0;
+			view_info.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(device.get_device(), &view_info, nullptr, &target.color_image_view) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create offscreen color image view!");
+
+			view_info.image = target.depth_image;
+			view_info.format = depth_format;
+			view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+			if (vkCreateImageView(device.get_device(), &view_info, nullptr, &target.depth_image_view) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create offscreen depth image view!");
+
+			const std::array<VkImageView, 2> attachments = {target.color_image_view, target.depth_image_view};
+			VkFramebufferCreateInfo framebuffer_info = {};
+			framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_info.renderPass = render_pass;
+			framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebuffer_info.pAttachments = attachments.data();
+			framebuffer_info.width = extent.width;
+			framebuffer_info.height = extent.height;
+			framebuffer_info.layers = 1;
+
+			if (vkCreateFramebuffer(device.get_device(), &framebuffer_info, nullptr, &target.framebuffer) !=
+				VK_SUCCESS)
+				throw std::runtime_error("Failed to create offscreen framebuffer!");
+
+			VkCommandBufferAllocateInfo allocate_info{};
+			allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandPool = device.get_command_pool();
+			allocate_info.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device.get_device(), &allocate_info, &target.command_buffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate command buffers!");
+
+			VkFenceCreateInfo fence_info = {};
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			if (vkCreateFence(device.get_device(), &fence_info, nullptr, &target.in_flight_fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create synchronization objects for a frame!");
+		}
+	}
+
+	void vk_offscreen_renderer::create_readback_buffer(frame_target& target) const
+	{
+		device.create_buffer(
+			static_cast<VkDeviceSize>(extent.width) * extent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			target.readback_buffer,
+			target.readback_buffer_memory);
+	}
+
+	void vk_offscreen_renderer::record_readback(frame_target& target, const VkCommandBuffer command_buffer) const
+	{
+		if (target.readback_buffer == VK_NULL_HANDLE)
+			create_readback_buffer(target);
+
+		// the render pass already left the image in transfer src layout
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {extent.width, extent.height, 1};
+
+		vkCmdCopyImageToBuffer(
+			command_buffer,
+			target.color_image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			target.readback_buffer,
+			1,
+			&region);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = target.readback_buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			0, nullptr,
+			1, &barrier,
+			0, nullptr);
+	}
+
+	void vk_offscreen_renderer::complete_readback(frame_target& target)
+	{
+		// the fence of this slot has been waited on, so the copy has landed in the host buffer
+		std::vector<uint8_t> pixels(static_cast<size_t>(extent.width) * extent.height * 4);
+
+		void* mapped = nullptr;
+		vkMapMemory(device.get_device(), target.readback_buffer_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		std::memcpy(pixels.data(), mapped, pixels.size());
+		vkUnmapMemory(device.get_device(), target.readback_buffer_memory);
+
+		target.readback_in_flight = false;
+
+		pending_writes.push_back(std::async(
+			std::launch::async,
+			[path = std::move(target.readback_path), format = target.readback_format, extent = extent,
+				pixels = std::move(pixels)]
+			{
+				write_image(path, format, extent.width, extent.height, pixels);
+			}));
+	}
+
+	void vk_offscreen_renderer::collect_finished_writes()
+	{
+		for (auto it = pending_writes.begin(); it != pending_writes.end();)
+		{
+			if (it->wait_for(std::chrono::seconds{0}) == std::future_status::ready)
+			{
+				it->get(); // rethrows io errors from the worker
+				it = pending_writes.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+}
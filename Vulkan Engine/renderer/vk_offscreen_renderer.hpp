@@ -0,0 +1,82 @@
+#pragma once
+
+#include "vk_device.hpp"
+#include "../engine/vk_image_writer.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+	// renders into a ring of offscreen color/depth targets instead of a swap chain, nothing is ever presented.
+	// mirrors the vk_renderer frame api so render systems and app loops can use either one.
+	class vk_offscreen_renderer
+	{
+	public:
+		static constexpr VkFormat color_format = VK_FORMAT_R8G8B8A8_SRGB;
+
+		vk_offscreen_renderer(vk_device& device, VkExtent2D extent);
+		~vk_offscreen_renderer();
+
+		vk_offscreen_renderer(const vk_offscreen_renderer&) = delete;
+		vk_offscreen_renderer& operator=(const vk_offscreen_renderer&) = delete;
+
+		VkCommandBuffer begin_frame();
+		void end_frame();
+		void begin_swap_chain_render_pass(VkCommandBuffer command_buffer) const;
+		void end_swap_chain_render_pass(VkCommandBuffer command_buffer) const;
+		bool is_frame_in_progress() const;
+		int get_frame_index() const;
+		VkCommandBuffer get_current_command_buffer() const;
+		VkRenderPass get_swap_chain_render_pass() const { return render_pass; }
+		float get_aspect_ratio() const;
+		VkExtent2D get_swap_chain_extent() const { return extent; }
+
+		// copies the color target of the frame being recorded into a host buffer, the file is written on a
+		// worker thread once the gpu has finished that frame, so the frame loop never waits on it
+		void request_readback(std::string path, image_file_format format = image_file_format::png);
+		// blocks until the gpu is idle and every requested readback is on disk
+		void wait_for_readbacks();
+
+	private:
+		struct frame_target
+		{
+			VkImage color_image{};
+			VkDeviceMemory color_image_memory{};
+			VkImageView color_image_view{};
+			VkImage depth_image{};
+			VkDeviceMemory depth_image_memory{};
+			VkImageView depth_image_view{};
+			VkFramebuffer framebuffer{};
+			VkCommandBuffer command_buffer{};
+			VkFence in_flight_fence{};
+
+			// created on the first readback request for this slot
+			VkBuffer readback_buffer{};
+			VkDeviceMemory readback_buffer_memory{};
+			bool readback_requested{false};
+			bool readback_in_flight{false};
+			std::string readback_path;
+			image_file_format readback_format{image_file_format::png};
+		};
+
+		void create_render_pass();
+		void create_frame_targets();
+		void create_readback_buffer(frame_target& target) const;
+		void record_readback(frame_target& target, VkCommandBuffer command_buffer) const;
+		void complete_readback(frame_target& target);
+		void collect_finished_writes();
+
+		vk_device& device;
+		VkExtent2D extent;
+		VkFormat depth_format{};
+
+		VkRenderPass render_pass{};
+		std::vector<frame_target> frame_targets;
+		std::vector<std::future<void>> pending_writes;
+
+		int current_frame_index{};
+		bool is_frame_started{false};
+	};
+}
@@ -0,0 +1,1266 @@
+#include "vk_render_graph.hpp"
+
+#include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <queue>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	namespace
+	{
+		constexpr VkAccessFlags write_access_mask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_SHADER_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT |
+			VK_ACCESS_HOST_WRITE_BIT |
+			VK_ACCESS_MEMORY_WRITE_BIT;
+
+		// swap chain images rotate, a framebuffer has to sit idle this long before it is dropped
+		constexpr uint64_t framebuffer_idle_frames = 4 * vk_swapchain::MAX_FRAMES_IN_FLIGHT;
+
+		VkAttachmentLoadOp to_vk_load_op(const attachment_load_op load)
+		{
+			switch (load)
+			{
+			case attachment_load_op::clear:
+				return VK_ATTACHMENT_LOAD_OP_CLEAR;
+			case attachment_load_op::load:
+				return VK_ATTACHMENT_LOAD_OP_LOAD;
+			case attachment_load_op::dont_care:
+				break;
+			}
+			return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		}
+	}
+
+	// pass builder
+
+	void vk_render_graph::pass_builder::write_color(const render_graph_resource resource,
+	                                                const attachment_load_op load,
+	                                                const VkClearColorValue clear_value)
+	{
+		VkClearValue clear{};
+		clear.color = clear_value;
+		if (const auto existing = graph.find_attachment(pass, resource.index))
+			existing->final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		else
+			graph.passes[pass].color_attachments.push_back({
+				resource.index, load, clear, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			});
+		graph.current_subpass(pass).color_attachments.push_back(resource.index);
+
+		const bool loads = load == attachment_load_op::load;
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (loads ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0u),
+			                 loads,
+			                 true
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	}
+
+	void vk_render_graph::pass_builder::write_depth(const render_graph_resource resource,
+	                                                const attachment_load_op load,
+	                                                const VkClearDepthStencilValue clear_value)
+	{
+		auto& depth_attachment = graph.passes[pass].depth_attachment;
+		assert((depth_attachment.empty() || depth_attachment[0].resource == resource.index) &&
+			"A pass can only have one depth attachment");
+
+		VkClearValue clear{};
+		clear.depthStencil = clear_value;
+		if (depth_attachment.empty())
+			depth_attachment.push_back({
+				resource.index, load, clear, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			});
+		else
+			depth_attachment[0].final_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		graph.current_subpass(pass).depth_attachment = resource.index;
+		graph.current_subpass(pass).depth_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+			                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			                 load == attachment_load_op::load,
+			                 true
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	}
+
+	void vk_render_graph::pass_builder::read_depth(const render_graph_resource resource)
+	{
+		auto& depth_attachment = graph.passes[pass].depth_attachment;
+		assert((depth_attachment.empty() || depth_attachment[0].resource == resource.index) &&
+			"A pass can only have one depth attachment");
+
+		if (depth_attachment.empty())
+			depth_attachment.push_back({
+				resource.index, attachment_load_op::load, {}, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			});
+		else
+			depth_attachment[0].final_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		graph.current_subpass(pass).depth_attachment = resource.index;
+		graph.current_subpass(pass).depth_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			                 true,
+			                 false
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	}
+
+	void vk_render_graph::pass_builder::read_texture(const render_graph_resource resource,
+	                                                 const VkPipelineStageFlags stages)
+	{
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			                 stages,
+			                 VK_ACCESS_SHADER_READ_BIT,
+			                 true,
+			                 false
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+
+	void vk_render_graph::pass_builder::read_transfer(const render_graph_resource resource)
+	{
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                 VK_ACCESS_TRANSFER_READ_BIT,
+			                 true,
+			                 false
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	void vk_render_graph::pass_builder::write_transfer(const render_graph_resource resource)
+	{
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                 VK_ACCESS_TRANSFER_WRITE_BIT,
+			                 false,
+			                 true
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	void vk_render_graph::pass_builder::read_buffer(const render_graph_resource resource,
+	                                                const VkPipelineStageFlags stages)
+	{
+		assert(graph.resources[resource.index].is_buffer && "Only buffers are read as buffers");
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_UNDEFINED,
+			                 stages,
+			                 VK_ACCESS_SHADER_READ_BIT,
+			                 true,
+			                 false
+		                 });
+	}
+
+	void vk_render_graph::pass_builder::write_buffer(const render_graph_resource resource,
+	                                                 const VkPipelineStageFlags stages)
+	{
+		assert(graph.resources[resource.index].is_buffer && "Only buffers are written as buffers");
+		graph.add_access(pass, {
+			                 resource.index,
+			                 VK_IMAGE_LAYOUT_UNDEFINED,
+			                 stages,
+			                 VK_ACCESS_SHADER_WRITE_BIT,
+			                 false,
+			                 true
+		                 });
+	}
+
+	void vk_render_graph::pass_builder::set_side_effects()
+	{
+		graph.passes[pass].side_effects = true;
+	}
+
+	void vk_render_graph::pass_builder::next_subpass()
+	{
+		graph.passes[pass].subpasses.emplace_back();
+	}
+
+	void vk_render_graph::pass_builder::read_input(const render_graph_resource resource)
+	{
+		const auto existing = graph.find_attachment(pass, resource.index);
+		assert(existing != nullptr && graph.passes[pass].subpasses.size() > 1 &&
+			"Input attachments are attachments of an earlier subpass of the same pass");
+
+		const bool depth = !graph.passes[pass].depth_attachment.empty() &&
+			existing == &graph.passes[pass].depth_attachment[0];
+		const VkImageLayout layout = depth
+			                             ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			                             : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		existing->final_layout = layout;
+		graph.current_subpass(pass).input_attachments.emplace_back(resource.index, layout);
+
+		graph.add_access(pass, {
+			                 resource.index,
+			                 layout,
+			                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			                 VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+			                 true,
+			                 false
+		                 });
+		graph.resources[resource.index].usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+	}
+
+	// graph
+
+	vk_render_graph::vk_render_graph(vk_device& device) : device{device}
+	{
+	}
+
+	vk_render_graph::~vk_render_graph()
+	{
+		// the owner waits for the device to be idle before tearing the graph down
+		retired_resources.flush();
+
+		for (const auto& [key, entry] : framebuffers)
+			vkDestroyFramebuffer(device.get_device(), entry.framebuffer, nullptr);
+
+		for (const auto& resource : resources)
+		{
+			if (resource.imported)
+				continue;
+			vkDestroyImageView(device.get_device(), resource.view, nullptr);
+			vkDestroyImage(device.get_device(), resource.image, nullptr);
+		}
+
+		for (const auto& block : memory_blocks)
+			device.free_memory(block.memory);
+
+		for (const auto& pass : passes)
+			vkDestroyRenderPass(device.get_device(), pass.render_pass, nullptr);
+	}
+
+	render_graph_resource vk_render_graph::create_image(std::string name, const render_graph_image_info& info)
+	{
+		assert(!compiled && "Cannot add images to a compiled render graph");
+
+		resource_node resource{};
+		resource.name = std::move(name);
+		resource.image_info = info;
+		resource.usage = info.extra_usage;
+		resources.push_back(std::move(resource));
+
+		return {static_cast<uint32_t>(resources.size() - 1)};
+	}
+
+	render_graph_resource vk_render_graph::import_image(std::string name, const render_graph_import_info& info)
+	{
+		assert(!compiled && "Cannot add images to a compiled render graph");
+
+		resource_node resource{};
+		resource.name = std::move(name);
+		resource.imported = true;
+		resource.import_info = info;
+		resources.push_back(std::move(resource));
+
+		return {static_cast<uint32_t>(resources.size() - 1)};
+	}
+
+	render_graph_resource vk_render_graph::import_buffer(std::string name)
+	{
+		assert(!compiled && "Cannot add buffers to a compiled render graph");
+
+		resource_node resource{};
+		resource.name = std::move(name);
+		resource.imported = true;
+		resource.is_buffer = true;
+		resources.push_back(std::move(resource));
+
+		return {static_cast<uint32_t>(resources.size() - 1)};
+	}
+
+	render_graph_pass vk_render_graph::add_pass(std::string name, const std::function<void(pass_builder&)>& setup)
+	{
+		assert(!compiled && "Cannot add passes to a compiled render graph");
+
+		pass_node pass{};
+		pass.name = std::move(name);
+		passes.push_back(std::move(pass));
+
+		const auto index = static_cast<uint32_t>(passes.size() - 1);
+		pass_builder builder{*this, index};
+		setup(builder);
+
+		return {index};
+	}
+
+	void vk_render_graph::set_record(const render_graph_pass pass, record_fn record)
+	{
+		set_record(pass, 0, std::move(record));
+	}
+
+	void vk_render_graph::set_record(const render_graph_pass pass, const uint32_t subpass, record_fn record)
+	{
+		assert(pass.index < passes.size() && "Invalid render graph pass");
+		assert(subpass < passes[pass.index].subpasses.size() && "Invalid render graph subpass");
+		passes[pass.index].subpasses[subpass].record = std::move(record);
+	}
+
+	void vk_render_graph::set_render_area(const render_graph_pass pass, const VkExtent2D area)
+	{
+		set_render_area(pass, VkRect2D{{0, 0}, area});
+	}
+
+	void vk_render_graph::set_render_area(const render_graph_pass pass, const VkRect2D& area)
+	{
+		assert(pass.index < passes.size() && "Invalid render graph pass");
+		assert(area.offset.x >= 0 && area.offset.y >= 0 && "Render area must lie inside the attachments");
+		passes[pass.index].render_area = area;
+	}
+
+	void vk_render_graph::set_pass_enabled(const render_graph_pass pass, const bool enabled)
+	{
+		assert(pass.index < passes.size() && "Invalid render graph pass");
+		passes[pass.index].enabled = enabled;
+	}
+
+	void vk_render_graph::add_access(const uint32_t pass, const resource_access& access)
+	{
+		assert(access.resource < resources.size() && "Invalid render graph resource");
+
+		auto& accesses = passes[pass].accesses;
+		const auto existing = std::find_if(accesses.begin(), accesses.end(), [&](const resource_access& other)
+		{
+			return other.resource == access.resource;
+		});
+		if (existing == accesses.end())
+		{
+			accesses.push_back(access);
+			return;
+		}
+
+		// subpasses share one access: transitioned to the first layout before the pass, left in the last one.
+		// it only reads what was there before if the first use does
+		assert(passes[pass].subpasses.size() > 1 && "A pass can only access a resource once");
+		existing->reads = existing->reads || (access.reads && !existing->writes);
+		existing->writes = existing->writes || access.writes;
+		existing->stages |= access.stages;
+		existing->access |= access.access;
+		existing->final_layout = access.layout;
+	}
+
+	vk_render_graph::attachment* vk_render_graph::find_attachment(const uint32_t pass, const uint32_t resource)
+	{
+		for (auto& a : passes[pass].color_attachments)
+			if (a.resource == resource)
+				return &a;
+		for (auto& a : passes[pass].depth_attachment)
+			if (a.resource == resource)
+				return &a;
+		return nullptr;
+	}
+
+	void vk_render_graph::compile()
+	{
+		assert(!compiled && "Render graph is already compiled");
+
+		const auto dependencies = build_dependencies();
+		cull_passes(dependencies);
+		sort_passes(dependencies);
+		compute_lifetimes();
+
+		for (uint32_t position = 0; position < execution_order.size(); position++)
+		{
+			auto& pass = passes[execution_order[position]];
+			if (!pass.color_attachments.empty() || !pass.depth_attachment.empty())
+				create_render_pass(position, pass);
+		}
+
+		stats.pass_count = static_cast<uint32_t>(passes.size());
+		stats.culled_pass_count = static_cast<uint32_t>(passes.size() - execution_order.size());
+		compiled = true;
+	}
+
+	std::vector<std::vector<uint32_t>> vk_render_graph::build_dependencies() const
+	{
+		std::vector<std::vector<uint32_t>> dependencies(passes.size());
+
+		const auto depend = [&](const uint32_t pass, const uint32_t on)
+		{
+			auto& list = dependencies[pass];
+			if (pass != on && std::find(list.begin(), list.end(), on) == list.end())
+				list.push_back(on);
+		};
+
+		for (uint32_t resource = 0; resource < resources.size(); resource++)
+		{
+			// passes touching this resource, in declaration order
+			std::vector<std::pair<uint32_t, const resource_access*>> users;
+			for (uint32_t pass = 0; pass < passes.size(); pass++)
+				for (const auto& access : passes[pass].accesses)
+					if (access.resource == resource)
+						users.emplace_back(pass, &access);
+
+			for (size_t i = 0; i < users.size(); i++)
+			{
+				const auto [pass, access] = users[i];
+
+				// a reader depends on the writers declared before it, if there are none the producer was simply
+				// declared later and every writer has to run first
+				const auto earlier_writer = std::find_if(users.begin(), users.begin() + i,
+				                                         [](const auto& user) { return user.second->writes; });
+				const bool reads_declared_later_writes = access->reads && earlier_writer == users.begin() + i;
+
+				for (size_t j = 0; j < users.size(); j++)
+				{
+					if (i == j)
+						continue;
+					const auto [other_pass, other_access] = users[j];
+
+					if (access->reads && other_access->writes && (j < i || reads_declared_later_writes))
+						depend(pass, other_pass);
+					else if (access->writes && j < i)
+					{
+						// write after read or write, unless the earlier reader is waiting on this very write
+						const auto other_earlier_writer = std::find_if(
+							users.begin(), users.begin() + j, [](const auto& user) { return user.second->writes; });
+						const bool other_consumes_this = other_access->reads && !other_access->writes &&
+							other_earlier_writer == users.begin() + j;
+						if (!other_consumes_this)
+							depend(pass, other_pass);
+					}
+				}
+			}
+		}
+
+		return dependencies;
+	}
+
+	void vk_render_graph::cull_passes(const std::vector<std::vector<uint32_t>>& dependencies)
+	{
+		// anything that writes outside the graph is a root, everything they transitively depend on survives
+		std::vector<uint32_t> stack;
+		for (uint32_t pass = 0; pass < passes.size(); pass++)
+		{
+			passes[pass].culled = true;
+
+			const bool writes_import = std::any_of(
+				passes[pass].accesses.begin(), passes[pass].accesses.end(),
+				[&](const resource_access& access) { return access.writes && resources[access.resource].imported; });
+			if (passes[pass].side_effects || writes_import)
+				stack.push_back(pass);
+		}
+
+		while (!stack.empty())
+		{
+			const uint32_t pass = stack.back();
+			stack.pop_back();
+			if (!passes[pass].culled)
+				continue;
+
+			passes[pass].culled = false;
+			for (const uint32_t dependency : dependencies[pass])
+				stack.push_back(dependency);
+		}
+	}
+
+	void vk_render_graph::sort_passes(const std::vector<std::vector<uint32_t>>& dependencies)
+	{
+		// kahn's algorithm, ties are broken by declaration order so the result is stable
+		std::vector<uint32_t> remaining(passes.size(), 0);
+		std::vector<std::vector<uint32_t>> dependents(passes.size());
+		for (uint32_t pass = 0; pass < passes.size(); pass++)
+		{
+			if (passes[pass].culled)
+				continue;
+			for (const uint32_t dependency : dependencies[pass])
+			{
+				remaining[pass]++;
+				dependents[dependency].push_back(pass);
+			}
+		}
+
+		std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> ready;
+		for (uint32_t pass = 0; pass < passes.size(); pass++)
+			if (!passes[pass].culled && remaining[pass] == 0)
+				ready.push(pass);
+
+		execution_order.clear();
+		while (!ready.empty())
+		{
+			const uint32_t pass = ready.top();
+			ready.pop();
+			execution_order.push_back(pass);
+
+			for (const uint32_t dependent : dependents[pass])
+				if (--remaining[dependent] == 0)
+					ready.push(dependent);
+		}
+
+		const auto live_count = std::count_if(passes.begin(), passes.end(),
+		                                      [](const pass_node& pass) { return !pass.culled; });
+		if (execution_order.size() != static_cast<size_t>(live_count))
+			throw std::runtime_error("Render graph has a dependency cycle!");
+	}
+
+	void vk_render_graph::compute_lifetimes()
+	{
+		for (uint32_t position = 0; position < execution_order.size(); position++)
+		{
+			for (const auto& access : passes[execution_order[position]].accesses)
+			{
+				auto& resource = resources[access.resource];
+				resource.first_use = std::min(resource.first_use, position);
+				resource.last_use = std::max(resource.last_use, position);
+			}
+		}
+
+		for (const auto& resource : resources)
+		{
+			if (resource.imported || resource.first_use == ~0u)
+				continue;
+
+			// the first access of a transient sees undefined contents, reading it there is a bug in the setup
+			const auto& first = passes[execution_order[resource.first_use]];
+			const auto access = std::find_if(first.accesses.begin(), first.accesses.end(),
+			                                 [&](const resource_access& a) { return &resources[a.resource] == &resource; });
+			if (access->reads)
+				throw std::runtime_error("Render graph image '" + resource.name + "' is read before it is written!");
+		}
+	}
+
+	void vk_render_graph::create_render_pass(const uint32_t position, pass_node& pass) const
+	{
+		std::vector<VkAttachmentDescription> attachments;
+
+		const auto describe = [&](const attachment& a)
+		{
+			const auto& resource = resources[a.resource];
+
+			// contents only need to survive the pass if something later (or outside the graph) looks at them
+			const bool keep = resource.imported || resource.last_use > position;
+
+			VkAttachmentDescription description{};
+			description.format = resource.imported ? resource.import_info.format : resource.image_info.format;
+			description.samples = VK_SAMPLE_COUNT_1_BIT;
+			description.loadOp = to_vk_load_op(a.load);
+			description.storeOp = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			// the graph transitions images with barriers before the pass, the render pass itself only changes
+			// layouts between subpasses
+			description.initialLayout = a.layout;
+			description.finalLayout = a.final_layout;
+			attachments.push_back(description);
+		};
+
+		for (const auto& a : pass.color_attachments)
+			describe(a);
+		for (const auto& a : pass.depth_attachment)
+			describe(a);
+
+		// framebuffer order, colors first
+		const auto attachment_index = [&](const uint32_t resource)
+		{
+			for (uint32_t i = 0; i < pass.color_attachments.size(); i++)
+				if (pass.color_attachments[i].resource == resource)
+					return i;
+			return static_cast<uint32_t>(pass.color_attachments.size());
+		};
+
+		const auto subpass_count = static_cast<uint32_t>(pass.subpasses.size());
+		std::vector<std::vector<VkAttachmentReference>> color_refs(subpass_count);
+		std::vector<std::vector<VkAttachmentReference>> input_refs(subpass_count);
+		std::vector<VkAttachmentReference> depth_refs(subpass_count);
+		std::vector<std::vector<uint32_t>> preserved(subpass_count);
+		std::vector<std::vector<bool>> uses(subpass_count, std::vector<bool>(attachments.size(), false));
+
+		for (uint32_t s = 0; s < subpass_count; s++)
+		{
+			const auto& subpass = pass.subpasses[s];
+			for (const uint32_t resource : subpass.color_attachments)
+			{
+				color_refs[s].push_back({attachment_index(resource), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+				uses[s][color_refs[s].back().attachment] = true;
+			}
+			for (const auto& [resource, layout] : subpass.input_attachments)
+			{
+				input_refs[s].push_back({attachment_index(resource), layout});
+				uses[s][input_refs[s].back().attachment] = true;
+			}
+			if (subpass.depth_attachment != ~0u)
+			{
+				depth_refs[s] = {attachment_index(subpass.depth_attachment), subpass.depth_layout};
+				uses[s][depth_refs[s].attachment] = true;
+			}
+		}
+
+		// an attachment a subpass skips but an earlier and a later one use has to survive it
+		for (uint32_t i = 0; i < attachments.size(); i++)
+		{
+			uint32_t first = subpass_count;
+			uint32_t last = 0;
+			for (uint32_t s = 0; s < subpass_count; s++)
+			{
+				if (!uses[s][i])
+					continue;
+				first = std::min(first, s);
+				last = s;
+			}
+			for (uint32_t s = first + 1; s < last; s++)
+				if (!uses[s][i])
+					preserved[s].push_back(i);
+		}
+
+		std::vector<VkSubpassDescription> subpasses(subpass_count);
+		for (uint32_t s = 0; s < subpass_count; s++)
+		{
+			auto& subpass = subpasses[s];
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(color_refs[s].size());
+			subpass.pColorAttachments = color_refs[s].data();
+			subpass.inputAttachmentCount = static_cast<uint32_t>(input_refs[s].size());
+			subpass.pInputAttachments = input_refs[s].data();
+			subpass.pDepthStencilAttachment = pass.subpasses[s].depth_attachment == ~0u ? nullptr : &depth_refs[s];
+			subpass.preserveAttachmentCount = static_cast<uint32_t>(preserved[s].size());
+			subpass.pPreserveAttachments = preserved[s].data();
+		}
+
+		// every subpass waits for the attachment writes of the one before, per region so tilers stay on chip
+		std::vector<VkSubpassDependency> dependencies;
+		for (uint32_t s = 1; s < subpass_count; s++)
+		{
+			VkSubpassDependency dependency{};
+			dependency.srcSubpass = s - 1;
+			dependency.dstSubpass = s;
+			dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+				VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies.push_back(dependency);
+		}
+
+		VkRenderPassCreateInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		render_pass_info.pAttachments = attachments.data();
+		render_pass_info.subpassCount = subpass_count;
+		render_pass_info.pSubpasses = subpasses.data();
+		render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		render_pass_info.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(device.get_device(), &render_pass_info, nullptr, &pass.render_pass) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create render pass for render graph pass '" + pass.name + "'!");
+	}
+
+	void vk_render_graph::set_extent(const VkExtent2D new_extent)
+	{
+		assert(compiled && "Render graph must be compiled before setting its extent");
+		assert(new_extent.width > 0 && new_extent.height > 0 && "Render graph extent must not be empty");
+
+		if (new_extent.width == extent.width && new_extent.height == extent.height)
+			return;
+
+		retire_transient_images();
+		extent = new_extent;
+		create_transient_images();
+	}
+
+	void vk_render_graph::create_transient_images()
+	{
+		std::vector<uint32_t> transients;
+		for (uint32_t i = 0; i < resources.size(); i++)
+			if (!resources[i].imported && resources[i].first_use != ~0u)
+				transients.push_back(i);
+
+		std::sort(transients.begin(), transients.end(),
+		          [&](const uint32_t a, const uint32_t b) { return resources[a].first_use < resources[b].first_use; });
+
+		stats.transient_image_count = static_cast<uint32_t>(transients.size());
+		stats.lazy_image_count = 0;
+		stats.transient_memory = 0;
+		stats.transient_memory_unaliased = 0;
+
+		constexpr VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+		std::vector<VkMemoryRequirements> requirements(resources.size());
+		std::vector<bool> lazy(resources.size(), false);
+		for (const uint32_t index : transients)
+		{
+			auto& resource = resources[index];
+			resource.extent = {
+				std::max(1u, static_cast<uint32_t>(std::lround(extent.width * resource.image_info.extent_scale))),
+				std::max(1u, static_cast<uint32_t>(std::lround(extent.height * resource.image_info.extent_scale)))
+			};
+
+			VkImageCreateInfo image_info{};
+			image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_info.imageType = VK_IMAGE_TYPE_2D;
+			image_info.extent.width = resource.extent.width;
+			image_info.extent.height = resource.extent.height;
+			image_info.extent.depth = 1;
+			image_info.mipLevels = 1;
+			image_info.arrayLayers = 1;
+			image_info.format = resource.image_info.format;
+			image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			image_info.usage = resource.usage;
+			// an attachment of a single pass is never stored, on tilers it need not exist outside tile memory
+			const bool transient_attachment = resource.first_use == resource.last_use &&
+				(resource.usage & ~attachment_usage) == 0;
+			if (transient_attachment)
+				image_info.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+			image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateImage(device.get_device(), &image_info, nullptr, &resource.image) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create render graph image '" + resource.name + "'!");
+
+			vkGetImageMemoryRequirements(device.get_device(), resource.image, &requirements[index]);
+			stats.transient_memory_unaliased += requirements[index].size;
+
+			lazy[index] = transient_attachment && device.has_memory_type(requirements[index].memoryTypeBits,
+			                                                            VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+			if (lazy[index])
+				stats.lazy_image_count++;
+		}
+
+		// greedy interval packing: every image goes into the best fitting block that is free by its first use.
+		// all images in a block sit at offset 0, lifetimes never overlap so they never need to coexist. lazily
+		// allocated images only share with each other
+		memory_blocks.clear();
+		for (const uint32_t index : transients)
+		{
+			auto& resource = resources[index];
+			const auto& requirement = requirements[index];
+
+			uint32_t best = ~0u;
+			for (uint32_t b = 0; b < memory_blocks.size(); b++)
+			{
+				const auto& block = memory_blocks[b];
+				if (block.free_after >= resource.first_use || block.lazy != lazy[index] ||
+					(block.memory_type_bits & requirement.memoryTypeBits) == 0)
+					continue;
+
+				// prefer a block that is already big enough and wastes the least, else the biggest one
+				const auto fits = [&](const memory_block& candidate) { return candidate.size >= requirement.size; };
+				if (best == ~0u ||
+					(fits(block) && (!fits(memory_blocks[best]) || block.size < memory_blocks[best].size)) ||
+					(!fits(block) && !fits(memory_blocks[best]) && block.size > memory_blocks[best].size))
+					best = b;
+			}
+
+			if (best == ~0u)
+			{
+				memory_blocks.emplace_back();
+				memory_blocks.back().lazy = lazy[index];
+				best = static_cast<uint32_t>(memory_blocks.size() - 1);
+			}
+
+			auto& block = memory_blocks[best];
+			block.size = std::max(block.size, requirement.size);
+			block.memory_type_bits &= requirement.memoryTypeBits;
+			block.free_after = resource.last_use;
+			resource.memory_block = best;
+		}
+
+		for (auto& block : memory_blocks)
+		{
+			VkMemoryAllocateInfo alloc_info{};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = block.size;
+			alloc_info.memoryTypeIndex = device.find_memory_type(
+				block.memory_type_bits,
+				block.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			if (device.allocate_memory(alloc_info, block.memory) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate render graph memory!");
+
+			if (!block.lazy)
+				stats.transient_memory += block.size;
+		}
+
+		for (const uint32_t index : transients)
+		{
+			auto& resource = resources[index];
+
+			if (vkBindImageMemory(device.get_device(), resource.image, memory_blocks[resource.memory_block].memory, 0)
+				!= VK_SUCCESS)
+				throw std::runtime_error("Failed to bind render graph image memory!");
+
+			VkImageViewCreateInfo view_info{};
+			view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_info.image = resource.image;
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = resource.image_info.format;
+			// descriptors see one aspect of a depth stencil image, the graph never reads the stencil
+			view_info.subresourceRange.aspectMask = aspect_of(resource.image_info.format);
+			if ((resource.usage & (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)) != 0 &&
+				(view_info.subresourceRange.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) != 0)
+				view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			view_info.subresourceRange.baseMipLevel = 0;
+			view_info.subresourceRange.levelCount = 1;
+			view_info.subresourceRange.baseArrayLayer = 0;
+			view_info.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(device.get_device(), &view_info, nullptr, &resource.view) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create render graph image view!");
+		}
+	}
+
+	void vk_render_graph::retire_transient_images()
+	{
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+		std::vector<VkDeviceMemory> memories;
+
+		for (auto& resource : resources)
+		{
+			if (resource.imported || resource.image == VK_NULL_HANDLE)
+				continue;
+			images.push_back(resource.image);
+			views.push_back(resource.view);
+			resource.image = VK_NULL_HANDLE;
+			resource.view = VK_NULL_HANDLE;
+		}
+		for (const auto& block : memory_blocks)
+			memories.push_back(block.memory);
+		memory_blocks.clear();
+
+		// every cached framebuffer references at least one of the views going away
+		std::vector<VkFramebuffer> old_framebuffers;
+		for (const auto& [key, entry] : framebuffers)
+			old_framebuffers.push_back(entry.framebuffer);
+		framebuffers.clear();
+
+		if (images.empty() && memories.empty() && old_framebuffers.empty())
+			return;
+
+		auto destroy = [&owner = device, device = device.get_device(), images, views, memories, old_framebuffers]
+		{
+			for (const auto framebuffer : old_framebuffers)
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			for (const auto view : views)
+				vkDestroyImageView(device, view, nullptr);
+			for (const auto image : images)
+				vkDestroyImage(device, image, nullptr);
+			for (const auto memory : memories)
+				owner.free_memory(memory);
+		};
+
+		// frames that are still in flight may be using them
+		if (executed_frame_count == 0)
+			destroy();
+		else
+			retired_resources.push(executed_frame_count - 1, std::move(destroy));
+	}
+
+	void vk_render_graph::bind_imported_image(const render_graph_resource resource, const VkImage image,
+	                                          const VkImageView view)
+	{
+		assert(resource.index < resources.size() && resources[resource.index].imported &&
+			"Only imported images can be bound");
+
+		resources[resource.index].image = image;
+		resources[resource.index].view = view;
+	}
+
+	void vk_render_graph::bind_imported_buffer(const render_graph_resource resource, const VkBuffer buffer)
+	{
+		assert(resource.index < resources.size() && resources[resource.index].is_buffer &&
+			"Only imported buffers can be bound");
+
+		resources[resource.index].buffer = buffer;
+	}
+
+	void vk_render_graph::execute(const vk_frame_info& frame_info)
+	{
+		VK_PROFILE_FUNCTION();
+		assert(compiled && "Render graph must be compiled before it is executed");
+		assert(extent.width > 0 && extent.height > 0 && "Render graph extent must be set before it is executed");
+
+		// called after begin_frame waited on this slot's fence, so frame n - MAX_FRAMES_IN_FLIGHT is done
+		if (executed_frame_count >= vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+			retired_resources.collect(executed_frame_count - vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+		evict_framebuffers();
+
+		for (auto& resource : resources)
+		{
+			resource.touched = false;
+			resource.state = {};
+			if (resource.imported)
+			{
+				resource.state.layout = resource.import_info.initial_layout;
+				resource.state.write_stages = resource.import_info.initial_stages;
+				resource.state.write_access = resource.import_info.initial_access;
+			}
+		}
+
+		const auto command_buffer = frame_info.command_buffer;
+		barrier_batch barriers;
+		stats.barrier_count = 0;
+
+		for (const uint32_t pass_index : execution_order)
+		{
+			auto& pass = passes[pass_index];
+			if (!pass.enabled)
+				continue;
+			const vk_gpu_scope pass_scope{profiler, command_buffer, pass.name};
+
+			for (const auto& access : pass.accesses)
+				transition(access.resource, access, barriers);
+			record_barriers(command_buffer, barriers);
+
+			if (pass.render_pass == VK_NULL_HANDLE)
+			{
+				if (pass.subpasses[0].record)
+					pass.subpasses[0].record(frame_info);
+				continue;
+			}
+
+			const VkExtent2D pass_extent = get_pass_extent(pass);
+			VkRect2D render_area{{0, 0}, pass_extent};
+			if (pass.render_area.extent.width != 0 && pass.render_area.extent.height != 0)
+			{
+				const auto x = std::min(static_cast<uint32_t>(pass.render_area.offset.x), pass_extent.width);
+				const auto y = std::min(static_cast<uint32_t>(pass.render_area.offset.y), pass_extent.height);
+				render_area = {
+					{static_cast<int32_t>(x), static_cast<int32_t>(y)},
+					{
+						std::min(pass.render_area.extent.width, pass_extent.width - x),
+						std::min(pass.render_area.extent.height, pass_extent.height - y)
+					}
+				};
+			}
+
+			std::vector<VkClearValue> clear_values;
+			for (const auto& a : pass.color_attachments)
+				clear_values.push_back(a.clear_value);
+			for (const auto& a : pass.depth_attachment)
+				clear_values.push_back(a.clear_value);
+
+			VkRenderPassBeginInfo render_pass_begin_info{};
+			render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			render_pass_begin_info.renderPass = pass.render_pass;
+			render_pass_begin_info.framebuffer = get_framebuffer(pass, pass_extent);
+			render_pass_begin_info.renderArea = render_area;
+			render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+			render_pass_begin_info.pClearValues = clear_values.data();
+
+			vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport;
+			viewport.x = static_cast<float>(render_area.offset.x);
+			viewport.y = static_cast<float>(render_area.offset.y);
+			viewport.width = static_cast<float>(render_area.extent.width);
+			viewport.height = static_cast<float>(render_area.extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+			vkCmdSetScissor(command_buffer, 0, 1, &render_area);
+
+			for (size_t subpass = 0; subpass < pass.subpasses.size(); subpass++)
+			{
+				if (subpass > 0)
+					vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+				if (pass.subpasses[subpass].record)
+					pass.subpasses[subpass].record(frame_info);
+			}
+
+			vkCmdEndRenderPass(command_buffer);
+		}
+
+		// hand imported images back in the state their owner expects (present, transfer, ...)
+		for (uint32_t i = 0; i < resources.size(); i++)
+		{
+			const auto& resource = resources[i];
+			if (!resource.imported || !resource.touched || resource.import_info.final_layout == VK_IMAGE_LAYOUT_UNDEFINED)
+				continue;
+
+			resource_access release{};
+			release.resource = i;
+			release.layout = resource.import_info.final_layout;
+			release.stages = resource.import_info.final_stages;
+			release.access = resource.import_info.final_access;
+			release.reads = true;
+			release.writes = false;
+			transition(i, release, barriers);
+		}
+		record_barriers(command_buffer, barriers);
+
+		executed_frame_count++;
+	}
+
+	void vk_render_graph::record_barriers(const VkCommandBuffer command_buffer, barrier_batch& barriers)
+	{
+		if (barriers.images.empty() && barriers.buffers.empty())
+			return;
+
+		vkCmdPipelineBarrier(
+			command_buffer,
+			barriers.src_stages,
+			barriers.dst_stages,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(barriers.buffers.size()), barriers.buffers.data(),
+			static_cast<uint32_t>(barriers.images.size()), barriers.images.data());
+		stats.barrier_count += static_cast<uint32_t>(barriers.images.size() + barriers.buffers.size());
+
+		barriers.images.clear();
+		barriers.buffers.clear();
+		barriers.src_stages = 0;
+		barriers.dst_stages = 0;
+	}
+
+	void vk_render_graph::transition(const uint32_t resource_index, const resource_access& access,
+	                                 barrier_batch& barriers)
+	{
+		auto& resource = resources[resource_index];
+		auto& state = resource.state;
+		assert((resource.is_buffer ? resource.buffer != VK_NULL_HANDLE : resource.image != VK_NULL_HANDLE) &&
+			"Render graph resource is not bound");
+
+		bool needed = false;
+		VkImageLayout old_layout = state.layout;
+		VkPipelineStageFlags src_stage = 0;
+		VkAccessFlags src_access = 0;
+
+		if (!resource.imported && !resource.touched)
+		{
+			// previous contents are garbage, but the memory may still be in use by the last occupant of the block
+			const auto& block = memory_blocks[resource.memory_block];
+			old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			src_stage = block.stages;
+			src_access = block.write_access;
+			needed = true;
+		}
+		else if (state.layout != access.layout || access.writes)
+		{
+			// layout change, write after read or write after write
+			src_stage = state.write_stages | state.read_stages;
+			src_access = state.write_access;
+			needed = true;
+		}
+		else if (state.write_access != 0 &&
+			((state.visible_access & access.access) != access.access ||
+				(state.visible_stages & access.stages) != access.stages))
+		{
+			// read after write that has not been made visible to this stage yet
+			src_stage = state.write_stages;
+			src_access = state.write_access;
+			needed = true;
+		}
+
+		// a buffer has no layout to change, the first write of the frame has nothing in the graph to wait for
+		if (resource.is_buffer && src_access == 0 && (src_stage & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) == 0)
+			needed = false;
+
+		resource.touched = true;
+
+		if (needed && resource.is_buffer)
+		{
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = src_access;
+			barrier.dstAccessMask = access.access;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = resource.buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barriers.buffers.push_back(barrier);
+
+			barriers.src_stages |= src_stage != 0 ? src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			barriers.dst_stages |= access.stages;
+		}
+		else if (needed)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = src_access;
+			barrier.dstAccessMask = access.access;
+			barrier.oldLayout = old_layout;
+			barrier.newLayout = access.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = resource.image;
+			barrier.subresourceRange.aspectMask = aspect_of(
+				resource.imported ? resource.import_info.format : resource.image_info.format);
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = resource.imported ? resource.import_info.array_layer : 0;
+			barrier.subresourceRange.layerCount = 1;
+			barriers.images.push_back(barrier);
+
+			barriers.src_stages |= src_stage != 0 ? src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			barriers.dst_stages |= access.stages;
+		}
+
+		if (access.writes)
+		{
+			state.write_stages = access.stages;
+			state.write_access = access.access & write_access_mask;
+			state.read_stages = 0;
+			state.visible_stages = access.stages;
+			state.visible_access = access.access;
+		}
+		else if (needed)
+		{
+			// the barrier orders every earlier access, only this read is outstanding
+			state.read_stages = access.stages;
+			state.visible_stages |= access.stages;
+			state.visible_access |= access.access;
+		}
+		else
+			state.read_stages |= access.stages;
+		state.layout = access.final_layout != VK_IMAGE_LAYOUT_UNDEFINED ? access.final_layout : access.layout;
+
+		if (!resource.imported)
+		{
+			auto& block = memory_blocks[resource.memory_block];
+			if (access.writes)
+			{
+				block.stages = access.stages;
+				block.write_access = access.access & write_access_mask;
+			}
+			else
+				block.stages |= access.stages;
+		}
+	}
+
+	VkExtent2D vk_render_graph::get_pass_extent(const pass_node& pass) const
+	{
+		const auto extent_of = [&](const attachment& a)
+		{
+			const auto& resource = resources[a.resource];
+			if (!resource.imported)
+				return resource.extent;
+			return resource.import_info.extent.width == 0 ? extent : resource.import_info.extent;
+		};
+
+		const VkExtent2D pass_extent = pass.color_attachments.empty()
+			                               ? extent_of(pass.depth_attachment[0])
+			                               : extent_of(pass.color_attachments[0]);
+
+		assert(std::all_of(pass.color_attachments.begin(), pass.color_attachments.end(), [&](const attachment& a)
+			{
+			return extent_of(a).width == pass_extent.width && extent_of(a).height == pass_extent.height;
+			}) && "All attachments of a pass must have the same extent");
+
+		return pass_extent;
+	}
+
+	VkFramebuffer vk_render_graph::get_framebuffer(const pass_node& pass, const VkExtent2D pass_extent)
+	{
+		std::vector<VkImageView> views;
+		for (const auto& a : pass.color_attachments)
+			views.push_back(resources[a.resource].view);
+		for (const auto& a : pass.depth_attachment)
+			views.push_back(resources[a.resource].view);
+
+		auto& entry = framebuffers[{pass.render_pass, views}];
+		entry.last_used_frame = executed_frame_count;
+
+		if (entry.framebuffer == VK_NULL_HANDLE)
+		{
+			VkFramebufferCreateInfo framebuffer_info = {};
+			framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebuffer_info.renderPass = pass.render_pass;
+			framebuffer_info.attachmentCount = static_cast<uint32_t>(views.size());
+			framebuffer_info.pAttachments = views.data();
+			framebuffer_info.width = pass_extent.width;
+			framebuffer_info.height = pass_extent.height;
+			framebuffer_info.layers = 1;
+
+			if (vkCreateFramebuffer(device.get_device(), &framebuffer_info, nullptr, &entry.framebuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create framebuffer for render graph pass '" + pass.name + "'!");
+		}
+
+		return entry.framebuffer;
+	}
+
+	void vk_render_graph::evict_framebuffers()
+	{
+		// imported views change with the swap chain, idle entries (never used by a frame in flight) are dropped
+		// before their views can be destroyed and their handles reused
+		for (auto it = framebuffers.begin(); it != framebuffers.end();)
+		{
+			if (it->second.last_used_frame + framebuffer_idle_frames <= executed_frame_count)
+			{
+				vkDestroyFramebuffer(device.get_device(), it->second.framebuffer, nullptr);
+				it = framebuffers.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	VkRenderPass vk_render_graph::get_render_pass(const render_graph_pass pass) const
+	{
+		assert(compiled && "Render graph must be compiled before its render passes exist");
+		assert(pass.index < passes.size() && "Invalid render graph pass");
+		return passes[pass.index].render_pass;
+	}
+
+	VkImage vk_render_graph::get_image(const render_graph_resource resource) const
+	{
+		assert(resource.index < resources.size() && "Invalid render graph resource");
+		return resources[resource.index].image;
+	}
+
+	VkImageView vk_render_graph::get_image_view(const render_graph_resource resource) const
+	{
+		assert(resource.index < resources.size() && "Invalid render graph resource");
+		return resources[resource.index].view;
+	}
+
+	bool vk_render_graph::is_pass_culled(const render_graph_pass pass) const
+	{
+		assert(pass.index < passes.size() && "Invalid render graph pass");
+		return passes[pass.index].culled;
+	}
+
+	VkImageAspectFlags vk_render_graph::aspect_of(const VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "vk_deletion_queue.hpp"
+#include "vk_device.hpp"
+#include "vk_gpu_profiler.hpp"
+#include "../engine/vk_frame_info.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+	struct render_graph_resource
+	{
+		uint32_t index = ~0u;
+		bool is_valid() const { return index != ~0u; }
+	};
+
+	struct render_graph_pass
+	{
+		uint32_t index = ~0u;
+		bool is_valid() const { return index != ~0u; }
+	};
+
+	// image owned by the graph, memory is shared with other transients whose lifetimes don't overlap
+	struct render_graph_image_info
+	{
+		VkFormat format{VK_FORMAT_UNDEFINED};
+		float extent_scale{1.f}; // relative to the graph extent
+		VkImageUsageFlags extra_usage{0};
+	};
+
+	// image owned by someone else (swap chain, offscreen target, shadow map layer), bound anew every frame
+	struct render_graph_import_info
+	{
+		VkFormat format{VK_FORMAT_UNDEFINED};
+
+		// state the image is in when the graph starts, e.g. color attachment output for a freshly acquired image
+		VkImageLayout initial_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+		VkPipelineStageFlags initial_stages{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+		VkAccessFlags initial_access{0};
+
+		// state the graph leaves it in, undefined keeps whatever the last pass left
+		VkImageLayout final_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+		VkPipelineStageFlags final_stages{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+		VkAccessFlags final_access{0};
+
+		VkExtent2D extent{}; // empty follows the graph extent
+		// the layer of an array image the resource stands for, its barriers only cover that layer and the bound
+		// view only shows it. every layer is a resource of its own
+		uint32_t array_layer{0};
+	};
+
+	enum class attachment_load_op
+	{
+		clear,
+		load,
+		dont_care,
+	};
+
+	struct render_graph_stats
+	{
+		uint32_t pass_count{};
+		uint32_t culled_pass_count{};
+		uint32_t barrier_count{}; // image and buffer barriers recorded by the last execute
+		uint32_t transient_image_count{};
+		uint32_t lazy_image_count{}; // transients that never leave their pass, lazily allocated where supported
+		VkDeviceSize transient_memory{}; // actually allocated, lazily allocated memory left out
+		VkDeviceSize transient_memory_unaliased{}; // what one allocation per image would have cost
+	};
+
+	// frame graph: passes declare the images and buffers they read and write, the graph orders them, culls passes
+	// nothing depends on, records the layout transitions and barriers in between and aliases transient image memory.
+	// a pass without attachments records outside a render pass, e.g. compute dispatches or copies.
+	// a pass can have several subpasses that read what the earlier ones wrote as input attachments, transients
+	// used by a single pass are then never stored and get lazily allocated memory where the device has it, so
+	// tile based gpus keep them in tile memory.
+	//
+	// usage: create/import images, add passes, compile() once, create pipelines against get_render_pass(),
+	// set the records, then every frame set_extent(), bind imported images and buffers and execute().
+	class vk_render_graph
+	{
+	public:
+		using record_fn = std::function<void(const vk_frame_info& frame_info)>;
+
+		class pass_builder
+		{
+		public:
+			void write_color(render_graph_resource resource, attachment_load_op load = attachment_load_op::clear,
+			                 VkClearColorValue clear_value = {{0.f, 0.f, 0.f, 1.f}});
+			void write_depth(render_graph_resource resource, attachment_load_op load = attachment_load_op::clear,
+			                 VkClearDepthStencilValue clear_value = {1.f, 0});
+			// depth test against a depth buffer written by an earlier pass, without writing to it
+			void read_depth(render_graph_resource resource);
+			void read_texture(render_graph_resource resource,
+			                  VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			// source or destination of copies and blits the record does itself
+			void read_transfer(render_graph_resource resource);
+			void write_transfer(render_graph_resource resource);
+			// storage buffer the shaders of stages read or write
+			void read_buffer(render_graph_resource resource,
+			                 VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			void write_buffer(render_graph_resource resource,
+			                  VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			// keeps the pass even if nothing reads what it writes
+			void set_side_effects();
+
+			// attachments declared from here on belong to the next subpass of the same render pass, its records
+			// are set with set_record(pass, subpass, ...). an attachment used by several subpasses is declared in
+			// each of them, its load op and clear value are those of the first
+			void next_subpass();
+			// input attachment of the current subpass, a color or depth attachment an earlier subpass wrote
+			void read_input(render_graph_resource resource);
+
+		private:
+			pass_builder(vk_render_graph& graph, uint32_t pass) : graph{graph}, pass{pass}
+			{
+			}
+
+			vk_render_graph& graph;
+			uint32_t pass;
+
+			friend class vk_render_graph;
+		};
+
+		explicit vk_render_graph(vk_device& device);
+		~vk_render_graph();
+
+		vk_render_graph(const vk_render_graph&) = delete;
+		vk_render_graph& operator=(const vk_render_graph&) = delete;
+
+		render_graph_resource create_image(std::string name, const render_graph_image_info& info);
+		render_graph_resource import_image(std::string name, const render_graph_import_info& info);
+		// buffer owned by someone else, bound anew every frame. host writes before the submit need no barrier, the
+		// graph only orders the accesses of its passes
+		render_graph_resource import_buffer(std::string name);
+		render_graph_pass add_pass(std::string name, const std::function<void(pass_builder&)>& setup);
+		void set_record(render_graph_pass pass, record_fn record);
+		// the graph moves on with vkCmdNextSubpass between the records of a pass
+		void set_record(render_graph_pass pass, uint32_t subpass, record_fn record);
+		// renders only the top left area of the attachments, viewport and scissor included. lets the resolution
+		// change every frame without recreating images, {0, 0} renders all of them again
+		void set_render_area(render_graph_pass pass, VkExtent2D area);
+		// any area of the attachments, e.g. the part of a cached image that changed
+		void set_render_area(render_graph_pass pass, const VkRect2D& area);
+		// disabled passes are skipped by execute, what they write keeps its old contents. picks between
+		// alternative passes at runtime, compile() already kept and ordered all of them
+		void set_pass_enabled(render_graph_pass pass, bool enabled);
+
+		// orders and culls the passes and creates their render passes, the graph is immutable afterwards
+		void compile();
+
+		// (re)creates transient images when the extent changes, old ones are kept until in-flight frames finish
+		void set_extent(VkExtent2D extent);
+		void bind_imported_image(render_graph_resource resource, VkImage image, VkImageView view);
+		void bind_imported_buffer(render_graph_resource resource, VkBuffer buffer);
+		// times every pass (barriers included) under its name, null disables it
+		void set_profiler(vk_gpu_profiler* gpu_profiler) { profiler = gpu_profiler; }
+
+		// records every live pass into frame_info.command_buffer, call once per frame after begin_frame
+		void execute(const vk_frame_info& frame_info);
+
+		VkRenderPass get_render_pass(render_graph_pass pass) const;
+		VkImage get_image(render_graph_resource resource) const;
+		VkImageView get_image_view(render_graph_resource resource) const;
+		bool is_pass_culled(render_graph_pass pass) const;
+		const render_graph_stats& get_stats() const { return stats; }
+
+	private:
+		struct image_state
+		{
+			VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+			VkPipelineStageFlags write_stages{0};
+			VkAccessFlags write_access{0};
+			VkPipelineStageFlags read_stages{0}; // reads since the last write
+			VkPipelineStageFlags visible_stages{0}; // stages the last write has been made visible to
+			VkAccessFlags visible_access{0};
+		};
+
+		// accesses are images unless the resource is a buffer, its layouts are always undefined
+		struct resource_access
+		{
+			uint32_t resource;
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			bool reads;
+			bool writes;
+			// the layout the pass leaves it in, when a later subpass uses it differently. undefined is layout
+			VkImageLayout final_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+		};
+
+		struct attachment
+		{
+			uint32_t resource;
+			attachment_load_op load;
+			VkClearValue clear_value;
+			VkImageLayout layout; // in the first subpass using it
+			VkImageLayout final_layout; // in the last one
+		};
+
+		// attachments of a subpass, as resources of its pass
+		struct subpass_node
+		{
+			std::vector<uint32_t> color_attachments;
+			uint32_t depth_attachment{~0u};
+			VkImageLayout depth_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+			std::vector<std::pair<uint32_t, VkImageLayout>> input_attachments;
+			record_fn record;
+		};
+
+		struct pass_node
+		{
+			std::string name;
+			// every attachment of the render pass, in framebuffer order after each other
+			std::vector<attachment> color_attachments;
+			std::vector<attachment> depth_attachment; // zero or one
+			std::vector<subpass_node> subpasses{1};
+			std::vector<resource_access> accesses;
+			bool side_effects{false};
+			bool culled{false};
+			bool enabled{true};
+			VkRect2D render_area{}; // empty is the whole pass extent
+			VkRenderPass render_pass{};
+		};
+
+		struct resource_node
+		{
+			std::string name;
+			bool imported{false};
+			bool is_buffer{false}; // always imported
+			render_graph_image_info image_info{};
+			render_graph_import_info import_info{};
+			VkImageUsageFlags usage{0};
+
+			VkImage image{};
+			VkImageView view{};
+			VkBuffer buffer{};
+			VkExtent2D extent{};
+			uint32_t memory_block{~0u};
+			uint32_t first_use{~0u}; // indices into execution_order
+			uint32_t last_use{0};
+			image_state state{};
+			bool touched{false}; // accessed during the current execute
+		};
+
+		struct memory_block
+		{
+			VkDeviceMemory memory{};
+			VkDeviceSize size{0};
+			uint32_t memory_type_bits{~0u};
+			uint32_t free_after{0};
+			bool lazy{false};
+
+			// last accesses to any image placed in the block, a new occupant has to wait for them
+			VkPipelineStageFlags stages{0};
+			VkAccessFlags write_access{0};
+		};
+
+		// everything one vkCmdPipelineBarrier waits for
+		struct barrier_batch
+		{
+			std::vector<VkImageMemoryBarrier> images;
+			std::vector<VkBufferMemoryBarrier> buffers;
+			VkPipelineStageFlags src_stages{0};
+			VkPipelineStageFlags dst_stages{0};
+		};
+
+		struct framebuffer_entry
+		{
+			VkFramebuffer framebuffer{};
+			uint64_t last_used_frame{};
+		};
+
+		void add_access(uint32_t pass, const resource_access& access);
+		// the attachment of resource in pass, null if it is none
+		attachment* find_attachment(uint32_t pass, uint32_t resource);
+		subpass_node& current_subpass(uint32_t pass) { return passes[pass].subpasses.back(); }
+		std::vector<std::vector<uint32_t>> build_dependencies() const;
+		void sort_passes(const std::vector<std::vector<uint32_t>>& dependencies);
+		void cull_passes(const std::vector<std::vector<uint32_t>>& dependencies);
+		void compute_lifetimes();
+		void create_render_pass(uint32_t position, pass_node& pass) const;
+		void create_transient_images();
+		void retire_transient_images();
+		void transition(uint32_t resource, const resource_access& access, barrier_batch& barriers);
+		void record_barriers(VkCommandBuffer command_buffer, barrier_batch& barriers);
+		VkFramebuffer get_framebuffer(const pass_node& pass, VkExtent2D pass_extent);
+		VkExtent2D get_pass_extent(const pass_node& pass) const;
+		void evict_framebuffers();
+		static VkImageAspectFlags aspect_of(VkFormat format);
+
+		vk_device& device;
+
+		std::vector<pass_node> passes;
+		std::vector<resource_node> resources;
+		std::vector<uint32_t> execution_order; // live passes only
+		std::vector<memory_block> memory_blocks;
+		std::map<std::pair<VkRenderPass, std::vector<VkImageView>>, framebuffer_entry> framebuffers;
+		vk_deletion_queue retired_resources;
+		vk_gpu_profiler* profiler = nullptr;
+
+		VkExtent2D extent{};
+		bool compiled{false};
+		uint64_t executed_frame_count{};
+		render_graph_stats stats{};
+	};
+}
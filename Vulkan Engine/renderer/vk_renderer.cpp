@@ -8,6 +8,8 @@
 #include <stdexcept>
 
 #include "vk_device.hpp"
+#include "vk_geometry_pool.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
 
 namespace vk_engine
 {
@@ -20,13 +22,18 @@ namespace vk_engine
 	vk_renderer::~vk_renderer()
 	{
 		free_command_buffers();
+		retired_resources.flush();
 	}
 
 	VkCommandBuffer vk_renderer::begin_frame()
 	{
+		VK_PROFILE_FUNCTION();
 		assert(!is_frame_started && "Cannot call begin_frame while already in progress.");
 		const auto result = swapchain->acquire_next_image(&current_image_index);
 
+		// acquire_next_image waited on this frame slot's fence, so older frames are done with their resources
+		collect_retired_resources();
+
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
 			recreate_swap_chain();
@@ -36,6 +43,9 @@ namespace vk_engine
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			throw std::runtime_error("Failed to acquire swap chain image!");
 
+		// only frames that get submitted count, the pool retires by them
+		device.get_geometry_pool().begin_frame();
+
 		is_frame_started = true;
 		const auto command_buffer = get_current_command_buffer();
 		VkCommandBufferBeginInfo begin_info{};
@@ -49,14 +59,17 @@ namespace vk_engine
 
 	void vk_renderer::end_frame()
 	{
+		VK_PROFILE_FUNCTION();
 		assert(is_frame_started && "Cannot call end_frame while frame is not in progress.");
 		const auto command_buffer = get_current_command_buffer();
 
 		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
 			throw std::runtime_error("Failed to record command buffer!");
 
-		if (const auto result = swapchain->submit_command_buffers(&command_buffer, &current_image_index);
-			result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.was_window_resized())
+		const auto result = swapchain->submit_command_buffers(&command_buffer, &current_image_index);
+		submitted_frame_count++;
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.was_window_resized())
 		{
 			window.reset_window_resized_flag();
 			recreate_swap_chain();
@@ -140,6 +153,18 @@ namespace vk_engine
 		return swapchain->extent_aspect_ratio();
 	}
 
+	VkImage vk_renderer::get_current_swap_chain_image() const
+	{
+		assert(is_frame_started && "Cannot get swap chain image when frame is not in progress.");
+		return swapchain->get_image(static_cast<int>(current_image_index));
+	}
+
+	VkImageView vk_renderer::get_current_swap_chain_image_view() const
+	{
+		assert(is_frame_started && "Cannot get swap chain image view when frame is not in progress.");
+		return swapchain->get_image_view(static_cast<int>(current_image_index));
+	}
+
 	void vk_renderer::create_command_buffers()
 	{
 		command_buffers.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
@@ -174,21 +199,36 @@ namespace vk_engine
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(device.get_device());
-
 		if (swapchain == nullptr)
 			swapchain = std::make_unique<vk_swapchain>(device, extent);
 		else
 		{
-			const std::shared_ptr old_swap_chain = std::move(swapchain); //old
-			swapchain = std::make_unique<vk_swapchain>(device, extent, std::move(swapchain)); //new
+			std::shared_ptr old_swap_chain = std::move(swapchain); //old
+			swapchain = std::make_unique<vk_swapchain>(device, extent, old_swap_chain); //new
 
 			if (!old_swap_chain->compare_swap_formats(*swapchain))
 				throw std::runtime_error("Swap chain image or depth format has changed!");
+
+			// frames still in flight may reference the old images, framebuffers and depth buffers,
+			// so instead of draining the device the old swap chain dies once the last of them completes
+			const uint64_t last_use_frame = submitted_frame_count == 0 ? 0 : submitted_frame_count - 1;
+			retired_resources.push(last_use_frame, [retired = std::move(old_swap_chain)]() mutable
+			{
+				retired.reset();
+			});
 		}
 
 		std::cout
 			<< "[RENDERER]" << std::endl
 			<< "	window size: (h: " << extent.height << ", w: " << extent.width << ')' << std::endl;
 	}
+
+	void vk_renderer::collect_retired_resources()
+	{
+		// frame n reuses the fence of frame n - MAX_FRAMES_IN_FLIGHT, which has just been waited on
+		if (submitted_frame_count < vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+			return;
+
+		retired_resources.collect(submitted_frame_count - vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	}
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "vk_deletion_queue.hpp"
 #include "vk_device.hpp"
 #include "vk_swapchain.hpp"
 #include "vk_window.hpp"
@@ -27,21 +28,31 @@ namespace vk_engine
 		VkRenderPass get_swap_chain_render_pass() const;
 		float get_aspect_ratio() const;
 
+		// for drawing into the acquired image without the swap chain render pass, e.g. from a render graph
+		VkImage get_current_swap_chain_image() const;
+		VkImageView get_current_swap_chain_image_view() const;
+		VkFormat get_swap_chain_image_format() const { return swapchain->get_swap_chain_image_format(); }
+		VkFormat get_swap_chain_depth_format() const { return swapchain->get_swap_chain_depth_format(); }
+		VkExtent2D get_swap_chain_extent() const { return swapchain->get_swap_chain_extent(); }
+
 	private:
 		void create_command_buffers();
 		void free_command_buffers();
 
 		void recreate_swap_chain();
+		void collect_retired_resources();
 
 		vk_window& window;
 		vk_device& device;
 
 		std::unique_ptr<vk_swapchain> swapchain;
+		vk_deletion_queue retired_resources;
 
 		std::vector<VkCommandBuffer> command_buffers;
 
 		uint32_t current_image_index{};
         int current_frame_index{};
+		uint64_t submitted_frame_count{};
 		bool is_frame_started{false};
 	};
 }
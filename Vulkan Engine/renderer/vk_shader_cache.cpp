@@ -0,0 +1,217 @@
+#include "vk_shader_cache.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef VK_ENGINE_EMBEDDED_SHADERS
+namespace vk_engine
+{
+	// generated by cmake/embed_shaders.cmake
+	struct embedded_shader
+	{
+		const char* path;
+		const unsigned char* code;
+		size_t code_size;
+	};
+
+	extern const embedded_shader embedded_shaders[];
+	extern const size_t embedded_shader_count;
+}
+#endif
+
+namespace vk_engine
+{
+	namespace
+	{
+		// read only view of a whole file, the pages are only touched while hashing and creating the module
+		class mapped_file
+		{
+		public:
+			explicit mapped_file(const std::string& file_path)
+			{
+#ifdef _WIN32
+				file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				                   FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file == INVALID_HANDLE_VALUE)
+					throw std::runtime_error("Failed to open file: " + file_path);
+
+				LARGE_INTEGER file_size{};
+				GetFileSizeEx(file, &file_size);
+				size = static_cast<size_t>(file_size.QuadPart);
+				if (size == 0)
+					return;
+
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping != nullptr)
+					data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+				fd = open(file_path.c_str(), O_RDONLY);
+				if (fd < 0)
+					throw std::runtime_error("Failed to open file: " + file_path);
+
+				struct stat file_stat{};
+				fstat(fd, &file_stat);
+				size = static_cast<size_t>(file_stat.st_size);
+				if (size == 0)
+					return;
+
+				data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data == MAP_FAILED)
+					data = nullptr;
+#endif
+				if (data == nullptr)
+				{
+					close();
+					throw std::runtime_error("Failed to map file: " + file_path);
+				}
+			}
+
+			~mapped_file() { close(); }
+
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+
+			// mappings are page aligned, good enough for spir-v words
+			const uint32_t* words() const { return static_cast<const uint32_t*>(data); }
+			size_t get_size() const { return size; }
+
+		private:
+			void close()
+			{
+#ifdef _WIN32
+				if (data != nullptr)
+					UnmapViewOfFile(data);
+				if (mapping != nullptr)
+					CloseHandle(mapping);
+				if (file != INVALID_HANDLE_VALUE)
+					CloseHandle(file);
+				mapping = nullptr;
+				file = INVALID_HANDLE_VALUE;
+#else
+				if (data != nullptr)
+					munmap(data, size);
+				if (fd >= 0)
+					::close(fd);
+				fd = -1;
+#endif
+				data = nullptr;
+			}
+
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+			void* data = nullptr;
+			size_t size = 0;
+		};
+
+		uint64_t hash_code(const uint32_t* code, const size_t code_size)
+		{
+			// fnv-1a over the words
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < code_size / sizeof(uint32_t); i++)
+			{
+				hash ^= code[i];
+				hash *= 1099511628211ull;
+			}
+			return hash ^ code_size;
+		}
+	}
+
+	vk_shader_module::vk_shader_module(vk_device& device, const uint32_t* code, const size_t code_size,
+	                                   const uint64_t content_hash)
+		: device{device}, code_size{code_size}, content_hash{content_hash}
+	{
+		VkShaderModuleCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		create_info.codeSize = code_size;
+		create_info.pCode = code;
+
+		if (vkCreateShaderModule(device.get_device(), &create_info, nullptr, &shader_module) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create shader module!");
+	}
+
+	vk_shader_module::~vk_shader_module()
+	{
+		vkDestroyShaderModule(device.get_device(), shader_module, nullptr);
+	}
+
+	std::shared_ptr<vk_shader_module> vk_shader_cache::acquire(const std::string& file_path)
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+
+		if (const auto it = modules_by_path.find(file_path); it != modules_by_path.end())
+		{
+			if (auto module = it->second.lock())
+			{
+				cache_stats.path_hits++;
+				return module;
+			}
+		}
+
+		std::shared_ptr<vk_shader_module> module;
+
+#ifdef VK_ENGINE_EMBEDDED_SHADERS
+		for (size_t i = 0; i < embedded_shader_count && module == nullptr; i++)
+		{
+			if (file_path != embedded_shaders[i].path)
+				continue;
+
+			cache_stats.embedded_reads++;
+			module = acquire_code(reinterpret_cast<const uint32_t*>(embedded_shaders[i].code),
+			                      embedded_shaders[i].code_size);
+		}
+#endif
+
+		if (module == nullptr)
+		{
+			const mapped_file file{file_path};
+			if (file.get_size() == 0 || file.get_size() % sizeof(uint32_t) != 0)
+				throw std::runtime_error("Invalid SPIR-V file: " + file_path);
+
+			cache_stats.file_reads++;
+			module = acquire_code(file.words(), file.get_size());
+		}
+
+		modules_by_path[file_path] = module;
+		return module;
+	}
+
+	std::shared_ptr<vk_shader_module> vk_shader_cache::acquire_code(const uint32_t* code, const size_t code_size)
+	{
+		// the same blob under another path (copies, symlinks, embedded and on disk) shares the module
+		const uint64_t hash = hash_code(code, code_size);
+		auto& cached = modules_by_hash[hash];
+		if (auto module = cached.lock())
+		{
+			if (module->get_code_size() == code_size)
+			{
+				cache_stats.content_hits++;
+				return module;
+			}
+		}
+
+		auto module = std::make_shared<vk_shader_module>(device, code, code_size, hash);
+		cache_stats.modules_created++;
+		cached = module;
+		return module;
+	}
+
+	vk_shader_cache::stats vk_shader_cache::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		return cache_stats;
+	}
+}
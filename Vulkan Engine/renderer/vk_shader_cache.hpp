@@ -0,0 +1,69 @@
+#pragma once
+
+#include "vk_device.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace vk_engine
+{
+	class vk_shader_module
+	{
+	public:
+		vk_shader_module(vk_device& device, const uint32_t* code, size_t code_size, uint64_t content_hash);
+		~vk_shader_module();
+
+		vk_shader_module(const vk_shader_module&) = delete;
+		vk_shader_module& operator=(const vk_shader_module&) = delete;
+
+		VkShaderModule get_shader_module() const { return shader_module; }
+		size_t get_code_size() const { return code_size; }
+		uint64_t get_content_hash() const { return content_hash; }
+
+	private:
+		vk_device& device;
+		VkShaderModule shader_module{};
+		size_t code_size;
+		uint64_t content_hash;
+	};
+
+	// hands out one shared module per spir-v blob. modules live as long as a pipeline holds them, a path that is
+	// still alive is served without touching the disk, others are memory mapped (or taken from the spir-v
+	// embedded at build time) and deduplicated by content
+	class vk_shader_cache
+	{
+	public:
+		struct stats
+		{
+			uint32_t path_hits = 0;
+			uint32_t content_hits = 0;
+			uint32_t file_reads = 0;
+			uint32_t embedded_reads = 0;
+			uint32_t modules_created = 0;
+		};
+
+		explicit vk_shader_cache(vk_device& device) : device{device}
+		{
+		}
+
+		vk_shader_cache(const vk_shader_cache&) = delete;
+		vk_shader_cache& operator=(const vk_shader_cache&) = delete;
+
+		// thread safe, pipelines are compiled on worker threads
+		std::shared_ptr<vk_shader_module> acquire(const std::string& file_path);
+
+		stats get_stats() const;
+
+	private:
+		std::shared_ptr<vk_shader_module> acquire_code(const uint32_t* code, size_t code_size);
+
+		vk_device& device;
+
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, std::weak_ptr<vk_shader_module>> modules_by_path;
+		std::unordered_map<uint64_t, std::weak_ptr<vk_shader_module>> modules_by_hash;
+		stats cache_stats{};
+	};
+}
@@ -0,0 +1,242 @@
+#include "vk_static_batch.hpp"
+#include "vk_dynamic_batcher.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+#include "../engine/vk_frustum.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace vk_engine
+{
+	namespace
+	{
+		std::unique_ptr<vk_buffer> create_device_local_buffer(vk_device& device, const void* data,
+		                                                      const uint32_t element_size, const uint32_t count,
+		                                                      const VkBufferUsageFlags usage)
+		{
+			vk_buffer staging_buffer{
+				device,
+				element_size,
+				count,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			};
+			staging_buffer.map();
+			staging_buffer.write_to_buffer(data);
+
+			auto buffer = std::make_unique<vk_buffer>(
+				device,
+				element_size,
+				count,
+				usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+			device.copy_buffer(staging_buffer.get_buffer(), buffer->get_buffer(), VkDeviceSize{element_size} * count);
+			return buffer;
+		}
+	}
+
+	vk_static_batch::vk_static_batch(vk_device& device, const static_batch_config config)
+		: device{device}, config{config}
+	{
+		assert(config.cell_size > 0.f && "Static batch cells must have a size");
+	}
+
+	vk_static_batch::~vk_static_batch() = default;
+
+	void vk_static_batch::clear()
+	{
+		vertex_buffer.reset();
+		index_buffer.reset();
+		cells.clear();
+		visible_ranges.clear();
+		stats = {};
+	}
+
+	void vk_static_batch::retire(vk_deletion_queue& retired_resources, const uint64_t last_use_frame)
+	{
+		// frames still in flight may draw from the buffers, they die once the last of them completes
+		if (vertex_buffer)
+		{
+			std::shared_ptr retired_vertices = std::move(vertex_buffer);
+			std::shared_ptr retired_indices = std::move(index_buffer);
+			retired_resources.push(last_use_frame, [retired_vertices, retired_indices]() mutable
+			{
+				retired_vertices.reset();
+				retired_indices.reset();
+			});
+		}
+		clear();
+	}
+
+	void vk_static_batch::build(const vk_game_object::map& game_objects)
+	{
+		VK_PROFILE_FUNCTION();
+		assert(!vertex_buffer && "The last static batch must be retired or cleared before building again");
+		clear();
+
+		// in id order, the same scene merges into the same buffers
+		std::vector<const vk_game_object*> objects;
+		for (const auto& [id, game_object] : game_objects)
+		{
+			if (game_object.is_static && game_object.model != nullptr)
+				objects.push_back(&game_object);
+		}
+		std::sort(objects.begin(), objects.end(),
+		          [](const vk_game_object* a, const vk_game_object* b) { return a->get_id() < b->get_id(); });
+
+		struct model_geometry
+		{
+			std::vector<vk_model::vertex> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		struct cell_builder
+		{
+			std::vector<vk_model::vertex> vertices;
+			std::vector<uint32_t> indices; // into vertices
+			glm::vec3 min_position{std::numeric_limits<float>::max()};
+			glm::vec3 max_position{std::numeric_limits<float>::lowest()};
+			// vertices of the object being added are shared by its triangles in the cell
+			uint32_t object = ~0u;
+			std::unordered_map<uint32_t, uint32_t> remap;
+		};
+
+		std::unordered_map<const vk_model*, model_geometry> geometries;
+		std::map<std::tuple<int, int, int>, cell_builder> cell_builders;
+		std::vector<vk_model::vertex> world_vertices;
+
+		for (uint32_t object_index = 0; object_index < objects.size(); object_index++)
+		{
+			const auto& game_object = *objects[object_index];
+			auto& geometry = geometries[game_object.model.get()];
+			if (geometry.vertices.empty())
+				game_object.model->read_geometry(geometry.vertices, geometry.indices);
+			const auto& model_vertices = geometry.vertices;
+			const auto& model_indices = geometry.indices;
+
+			const auto vertex_count = static_cast<uint32_t>(model_vertices.size());
+			world_vertices.resize(vertex_count);
+			transform_vertices(model_vertices.data(), vertex_count, game_object.transform.mat4(),
+			                   game_object.transform.normal_matrix(), world_vertices.data());
+
+			const auto corner_count = static_cast<uint32_t>(model_indices.empty()
+				                                                ? vertex_count
+				                                                : model_indices.size());
+			const auto corner = [&](const uint32_t i) { return model_indices.empty() ? i : model_indices[i]; };
+			for (uint32_t i = 0; i + 2 < corner_count; i += 3)
+			{
+				const uint32_t triangle[] = {corner(i), corner(i + 1), corner(i + 2)};
+				for (const uint32_t index : triangle)
+				{
+					if (index >= vertex_count)
+						throw std::runtime_error("Static batch got a model with an out of range index!");
+				}
+
+				const glm::vec3 centroid = (world_vertices[triangle[0]].position +
+					world_vertices[triangle[1]].position + world_vertices[triangle[2]].position) / 3.f;
+				const glm::ivec3 key{glm::floor(centroid / config.cell_size)};
+				auto& builder = cell_builders[{key.z, key.y, key.x}];
+				if (builder.object != object_index)
+				{
+					builder.object = object_index;
+					builder.remap.clear();
+				}
+
+				for (const uint32_t index : triangle)
+				{
+					const auto [it, inserted] = builder.remap.try_emplace(
+						index, static_cast<uint32_t>(builder.vertices.size()));
+					if (inserted)
+					{
+						const auto& vertex = world_vertices[index];
+						builder.vertices.push_back(vertex);
+						builder.min_position = glm::min(builder.min_position, vertex.position);
+						builder.max_position = glm::max(builder.max_position, vertex.position);
+					}
+					builder.indices.push_back(it->second);
+				}
+			}
+		}
+
+		// indices are made absolute, so neighbouring cells draw as one range
+		std::vector<vk_model::vertex> vertices;
+		std::vector<uint32_t> indices;
+		cells.reserve(cell_builders.size());
+		for (const auto& [key, builder] : cell_builders)
+		{
+			const auto base_vertex = static_cast<uint32_t>(vertices.size());
+			const glm::vec3 center = (builder.min_position + builder.max_position) * .5f;
+			cells.push_back({
+				glm::vec4{center, glm::length(builder.max_position - center)},
+				static_cast<uint32_t>(indices.size()),
+				static_cast<uint32_t>(builder.indices.size())
+			});
+			vertices.insert(vertices.end(), builder.vertices.begin(), builder.vertices.end());
+			for (const uint32_t index : builder.indices)
+				indices.push_back(base_vertex + index);
+		}
+
+		stats.object_count = static_cast<uint32_t>(objects.size());
+		stats.cell_count = static_cast<uint32_t>(cells.size());
+		stats.vertex_count = static_cast<uint32_t>(vertices.size());
+		stats.index_count = static_cast<uint32_t>(indices.size());
+		if (indices.empty())
+		{
+			cells.clear();
+			return;
+		}
+
+		vertex_buffer = create_device_local_buffer(device, vertices.data(), sizeof(vk_model::vertex),
+		                                           stats.vertex_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		index_buffer = create_device_local_buffer(device, indices.data(), sizeof(uint32_t), stats.index_count,
+		                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+		std::cout
+			<< "[Static Batch]" << std::endl
+			<< "	objects: " << stats.object_count << std::endl
+			<< "	cells: " << stats.cell_count << std::endl
+			<< "	vertex count: " << stats.vertex_count << std::endl
+			<< "	index count: " << stats.index_count << std::endl;
+	}
+
+	void vk_static_batch::cull(const glm::mat4& view_projection)
+	{
+		VK_PROFILE_FUNCTION();
+		visible_ranges.clear();
+		stats.visible_cells = 0;
+
+		const vk_frustum frustum = vk_frustum::from_matrix(view_projection);
+		for (const auto& [sphere, first_index, index_count] : cells)
+		{
+			if (!frustum.intersects_sphere(glm::vec3{sphere}, sphere.w))
+				continue;
+
+			stats.visible_cells++;
+			if (!visible_ranges.empty() && visible_ranges.back().x + visible_ranges.back().y == first_index)
+				visible_ranges.back().y += index_count;
+			else
+				visible_ranges.emplace_back(first_index, index_count);
+		}
+		stats.draws = static_cast<uint32_t>(visible_ranges.size());
+	}
+
+	void vk_static_batch::draw(const VkCommandBuffer command_buffer, const uint32_t first_instance) const
+	{
+		if (visible_ranges.empty())
+			return;
+
+		const VkBuffer buffers[] = {vertex_buffer->get_buffer()};
+		constexpr VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(command_buffer, index_buffer->get_buffer(), 0, VK_INDEX_TYPE_UINT32);
+		for (const auto& [first_index, index_count] : visible_ranges)
+			vkCmdDrawIndexed(command_buffer, index_count, 1, first_index, 0, first_instance);
+	}
+}
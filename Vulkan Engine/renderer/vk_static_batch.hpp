@@ -0,0 +1,80 @@
+#pragma once
+
+#include "vk_buffer.hpp"
+#include "vk_deletion_queue.hpp"
+#include "vk_device.hpp"
+#include "../engine/vk_game_object.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	struct static_batch_config
+	{
+		float cell_size = 16.f; // world units along each side of a cell
+	};
+
+	// of the last build and cull
+	struct static_batch_stats
+	{
+		uint32_t object_count = 0;
+		uint32_t cell_count = 0;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		uint32_t visible_cells = 0;
+		uint32_t draws = 0;
+	};
+
+	// the meshes of every static object (vk_game_object::is_static) moved to world space once and merged into one
+	// vertex and one index buffer. triangles are sorted into a grid of cells by their centroid, each cell is a
+	// contiguous index range with its own bounds, so culling drops whole cells and neighbouring visible cells are
+	// drawn as one range. nothing is transformed per frame, the draws read one per object entry that holds the
+	// identity
+	class vk_static_batch
+	{
+	public:
+		explicit vk_static_batch(vk_device& device, static_batch_config config = {});
+		~vk_static_batch();
+
+		vk_static_batch(const vk_static_batch&) = delete;
+		vk_static_batch& operator=(const vk_static_batch&) = delete;
+
+		// merges the models' meshes and uploads them, waiting for the queue. meshes without a cpu copy are read
+		// back (see vk_model::read_geometry). the last build must be retired or cleared first
+		void build(const vk_game_object::map& game_objects);
+		// the buffers are destroyed once the gpu is done with last_use_frame, the batch is empty right away
+		void retire(vk_deletion_queue& retired_resources, uint64_t last_use_frame);
+		// the buffers must not be in use on the gpu anymore
+		void clear();
+
+		// the index ranges of the cells in the frustum, for draw(). call once per frame
+		void cull(const glm::mat4& view_projection);
+		// rebinds vertex buffer 0 and the index buffer, nothing when every cell was culled
+		void draw(VkCommandBuffer command_buffer, uint32_t first_instance) const;
+
+		bool empty() const { return cells.empty(); }
+		// static objects with a model in the last build
+		uint32_t get_object_count() const { return stats.object_count; }
+		const static_batch_stats& get_stats() const { return stats; }
+
+	private:
+		struct cell
+		{
+			glm::vec4 sphere; // world space, xyz center, w radius
+			uint32_t first_index;
+			uint32_t index_count;
+		};
+
+		vk_device& device;
+		static_batch_config config;
+
+		std::unique_ptr<vk_buffer> vertex_buffer;
+		std::unique_ptr<vk_buffer> index_buffer;
+		std::vector<cell> cells; // z, then y, then x, so neighbours in x are neighbours in the index buffer
+
+		std::vector<glm::uvec2> visible_ranges; // first index, index count
+		static_batch_stats stats{};
+	};
+}
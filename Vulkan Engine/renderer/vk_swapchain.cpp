@@ -1,4 +1,5 @@
 #include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
 
 // std
 #include <array>
@@ -17,11 +18,11 @@ namespace vk_engine
 
 	vk_swapchain::vk_swapchain(vk_device& device_ref, const VkExtent2D window_extent,
 	                           std::shared_ptr<vk_swapchain> previous)
-		: device{device_ref}, window_extent{window_extent}
+		: device{device_ref}, window_extent{window_extent}, old_swap_chain{std::move(previous)}
 	{
 		init();
 
-		//clean up old swap chain as its no longer needed
+		// the old swap chain itself is kept alive by the renderer until its last frame retires
 		old_swap_chain = nullptr;
 	}
 
@@ -43,7 +44,7 @@ namespace vk_engine
 		{
 			vkDestroyImageView(device.get_device(), depth_image_views[i], nullptr);
 			vkDestroyImage(device.get_device(), depth_images[i], nullptr);
-			vkFreeMemory(device.get_device(), depth_image_memory[i], nullptr);
+			device.free_memory(depth_image_memory[i]);
 		}
 
 		for (const auto framebuffer : swap_chain_framebuffers)
@@ -54,23 +55,28 @@ namespace vk_engine
 		vkDestroyRenderPass(device.get_device(), render_pass, nullptr);
 
 		// cleanup synchronization objects
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			vkDestroySemaphore(device.get_device(), render_finished_semaphores[i], nullptr);
-			vkDestroySemaphore(device.get_device(), image_available_semaphores[i], nullptr);
-			vkDestroyFence(device.get_device(), in_flight_fences[i], nullptr);
-		}
+		// these are empty when a newer swap chain has taken them over
+		for (const auto semaphore : render_finished_semaphores)
+			vkDestroySemaphore(device.get_device(), semaphore, nullptr);
+		for (const auto semaphore : image_available_semaphores)
+			vkDestroySemaphore(device.get_device(), semaphore, nullptr);
+		for (const auto fence : in_flight_fences)
+			vkDestroyFence(device.get_device(), fence, nullptr);
 	}
 
 	VkResult vk_swapchain::acquire_next_image(uint32_t* image_index) const
 	{
-		vkWaitForFences(
-			device.get_device(),
-			1,
-			&in_flight_fences[current_frame],
-			VK_TRUE,
-			std::numeric_limits<uint64_t>::max());
+		{
+			VK_PROFILE_SCOPE("wait_for_frame_fence");
+			vkWaitForFences(
+				device.get_device(),
+				1,
+				&in_flight_fences[current_frame],
+				VK_TRUE,
+				std::numeric_limits<uint64_t>::max());
+		}
 
+		VK_PROFILE_SCOPE("acquire_next_image");
 		const VkResult result = vkAcquireNextImageKHR(
 			device.get_device(),
 			swap_chain,
@@ -87,6 +93,7 @@ namespace vk_engine
 	{
 		if (images_in_flight[*image_index] != VK_NULL_HANDLE)
 		{
+			VK_PROFILE_SCOPE("wait_for_image_fence");
 			vkWaitForFences(device.get_device(), 1, &images_in_flight[*image_index], VK_TRUE, UINT64_MAX);
 		}
 		images_in_flight[*image_index] = in_flight_fences[current_frame];
@@ -174,6 +181,9 @@ namespace vk_engine
 		create_info.imageExtent = extent;
 		create_info.imageArrayLayers = 1;
 		create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		// lets a smaller offscreen frame be blitted straight into the image
+		if (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+			create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
 		const auto [graphics_family, present_family, graphics_family_has_value, present_family_has_value] = device.
 			find_physical_queue_families();
@@ -386,10 +396,24 @@ namespace vk_engine
 
 	void vk_swapchain::create_sync_objects()
 	{
+		images_in_flight.resize(image_count(), VK_NULL_HANDLE);
+
+		if (old_swap_chain != nullptr)
+		{
+			// take over the per frame objects so frames still in flight keep being tracked by the same fences
+			image_available_semaphores = std::move(old_swap_chain->image_available_semaphores);
+			render_finished_semaphores = std::move(old_swap_chain->render_finished_semaphores);
+			in_flight_fences = std::move(old_swap_chain->in_flight_fences);
+			current_frame = old_swap_chain->current_frame;
+			old_swap_chain->image_available_semaphores.clear();
+			old_swap_chain->render_finished_semaphores.clear();
+			old_swap_chain->in_flight_fences.clear();
+			return;
+		}
+
 		image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
-		images_in_flight.resize(image_count(), VK_NULL_HANDLE);
 
 		VkSemaphoreCreateInfo semaphore_info = {};
 		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
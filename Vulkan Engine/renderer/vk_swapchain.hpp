@@ -26,8 +26,10 @@ namespace vk_engine
 		VkFramebuffer get_frame_buffer(const int index) const { return swap_chain_framebuffers[index]; }
 		VkRenderPass get_render_pass() const { return render_pass; }
 		VkImageView get_image_view(const int index) const { return swap_chain_image_views[index]; }
+		VkImage get_image(const int index) const { return swap_chain_images[index]; }
 		size_t image_count() const { return swap_chain_images.size(); }
 		VkFormat get_swap_chain_image_format() const { return swap_chain_image_format; }
+		VkFormat get_swap_chain_depth_format() const { return swap_chain_depth_format; }
 		VkExtent2D get_swap_chain_extent() const { return swap_chain_extent; }
 		uint32_t width() const { return swap_chain_extent.width; }
 		uint32_t height() const { return swap_chain_extent.height; }
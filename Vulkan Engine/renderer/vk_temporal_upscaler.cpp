@@ -0,0 +1,254 @@
+#include "vk_temporal_upscaler.hpp"
+#include "vk_swapchain.hpp"
+#include "../engine/vk_cpu_profiler.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace vk_engine
+{
+	namespace
+	{
+		// radical inverse of index in base, low discrepancy in (0, 1)
+		float halton(uint32_t index, const uint32_t base)
+		{
+			float fraction = 1.f;
+			float result = 0.f;
+			while (index > 0)
+			{
+				fraction /= static_cast<float>(base);
+				result += fraction * static_cast<float>(index % base);
+				index /= base;
+			}
+			return result;
+		}
+	}
+
+	vk_temporal_upscaler::vk_temporal_upscaler(vk_device& device, vk_pipeline_manager& pipeline_manager,
+	                                           const VkRenderPass resolve_pass, const temporal_config config)
+		: device{device}, pipeline_manager{pipeline_manager}, config{config}
+	{
+		assert(config.jitter_phases > 0 && "Temporal upscaling needs at least one jitter phase");
+
+		create_sampler();
+		create_descriptors();
+		create_pipeline(resolve_pass);
+	}
+
+	// the pipeline and its layout belong to the pipeline manager, the pipeline may still be compiling against the
+	// resolve pass
+	vk_temporal_upscaler::~vk_temporal_upscaler()
+	{
+		pipeline_manager.wait(pipeline);
+
+		destroy_histories();
+		vkDestroySampler(device.get_device(), sampler, nullptr);
+	}
+
+	void vk_temporal_upscaler::create_sampler()
+	{
+		// bilinear for the scene and the history, the velocity and the neighbourhood are fetched per texel
+		VkSamplerCreateInfo sampler_info{};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_LINEAR;
+		sampler_info.minFilter = VK_FILTER_LINEAR;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.minLod = 0.f;
+		sampler_info.maxLod = 0.f;
+
+		if (vkCreateSampler(device.get_device(), &sampler_info, nullptr, &sampler) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create temporal upscaler sampler!");
+	}
+
+	void vk_temporal_upscaler::create_descriptors()
+	{
+		resolve_set_layout = vk_descriptor_set_layout::builder(device)
+		                     .add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		                     .build();
+		descriptor_pool = vk_descriptor_pool::builder(device)
+		                  .set_max_sets(vk_swapchain::MAX_FRAMES_IN_FLIGHT)
+		                  .add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		                                 vk_swapchain::MAX_FRAMES_IN_FLIGHT * 3)
+		                  .build();
+		resolve_sets.resize(vk_swapchain::MAX_FRAMES_IN_FLIGHT);
+	}
+
+	void vk_temporal_upscaler::create_pipeline(const VkRenderPass resolve_pass)
+	{
+		pipeline_layout = pipeline_manager.get_pipeline_layout(
+			{resolve_set_layout->get_descriptor_set_layout()},
+			{{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(temporal_resolve_push)}});
+
+		pipeline = pipeline_manager.request(
+			"assets/shaders/fullscreen.vert.spv",
+			"assets/shaders/temporal_resolve.frag.spv",
+			[resolve_pass, layout = pipeline_layout](pipeline_config_info& pipeline_config)
+			{
+				// one triangle made up in the vertex shader, no depth attachment
+				pipeline_config.binding_descriptions.clear();
+				pipeline_config.attribute_descriptions.clear();
+				pipeline_config.depth_stencil_info.depthTestEnable = VK_FALSE;
+				pipeline_config.depth_stencil_info.depthWriteEnable = VK_FALSE;
+				vk_pipeline::set_color_attachment_count(pipeline_config, 2);
+				pipeline_config.render_pass = resolve_pass;
+				pipeline_config.pipeline_layout = layout;
+			});
+	}
+
+	void vk_temporal_upscaler::create_histories(const VkExtent2D extent)
+	{
+		VkImageCreateInfo image_info{};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = extent.width;
+		image_info.extent.height = extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.format = history_format;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImageViewCreateInfo view_info{};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = history_format;
+		view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+		for (auto& history : histories)
+		{
+			device.create_image_with_info(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, history.image,
+			                              history.memory);
+			view_info.image = history.image;
+			if (vkCreateImageView(device.get_device(), &view_info, nullptr, &history.view) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create temporal history image view!");
+		}
+
+		// both rest in shader read only layout between frames, the graph imports them that way
+		const VkCommandBuffer command_buffer = device.begin_single_time_commands();
+
+		VkImageMemoryBarrier barriers[2]{};
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barriers[i].srcAccessMask = 0;
+			barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].image = histories[i].image;
+			barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		}
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+		device.end_single_time_commands(command_buffer);
+
+		history_extent = extent;
+		history_valid = false;
+	}
+
+	void vk_temporal_upscaler::destroy_histories()
+	{
+		for (auto& history : histories)
+		{
+			if (history.image == VK_NULL_HANDLE)
+				continue;
+			vkDestroyImageView(device.get_device(), history.view, nullptr);
+			vkDestroyImage(device.get_device(), history.image, nullptr);
+			device.free_memory(history.memory);
+			history = {};
+		}
+	}
+
+	void vk_temporal_upscaler::begin_frame(const VkExtent2D new_render_extent, const VkExtent2D output_extent)
+	{
+		VK_PROFILE_FUNCTION();
+		assert(new_render_extent.width <= output_extent.width && new_render_extent.height <= output_extent.height &&
+			"Temporal upscaling renders at most at the output resolution");
+
+		if (output_extent.width != history_extent.width || output_extent.height != history_extent.height)
+		{
+			// rare enough that waiting beats keeping the old ones alive until the frames in flight are done
+			vkDeviceWaitIdle(device.get_device());
+			destroy_histories();
+			create_histories(output_extent);
+		}
+		else
+			history_index ^= 1;
+
+		render_extent = new_render_extent;
+		jitter_texels = glm::vec2{0.f};
+		if (enabled)
+		{
+			// halton from index 1, 0 would put the first offset in a corner
+			jitter_phase = (jitter_phase + 1) % config.jitter_phases;
+			jitter_texels = {halton(jitter_phase + 1, 2) - .5f, halton(jitter_phase + 1, 3) - .5f};
+		}
+		jitter_ndc = {
+			jitter_texels.x * 2.f / static_cast<float>(render_extent.width),
+			jitter_texels.y * 2.f / static_cast<float>(render_extent.height)
+		};
+	}
+
+	void vk_temporal_upscaler::set_enabled(const bool value)
+	{
+		enabled = value;
+		history_valid = false;
+	}
+
+	void vk_temporal_upscaler::resolve(const vk_frame_info& frame_info, const VkImageView scene_color,
+	                                   const VkImageView velocity)
+	{
+		VK_PROFILE_FUNCTION();
+		const auto ready_pipeline = pipeline_manager.get(pipeline);
+		if (ready_pipeline == nullptr)
+			return;
+
+		// the graph may have recreated the scene targets and the histories swapped, so this frame's set is
+		// rewritten every time. its fence was waited on, nothing reads it anymore
+		VkDescriptorImageInfo image_infos[3]{};
+		image_infos[0] = {sampler, scene_color, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		image_infos[1] = {sampler, velocity, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		image_infos[2] = {sampler, get_history_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+		auto& resolve_set = resolve_sets[frame_info.frame_index];
+		vk_descriptor_writer writer{*resolve_set_layout, *descriptor_pool};
+		writer.write_image(0, &image_infos[0])
+		      .write_image(1, &image_infos[1])
+		      .write_image(2, &image_infos[2]);
+		if (resolve_set == VK_NULL_HANDLE)
+		{
+			if (!writer.build(resolve_set))
+				throw std::runtime_error("failed to allocate temporal resolve descriptor set!");
+		}
+		else
+			writer.overwrite(resolve_set);
+
+		temporal_resolve_push push{};
+		push.area = {
+			static_cast<float>(render_extent.width), static_cast<float>(render_extent.height),
+			static_cast<float>(history_extent.width), static_cast<float>(history_extent.height)
+		};
+		push.jitter_weight = {jitter_texels.x, jitter_texels.y, enabled && history_valid ? config.history_weight : 0.f,
+		                      0.f};
+
+		ready_pipeline->bind(frame_info.command_buffer);
+		vkCmdBindDescriptorSets(frame_info.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
+		                        &resolve_set, 0, nullptr);
+		vkCmdPushConstants(frame_info.command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+		                   sizeof(temporal_resolve_push), &push);
+		vkCmdDraw(frame_info.command_buffer, 3, 1, 0, 0);
+
+		history_valid = true;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "vk_device.hpp"
+#include "simple_render_system/vk_descriptors.hpp"
+#include "simple_render_system/vk_pipeline_manager.hpp"
+#include "../engine/vk_frame_info.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+	struct temporal_config
+	{
+		float history_weight = .9f; // share of the history in every resolved pixel
+		uint32_t jitter_phases = 8; // halton(2, 3) offsets before the pattern repeats
+		// per axis, the range the reconstruction holds up in, see vk_resolution_controller::set_scale_range
+		float min_render_scale = .5f;
+		float max_render_scale = .7f;
+	};
+
+	// push constants of temporal_resolve.frag
+	struct temporal_resolve_push
+	{
+		glm::vec4 area{0.f}; // render area width and height in texels, target width and height
+		glm::vec4 jitter_weight{0.f}; // jitter in render texels, history weight (0 without a history), unused
+	};
+
+	// temporal upscaling: the scene is rendered with a different sub pixel jitter every frame into the top left of
+	// a full size target, the resolve pass reprojects last frame's full resolution result with the motion vectors
+	// and blends the new samples into it, clamped to the colors around them so stale history can't ghost. the two
+	// history images belong to the upscaler and swap every frame, the render graph imports them.
+	//
+	// usage: begin_frame() and vk_camera::set_jitter(get_jitter()) before the global ubo is written, bind
+	// get_history_*() and get_next_history_*() to the graph, then resolve() in the resolve pass that reads the
+	// scene and its velocity and writes the next history (attachment 0) and the output (attachment 1)
+	class vk_temporal_upscaler
+	{
+	public:
+		static constexpr VkFormat history_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		static constexpr VkFormat velocity_format = VK_FORMAT_R16G16_SFLOAT;
+
+		// the pipeline compiles in the background, nothing is resolved until it is ready
+		vk_temporal_upscaler(vk_device& device, vk_pipeline_manager& pipeline_manager, VkRenderPass resolve_pass,
+		                     temporal_config config = {});
+		~vk_temporal_upscaler();
+
+		vk_temporal_upscaler(const vk_temporal_upscaler&) = delete;
+		vk_temporal_upscaler& operator=(const vk_temporal_upscaler&) = delete;
+
+		// swaps the histories and picks this frame's jitter, recreates the histories (stalling the queue) when the
+		// output extent changed. call once per frame
+		void begin_frame(VkExtent2D render_extent, VkExtent2D output_extent);
+
+		// records the fullscreen resolve, inside the resolve pass
+		void resolve(const vk_frame_info& frame_info, VkImageView scene_color, VkImageView velocity);
+
+		// off is a plain bilinear upscale: no jitter and no history
+		void set_enabled(bool value);
+		bool is_enabled() const { return enabled; }
+		// the next resolve ignores the history, e.g. after a camera cut
+		void reset_history() { history_valid = false; }
+
+		// ndc, for vk_camera::set_jitter. zero while disabled
+		glm::vec2 get_jitter() const { return jitter_ndc; }
+		// read by the resolve, in shader read only layout
+		VkImage get_history_image() const { return histories[history_index].image; }
+		VkImageView get_history_view() const { return histories[history_index].view; }
+		// written by the resolve, left in shader read only layout for the next frame
+		VkImage get_next_history_image() const { return histories[history_index ^ 1].image; }
+		VkImageView get_next_history_view() const { return histories[history_index ^ 1].view; }
+		const temporal_config& get_config() const { return config; }
+
+	private:
+		struct history_image
+		{
+			VkImage image{};
+			VkDeviceMemory memory{};
+			VkImageView view{};
+		};
+
+		void create_sampler();
+		void create_descriptors();
+		void create_pipeline(VkRenderPass resolve_pass);
+		void create_histories(VkExtent2D extent);
+		void destroy_histories();
+
+		vk_device& device;
+		vk_pipeline_manager& pipeline_manager;
+		temporal_config config;
+
+		history_image histories[2]{};
+		uint32_t history_index = 0;
+		VkExtent2D history_extent{};
+		bool history_valid = false;
+		VkSampler sampler{};
+
+		std::unique_ptr<vk_descriptor_set_layout> resolve_set_layout;
+		std::unique_ptr<vk_descriptor_pool> descriptor_pool;
+		std::vector<VkDescriptorSet> resolve_sets; // one per frame in flight, rewritten every resolve
+
+		pipeline_handle pipeline;
+		VkPipelineLayout pipeline_layout{};
+
+		bool enabled = true;
+		uint32_t jitter_phase = 0;
+		VkExtent2D render_extent{};
+		glm::vec2 jitter_texels{0.f};
+		glm::vec2 jitter_ndc{0.f};
+	};
+}
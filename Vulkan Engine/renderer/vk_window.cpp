@@ -16,6 +16,12 @@ namespace vk_engine
 		glfwTerminate();
 	}
 
+	bool vk_window::is_display_available()
+	{
+		// init is reference free, the window's own init after this is a no-op
+		return glfwInit() == GLFW_TRUE;
+	}
+
 	bool vk_window::should_close() const
 	{
 		return glfwWindowShouldClose(window);
@@ -17,6 +17,9 @@ namespace vk_engine
 		vk_window(const vk_window&) = delete;
 		vk_window& operator=(const vk_window&) = delete;
 
+		// false when glfw can't reach a display server, e.g. on a build machine over ssh
+		static bool is_display_available();
+
 		bool should_close() const;
 		bool was_window_resized() const;
 		void reset_window_resized_flag();